@@ -0,0 +1,13 @@
+/*
+ * Common definitions for benchmarks on linux386.
+ */
+#ifndef __BENCH_H_
+#define __BENCH_H_ 1
+
+/*
+ * Process CPU time in microseconds, from the host C library.
+ * The headers of uOS replace the host <time.h>, so declare it here.
+ */
+extern long clock (void);
+
+#endif /* __BENCH_H_ */
@@ -0,0 +1,318 @@
+/*
+ * Benchmark of FAT file reads: build an image of FAT32 file system
+ * in a host file, with one contiguous and one fragmented file,
+ * read the files sequentially and at random positions through
+ * a flash driver over this file, and check the data.
+ * Reports the number of flash read requests, the number of restarts
+ * of multiple block read (non-sequential pages), CPU time and
+ * the throughput, estimated for SD card over SPI.
+ */
+#include <unistd.h>
+#include <fcntl.h>
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <flash/flash-interface.h>
+#include <fs/fat.h>
+#include <fs/fat-private.h>
+#include "bench.h"
+
+#define IMAGE		"bench_fat.img"
+#define SEC_SIZE	512
+#define SEC_PER_CLUS	8
+#define RSVD_SEC	32
+#define NB_CLUS		2048			/* clusters on the volume */
+#define FAT_SEC		((NB_CLUS + 2) * 4 / SEC_SIZE + 1)
+#define DATA_SEC	(RSVD_SEC + FAT_SEC)
+#define CLUS_SIZE	(SEC_SIZE * SEC_PER_CLUS)
+#define FILE_CLUS	384			/* clusters per file */
+#define FILE_SIZE	(FILE_CLUS * CLUS_SIZE - 100)
+#define NB_SEEKS	500			/* random reads per file */
+#define SEEK_BYTES	64			/* bytes per random read */
+
+/*
+ * Time of SD card over SPI at 20 MHz, microseconds.
+ */
+#define CMD_USEC	300			/* start of multiple block read */
+#define CALL_USEC	20			/* wait for data token */
+#define PAGE_USEC	210			/* transfer of 512 bytes */
+
+/*
+ * Flash driver over a host file.  Counts the requests and
+ * the non-sequential reads, like the SD card driver restarts
+ * the multiple block read.
+ */
+typedef struct {
+	flashif_t flashif;
+	int fd;
+	unsigned next_page;
+	unsigned long reads, pages, restarts;
+} file_flash_t;
+
+ARRAY (task, 8000);
+char memory [65536];
+mem_pool_t pool;
+file_flash_t flash;
+fat_fs_t fat;
+uint32_t fat_table [FAT_SEC * SEC_SIZE / 4];
+unsigned char clus_buf [CLUS_SIZE];
+
+static int
+file_flash_read (flashif_t *flashif, unsigned page_num, void *data, unsigned size)
+{
+	file_flash_t *f = (file_flash_t*) flashif;
+
+	f->reads++;
+	f->pages += (size + SEC_SIZE - 1) / SEC_SIZE;
+	if (page_num != f->next_page)
+		f->restarts++;
+	f->next_page = page_num + (size + SEC_SIZE - 1) / SEC_SIZE;
+
+	if (lseek (f->fd, (off_t) page_num * SEC_SIZE, SEEK_SET) < 0 ||
+	    read (f->fd, data, size) != size)
+		return FLASH_ERR_IO;
+	return FLASH_ERR_OK;
+}
+
+static int
+file_flash_write (flashif_t *flashif, unsigned page_num, void *data, unsigned size)
+{
+	file_flash_t *f = (file_flash_t*) flashif;
+
+	if (lseek (f->fd, (off_t) page_num * SEC_SIZE, SEEK_SET) < 0 ||
+	    write (f->fd, data, size) != size)
+		return FLASH_ERR_IO;
+	return FLASH_ERR_OK;
+}
+
+static void
+file_flash_init (file_flash_t *f, const char *name)
+{
+	f->fd = open (name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (f->fd < 0) {
+		debug_printf ("%s: cannot create\n", name);
+		uos_halt (0);
+	}
+	f->flashif.page_size = SEC_SIZE;
+	f->flashif.nb_pages_in_sector = 1;
+	f->flashif.nb_sectors = DATA_SEC + NB_CLUS * SEC_PER_CLUS;
+	f->flashif.read = file_flash_read;
+	f->flashif.write = file_flash_write;
+}
+
+/*
+ * Contents of the files.
+ */
+static inline unsigned char
+data_byte (unsigned file, unsigned pos)
+{
+	return pos ^ (pos >> 8) ^ (pos >> 16) ^ file;
+}
+
+static unsigned long seed = 1;
+
+static unsigned
+rnd (unsigned n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static void
+write_clus (unsigned clus, unsigned file, unsigned pos)
+{
+	unsigned i;
+
+	for (i=0; i<CLUS_SIZE; ++i)
+		clus_buf[i] = data_byte (file, pos + i);
+	flash_write (&flash.flashif, DATA_SEC + (clus - 2) * SEC_PER_CLUS,
+		clus_buf, CLUS_SIZE);
+}
+
+static void
+set_dir_entry (fat_dir_ent_t *de, const char *name, unsigned clus)
+{
+	memcpy (de->name, name, 11);
+	de->attr = FAT_ATTR_ARCHIVE;
+	de->fst_clus_hi = clus >> 16;
+	de->fst_clus_lo = clus;
+	de->file_size = FILE_SIZE;
+}
+
+/*
+ * Build the image: root directory in cluster 2, file 1 contiguous
+ * from cluster 3, file 2 in pieces of 1-4 clusters with gaps.
+ */
+static void
+make_image ()
+{
+	fat32_bs_t *bs = (fat32_bs_t*) clus_buf;
+	unsigned clus, prev, i, piece;
+
+	memset (clus_buf, 0, SEC_SIZE);
+	bs->jump_boot[0] = 0xEB;
+	bs->jump_boot[1] = 0x58;
+	bs->jump_boot[2] = 0x90;
+	bs->bytes_per_sec = SEC_SIZE;
+	bs->sec_per_clus = SEC_PER_CLUS;
+	bs->rsvd_sec_cnt = RSVD_SEC;
+	bs->num_fats = 1;
+	bs->media = 0xF8;
+	bs->tot_sec32 = DATA_SEC + NB_CLUS * SEC_PER_CLUS;
+	bs->fat_sz32 = FAT_SEC;
+	bs->root_clus = 2;
+	bs->boot_sig = 0x29;
+	clus_buf[510] = 0x55;
+	clus_buf[511] = 0xAA;
+	flash_write (&flash.flashif, 0, clus_buf, SEC_SIZE);
+
+	fat_table[0] = 0x0FFFFFF8;
+	fat_table[1] = 0x0FFFFFFF;
+	fat_table[2] = 0x0FFFFFFF;
+
+	memset (clus_buf, 0, CLUS_SIZE);
+	set_dir_entry ((fat_dir_ent_t*) clus_buf, "CONTIG  BIN", 3);
+	set_dir_entry ((fat_dir_ent_t*) clus_buf + 1, "FRAG    BIN",
+		3 + FILE_CLUS);
+	flash_write (&flash.flashif, DATA_SEC, clus_buf, CLUS_SIZE);
+
+	for (i=0; i<FILE_CLUS; ++i) {
+		fat_table[3 + i] = (i == FILE_CLUS-1) ? 0x0FFFFFFF : 4 + i;
+		write_clus (3 + i, 1, i * CLUS_SIZE);
+	}
+
+	prev = 0;
+	clus = 3 + FILE_CLUS;
+	for (i=0; i<FILE_CLUS; ) {
+		for (piece = rnd (4) + 1; piece > 0 && i < FILE_CLUS; --piece) {
+			if (prev)
+				fat_table[prev] = clus;
+			write_clus (clus, 2, i * CLUS_SIZE);
+			prev = clus++;
+			++i;
+		}
+		clus += rnd (3) + 1;
+	}
+	fat_table[prev] = 0x0FFFFFFF;
+	flash_write (&flash.flashif, RSVD_SEC, fat_table, sizeof (fat_table));
+}
+
+static fs_entry_t *
+find_file (fs_entry_t *root, const char *name)
+{
+	fs_entry_t *e;
+
+	for (e = fat.fsif.first_child (root); e; e = fat.fsif.next_child (root)) {
+		if (strcmp ((unsigned char*) e->name,
+		    (const unsigned char*) name) == 0)
+			return e;
+		fat.fsif.free_fs_entry (e);
+	}
+	debug_printf ("%s: not found, error %d\n", name, fat.fsif.last_error);
+	uos_halt (0);
+	return 0;
+}
+
+/*
+ * Read n bytes from the current position, and check them.
+ */
+static unsigned
+read_check (fs_entry_t *e, unsigned file, unsigned n)
+{
+	unsigned limit, i, bad = 0;
+
+	while (n > 0 && ! fs_at_end (e)) {
+		fat.fsif.update_cache (e);
+		if (fat.fsif.last_error != FS_ERR_OK) {
+			debug_printf ("read error %d at %u\n",
+				fat.fsif.last_error, e->cur_pos);
+			return 1;
+		}
+		limit = fs_size_to_end_of_cache (e);
+		if (limit > n)
+			limit = n;
+		for (i=0; i<limit; ++i)
+			if (e->cache_p[i] != data_byte (file, e->cur_pos + i))
+				++bad;
+		fat.fsif.advance (e, limit);
+		n -= limit;
+	}
+	return bad;
+}
+
+static void
+report (const char *name, long t0, unsigned long bytes, unsigned bad)
+{
+	unsigned long usec;
+
+	usec = flash.reads * CALL_USEC + flash.restarts * CMD_USEC +
+		flash.pages * PAGE_USEC;
+	debug_printf ("%s: %lu reads, %lu restarts, %lu pages, CPU %ld usec, SD %lu kbytes/sec",
+		name, flash.reads, flash.restarts, flash.pages,
+		clock () - t0, bytes * 1000 / usec * 1000 / 1024);
+	if (bad)
+		debug_printf (", %u BAD BYTES", bad);
+	debug_printf ("\n");
+	flash.reads = flash.pages = flash.restarts = 0;
+}
+
+static void
+bench (fs_entry_t *root, const char *name, unsigned file)
+{
+	fs_entry_t *e;
+	unsigned bad, i, pos;
+	long t0;
+
+	e = find_file (root, name);
+	fat.fsif.open (e);
+
+	flash.reads = flash.pages = flash.restarts = 0;
+	t0 = clock ();
+	bad = read_check (e, file, FILE_SIZE);
+	report ("Sequential", t0, FILE_SIZE, bad);
+
+	t0 = clock ();
+	bad = 0;
+	for (i=0; i<NB_SEEKS; ++i) {
+		pos = rnd (FILE_SIZE - SEEK_BYTES);
+		fat.fsif.seek_start (e);
+		fat.fsif.advance (e, pos);
+		bad += read_check (e, file, SEEK_BYTES);
+	}
+	report ("Random    ", t0, NB_SEEKS * SEEK_BYTES, bad);
+
+	fat.fsif.close (e);
+	fat.fsif.free_fs_entry (e);
+}
+
+void main_task (void *data)
+{
+	fs_entry_t *root;
+
+	make_image ();
+	fat_fs_init (&fat, &pool, &flash.flashif, 0);
+	if (fat.fsif.last_error != FS_ERR_OK ||
+	    fat.fsif.fs_type != FS_TYPE_FAT32) {
+		debug_printf ("fat_fs_init: error %d\n", fat.fsif.last_error);
+		uos_halt (0);
+	}
+	root = fat.fsif.get_root (&fat.fsif);
+
+	debug_printf ("Contiguous file, %u bytes:\n", FILE_SIZE);
+	bench (root, "CONTIG.BIN", 1);
+	debug_printf ("Fragmented file, %u bytes:\n", FILE_SIZE);
+	bench (root, "FRAG.BIN", 2);
+	debug_printf ("Free memory %u bytes\n", mem_available (&pool));
+
+	fat.fsif.free_fs_entry (root);
+	close (flash.fd);
+	unlink (IMAGE);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	mem_init (&pool, (size_t) memory, (size_t) memory + sizeof (memory));
+	file_flash_init (&flash, IMAGE);
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
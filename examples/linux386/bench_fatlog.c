@@ -0,0 +1,264 @@
+/*
+ * Benchmark of data logging to FAT32 Fast Write: a task writes
+ * records at a constant rate to a slow flash, which models SD card
+ * over SPI with periodic busy periods. The file is written
+ * synchronously, and through the ring of buffers with the writer task.
+ * Reports the worst and average time of fat32_fw_write(),
+ * checks the data, the size in the directory and the cluster chain.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <timer/timer.h>
+#include <flash/flash-interface.h>
+#include <fs/fat-private.h>
+#include <fs/fat32-fast-write.h>
+#include "bench.h"
+
+#define SEC_SIZE	512
+#define NB_SEC		16384			/* 8 Mbytes */
+#define REC_SIZE	100			/* bytes per record */
+#define COUNT		20000			/* records per test */
+#define RECS_PER_MSEC	4			/* logging rate */
+#define SYNC_RECS	5000			/* fat32_fw_sync() period */
+#define NB_BUFS		4
+#define BUF_SIZE	(SEC_SIZE * 16)
+
+/*
+ * Time of SD card over SPI at 20 MHz, microseconds.
+ */
+#define CMD_USEC	300			/* start of multiple block write */
+#define CALL_USEC	20			/* wait for ready */
+#define PAGE_USEC	210			/* transfer of 512 bytes */
+#define BUSY_PAGES	512			/* busy period every 256 kbytes */
+#define BUSY_USEC	20000			/* busy period */
+
+/*
+ * Flash driver over a memory array, with the time of SD card.
+ */
+typedef struct {
+	flashif_t flashif;
+	unsigned next_page;
+	unsigned long calls, pages, restarts;
+} ram_flash_t;
+
+ARRAY (task, 8000);
+ARRAY (writer_stack, 8000);
+timer_t timer;
+ram_flash_t flash;
+fat32_fw_t fat;
+fat32_fw_writer_t writer;
+fs_entry_t file_entry;
+char file_name [12];			/* fat32_fw_create() copies 12 bytes */
+unsigned char disk [NB_SEC * SEC_SIZE];
+unsigned char bufs [NB_BUFS * BUF_SIZE] __attribute__((aligned(8)));
+unsigned char rec [REC_SIZE];
+
+static void
+delay_usec (long usec)
+{
+	long t0 = clock ();
+
+	while (clock () - t0 < usec)
+		continue;
+}
+
+static int
+ram_flash_write (flashif_t *flashif, unsigned page_num, void *data, unsigned size)
+{
+	ram_flash_t *f = (ram_flash_t*) flashif;
+	unsigned n = (size + SEC_SIZE - 1) / SEC_SIZE;
+	long usec;
+
+	if (page_num + n > NB_SEC)
+		return FLASH_ERR_INVAL_SIZE;
+	mutex_lock (&f->flashif.lock);
+	usec = CALL_USEC + n * PAGE_USEC;
+	if (page_num != f->next_page) {
+		usec += CMD_USEC;
+		f->restarts++;
+	}
+	if ((f->pages + n) / BUSY_PAGES != f->pages / BUSY_PAGES)
+		usec += BUSY_USEC;
+	f->calls++;
+	f->pages += n;
+	f->next_page = page_num + n;
+	memcpy (disk + page_num * SEC_SIZE, data, size);
+	delay_usec (usec);
+	mutex_unlock (&f->flashif.lock);
+	return FLASH_ERR_OK;
+}
+
+static int
+ram_flash_read (flashif_t *flashif, unsigned page_num, void *data, unsigned size)
+{
+	if (page_num + (size + SEC_SIZE - 1) / SEC_SIZE > NB_SEC)
+		return FLASH_ERR_INVAL_SIZE;
+	memcpy (data, disk + page_num * SEC_SIZE, size);
+	return FLASH_ERR_OK;
+}
+
+static int
+ram_flash_erase_all (flashif_t *flashif)
+{
+	memset (disk, 0, sizeof (disk));
+	return FLASH_ERR_OK;
+}
+
+static int
+ram_flash_flush (flashif_t *flashif)
+{
+	return FLASH_ERR_OK;
+}
+
+static void
+ram_flash_init (ram_flash_t *f)
+{
+	f->flashif.page_size = SEC_SIZE;
+	f->flashif.nb_pages_in_sector = 1;
+	f->flashif.nb_sectors = NB_SEC;
+	f->flashif.write = ram_flash_write;
+	f->flashif.read = ram_flash_read;
+	f->flashif.erase_all = ram_flash_erase_all;
+	f->flashif.flush = ram_flash_flush;
+}
+
+static inline unsigned char
+data_byte (unsigned file, unsigned pos)
+{
+	return pos ^ (pos >> 8) ^ (pos >> 16) ^ file;
+}
+
+/*
+ * Read the file back and count bad bytes.
+ */
+static unsigned
+check_data (unsigned file, unsigned size)
+{
+	unsigned pos, n, i, bad = 0;
+
+	fat32_fw_open (&fat, O_READ);
+	for (pos=0; pos<size; pos+=n) {
+		n = fat32_fw_read (&fat, rec, REC_SIZE);
+		if (fat32_fw_last_error (&fat) != FS_ERR_OK || n == 0)
+			return bad + size - pos;
+		for (i=0; i<n; ++i)
+			if (rec[i] != data_byte (file, pos + i))
+				++bad;
+	}
+	fat32_fw_close (&fat);
+	return bad;
+}
+
+/*
+ * Walk the cluster chain in the first FAT, return the number of clusters.
+ */
+static unsigned
+chain_length (unsigned clus)
+{
+	uint32_t *tab = (uint32_t*) (disk + fat.rsvd_sec_cnt * SEC_SIZE);
+	unsigned n;
+
+	for (n=1; n<=fat.tot_clus; ++n) {
+		if (tab[clus] >= FAT32_FILE_END)
+			return n;
+		clus = tab[clus];
+	}
+	return 0;
+}
+
+static void
+test (const char *name, unsigned file)
+{
+	unsigned i, k, bad, clusters, expected;
+	long t0, t, t_max, t_sum;
+	fs_entry_t *e;
+
+	memset (file_name, 0, sizeof (file_name));
+	strncpy ((unsigned char*) file_name, (const unsigned char*) name,
+		sizeof (file_name) - 1);
+	file_entry.name = file_name;
+	fat32_fw_create (&fat, &file_entry);
+	fat32_fw_open (&fat, O_WRITE);
+	if (fat32_fw_last_error (&fat) != FS_ERR_OK) {
+		debug_printf ("%s: cannot create, error %d\n", name,
+			fat32_fw_last_error (&fat));
+		uos_halt (0);
+	}
+	flash.calls = flash.pages = flash.restarts = 0;
+	t_max = t_sum = 0;
+	for (i=0; i<COUNT; ++i) {
+		for (k=0; k<REC_SIZE; ++k)
+			rec[k] = data_byte (file, i * REC_SIZE + k);
+		t0 = clock ();
+		fat32_fw_write (&fat, rec, REC_SIZE);
+		t = clock () - t0;
+		if (fat32_fw_last_error (&fat) != FS_ERR_OK) {
+			debug_printf ("%s: write error %d\n", name,
+				fat32_fw_last_error (&fat));
+			uos_halt (0);
+		}
+		t_sum += t;
+		if (t > t_max)
+			t_max = t;
+		if (i % SYNC_RECS == SYNC_RECS - 1)
+			fat32_fw_sync (&fat);
+		if (i % RECS_PER_MSEC == RECS_PER_MSEC - 1)
+			timer_delay (&timer, 1);
+	}
+	fat32_fw_close (&fat);
+	if (fat32_fw_last_error (&fat) != FS_ERR_OK) {
+		debug_printf ("%s: close error %d\n", name,
+			fat32_fw_last_error (&fat));
+		uos_halt (0);
+	}
+	debug_printf ("%s: write max %ld usec, average %ld usec; %lu calls, %lu restarts, %lu pages\n",
+		name, t_max, t_sum / COUNT, flash.calls, flash.restarts,
+		flash.pages);
+
+	bad = check_data (file, COUNT * REC_SIZE);
+	clusters = chain_length (fat.cur_dir_entry.first_clus);
+	expected = (COUNT * REC_SIZE + SEC_SIZE * FAT_SEC_PER_CLUSTER - 1) /
+		(SEC_SIZE * FAT_SEC_PER_CLUSTER);
+	for (e = get_first_entry (&fat); e; e = get_next_entry (&fat))
+		if (strcmp ((unsigned char*) e->name,
+		    (const unsigned char*) name) == 0)
+			break;
+	if (bad || clusters != expected || ! e || e->size != COUNT * REC_SIZE)
+		debug_printf ("%s: %u BAD BYTES, %u of %u clusters, size %lu\n",
+			name, bad, clusters, expected,
+			e ? (unsigned long) e->size : 0);
+}
+
+void main_task (void *data)
+{
+	fat32_fw_init (&fat, &flash.flashif);
+	fat32_fw_format (&fat, NB_SEC, "BENCH FATFW");
+	fat32_fw_init (&fat, &flash.flashif);
+	if (fat32_fw_last_error (&fat) != FS_ERR_OK) {
+		debug_printf ("fat32_fw_init: error %d\n", fat32_fw_last_error (&fat));
+		uos_halt (0);
+	}
+	file_entry.year = 2016;
+	file_entry.month = 1;
+	file_entry.day = 1;
+
+	debug_printf ("%u records of %u bytes, %u records per msec, busy %u msec every %u kbytes\n",
+		COUNT, REC_SIZE, RECS_PER_MSEC, BUSY_USEC / 1000,
+		BUSY_PAGES * SEC_SIZE / 1024);
+	test ("SYNC.LOG", 1);
+
+	fat32_fw_writer_init (&fat, &writer, bufs, NB_BUFS, BUF_SIZE, &timer);
+	fat32_fw_writer_start (&fat, 5, writer_stack, sizeof (writer_stack));
+	test ("ASYNC.LOG", 2);
+	debug_printf ("Writer: %lu buffers, %lu stalls, queued max %u of %u, write max %lu msec, flash max %lu msec\n",
+		writer.buffers, writer.stalls, writer.max_queued, NB_BUFS,
+		writer.max_write_msec, writer.max_flash_msec);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	timer_init (&timer, KHZ, 1);
+	ram_flash_init (&flash);
+	task_create (main_task, 0, "main", 10, task, sizeof (task));
+}
@@ -0,0 +1,229 @@
+/*
+ * Benchmark of the flash page cache: run typical access patterns
+ * of file systems on a flash in memory, directly and through
+ * the cache, and check that the contents are the same.
+ * Reports the hit rate, the number of device requests, CPU time and
+ * the time of the device, estimated for SD card over SPI.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <flash/flash-ram.h>
+#include <flash/flash-cache.h>
+#include "bench.h"
+
+#define PAGE_SIZE	512
+#define NB_PAGES	16384			/* 8 Mbytes */
+#define CACHE_BYTES	65536
+#define NB_OPS		20000			/* requests per test */
+#define HOT_PAGES	48			/* FAT and directory */
+
+/*
+ * Time of SD card over SPI at 20 MHz, microseconds.
+ */
+#define CMD_USEC	300			/* start of multiple block transfer */
+#define CALL_USEC	20			/* wait for data token */
+#define PAGE_USEC	210			/* transfer of 512 bytes */
+
+ARRAY (task, 8000);
+flash_ram_t raw, dev;
+flash_cache_t cache;
+unsigned char raw_mem [NB_PAGES * PAGE_SIZE];
+unsigned char dev_mem [NB_PAGES * PAGE_SIZE];
+unsigned long cache_buf [CACHE_BYTES / sizeof (long)];
+unsigned char buf [PAGE_SIZE * 32];
+unsigned bad;
+
+static unsigned long seed;
+
+static unsigned
+rnd (unsigned n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static void
+fill_buf (unsigned page, unsigned size)
+{
+	unsigned i;
+
+	for (i=0; i<size; ++i)
+		buf[i] = page + i + seed;
+}
+
+static unsigned long
+checksum (unsigned size)
+{
+	unsigned long sum = 0;
+	unsigned i;
+
+	for (i=0; i<size; ++i)
+		sum = sum * 31 + buf[i];
+	return sum;
+}
+
+static unsigned long
+do_read (flashif_t *f, unsigned page, unsigned size)
+{
+	if (flash_read (f, page, buf, size) != FLASH_ERR_OK)
+		++bad;
+	return checksum (size);
+}
+
+static void
+do_write (flashif_t *f, unsigned page, unsigned size)
+{
+	fill_buf (page, size);
+	if (flash_write (f, page, buf, size) != FLASH_ERR_OK)
+		++bad;
+}
+
+/*
+ * Access patterns. Return the sum of data read.
+ */
+static unsigned long
+seq_read (flashif_t *f)
+{
+	unsigned long sum = 0;
+	unsigned i;
+
+	for (i=0; i<NB_PAGES/2; ++i)
+		sum += do_read (f, i, PAGE_SIZE);
+	return sum;
+}
+
+static unsigned long
+hot_read (flashif_t *f)
+{
+	unsigned long sum = 0;
+	unsigned i;
+
+	for (i=0; i<NB_OPS; ++i) {
+		if (rnd (10) == 0)
+			sum += do_read (f, rnd (NB_PAGES), PAGE_SIZE);
+		else
+			sum += do_read (f, 32 + rnd (HOT_PAGES), PAGE_SIZE);
+	}
+	return sum;
+}
+
+static unsigned long
+seq_write (flashif_t *f)
+{
+	unsigned i;
+
+	for (i=0; i<NB_PAGES/2; ++i)
+		do_write (f, NB_PAGES/2 + i, PAGE_SIZE);
+	return 0;
+}
+
+/*
+ * Logging through a file system, like fat32-fast-write with sync:
+ * data in records of 200 bytes, the sectors of FAT and
+ * of the directory are updated every 10 records.
+ */
+static unsigned long
+log_write (flashif_t *f)
+{
+	unsigned i, end;
+
+	for (i=0; i<NB_OPS; ++i) {
+		/* The partial sector is written from its start. */
+		end = i * 200 % PAGE_SIZE + 200;
+		do_write (f, 4096 + i * 200 / PAGE_SIZE,
+			end < PAGE_SIZE ? end : PAGE_SIZE);
+		if (end > PAGE_SIZE)
+			do_write (f, 4096 + i * 200 / PAGE_SIZE + 1, end - PAGE_SIZE);
+		if (i % 10 == 9) {
+			do_write (f, 32 + i * 200 / (PAGE_SIZE * 64 * 128), 4);
+			do_write (f, 40, 32);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Random reads and writes of 1 to 32 pages, and reads of what is written.
+ */
+static unsigned long
+mixed (flashif_t *f)
+{
+	unsigned long sum = 0;
+	unsigned i, page, n;
+
+	for (i=0; i<NB_OPS/4; ++i) {
+		n = 1 + rnd (32);
+		page = rnd (NB_PAGES - n);
+		if (rnd (3) == 0)
+			do_write (f, page, n * PAGE_SIZE - rnd (2) * 100);
+		else
+			sum += do_read (f, page, n * PAGE_SIZE);
+	}
+	return sum;
+}
+
+static unsigned long
+usec (flash_ram_t *m)
+{
+	return (m->reads + m->writes) * CALL_USEC + m->restarts * CMD_USEC +
+		(m->pages_read + m->pages_written) * PAGE_USEC;
+}
+
+static void
+test (const char *name, unsigned long (*func) (flashif_t*))
+{
+	unsigned long sum1, sum2, s;
+	long t0, t1, t2;
+
+	raw.reads = raw.writes = raw.pages_read = raw.pages_written = raw.restarts = 0;
+	dev.reads = dev.writes = dev.pages_read = dev.pages_written = dev.restarts = 0;
+	cache.hits = cache.misses = cache.prefetched = 0;
+
+	s = seed;
+	t0 = clock ();
+	sum1 = func (&raw.flashif);
+	flash_flush (&raw.flashif);
+	t1 = clock ();
+	seed = s;
+	sum2 = func (&cache.flashif);
+	flash_flush (&cache.flashif);
+	t2 = clock ();
+
+	debug_printf ("%-22s direct %5lu calls %5lu msec, CPU %4ld msec\n",
+		name, raw.reads + raw.writes, usec (&raw) / 1000,
+		(t1 - t0) / 1000);
+	debug_printf ("%-22s cached %5lu calls %5lu msec, CPU %4ld msec, %lu%% hits, %lu prefetched\n",
+		"", dev.reads + dev.writes, usec (&dev) / 1000, (t2 - t1) / 1000,
+		cache.hits * 100 / (cache.hits + cache.misses + 1), cache.prefetched);
+	if (sum1 != sum2 || memcmp (raw_mem, dev_mem, sizeof (raw_mem)) != 0 || bad)
+		debug_printf ("%s: DATA DIFFER\n", name);
+}
+
+void main_task (void *data)
+{
+	unsigned i;
+
+	if (flash_connect (&cache.flashif) != FLASH_ERR_OK) {
+		debug_printf ("flash_connect: cache too small\n");
+		uos_halt (0);
+	}
+	debug_printf ("Cache %u bytes, %u sets of %u pages\n",
+		CACHE_BYTES, cache.nb_sets, FLASH_CACHE_WAYS);
+	for (i=0; i<sizeof (raw_mem); ++i)
+		raw_mem[i] = dev_mem[i] = i ^ (i >> 9);
+
+	test ("Sequential read", seq_read);
+	test ("Hot pages read", hot_read);
+	test ("Sequential write", seq_write);
+	test ("Log with metadata", log_write);
+	test ("Mixed, 1-32 pages", mixed);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	flash_ram_init (&raw, raw_mem, NB_PAGES, PAGE_SIZE);
+	flash_ram_init (&dev, dev_mem, NB_PAGES, PAGE_SIZE);
+	flash_cache_init (&cache, &dev.flashif, cache_buf, sizeof (cache_buf));
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
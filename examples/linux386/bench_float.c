@@ -0,0 +1,77 @@
+/*
+ * Benchmark of floating-point output: sensor-like doubles formatted
+ * with %f, %e, %g and shortest %lg, by uOS snprintf and by
+ * the host C library.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <stream/stream.h>
+#include "bench.h"
+
+#define COUNT		200000		/* values per test */
+
+/* Host C library. */
+extern int __vsnprintf (char *buf, size_t size, const char *fmt, va_list args);
+extern long random (void);
+
+ARRAY (task, 0x2000);
+double values [1000];
+
+static int
+host_snprintf (char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	va_start (args, fmt);
+	n = __vsnprintf (buf, size, fmt, args);
+	va_end (args);
+	return n;
+}
+
+static void
+bench (const char *fmt)
+{
+	unsigned char buf [64];
+	unsigned long i, bytes;
+	long t0, t1, t2;
+
+	bytes = 0;
+	t0 = clock ();
+	for (i=0; i<COUNT; ++i)
+		bytes += snprintf (buf, sizeof (buf), fmt, values [i % 1000]);
+	t1 = clock ();
+	for (i=0; i<COUNT; ++i)
+		bytes += host_snprintf ((char*) buf, sizeof (buf), fmt,
+			values [i % 1000]);
+	t2 = clock ();
+	debug_printf ("%-6s uos %4lu nsec, libc %4lu nsec per value\n", fmt,
+		(unsigned long) (t1 - t0) * 1000 / COUNT,
+		(unsigned long) (t2 - t1) * 1000 / COUNT);
+}
+
+void main_task (void *data)
+{
+	int i;
+
+	/* Temperatures, voltages, pressures and small currents. */
+	for (i=0; i<1000; ++i) {
+		switch (i % 4) {
+		case 0: values[i] = (random () % 20000 - 5000) / 100.0;	break;
+		case 1: values[i] = (random () % 330000) / 100000.0;	break;
+		case 2: values[i] = 101325.0 + (random () % 2000 - 1000) / 7.0; break;
+		case 3: values[i] = (random () % 1000) * 1e-6 / 3.0;	break;
+		}
+	}
+	bench ("%f");
+	bench ("%.2f");
+	bench ("%e");
+	bench ("%g");
+	bench ("%lg");
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,165 @@
+/*
+ * Benchmark of IP forwarding: host A -> router R -> host B,
+ * connected by two virtual switches. Compares the forwarding rate
+ * of the slow path (flow cache flushed for every packet)
+ * with the flow cache fast path.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <buf/buf.h>
+#include <net/arp.h>
+#include <net/route.h>
+#include <net/ip.h>
+#include <net/udp.h>
+#include <timer/timer.h>
+#include <vnet/vswitch.h>
+
+#define MEM_SIZE	200000
+#define COUNT		50000		/* datagrams per test */
+#define SIZE		64		/* bytes per datagram */
+#define PORT		5001
+
+typedef struct {
+	ip_t ip;
+	mem_pool_t pool;
+	vswitch_port_t port [2];
+	route_t route [2];
+	route_t gw;
+	arp_t *arp;
+	ARRAY (arp_data, sizeof(arp_t) + 10 * sizeof(arp_entry_t));
+	ARRAY (group, sizeof(mutex_group_t) + 4 * sizeof(mutex_slot_t));
+	char memory [MEM_SIZE];
+} node_t;
+
+ARRAY (task, 8000);
+ARRAY (sink_task, 8000);
+timer_t timer;
+vswitch_t sw1, sw2;
+node_t a, r, b;
+udp_socket_t sock_a, sock_sink;
+
+unsigned char addr_a[]  = "\12\0\1\1";		/* 10.0.1.1 */
+unsigned char addr_r0[] = "\12\0\1\2";		/* 10.0.1.2 */
+unsigned char addr_r1[] = "\12\0\2\2";		/* 10.0.2.2 */
+unsigned char addr_b[]  = "\12\0\2\1";		/* 10.0.2.1 */
+
+volatile unsigned long sink_packets;
+
+void sink (void *arg)
+{
+	buf_t *p;
+
+	udp_socket (&sock_sink, &b.ip, PORT);
+	for (;;) {
+		p = udp_recvfrom (&sock_sink, 0, 0);
+		++sink_packets;
+		buf_free (p);
+	}
+}
+
+static void
+send_udp (void)
+{
+	buf_t *p;
+
+	p = buf_alloc (&a.pool, SIZE, 64);
+	if (! p) {
+		timer_delay (&timer, 1);
+		return;
+	}
+	memset (p->payload, 0x5a, SIZE);
+	mutex_lock (&a.ip.lock);
+	udp_sendto (&sock_a, p, addr_b, PORT);
+	mutex_unlock (&a.ip.lock);
+}
+
+void bench (const char *name, bool_t flush)
+{
+	unsigned long t0, t1, i, n0, forw0, cached0;
+
+	sink_packets = 0;
+	forw0 = r.ip.forw_datagrams;
+	cached0 = r.ip.forw_cached;
+	t0 = timer_milliseconds (&timer);
+	for (i=0; i<COUNT; ++i) {
+		if (flush) {
+			mutex_lock (&r.ip.lock);
+			ip_flow_flush (&r.ip);
+			mutex_unlock (&r.ip.lock);
+		}
+		send_udp ();
+		if (i % 8 == 7)
+			task_yield ();
+	}
+	do {
+		n0 = sink_packets;
+		timer_delay (&timer, 50);
+	} while (n0 != sink_packets);
+	t1 = timer_milliseconds (&timer) - 50;
+	if (t1 == t0)
+		t1 = t0 + 1;
+	debug_printf ("%s: %lu forwarded (%lu by flow cache), %lu delivered, %lu packets/sec\n",
+		name, r.ip.forw_datagrams - forw0, r.ip.forw_cached - cached0,
+		sink_packets, (r.ip.forw_datagrams - forw0) * 1000 / (t1 - t0));
+}
+
+void main_task (void *data)
+{
+	udp_socket (&sock_a, &a.ip, 5000);
+
+	/* Resolve MAC addresses. */
+	send_udp ();
+	timer_delay (&timer, 100);
+	send_udp ();
+	timer_delay (&timer, 100);
+
+	bench ("Slow path", 1);
+	bench ("Flow cache", 0);
+	uos_halt (0);
+}
+
+void node_init (node_t *n, int prio)
+{
+	mutex_group_t *g;
+
+	mem_init (&n->pool, (size_t) n->memory, (size_t) n->memory + MEM_SIZE);
+	n->arp = arp_init (n->arp_data, sizeof(n->arp_data), &n->ip);
+
+	g = mutex_group_init (n->group, sizeof(n->group));
+	mutex_group_add (g, &n->port[0].netif.lock);
+	mutex_group_add (g, &n->port[1].netif.lock);
+	mutex_group_add (g, &timer.decisec);
+	ip_init (&n->ip, &n->pool, prio, &timer, n->arp, g);
+}
+
+void uos_init (void)
+{
+	timer_init (&timer, KHZ, 1);
+	vswitch_init (&sw1, 0, 0);
+	vswitch_init (&sw2, 0, 0);
+
+	node_init (&a, 70);
+	vswitch_port_init (&a.port[0], &sw1, "a0", a.arp,
+		(const unsigned char*) "\0\1\2\3\1\1");
+	route_add_netif (&a.ip, &a.route[0], addr_a, 24, &a.port[0].netif);
+	route_add_gateway (&a.ip, &a.gw, (unsigned char*) "\0\0\0\0", 0, addr_r0);
+
+	node_init (&r, 71);
+	vswitch_port_init (&r.port[0], &sw1, "r0", r.arp,
+		(const unsigned char*) "\0\1\2\3\2\1");
+	vswitch_port_init (&r.port[1], &sw2, "r1", r.arp,
+		(const unsigned char*) "\0\1\2\3\2\2");
+	route_add_netif (&r.ip, &r.route[0], addr_r0, 24, &r.port[0].netif);
+	route_add_netif (&r.ip, &r.route[1], addr_r1, 24, &r.port[1].netif);
+	r.ip.forwarding = 1;
+
+	node_init (&b, 72);
+	vswitch_port_init (&b.port[0], &sw2, "b0", b.arp,
+		(const unsigned char*) "\0\1\2\3\3\1");
+	route_add_netif (&b.ip, &b.route[0], addr_b, 24, &b.port[0].netif);
+	route_add_gateway (&b.ip, &b.gw, (unsigned char*) "\0\0\0\0", 0, addr_r1);
+
+	task_create (sink, 0, "sink", 10, sink_task, sizeof (sink_task));
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,107 @@
+/*
+ * Benchmark of deferred logging: the time a task spends per log line,
+ * when the line is printed synchronously to a slow serial port,
+ * and when it is stored by log_printf() for the drain task.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <stream/stream.h>
+#include <timer/timer.h>
+#include <log/log.h>
+#include "bench.h"
+
+#define COUNT		2000		/* lines per test */
+#define BURST		100		/* lines between flushes */
+#define BYTE_USEC	10		/* serial port speed: 1 Mbit/sec */
+
+typedef struct {
+	stream_interface_t *interface;
+	mutex_t lock;
+	unsigned long bytes;
+} serial_t;
+
+ARRAY (task, 8000);
+ARRAY (log_task, 8000);
+ARRAY (log_buf, sizeof(log_t) + 32768);
+timer_t timer;
+serial_t serial;
+log_t *lg;
+
+/*
+ * Transmit the data, waiting until it is sent.
+ */
+static void
+serial_send (serial_t *u, int len)
+{
+	long t0;
+
+	mutex_lock (&u->lock);
+	u->bytes += len;
+	t0 = clock ();
+	while (clock () - t0 < len * BYTE_USEC)
+		continue;
+	mutex_unlock (&u->lock);
+}
+
+static void
+serial_putchar (serial_t *u, short c)
+{
+	serial_send (u, 1);
+}
+
+static int
+serial_write (serial_t *u, const void *buf, int len)
+{
+	serial_send (u, len);
+	return len;
+}
+
+static stream_interface_t serial_interface = {
+	.putc = (void (*) (stream_t*, short))		serial_putchar,
+	.write = (int (*) (stream_t*, const void*, int))	serial_write,
+};
+
+void main_task (void *data)
+{
+	unsigned long i, bytes;
+	long t0, t_sync, t_log, t_drain;
+
+	t0 = clock ();
+	for (i=0; i<COUNT; ++i)
+		printf (&serial, "eth0: rx %lu packets, %lu bytes, queue %d\n",
+			i, i * 1500, (int) i & 15);
+	t_sync = clock () - t0;
+	bytes = serial.bytes;
+
+	t_log = 0;
+	t_drain = 0;
+	for (i=0; i<COUNT; ++i) {
+		t0 = clock ();
+		log_printf (lg, "eth0: rx %lu packets, %lu bytes, queue %d\n",
+			i, i * 1500, (int) i & 15);
+		t_log += clock () - t0;
+		if (i % BURST == BURST - 1) {
+			/* Let the drain task run. */
+			t0 = clock ();
+			log_flush (lg);
+			t_drain += clock () - t0;
+		}
+	}
+	debug_printf ("Synchronous printf: %lu nsec per line\n",
+		(unsigned long) t_sync * 1000 / COUNT);
+	debug_printf ("Deferred log_printf: %lu nsec per line, drain %lu nsec per line\n",
+		(unsigned long) t_log * 1000 / COUNT,
+		(unsigned long) t_drain * 1000 / COUNT);
+	debug_printf ("%lu bytes per test, %lu records, %lu lost, ring used %u of %u bytes\n",
+		bytes, lg->records, lg->dropped, lg->max_used, lg->size);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	timer_init (&timer, KHZ, 1);
+	serial.interface = &serial_interface;
+	lg = log_init (log_buf, sizeof (log_buf), (stream_t*) &serial, &timer);
+	log_start (lg, 1, log_task, sizeof (log_task));
+	task_create (main_task, 0, "main", 10, task, sizeof (task));
+}
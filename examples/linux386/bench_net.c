@@ -0,0 +1,298 @@
+/*
+ * Benchmark of TCP/IP stack: two stacks, connected by virtual switch.
+ * Measures UDP and TCP throughput, UDP round-trip time
+ * and CPU time per packet. No tap device or root privileges needed.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <buf/buf.h>
+#include <net/arp.h>
+#include <net/route.h>
+#include <net/ip.h>
+#include <net/udp.h>
+#include <net/tcp.h>
+#include <timer/timer.h>
+#include <vnet/vswitch.h>
+#include "bench.h"
+
+#define MEM_SIZE	200000
+
+#define UDP_COUNT	20000		/* datagrams for throughput test */
+#define UDP_SIZE	1024		/* bytes per datagram */
+#define PING_COUNT	2000		/* round trips for latency test */
+#define TCP_BYTES	4000000		/* bytes for TCP throughput test */
+#define TCP_CHUNK	1024
+
+#define UDP_PORT	5001
+#define ECHO_PORT	5002
+#define TCP_PORT	5003
+
+typedef struct {
+	ip_t ip;
+	mem_pool_t pool;
+	vswitch_port_t port;
+	route_t route;
+	arp_t *arp;
+	ARRAY (arp_data, sizeof(arp_t) + 10 * sizeof(arp_entry_t));
+	ARRAY (group, sizeof(mutex_group_t) + 4 * sizeof(mutex_slot_t));
+	char memory [MEM_SIZE];
+} node_t;
+
+ARRAY (task, 8000);
+ARRAY (sink_task, 8000);
+ARRAY (echo_task, 8000);
+ARRAY (tcp_task, 8000);
+timer_t timer;
+vswitch_t sw;
+node_t a, b;
+udp_socket_t sock_a, sock_sink, sock_echo;
+
+unsigned char addr_a[] = "\12\0\0\1";		/* 10.0.0.1 */
+unsigned char addr_b[] = "\12\0\0\2";		/* 10.0.0.2 */
+
+volatile unsigned long sink_bytes, sink_packets;
+volatile unsigned long tcp_bytes, tcp_t0, tcp_t1;
+
+/*
+ * Total number of packets, passed through both interfaces.
+ */
+static unsigned long
+packets (void)
+{
+	return a.port.netif.in_packets + a.port.netif.out_packets +
+		b.port.netif.in_packets + b.port.netif.out_packets;
+}
+
+static void
+report (const char *name, unsigned long bytes, unsigned long msec,
+	unsigned long npackets, long cpu)
+{
+	if (msec == 0)
+		msec = 1;
+	debug_printf ("%s: %lu bytes in %lu msec, %lu kbytes/sec",
+		name, bytes, msec, bytes / msec);
+	if (npackets)
+		debug_printf (", %lu nsec CPU per packet",
+			(unsigned long) cpu * 1000 / npackets);
+	debug_printf ("\n");
+}
+
+static bool_t
+send_udp (unsigned char *dest, unsigned short port, unsigned size)
+{
+	buf_t *p;
+	bool_t ok;
+
+	p = buf_alloc (&a.pool, size, 64);
+	if (! p)
+		return 0;
+	memset (p->payload, 0x5a, size);
+	mutex_lock (&a.ip.lock);
+	ok = udp_sendto (&sock_a, p, dest, port);
+	mutex_unlock (&a.ip.lock);
+	return ok;
+}
+
+/*
+ * Count all received datagrams.
+ */
+void sink (void *arg)
+{
+	buf_t *p;
+
+	udp_socket (&sock_sink, &b.ip, UDP_PORT);
+	for (;;) {
+		p = udp_recvfrom (&sock_sink, 0, 0);
+		sink_bytes += p->tot_len;
+		++sink_packets;
+		buf_free (p);
+	}
+}
+
+/*
+ * Send back all received datagrams.
+ */
+void echo (void *arg)
+{
+	buf_t *p;
+	unsigned char from [4];
+	unsigned short port;
+
+	udp_socket (&sock_echo, &b.ip, ECHO_PORT);
+	for (;;) {
+		p = udp_recvfrom (&sock_echo, from, &port);
+		mutex_lock (&b.ip.lock);
+		udp_sendto (&sock_echo, p, from, port);
+		mutex_unlock (&b.ip.lock);
+	}
+}
+
+/*
+ * Receive the TCP stream.
+ */
+void tcp_sink (void *arg)
+{
+	tcp_socket_t *lsock, *sock;
+	char buffer [TCP_CHUNK];
+	int n;
+
+	lsock = tcp_listen (&b.ip, 0, TCP_PORT);
+	for (;;) {
+		sock = tcp_accept (lsock);
+		if (! sock)
+			continue;
+		tcp_t0 = timer_milliseconds (&timer);
+		for (;;) {
+			n = tcp_read (sock, buffer, sizeof (buffer));
+			if (n <= 0)
+				break;
+			tcp_bytes += n;
+			if (tcp_bytes >= TCP_BYTES)
+				break;
+		}
+		tcp_t1 = timer_milliseconds (&timer);
+		tcp_close (sock);
+	}
+}
+
+void bench_udp (void)
+{
+	unsigned long t0, t1, n0, i;
+	long c0;
+
+	sink_bytes = sink_packets = 0;
+	n0 = packets ();
+	c0 = clock ();
+	t0 = timer_milliseconds (&timer);
+	for (i=0; i<UDP_COUNT; ++i) {
+		if (! send_udp (addr_b, UDP_PORT, UDP_SIZE))
+			timer_delay (&timer, 1);
+		if (i % 8 == 7)
+			task_yield ();
+	}
+	/* Wait until the receiver drains the queues. */
+	do {
+		i = sink_packets;
+		timer_delay (&timer, 50);
+	} while (i != sink_packets);
+	t1 = timer_milliseconds (&timer) - 50;
+	report ("UDP throughput", sink_bytes, t1 - t0, packets () - n0,
+		clock () - c0);
+	debug_printf ("    %lu of %u datagrams delivered\n",
+		sink_packets, UDP_COUNT);
+}
+
+void bench_ping (void)
+{
+	unsigned long t0, t1, n0, i, lost = 0;
+	long c0;
+	buf_t *p;
+
+	n0 = packets ();
+	c0 = clock ();
+	t0 = timer_milliseconds (&timer);
+	for (i=0; i<PING_COUNT; ++i) {
+		send_udp (addr_b, ECHO_PORT, 32);
+		for (;;) {
+			p = udp_peekfrom (&sock_a, 0, 0);
+			if (p)
+				break;
+			if (timer_passed (&timer, t0, 1000 * (i + 1))) {
+				++lost;
+				break;
+			}
+			task_yield ();
+		}
+		if (p)
+			buf_free (p);
+	}
+	t1 = timer_milliseconds (&timer);
+	debug_printf ("UDP round trip: %lu usec average, %lu lost",
+		(t1 - t0) * 1000 / PING_COUNT, lost);
+	debug_printf (", %lu nsec CPU per packet\n",
+		(unsigned long) (clock () - c0) * 1000 / (packets () - n0));
+}
+
+void bench_tcp (void)
+{
+	tcp_socket_t *sock;
+	static char buffer [TCP_CHUNK];
+	unsigned long n0, sent;
+	long c0;
+
+	tcp_bytes = tcp_t0 = tcp_t1 = 0;
+	n0 = packets ();
+	c0 = clock ();
+	sock = tcp_connect (&a.ip, addr_b, TCP_PORT);
+	if (! sock) {
+		debug_printf ("TCP connect failed\n");
+		return;
+	}
+	memset (buffer, 0x5a, sizeof (buffer));
+	for (sent=0; sent<TCP_BYTES; sent+=TCP_CHUNK)
+		if (tcp_write (sock, buffer, TCP_CHUNK) < 0) {
+			debug_printf ("TCP write failed\n");
+			break;
+		}
+	while (! tcp_t1)
+		timer_delay (&timer, 10);
+	tcp_close (sock);
+	report ("TCP throughput", tcp_bytes, tcp_t1 - tcp_t0,
+		packets () - n0, clock () - c0);
+}
+
+void main_task (void *data)
+{
+	udp_socket (&sock_a, &a.ip, 5000);
+
+	/* Resolve MAC addresses. */
+	send_udp (addr_b, 9, 1);
+	timer_delay (&timer, 100);
+
+	debug_printf ("--- Ideal link\n");
+	bench_udp ();
+	bench_ping ();
+	bench_tcp ();
+
+	debug_printf ("--- 100 Mbit/sec, 1 msec delay, 0.1%% loss, 0.1%% reordering\n");
+	vswitch_set_link (&sw, 1, 2, 1, 1, 100000000);
+	bench_udp ();
+	bench_ping ();
+	bench_tcp ();
+
+	debug_printf ("Switch: %lu forwarded, %lu flooded, %lu lost, %lu reordered, %lu overflows\n",
+		sw.forwarded, sw.flooded, sw.lost, sw.reordered, sw.overflows);
+	uos_halt (0);
+}
+
+void node_init (node_t *n, const char *name, unsigned char *ipaddr,
+	const unsigned char *macaddr, int prio)
+{
+	mutex_group_t *g;
+
+	mem_init (&n->pool, (size_t) n->memory, (size_t) n->memory + MEM_SIZE);
+	n->arp = arp_init (n->arp_data, sizeof(n->arp_data), &n->ip);
+
+	g = mutex_group_init (n->group, sizeof(n->group));
+	mutex_group_add (g, &n->port.netif.lock);
+	mutex_group_add (g, &timer.decisec);
+	ip_init (&n->ip, &n->pool, prio, &timer, n->arp, g);
+
+	vswitch_port_init (&n->port, &sw, name, n->arp, macaddr);
+	route_add_netif (&n->ip, &n->route, ipaddr, 24, &n->port.netif);
+}
+
+void uos_init (void)
+{
+	timer_init (&timer, KHZ, 1);
+	vswitch_init (&sw, &timer, 90);
+
+	node_init (&a, "veth0", addr_a, (const unsigned char*) "\0\1\2\3\4\1", 70);
+	node_init (&b, "veth1", addr_b, (const unsigned char*) "\0\1\2\3\4\2", 71);
+
+	task_create (sink, 0, "sink", 10, sink_task, sizeof (sink_task));
+	task_create (echo, 0, "echo", 11, echo_task, sizeof (echo_task));
+	task_create (tcp_sink, 0, "tcpsink", 12, tcp_task, sizeof (tcp_task));
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
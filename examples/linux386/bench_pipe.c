@@ -0,0 +1,89 @@
+/*
+ * Benchmark of pipe throughput: the writer task sends the data
+ * to the reader task of higher priority, per character or by lines,
+ * with the wakeup threshold of 1 byte and of 1 kbyte.
+ * Reports throughput, CPU time, task switches and wakeups per kbyte.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <kernel/internal.h>
+#include <stream/stream.h>
+#include <stream/pipe.h>
+#include "bench.h"
+
+#define TOTAL		4000000		/* bytes per test */
+#define LINE		64		/* bytes per write */
+#define PIPE_SIZE	8192
+
+ARRAY (task_writer, 8000);
+ARRAY (task_reader, 8000);
+char pipe_buf [sizeof(pipe_t) + PIPE_SIZE];
+pipe_t *pipe;
+stream_t *master, *slave;
+task_t *reader;
+unsigned long received;
+
+/*
+ * Reader: get all data from the master side.
+ */
+void main_reader (void *arg)
+{
+	unsigned char buf [256];
+
+	for (;;)
+		received += fread (master, buf, sizeof (buf));
+}
+
+static void
+bench (const char *name, bool_t bulk, unsigned threshold)
+{
+	char line [LINE];
+	unsigned long n, switches, wakeups, kbytes;
+	long t0;
+
+	memset (line, 'x', sizeof (line) - 1);
+	line [LINE-1] = '\n';
+	pipe_set_threshold (pipe, threshold);
+
+	received = 0;
+	switches = reader->ticks + task_current->ticks;
+	wakeups = pipe->wakeups;
+	t0 = clock ();
+	if (bulk) {
+		for (n=0; n<TOTAL; n+=LINE)
+			fwrite (slave, line, LINE);
+	} else {
+		for (n=0; n<TOTAL; n++)
+			putchar (slave, line [n % LINE]);
+	}
+	fflush (slave);
+	t0 = clock () - t0;
+	switches = reader->ticks + task_current->ticks - switches;
+	wakeups = pipe->wakeups - wakeups;
+	if (t0 == 0)
+		t0 = 1;
+
+	kbytes = received / 1024;
+	debug_printf ("%s: %lu kbytes/sec, %lu nsec per byte, %lu switches/kbyte, %lu wakeups/kbyte\n",
+		name, (unsigned long) ((long long) received * 1000 / t0 / 1024),
+		(unsigned long) t0 * 1000 / received,
+		switches / kbytes, wakeups / kbytes);
+}
+
+void main_writer (void *arg)
+{
+	bench ("Per character, threshold 1  ", 0, 1);
+	bench ("Per character, threshold 1k ", 0, 1024);
+	bench ("By lines, threshold 1       ", 1, 1);
+	bench ("By lines, threshold 1k      ", 1, 1024);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	pipe = pipe_init (pipe_buf, sizeof (pipe_buf), &master, &slave);
+	reader = task_create (main_reader, 0, "reader", 2,
+		task_reader, sizeof (task_reader));
+	task_create (main_writer, 0, "writer", 1,
+		task_writer, sizeof (task_writer));
+}
@@ -0,0 +1,129 @@
+/*
+ * Benchmark of formatted output: printf throughput for typical
+ * log formats. Compares a stream with per-character putc only
+ * and a stream with bulk write. Both streams take a lock on every
+ * call, like a real driver does.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <stream/stream.h>
+#include "bench.h"
+
+#define COUNT		100000		/* lines per test */
+
+typedef struct {
+	stream_interface_t *interface;
+	mutex_t lock;
+	unsigned long bytes;
+	unsigned long calls;
+} counter_t;
+
+ARRAY (task, 8000);
+
+static void
+counter_putchar (counter_t *u, short c)
+{
+	mutex_lock (&u->lock);
+	++u->bytes;
+	++u->calls;
+	mutex_unlock (&u->lock);
+}
+
+static int
+counter_write (counter_t *u, const void *buf, int len)
+{
+	mutex_lock (&u->lock);
+	u->bytes += len;
+	++u->calls;
+	mutex_unlock (&u->lock);
+	return len;
+}
+
+static stream_interface_t putc_interface = {
+	.putc = (void (*) (stream_t*, short))		counter_putchar,
+};
+
+static stream_interface_t bulk_interface = {
+	.putc = (void (*) (stream_t*, short))		counter_putchar,
+	.write = (int (*) (stream_t*, const void*, int))	counter_write,
+};
+
+static void
+log_lines (counter_t *u, int format)
+{
+	unsigned long i;
+
+	for (i=0; i<COUNT; ++i) {
+		switch (format) {
+		case 0:
+			printf (u, "eth0: %lu packets, %lu bytes, %u errors\n",
+				i, i * 1500, (unsigned) i & 7);
+			break;
+		case 1:
+			printf (u, "[%02u:%02u:%02u.%03u] %s: state %d -> %d\n",
+				(unsigned) (i / 3600000) % 24,
+				(unsigned) (i / 60000) % 60,
+				(unsigned) (i / 1000) % 60,
+				(unsigned) i % 1000, "tcp", 1, 4);
+			break;
+		case 2:
+			printf (u, "%08lx %-16s %5d %s\n", i * 0x10001,
+				"sensor", (int) i - 50000,
+				"temperature value out of range, check wiring");
+			break;
+		}
+	}
+}
+
+static void
+bench (const char *name, int format)
+{
+	counter_t u;
+	long t0;
+
+	memset (&u, 0, sizeof (u));
+	u.interface = &putc_interface;
+	t0 = clock ();
+	log_lines (&u, format);
+	t0 = clock () - t0;
+	debug_printf ("%s\n    putc only:  %lu bytes, %lu calls, %lu nsec per line\n",
+		name, u.bytes, u.calls, (unsigned long) t0 * 1000 / COUNT);
+
+	memset (&u, 0, sizeof (u));
+	u.interface = &bulk_interface;
+	t0 = clock ();
+	log_lines (&u, format);
+	t0 = clock () - t0;
+	debug_printf ("    bulk write: %lu bytes, %lu calls, %lu nsec per line\n",
+		u.bytes, u.calls, (unsigned long) t0 * 1000 / COUNT);
+}
+
+static void
+bench_snprintf (void)
+{
+	unsigned char buf [128];
+	unsigned long i, bytes = 0;
+	long t0;
+
+	t0 = clock ();
+	for (i=0; i<COUNT; ++i)
+		bytes += snprintf (buf, sizeof (buf), "%s: %lu packets, %ld delta\n",
+			"eth0", i * 12345, (long) i - 50000);
+	t0 = clock () - t0;
+	debug_printf ("snprintf: %lu bytes, %lu nsec per line\n",
+		bytes, (unsigned long) t0 * 1000 / COUNT);
+}
+
+void main_task (void *data)
+{
+	bench ("Counters", 0);
+	bench ("Timestamped state", 1);
+	bench ("Hex, padded and long string", 2);
+	bench_snprintf ();
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,356 @@
+/*
+ * Benchmark of SNMP agent: execute GET, GETNEXT and GETBULK requests
+ * with ASN.1 data allocated from the memory pool, and from the arena.
+ * Then walk the whole MIB by GETNEXT, like snmpwalk does, with variables
+ * found by the OID trie and by binary search.
+ * Requests are sent by UDP to the agent task through the loopback
+ * interface, so the times include the UDP/IP stack.
+ * Reports requests per second.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <buf/buf.h>
+#include <net/route.h>
+#include <net/ip.h>
+#include <net/udp.h>
+#include <snmp/asn.h>
+#include <snmp/snmp.h>
+#include <timer/timer.h>
+#include <vnet/loop.h>
+#include "bench.h"
+
+#define MEM_SIZE		65536
+#define ARENA_SIZE		16384
+#define COUNT			20000	/* requests per test */
+#define WALKS			200	/* walks per test */
+#define NSOCKETS		6	/* more rows of UDP table */
+#define AGENT_PORT		161
+#define CLIENT_PORT		5000
+#define STATIC_STRING(val)	({static char s[] = val; s; })
+
+ARRAY (task, 8000);
+ARRAY (agent_task, 8000);
+ARRAY (group, sizeof(mutex_group_t) + 4 * sizeof(mutex_slot_t));
+char memory [MEM_SIZE];
+char arena_data [ARENA_SIZE];
+mem_pool_t pool;
+asn_arena_t arena;
+timer_t timer;
+loop_t lo;
+route_t route;
+ip_t ip;
+snmp_t snmp;
+udp_socket_t agent_sock, client_sock;
+udp_socket_t sockets [NSOCKETS];
+
+unsigned char addr_lo[] = "\177\0\0\1";	/* 127.0.0.1 */
+
+/*
+ * Declare get/getnext/set functions.
+ */
+#include <snmp/snmp-var.h>
+#include <snmp/snmp-system.h>
+#include <snmp/snmp-snmp.h>
+#include <snmp/snmp-icmp.h>
+#include <snmp/snmp-udp.h>
+
+#include <snmp/snmp-vardecl.h>
+SYSTEM_VARIABLE_LIST
+ICMP_VARIABLE_LIST
+UDP_VARIABLE_LIST
+SNMP_VARIABLE_LIST
+
+const snmp_var_t snmp_tab [] = {
+#include <snmp/snmp-vardef.h>
+	SYSTEM_VARIABLE_LIST
+	ICMP_VARIABLE_LIST
+	UDP_VARIABLE_LIST
+	SNMP_VARIABLE_LIST
+};
+
+typedef struct {
+	const char *name;
+	unsigned char *data;
+	unsigned len;
+} request_t;
+
+/*
+ * Make a binary SNMPv2c request with the given variables.
+ */
+static void
+make_request (request_t *req, const char *name, small_uint_t type,
+	long arg1, long arg2, const char **vars)
+{
+	static unsigned char buf [1500];
+	asn_t *b, *pdu, *tab, *var;
+	unsigned char *output;
+	unsigned n;
+
+	for (n=0; vars[n]; ++n)
+		continue;
+	tab = asn_make_seq (&pool, n, ASN_SEQUENCE);
+	tab->seq.count = n;
+	for (n=0; vars[n]; ++n) {
+		var = asn_make_seq (&pool, 2, ASN_SEQUENCE);
+		var->seq.count = 2;
+		var->seq.arr[0] = asn_make_oid (&pool, vars[n]);
+		var->seq.arr[1] = asn_make_null (&pool);
+		tab->seq.arr[n] = var;
+	}
+	pdu = asn_make_seq (&pool, 4, type);
+	pdu->seq.count = 4;
+	pdu->seq.arr[0] = asn_make_int (&pool, 123, ASN_INTEGER);
+	pdu->seq.arr[1] = asn_make_int (&pool, arg1, ASN_INTEGER);
+	pdu->seq.arr[2] = asn_make_int (&pool, arg2, ASN_INTEGER);
+	pdu->seq.arr[3] = tab;
+
+	b = asn_make_seq (&pool, 3, ASN_SEQUENCE);
+	b->seq.count = 3;
+	b->seq.arr[0] = asn_make_int (&pool, 1, ASN_INTEGER);
+	b->seq.arr[1] = asn_make_string (&pool, (unsigned char*) "public");
+	b->seq.arr[2] = pdu;
+
+	output = asn_encode (b, buf + sizeof (buf), sizeof (buf));
+	asn_free (b);
+	req->name = name;
+	req->len = buf + sizeof (buf) - output;
+	req->data = mem_alloc (&pool, req->len);
+	memcpy (req->data, output, req->len);
+}
+
+/*
+ * Agent task: answer the requests, received on the SNMP port.
+ * A failed request is answered by an empty datagram,
+ * so that the client does not wait forever.
+ */
+static void
+agent (void *arg)
+{
+	buf_t *p, *r;
+	unsigned char addr [4], *output;
+	unsigned short port;
+
+	for (;;) {
+		p = udp_recvfrom (&agent_sock, addr, &port);
+		r = buf_alloc (&pool, 1500, 50);
+		if (! r) {
+			buf_free (p);
+			continue;
+		}
+		output = snmp_execute (&snmp, p->payload, p->len,
+			r->payload, r->len);
+		buf_free (p);
+		if (output)
+			buf_add_header (r, - (output - r->payload));
+		else
+			buf_truncate (r, 0);
+		udp_sendto (&agent_sock, r, addr, port);
+	}
+}
+
+/*
+ * Send the request to the agent through the loopback interface,
+ * and wait for the reply. Return the length of the reply,
+ * placed at the end of the output buffer, or 0 on failure.
+ */
+static unsigned
+transact (const unsigned char *input, unsigned len,
+	unsigned char *output, unsigned size)
+{
+	buf_t *p;
+
+	p = buf_alloc (&pool, len, 50);
+	if (! p)
+		return 0;
+	memcpy (p->payload, input, len);
+	if (! udp_sendto (&client_sock, p, addr_lo, AGENT_PORT))
+		return 0;
+
+	p = udp_recvfrom (&client_sock, 0, 0);
+	len = p->len;
+	if (len > size)
+		len = 0;
+	memcpy (output + size - len, p->payload, len);
+	buf_free (p);
+	return len;
+}
+
+static void
+bench (request_t *req, const char *mode)
+{
+	unsigned char output [1500];
+	unsigned long n, avail, rate, bytes = 0;
+	long t0;
+
+	avail = mem_available (&pool);
+	t0 = clock ();
+	for (n=0; n<COUNT; ++n) {
+		bytes = transact (req->data, req->len,
+			output, sizeof (output));
+		if (! bytes) {
+			debug_printf ("%s: request failed\n", req->name);
+			return;
+		}
+	}
+	t0 = clock () - t0;
+	if (t0 == 0)
+		t0 = 1;
+	rate = (unsigned long) ((long long) COUNT * 1000000 / t0);
+	debug_printf ("%s, %s: %lu requests/sec, reply %lu bytes",
+		req->name, mode, rate, bytes);
+	if (mem_available (&pool) != avail)
+		debug_printf (", LEAKED %lu bytes",
+			avail - mem_available (&pool));
+	debug_putchar (0, '\n');
+}
+
+/*
+ * Walk the MIB from mib-2 to the end by GETNEXT requests:
+ * every request asks for the name, returned by the previous reply.
+ * Return the number of variables.
+ */
+static unsigned
+walk (void)
+{
+	unsigned char input [1500], output [1500], *reply, *p;
+	asn_t *name, *b, *pdu, *tab, *var;
+	unsigned n, len;
+
+	name = asn_make_oid (&pool, "1.3.6.1.2.1");
+	for (n=0; ; ++n) {
+		var = asn_make_seq (&pool, 2, ASN_SEQUENCE);
+		var->seq.count = 2;
+		var->seq.arr[0] = name;
+		var->seq.arr[1] = asn_make_null (&pool);
+		tab = asn_make_seq (&pool, 1, ASN_SEQUENCE);
+		tab->seq.count = 1;
+		tab->seq.arr[0] = var;
+		pdu = asn_make_seq (&pool, 4, ASN_GET_NEXT_REQUEST);
+		pdu->seq.count = 4;
+		pdu->seq.arr[0] = asn_make_int (&pool, n, ASN_INTEGER);
+		pdu->seq.arr[1] = asn_make_int (&pool, 0, ASN_INTEGER);
+		pdu->seq.arr[2] = asn_make_int (&pool, 0, ASN_INTEGER);
+		pdu->seq.arr[3] = tab;
+		b = asn_make_seq (&pool, 3, ASN_SEQUENCE);
+		b->seq.count = 3;
+		b->seq.arr[0] = asn_make_int (&pool, 1, ASN_INTEGER);
+		b->seq.arr[1] = asn_make_string (&pool, (unsigned char*) "public");
+		b->seq.arr[2] = pdu;
+
+		p = asn_encode (b, input + sizeof (input), sizeof (input));
+		asn_free (b);
+		len = transact (p, input + sizeof (input) - p,
+			output, sizeof (output));
+		if (! len)
+			break;
+
+		/* Take the name of the next variable from the reply. */
+		reply = output + sizeof (output) - len;
+		b = asn_parse (&pool, &reply, &len);
+		if (! b)
+			break;
+		name = 0;
+		pdu = b->seq.arr[2];
+		var = pdu->seq.arr[3]->seq.arr[0];
+		if (pdu->seq.arr[1]->int32.val == 0 &&
+		    var->seq.arr[1]->type != ASN_ENDOFMIBVIEW)
+			name = asn_copy (var->seq.arr[0]);
+		asn_free (b);
+		if (! name)
+			break;
+	}
+	return n;
+}
+
+static void
+bench_walk (const char *mode)
+{
+	unsigned long n, avail, rate, vars = 0;
+	long t0;
+
+	avail = mem_available (&pool);
+	t0 = clock ();
+	for (n=0; n<WALKS; ++n)
+		vars = walk ();
+	t0 = clock () - t0;
+	if (t0 == 0)
+		t0 = 1;
+	rate = (unsigned long) ((long long) WALKS * vars * 1000000 / t0);
+	debug_printf ("Walk %lu vars, %s: %lu usec per walk, %lu requests/sec",
+		vars, mode, t0 / WALKS, rate);
+	if (mem_available (&pool) != avail)
+		debug_printf (", LEAKED %lu bytes",
+			avail - mem_available (&pool));
+	debug_putchar (0, '\n');
+}
+
+void main_task (void *data)
+{
+	static const char *get_vars[] = { "1.3.6.1.2.1.1.1.0",
+		"1.3.6.1.2.1.1.3.0", "1.3.6.1.2.1.1.5.0",
+		"1.3.6.1.2.1.11.1.0", 0 };
+	static const char *next_vars[] = { "1.3.6.1.2.1.1",
+		"1.3.6.1.2.1.5", "1.3.6.1.2.1.11", "1.3.6.1.2.1.11.4", 0 };
+	static const char *bulk_vars[] = { "1.3.6.1.2.1.5",
+		"1.3.6.1.2.1.11", 0 };
+	request_t req [3];
+	struct _snmp_node_t *trie;
+	int i;
+
+	make_request (&req[0], "GET 4 vars", ASN_GET_REQUEST,
+		0, 0, get_vars);
+	make_request (&req[1], "GETNEXT 4 vars", ASN_GET_NEXT_REQUEST,
+		0, 0, next_vars);
+	make_request (&req[2], "GETBULK 2x25 vars", ASN_GET_BULK_REQUEST,
+		0, 25, bulk_vars);
+
+	for (i=0; i<3; ++i) {
+		snmp_set_arena (&snmp, 0);
+		bench (&req[i], "memory pool");
+		snmp_set_arena (&snmp, &arena);
+		bench (&req[i], "arena      ");
+	}
+	debug_printf ("Arena: %u bytes used at most, %lu spills\n",
+		arena.max_used, arena.spills);
+
+	trie = snmp.trie;
+	snmp.trie = 0;
+	bench_walk ("binary search");
+	snmp.trie = trie;
+	bench_walk ("OID trie     ");
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	mutex_group_t *g;
+	int i;
+
+	timer_init (&timer, KHZ, 10);
+	mem_init (&pool, (size_t) memory, (size_t) memory + MEM_SIZE);
+
+	/*
+	 * Interface lo 127.0.0.1 / 255.0.0.0
+	 */
+	loop_init (&lo, "lo");
+	g = mutex_group_init (group, sizeof(group));
+	mutex_group_add (g, &lo.netif.lock);
+	mutex_group_add (g, &timer.decisec);
+	ip_init (&ip, &pool, 70, &timer, 0, g);
+	route_add_netif (&ip, &route, addr_lo, 8, &lo.netif);
+
+	/* Open sockets, to have some rows in UDP table. */
+	udp_socket (&agent_sock, &ip, AGENT_PORT);
+	udp_socket (&client_sock, &ip, CLIENT_PORT);
+	for (i=0; i<NSOCKETS; ++i)
+		udp_socket (&sockets[i], &ip, 1000 + (i * 37) % NSOCKETS);
+	asn_arena_init (&arena, &pool, arena_data, sizeof (arena_data));
+
+	snmp_init (&snmp, &pool, &ip, snmp_tab, sizeof(snmp_tab), 20520,
+		SNMP_SERVICE_REPEATER, STATIC_STRING("Testing SNMP"),
+		"1.3.6.1.4.1.20520.1.1", "Test", "1.3.6.1.4.1.20520.6.1");
+
+	task_create (agent, 0, "agent", 10, agent_task, sizeof (agent_task));
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,163 @@
+/*
+ * Benchmark of Tcl interpreter: run typical scripts of a device
+ * console (loops in procedures, walking the table of interfaces)
+ * with the procedure and loop bodies interpreted from the text,
+ * and compiled into the lists of commands, and a loop of regexp
+ * matches with the compiled patterns cached.
+ * Reports microseconds per run and the speedup.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <tcl/internal.h>
+#include "bench.h"
+
+#define MEM_SIZE	131072
+#define RUNS		2000		/* runs per test */
+
+ARRAY (task, 16000);
+char memory [MEM_SIZE];
+mem_pool_t pool;
+
+/*
+ * Procedures, defined once for all tests.
+ */
+static unsigned char setup[] =
+"proc sum {n} {\n"
+"    set s 0\n"
+"    for {set i 0} {$i < $n} {incr i} {\n"
+"        set s [expr {$s + $i}]\n"
+"    }\n"
+"    return $s\n"
+"}\n"
+"proc add {a b} {\n"
+"    set c $a\n"
+"    incr c $b\n"
+"    return $c\n"
+"}\n"
+"proc calls {n} {\n"
+"    set t 0\n"
+"    for {set i 0} {$i < $n} {incr i} {\n"
+"        set t [add $t $i]\n"
+"    }\n"
+"    return $t\n"
+"}\n"
+"proc ifstat {name} {\n"
+"    global ifc\n"
+"    return \"$name $ifc($name,in) $ifc($name,out)\"\n"
+"}\n"
+"proc ifwalk {} {\n"
+"    global ifc iflist\n"
+"    set total 0\n"
+"    foreach name $iflist {\n"
+"        if {$ifc($name,up)} {\n"
+"            incr total $ifc($name,in)\n"
+"            set line [ifstat $name]\n"
+"        }\n"
+"    }\n"
+"    return $total\n"
+"}\n"
+"set iflist {}\n"
+"foreach n {0 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15} {\n"
+"    lappend iflist eth$n\n"
+"    set ifc(eth$n,up) [expr {$n % 3 != 0}]\n"
+"    set ifc(eth$n,in) [expr {$n * 1000}]\n"
+"    set ifc(eth$n,out) [expr {$n * 77}]\n"
+"}\n";
+
+typedef struct {
+	const char *name;
+	const char *script;
+} test_t;
+
+static const test_t tests[] = {
+	{ "Proc with for loop   ", "sum 100" },
+	{ "Proc calls           ", "calls 100" },
+	{ "Foreach over list    ",
+	  "set n {}; set c 0; foreach x {a b c d e f g h i j k l m n o p q r s t} "
+	  "{ append n $x; incr c }; string length $n$c" },
+	{ "While with if        ",
+	  "set i 0; set odd 0; while {$i < 100} { if {$i & 1} "
+	  "{ incr odd } else { set even $i }; incr i }; set odd" },
+	{ "Nested procs, array  ", "ifwalk" },
+	{ "Loop with expressions",
+	  "set x 0; for {set i 0} {$i < 100} {incr i} "
+	  "{ if {($i & 3) == 0 && $i > 10 || $i == 5} { incr x } }; set x" },
+	{ "Regexp config parsing",
+	  "set n 0; foreach l {{ip 10.0.0.1} {mask 255.0.0.0} {# ip} "
+	  "{gw 10.0.0.254} {Name eth0}} { if {[regexp -nocase "
+	  "{^([a-z]+) +([0-9.]+)$} $l m k v]} { incr n } }; "
+	  "regsub -all {\\.} $v : v; concat $n $v" },
+};
+
+static long
+run (Tcl_Interp *interp, const test_t *t, unsigned char *result,
+	unsigned size)
+{
+	unsigned char script [256];
+	int i, code = TCL_OK;
+	long t0;
+
+	/* Tcl_Eval modifies the script in place while parsing it. */
+	strcpy (script, (const unsigned char*) t->script);
+	t0 = clock ();
+	for (i=0; i<RUNS; ++i) {
+		code = Tcl_Eval (interp, script, 0, 0);
+		if (code != TCL_OK)
+			break;
+	}
+	t0 = clock () - t0;
+	if (code != TCL_OK)
+		debug_printf ("%s: error: %s\n", t->name, interp->result);
+	strncpy (result, interp->result, size - 1);
+	result [size - 1] = 0;
+	return t0 ? t0 : 1;
+}
+
+void main_task (void *data)
+{
+	Tcl_Interp *interp;
+	Interp *iPtr;
+	unsigned char text [2][64];
+	unsigned long avail;
+	long t_text, t_comp;
+	int i;
+
+	interp = Tcl_CreateInterp (&pool);
+	iPtr = (Interp*) interp;
+	if (Tcl_Eval (interp, setup, 0, 0) != TCL_OK) {
+		debug_printf ("setup: error: %s\n", interp->result);
+		uos_halt (0);
+	}
+	for (i=0; i<sizeof(tests)/sizeof(tests[0]); ++i) {
+		avail = mem_available (&pool);
+		iPtr->flags |= NO_COMPILE;
+		t_text = run (interp, &tests[i], text[0], sizeof (text[0]));
+		iPtr->flags &= ~NO_COMPILE;
+		run (interp, &tests[i], text[1], sizeof (text[1]));
+		t_comp = run (interp, &tests[i], text[1], sizeof (text[1]));
+
+		debug_printf ("%s: text %ld usec, compiled %ld usec, speedup %ld.%02ld",
+			tests[i].name, t_text / RUNS, t_comp / RUNS,
+			t_text / t_comp, t_text * 100 / t_comp % 100);
+		if (strcmp (text[0], text[1]) != 0)
+			debug_printf (", RESULTS DIFFER: %s / %s",
+				text[0], text[1]);
+		debug_printf (", %lu bytes used\n",
+			avail - mem_available (&pool));
+	}
+	strcpy (text[0], (const unsigned char*) "info memory");
+	if (Tcl_Eval (interp, text[0], 0, 0) == TCL_OK)
+		debug_printf ("Memory: %s\n", interp->result);
+	strcpy (text[0], (const unsigned char*) "info regexps");
+	if (Tcl_Eval (interp, text[0], 0, 0) == TCL_OK)
+		debug_printf ("Regexps: %s\n", interp->result);
+	Tcl_DeleteInterp (interp);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	mem_init (&pool, (size_t) memory, (size_t) memory + MEM_SIZE);
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,128 @@
+/*
+ * Benchmark of UART reception on a pseudo-terminal: a child process
+ * floods the pty, and the task reads the data per character with
+ * default settings, then in bulk with large rings and watermark wakeups.
+ * Reports throughput, CPU time and the number of reader wakeups.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <timer/timer.h>
+#include <uart/uart.h>
+#include "bench.h"
+
+#define TOTAL		2000000		/* bytes per test */
+#define CHUNK		256		/* bytes per write of the sender */
+#define MEM_SIZE	32768
+
+/* Host C library. */
+extern int posix_openpt (int flags);
+extern int grantpt (int fd);
+extern int unlockpt (int fd);
+extern char *ptsname (int fd);
+extern int open (const char *path, int flags, ...);
+extern int close (int fd);
+extern int dup2 (int fd, int fd2);
+extern int fork (void);
+extern void _exit (int status);
+extern long write (int fd, const void *buf, unsigned long len);
+extern int tcgetattr (int fd, void *termios);
+extern int tcsetattr (int fd, int action, const void *termios);
+extern void cfmakeraw (void *termios);
+
+#define O_RDWR		2
+#define O_NOCTTY	0400
+
+ARRAY (task, 8000);
+uart_t uart;
+timer_t timer;
+mem_pool_t pool;
+char memory [MEM_SIZE];
+int master;
+
+/*
+ * Connect stdin to a new pseudo-terminal in raw mode.
+ */
+static void
+pty_open (void)
+{
+	long termios [32];
+	int slave;
+
+	master = posix_openpt (O_RDWR | O_NOCTTY);
+	grantpt (master);
+	unlockpt (master);
+	slave = open (ptsname (master), O_RDWR | O_NOCTTY);
+	tcgetattr (slave, termios);
+	cfmakeraw (termios);
+	tcsetattr (slave, 0, termios);
+	dup2 (slave, 0);
+	close (slave);
+}
+
+/*
+ * Start the child process, which writes the data to the pty.
+ */
+static void
+sender (void)
+{
+	static char data [CHUNK];
+	long n;
+
+	memset (data, 'x', sizeof (data));
+	if (fork () != 0)
+		return;
+	for (n=0; n<TOTAL; n+=CHUNK)
+		write (master, data, CHUNK);
+	_exit (0);
+}
+
+static void
+bench (const char *name, bool_t bulk)
+{
+	unsigned char buf [CHUNK];
+	unsigned long bytes, calls, msec;
+	long t0;
+
+	uart.wakeups = 0;
+	bytes = 0;
+	calls = 0;
+	sender ();
+	msec = timer_milliseconds (&timer);
+	t0 = clock ();
+	while (bytes < TOTAL) {
+		if (bulk)
+			bytes += uart_read (&uart, buf, sizeof (buf));
+		else {
+			uart_getchar (&uart);
+			++bytes;
+		}
+		++calls;
+	}
+	t0 = clock () - t0;
+	msec = timer_milliseconds (&timer) - msec;
+	if (msec == 0)
+		msec = 1;
+	debug_printf ("%s: %lu kbytes/sec, %lu nsec CPU per byte, %lu reads, %lu wakeups\n",
+		name, bytes / msec, (unsigned long) t0 * 1000 / bytes,
+		calls, uart.wakeups);
+}
+
+void main_task (void *data)
+{
+	bench ("Per character, default ring", 0);
+
+	uart_set_buffers (&uart, &pool, 8192, 256);
+	uart_set_watermark (&uart, 1024, &timer, 2);
+	bench ("Bulk, 8k ring, watermark 1k, idle 2 msec", 1);
+	uos_halt (0);
+}
+
+void uos_init (void)
+{
+	mem_init (&pool, (size_t) memory, (size_t) memory + MEM_SIZE);
+	timer_init (&timer, KHZ, 1);
+	pty_open ();
+	uart_init (&uart, 0, 90, KHZ, 921600);
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,186 @@
+/*
+ * Testing floating-point output of printf against the host C library.
+ * For every binary exponent, a set of random values is printed
+ * with %e, %f and %g at various precisions and flags,
+ * and compared with glibc. Shortest output (%le, %lf, %lg)
+ * must read back to the same value.
+ *
+ * Known differences from glibc, not tested: precision above DBL_DIG
+ * is padded by zeros, precision cancels the `0' flag, `+' flag
+ * is ignored, %f of huge values has DTOA_MAXDIGITS exact digits.
+ * Glibc loses the trailing zeros of %#g after a rounding carry
+ * (999.5 with %#.3g), such values are compared with the rounded one.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <stream/stream.h>
+#include <stream/dtoa.h>
+
+#define RANDOM_VALUES	40		/* values per binary exponent */
+#define DECIMAL_VALUES	100000		/* short decimals, like 12.5 */
+
+/* Host C library. */
+extern int __vsnprintf (char *buf, size_t size, const char *fmt, va_list args);
+extern double strtod (const char *str, char **endp);
+extern long random (void);
+
+ARRAY (task, 0x4000);
+
+static const char *formats [] = {
+	"%.0e", "%.1e", "%.2e", "%.3e", "%.5e", "%e", "%.8e", "%.12e", "%.15e",
+	"%.0f", "%.1f", "%.2f", "%.3f", "%f", "%.9f", "%.15f",
+	"%.0g", "%.1g", "%.2g", "%.3g", "%g", "%.10g", "%.15g",
+	"%#.0e", "%#.0f", "%#g", "%#.3g", "%#.0g", "%E", "%G",
+	"%12.4f", "%-12.4e|", "%012f", "%15.5e", "%10g", "%-5.0f|",
+	0,
+};
+
+unsigned long total, failed, not_shortest;
+
+static int
+host_snprintf (char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	va_start (args, fmt);
+	n = __vsnprintf (buf, size, fmt, args);
+	va_end (args);
+	return n;
+}
+
+static int
+significant_digits (const char *s)
+{
+	int n = 0, started = 0;
+
+	for (; *s && *s != 'e' && *s != 'E'; ++s) {
+		if (*s >= '1' && *s <= '9')
+			started = 1;
+		if (started && *s >= '0' && *s <= '9')
+			++n;
+	}
+	return n;
+}
+
+static const char *
+skip_spaces (const char *s)
+{
+	while (*s == ' ')
+		++s;
+	return s;
+}
+
+static void
+check (double d, const char *fmt)
+{
+	static unsigned char mine [600];
+	static char host [600];
+	int n1, n2;
+
+	++total;
+	n1 = snprintf (mine, sizeof (mine), fmt, d);
+	n2 = host_snprintf (host, sizeof (host), fmt, d);
+	if (n1 == n2 && strcmp (mine, (unsigned char*) host) == 0)
+		return;
+
+	/* Glibc drops the zeros of %#g, when rounding carries
+	 * into a new digit: 999.5 gives `1.e+03' with %#.3g.
+	 * Compare with glibc output for the rounded value. */
+	if (fmt[1] == '#' && (fmt[strlen ((const unsigned char*) fmt) - 1] | 040) == 'g') {
+		n2 = host_snprintf (host, sizeof (host), fmt,
+			strtod (host, 0));
+		if (n1 == n2 && strcmp (mine, (unsigned char*) host) == 0)
+			return;
+	}
+
+	/* Huge %f values: only DTOA_MAXDIGITS digits are exact. */
+	if (n1 == n2 && significant_digits (host) >= DTOA_MAXDIGITS &&
+	    strtod (skip_spaces ((char*) mine), 0) ==
+	    strtod (skip_spaces (host), 0))
+		return;
+
+	if (++failed <= 20)
+		debug_printf ("%s: got `%s' (%d), expected `%s' (%d)\n",
+			fmt, mine, n1, host, n2);
+}
+
+static void
+check_shortest (double d)
+{
+	static unsigned char mine [600];
+	static char host [600];
+	int p;
+
+	++total;
+	snprintf (mine, sizeof (mine), "%le", d);
+	if (strtod ((char*) mine, 0) != d) {
+		if (++failed <= 20)
+			debug_printf ("%%le: `%s' does not read back\n", mine);
+		return;
+	}
+	/* Find the shortest precision, which reads back. */
+	for (p=0; p<17; ++p) {
+		host_snprintf (host, sizeof (host), "%.*e", p, d);
+		if (strtod (host, 0) == d)
+			break;
+	}
+	if (significant_digits ((char*) mine) > p + 1)
+		++not_shortest;
+
+	snprintf (mine, sizeof (mine), "%lg", d);
+	if (strtod ((char*) mine, 0) != d && ++failed <= 20)
+		debug_printf ("%%lg: `%s' does not read back\n", mine);
+
+	snprintf (mine, sizeof (mine), "%lf", d);
+	if (strtod ((char*) mine, 0) != d && ++failed <= 20)
+		debug_printf ("%%lf: `%s' does not read back\n", mine);
+}
+
+static void
+check_value (double d)
+{
+	const char **fmt;
+
+	for (fmt = formats; *fmt; ++fmt)
+		check (d, *fmt);
+	check_shortest (d < 0 ? -d : d);
+}
+
+void main_task (void *data)
+{
+	static const double scale [8] = {
+		1, 10, 100, 1000, 1e4, 1e5, 1e6, 1e7,
+	};
+	union {
+		double d;
+		uint64_t u;
+	} x;
+	int e, i;
+
+	debug_printf ("Testing floating-point output...\n");
+	for (e=0; e<2047; ++e) {
+		for (i=0; i<RANDOM_VALUES; ++i) {
+			x.u = (uint64_t) random () << 31 ^ random ();
+			x.u &= 0x000fffffffffffffULL;
+			if (i == 0)
+				x.u = 0;
+			else if (i == 1)
+				x.u = 0x000fffffffffffffULL;
+			x.u |= (uint64_t) e << 52;
+			check_value ((i & 1) ? -x.d : x.d);
+		}
+	}
+	/* Short decimals and exact ties, like 0.125 or 2.5. */
+	for (i=0; i<DECIMAL_VALUES; ++i)
+		check_value ((random () % 2000000) / scale [random () % 8]);
+
+	debug_printf ("%lu checks, %lu failed, %lu shortest outputs not minimal\n",
+		total, failed, not_shortest);
+	uos_halt (failed != 0);
+}
+
+void uos_init (void)
+{
+	task_create (main_task, 0, "main", 1, task, sizeof (task));
+}
@@ -0,0 +1,451 @@
+//
+// Кэш страниц флеш-памяти
+//
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <flash/flash-cache.h>
+
+// Признак отсутствия страницы в кэше
+#define NO_WAY      FLASH_CACHE_WAYS
+
+static inline flash_cache_line_t *
+line_at(flash_cache_t *c, unsigned set, unsigned way)
+{
+    return &c->lines[way * c->nb_sets + set];
+}
+
+static inline uint8_t *
+line_data(flash_cache_t *c, unsigned set, unsigned way)
+{
+    return c->data + (way * c->nb_sets + set) * c->flashif.page_size;
+}
+
+static inline void
+touch(flash_cache_t *c, flash_cache_line_t *l)
+{
+    l->used = ++c->clock;
+}
+
+//
+// Поиск страницы в кэше. Возвращает номер пути или NO_WAY.
+//
+static unsigned
+lookup(flash_cache_t *c, unsigned page)
+{
+    unsigned set = page % c->nb_sets;
+    unsigned way;
+    flash_cache_line_t *l;
+
+    for (way = 0; way < FLASH_CACHE_WAYS; ++way) {
+        l = line_at(c, set, way);
+        if (l->valid && l->page == page)
+            return way;
+    }
+    return NO_WAY;
+}
+
+static inline int
+dirty_page(flash_cache_t *c, unsigned set, unsigned way, unsigned page)
+{
+    flash_cache_line_t *l = line_at(c, set, way);
+
+    return l->valid && l->dirty && l->page == page;
+}
+
+//
+// Запись изменённой строки на устройство. Соседние изменённые страницы
+// того же пути лежат в памяти подряд и записываются тем же вызовом.
+//
+static int
+write_back(flash_cache_t *c, unsigned set, unsigned way)
+{
+    unsigned page = line_at(c, set, way)->page;
+    unsigned first = set, last = set, i;
+    int res;
+
+    while (first > 0 && dirty_page(c, first - 1, way, page - (set - first) - 1))
+        first--;
+    while (last + 1 < c->nb_sets && dirty_page(c, last + 1, way, page + (last - set) + 1))
+        last++;
+
+    c->dev_writes++;
+    res = flash_write(c->dev, page - (set - first), line_data(c, first, way),
+        (last - first + 1) * c->flashif.page_size);
+    if (res != FLASH_ERR_OK)
+        return res;
+
+    c->dev_pages_written += last - first + 1;
+    for (i = first; i <= last; ++i)
+        line_at(c, i, way)->dirty = 0;
+    return FLASH_ERR_OK;
+}
+
+//
+// Выбор строки для страницы page, которой нет в кэше. Изменённая
+// строка предварительно записывается на устройство.
+//
+static int
+choose_way(flash_cache_t *c, unsigned page, unsigned *way)
+{
+    unsigned set = page % c->nb_sets;
+    unsigned w, best = NO_WAY;
+    flash_cache_line_t *l;
+    int res;
+
+    // Страницу, следующую за закэшированной, помещаем в тот же путь:
+    // тогда подряд идущие страницы и в памяти лежат подряд.
+    if (set > 0) {
+        w = lookup(c, page - 1);
+        if (w != NO_WAY && ! line_at(c, set, w)->dirty)
+            best = w;
+    }
+
+    // Иначе свободная строка или давно не использованная
+    if (best == NO_WAY) {
+        for (w = 0; w < FLASH_CACHE_WAYS; ++w) {
+            l = line_at(c, set, w);
+            if (! l->valid) {
+                best = w;
+                break;
+            }
+            if (best == NO_WAY || (int) (l->used - line_at(c, set, best)->used) < 0)
+                best = w;
+        }
+    }
+
+    l = line_at(c, set, best);
+    if (l->valid && l->dirty) {
+        res = write_back(c, set, best);
+        if (res != FLASH_ERR_OK)
+            return res;
+    }
+    l->valid = 0;
+    *way = best;
+    return FLASH_ERR_OK;
+}
+
+//
+// Чтение страницы page в кэш, вместе с ней - до n-1 следующих страниц
+// в следующие наборы того же пути, одним вызовом чтения устройства.
+// Чтение останавливается на странице, которая уже есть в кэше,
+// и не вытесняет изменённые строки. В *nread - число прочитанных страниц.
+//
+static int
+fill(flash_cache_t *c, unsigned page, unsigned n, unsigned *way, unsigned *nread)
+{
+    unsigned set = page % c->nb_sets;
+    unsigned total = flash_nb_pages(c->dev);
+    unsigned w, k, i;
+    flash_cache_line_t *l;
+    int res;
+
+    res = choose_way(c, page, &w);
+    if (res != FLASH_ERR_OK)
+        return res;
+
+    for (k = 1; k < n && set + k < c->nb_sets && page + k < total; ++k) {
+        l = line_at(c, set + k, w);
+        if ((l->valid && l->dirty) || lookup(c, page + k) != NO_WAY)
+            break;
+    }
+    for (i = 0; i < k; ++i)
+        line_at(c, set + i, w)->valid = 0;
+
+    c->dev_reads++;
+    res = flash_read(c->dev, page, line_data(c, set, w), k * c->flashif.page_size);
+    if (res != FLASH_ERR_OK)
+        return res;
+
+    for (i = 0; i < k; ++i) {
+        l = line_at(c, set + i, w);
+        l->page = page + i;
+        l->valid = 1;
+        l->dirty = 0;
+        touch(c, l);
+    }
+    *way = w;
+    *nread = k;
+    return FLASH_ERR_OK;
+}
+
+//
+// Подготовка к обращению к устройству в обход кэша, для страниц
+// с page по page+n-1. Перед чтением изменённые страницы записываются,
+// перед записью или стиранием все их копии в кэше отбрасываются.
+//
+static int
+bypass(flash_cache_t *c, unsigned page, unsigned n, int write)
+{
+    unsigned set, way;
+    flash_cache_line_t *l;
+    int res;
+
+    for (way = 0; way < FLASH_CACHE_WAYS; ++way) {
+        for (set = 0; set < c->nb_sets; ++set) {
+            l = line_at(c, set, way);
+            if (! l->valid || l->page - page >= n)
+                continue;
+            if (write) {
+                l->valid = 0;
+            } else if (l->dirty) {
+                res = write_back(c, set, way);
+                if (res != FLASH_ERR_OK)
+                    return res;
+            }
+        }
+    }
+    return FLASH_ERR_OK;
+}
+
+static int
+cache_read(flashif_t *flash, unsigned page_num, void *data, unsigned size)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    unsigned page_size = flash->page_size;
+    unsigned n, need, len, way;
+    uint8_t *p = data;
+    int res = FLASH_ERR_OK;
+
+    mutex_lock(&flash->lock);
+
+    // Большие запросы идут на устройство напрямую
+    n = size / page_size;
+    if (n >= FLASH_CACHE_BYPASS || n >= c->nb_sets) {
+        res = bypass(c, page_num, n, 0);
+        if (res != FLASH_ERR_OK)
+            goto out;
+        c->dev_reads++;
+        res = flash_read(c->dev, page_num, p, n * page_size);
+        if (res != FLASH_ERR_OK)
+            goto out;
+        page_num += n;
+        p += n * page_size;
+        size -= n * page_size;
+        c->next_read = page_num;
+    }
+
+    // При последовательном чтении порция упреждающего чтения
+    // растёт вдвое с каждым промахом, при переходе - сбрасывается.
+    if (page_num != c->next_read)
+        c->read_ahead = 1;
+
+    while (size > 0) {
+        len = (size < page_size) ? size : page_size;
+        way = lookup(c, page_num);
+        if (way == NO_WAY) {
+            c->misses++;
+            need = (size + page_size - 1) / page_size;
+            res = fill(c, page_num, (need > c->read_ahead) ? need : c->read_ahead,
+                &way, &n);
+            if (res != FLASH_ERR_OK)
+                goto out;
+            if (n > need)
+                c->prefetched += n - need;
+            if (c->read_ahead < FLASH_CACHE_READ_AHEAD)
+                c->read_ahead <<= 1;
+        } else {
+            c->hits++;
+        }
+        touch(c, line_at(c, page_num % c->nb_sets, way));
+        memcpy(p, line_data(c, page_num % c->nb_sets, way), len);
+
+        page_num++;
+        p += len;
+        size -= len;
+    }
+    c->next_read = page_num;
+
+out:
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static int
+cache_write(flashif_t *flash, unsigned page_num, void *data, unsigned size)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    unsigned page_size = flash->page_size;
+    unsigned n, len, way;
+    flash_cache_line_t *l;
+    uint8_t *p = data;
+    int res = FLASH_ERR_OK;
+
+    mutex_lock(&flash->lock);
+
+    // Большие запросы идут на устройство напрямую
+    n = size / page_size;
+    if (n >= FLASH_CACHE_BYPASS || n >= c->nb_sets) {
+        res = bypass(c, page_num, n, 1);
+        if (res != FLASH_ERR_OK)
+            goto out;
+        c->dev_writes++;
+        res = flash_write(c->dev, page_num, p, n * page_size);
+        if (res != FLASH_ERR_OK)
+            goto out;
+        c->dev_pages_written += n;
+        page_num += n;
+        p += n * page_size;
+        size -= n * page_size;
+    }
+
+    while (size > 0) {
+        len = (size < page_size) ? size : page_size;
+        way = lookup(c, page_num);
+        if (way != NO_WAY) {
+            c->hits++;
+        } else {
+            c->misses++;
+            if (len < page_size) {
+                // Неполная страница: остальное берём с устройства
+                res = fill(c, page_num, 1, &way, &n);
+                if (res != FLASH_ERR_OK)
+                    goto out;
+            } else {
+                res = choose_way(c, page_num, &way);
+                if (res != FLASH_ERR_OK)
+                    goto out;
+                l = line_at(c, page_num % c->nb_sets, way);
+                l->page = page_num;
+                l->valid = 1;
+            }
+        }
+        l = line_at(c, page_num % c->nb_sets, way);
+        memcpy(line_data(c, page_num % c->nb_sets, way), p, len);
+        l->dirty = 1;
+        touch(c, l);
+
+        page_num++;
+        p += len;
+        size -= len;
+    }
+
+out:
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+//
+// Запись всех изменённых страниц на устройство.
+//
+static int
+cache_flush(flashif_t *flash)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    unsigned set, way;
+    int res = FLASH_ERR_OK;
+
+    mutex_lock(&flash->lock);
+
+    for (way = 0; way < FLASH_CACHE_WAYS; ++way) {
+        for (set = 0; set < c->nb_sets; ++set) {
+            if (line_at(c, set, way)->valid && line_at(c, set, way)->dirty) {
+                res = write_back(c, set, way);
+                if (res != FLASH_ERR_OK)
+                    goto out;
+            }
+        }
+    }
+
+    // Устройство без flush: данные уже записаны
+    if (c->dev->flush)
+        res = flash_flush(c->dev);
+
+out:
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static int
+cache_erase_all(flashif_t *flash)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    int res;
+
+    mutex_lock(&flash->lock);
+    memset(c->lines, 0, c->nb_sets * FLASH_CACHE_WAYS * sizeof(flash_cache_line_t));
+    res = flash_erase_all(c->dev);
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static int
+cache_erase_sectors(flashif_t *flash, unsigned sector_num, unsigned nb_sectors)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    int res;
+
+    mutex_lock(&flash->lock);
+    bypass(c, sector_num * flash->nb_pages_in_sector,
+        nb_sectors * flash->nb_pages_in_sector, 1);
+    res = flash_erase_sectors(c->dev, sector_num, nb_sectors);
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static unsigned
+cache_min_address(flashif_t *flash)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+
+    return flash_min_address(c->dev);
+}
+
+//
+// Подключение устройства и размещение строк кэша в памяти:
+// сначала описатели строк, затем данные, выровненные для устройства.
+//
+static int
+cache_connect(flashif_t *flash)
+{
+    flash_cache_t *c = (flash_cache_t *) flash;
+    flashif_t *dev = c->dev;
+    unsigned line_bytes, align;
+    int res;
+
+    res = flash_connect(dev);
+    if (res != FLASH_ERR_OK)
+        return res;
+
+    mutex_lock(&flash->lock);
+
+    flash->nb_sectors = dev->nb_sectors;
+    flash->nb_pages_in_sector = dev->nb_pages_in_sector;
+    flash->page_size = dev->page_size;
+    flash->data_align = dev->data_align;
+    flash->direct_read = 0;
+
+    align = dev->data_align;
+    line_bytes = FLASH_CACHE_WAYS * (sizeof(flash_cache_line_t) + dev->page_size);
+    c->nb_sets = (c->bytes > align) ? (c->bytes - align) / line_bytes : 0;
+    if (c->nb_sets == 0) {
+        mutex_unlock(&flash->lock);
+        return FLASH_ERR_INVAL_SIZE;
+    }
+
+    c->lines = (flash_cache_line_t *) c->buf;
+    memset(c->lines, 0, c->nb_sets * FLASH_CACHE_WAYS * sizeof(flash_cache_line_t));
+    c->data = (uint8_t *) (((size_t) (c->lines + c->nb_sets * FLASH_CACHE_WAYS) +
+        align) & ~(size_t) align);
+    c->next_read = ~0;
+    c->read_ahead = 1;
+
+    mutex_unlock(&flash->lock);
+    return FLASH_ERR_OK;
+}
+
+void flash_cache_init(flash_cache_t *c, flashif_t *dev, void *buf, unsigned bytes)
+{
+    flashif_t *f = &c->flashif;
+
+    c->dev = dev;
+    c->buf = buf;
+    c->bytes = bytes;
+
+    f->connect = cache_connect;
+    f->erase_all = cache_erase_all;
+    f->erase_sectors = cache_erase_sectors;
+    f->write = cache_write;
+    f->read = cache_read;
+    f->min_address = cache_min_address;
+    f->flush = cache_flush;
+}
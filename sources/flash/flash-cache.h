@@ -0,0 +1,89 @@
+//
+// Кэш страниц флеш-памяти
+//
+// Драйвер реализует интерфейс flashif_t поверх другого драйвера flashif_t
+// и может использоваться файловыми системами вместо него.
+// Кэш наборно-ассоциативный: страница с номером page может находиться
+// только в наборе page % nb_sets, в одном из FLASH_CACHE_WAYS путей.
+// Запись отложенная: изменённые страницы пишутся на устройство при
+// вытеснении и при flash_flush(), причём подряд идущие страницы
+// выводятся одним вызовом записи (на SD-карте - многоблочной записью).
+// При последовательном чтении страницы читаются заранее, порциями
+// до FLASH_CACHE_READ_AHEAD страниц.
+// Большие запросы на чтение и запись идут на устройство напрямую,
+// чтобы не вытеснять из кэша служебные данные файловой системы.
+// Кэш рассчитан на устройства, страницы которых перезаписываются
+// без стирания (SD-карты): неполная страница дописывается по
+// прочитанному с устройства содержимому.
+//
+
+#ifndef __FLASH_CACHE_H__
+#define __FLASH_CACHE_H__
+
+#include <flash/flash-interface.h>
+
+// Количество путей в наборе
+#ifndef FLASH_CACHE_WAYS
+#define FLASH_CACHE_WAYS        4
+#endif
+
+// Наибольшее количество страниц, читаемых заранее за один раз
+#ifndef FLASH_CACHE_READ_AHEAD
+#define FLASH_CACHE_READ_AHEAD  8
+#endif
+
+// Запросы от стольких страниц идут в обход кэша
+#ifndef FLASH_CACHE_BYPASS
+#define FLASH_CACHE_BYPASS      8
+#endif
+
+//
+// Строка кэша
+//
+typedef struct _flash_cache_line_t
+{
+    unsigned        page;           // номер страницы на устройстве
+    unsigned        used;           // время последнего обращения (для LRU)
+    uint8_t         valid;
+    uint8_t         dirty;          // страница изменена и не записана
+} flash_cache_line_t;
+
+//
+// Структура драйвера кэша
+//
+struct _flash_cache_t
+{
+    flashif_t           flashif;    // Интерфейс флеш-памяти
+    flashif_t          *dev;        // Устройство под кэшем
+    uint8_t            *buf;        // Память под строки и данные
+    unsigned            bytes;
+    flash_cache_line_t *lines;      // nb_sets * FLASH_CACHE_WAYS строк
+    uint8_t            *data;       // Данные пути w набора s лежат по адресу
+                                    // data + (w * nb_sets + s) * page_size,
+                                    // так что соседние страницы в одном пути
+                                    // лежат в памяти подряд
+    unsigned            nb_sets;
+    unsigned            clock;      // счётчик обращений для LRU
+    unsigned            next_read;  // страница, следующая за прочитанной
+    unsigned            read_ahead; // текущая порция упреждающего чтения
+
+    // Статистика
+    unsigned long       hits;       // страниц найдено в кэше
+    unsigned long       misses;     // страниц прочитано или заведено заново
+    unsigned long       prefetched; // страниц прочитано заранее
+    unsigned long       dev_reads;  // вызовов чтения устройства
+    unsigned long       dev_writes; // вызовов записи устройства
+    unsigned long       dev_pages_written;
+};
+typedef struct _flash_cache_t flash_cache_t;
+
+//
+// Инициализация драйвера.
+// c     - драйвер кэша
+// dev   - драйвер устройства
+// buf   - память под кэш размером bytes; строки кэша размещаются
+//         в ней при flash_connect(), когда известен размер страницы
+//
+void flash_cache_init(flash_cache_t *c, flashif_t *dev, void *buf, unsigned bytes);
+
+#endif
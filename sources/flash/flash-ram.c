@@ -0,0 +1,116 @@
+//
+// Флеш-память в ОЗУ
+//
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <flash/flash-ram.h>
+
+static int
+ram_connect(flashif_t *flash)
+{
+    return FLASH_ERR_OK;
+}
+
+//
+// Учёт обмена: перезапуск, если страница не следующая
+// или сменилось направление.
+//
+static int
+ram_access(flash_ram_t *m, unsigned page_num, unsigned size, int state)
+{
+    flashif_t *flash = &m->flashif;
+    unsigned n = (size + flash->page_size - 1) / flash->page_size;
+
+    if (page_num + n > flash_nb_pages(flash))
+        return FLASH_ERR_INVAL_SIZE;
+
+    if (m->state != state || m->next_page != page_num)
+        m->restarts++;
+    m->state = state;
+    m->next_page = page_num + n;
+
+    if (state == FLASH_RAM_STATE_READ) {
+        m->reads++;
+        m->pages_read += n;
+    } else {
+        m->writes++;
+        m->pages_written += n;
+    }
+    return FLASH_ERR_OK;
+}
+
+static int
+ram_read(flashif_t *flash, unsigned page_num, void *data, unsigned size)
+{
+    flash_ram_t *m = (flash_ram_t *) flash;
+    int res;
+
+    mutex_lock(&flash->lock);
+    res = ram_access(m, page_num, size, FLASH_RAM_STATE_READ);
+    if (res == FLASH_ERR_OK)
+        memcpy(data, m->mem + page_num * flash->page_size, size);
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static int
+ram_write(flashif_t *flash, unsigned page_num, void *data, unsigned size)
+{
+    flash_ram_t *m = (flash_ram_t *) flash;
+    int res;
+
+    mutex_lock(&flash->lock);
+    res = ram_access(m, page_num, size, FLASH_RAM_STATE_WRITE);
+    if (res == FLASH_ERR_OK)
+        memcpy(m->mem + page_num * flash->page_size, data, size);
+    mutex_unlock(&flash->lock);
+    return res;
+}
+
+static int
+ram_erase_sectors(flashif_t *flash, unsigned sector_num, unsigned nb_sectors)
+{
+    flash_ram_t *m = (flash_ram_t *) flash;
+
+    if (sector_num + nb_sectors > flash->nb_sectors)
+        return FLASH_ERR_INVAL_SIZE;
+
+    mutex_lock(&flash->lock);
+    memset(m->mem + sector_num * flash_sector_size(flash), 0,
+        nb_sectors * flash_sector_size(flash));
+    m->state = FLASH_RAM_STATE_IDLE;
+    mutex_unlock(&flash->lock);
+    return FLASH_ERR_OK;
+}
+
+static int
+ram_erase_all(flashif_t *flash)
+{
+    return ram_erase_sectors(flash, 0, flash->nb_sectors);
+}
+
+static int
+ram_flush(flashif_t *flash)
+{
+    flash_ram_t *m = (flash_ram_t *) flash;
+
+    m->state = FLASH_RAM_STATE_IDLE;
+    return FLASH_ERR_OK;
+}
+
+void flash_ram_init(flash_ram_t *m, void *mem, unsigned nb_pages, unsigned page_size)
+{
+    flashif_t *f = &m->flashif;
+
+    m->mem = mem;
+    f->nb_sectors = nb_pages;
+    f->nb_pages_in_sector = 1;
+    f->page_size = page_size;
+
+    f->connect = ram_connect;
+    f->erase_all = ram_erase_all;
+    f->erase_sectors = ram_erase_sectors;
+    f->write = ram_write;
+    f->read = ram_read;
+    f->flush = ram_flush;
+}
@@ -0,0 +1,48 @@
+//
+// Флеш-память в ОЗУ
+//
+// Драйвер реализует интерфейс flashif_t над массивом в памяти и ведёт
+// себя как SD-карта: страницы перезаписываются без стирания, стирание
+// заполняет их нулями. Драйвер считает обращения и, как драйвер
+// sdhc-spi, перезапуски многоблочного обмена: при переходе на
+// непоследовательную страницу и при смене чтения на запись.
+// По этим счётчикам можно оценить на Linux работу файловых систем
+// и кэша (flash-cache.h) с реальным устройством.
+//
+
+#ifndef __FLASH_RAM_H__
+#define __FLASH_RAM_H__
+
+#include <flash/flash-interface.h>
+
+#define FLASH_RAM_STATE_IDLE    0
+#define FLASH_RAM_STATE_READ    1
+#define FLASH_RAM_STATE_WRITE   2
+
+//
+// Структура драйвера
+//
+struct _flash_ram_t
+{
+    flashif_t       flashif;        // Интерфейс флеш-памяти
+    uint8_t        *mem;            // Содержимое
+    uint8_t         state;          // Текущий многоблочный обмен
+    unsigned        next_page;      // Следующая страница обмена
+
+    // Статистика
+    unsigned long   reads;          // вызовов чтения
+    unsigned long   writes;         // вызовов записи
+    unsigned long   pages_read;
+    unsigned long   pages_written;
+    unsigned long   restarts;       // перезапусков многоблочного обмена
+};
+typedef struct _flash_ram_t flash_ram_t;
+
+//
+// Инициализация драйвера.
+// m         - драйвер флеш-памяти
+// mem       - память размером nb_pages * page_size
+//
+void flash_ram_init(flash_ram_t *m, void *mem, unsigned nb_pages, unsigned page_size);
+
+#endif
@@ -5,18 +5,27 @@
 
 void do_fat_close(fs_entry_t *entry)
 {
+    fat_fs_entry_t *e = (fat_fs_entry_t *)entry;
+
     mem_free(entry->cache_data);
     entry->cache_data = 0;
+    if (e->runs) {
+        mem_free(e->runs);
+        e->runs = 0;
+    }
+    e->nb_runs = 0;
     entry->fs->last_error = FS_ERR_OK;
 }
 
 void do_fat_free_fs_entry(fs_entry_t *entry)
 {
+    fsif_t *fs = entry->fs;
+
     if (entry->cache_data != 0)
         do_fat_close(entry);
     mem_free(entry->name);
     mem_free(entry);
-    entry->fs->last_error = FS_ERR_OK;
+    fs->last_error = FS_ERR_OK;
 }
 
 static fat_fs_entry_t *alloc_fs_entry(fat_fs_t *fat, unsigned name_size)
@@ -58,6 +67,10 @@ void do_fat_seek_start(fs_entry_t *entry)
    
     e->cur_clus = e->first_clus;
     e->cur_sec = 0;
+    e->cur_run = 0;
+    e->cache_pos = 0;
+    if (!(entry->attr & FS_ATTR_DIRECTORY))
+        entry->cache_size = 0;
     entry->cache_p = entry->cache_data;
     entry->cache_valid = 0;
     entry->cur_pos = 0;
@@ -66,44 +79,242 @@ void do_fat_seek_start(fs_entry_t *entry)
 void do_fat_open(fs_entry_t *entry)
 {
     fat_fs_t *fat = (fat_fs_t *)entry->fs;
-    
-    entry->cache_data = mem_alloc_dirty(fat->pool, fat->bytes_per_sec);
+    fat_fs_entry_t *e = (fat_fs_entry_t *)entry;
+    unsigned size = fat->bytes_per_sec;
+
+    // Каталог читается по одному сектору, файл - по FAT_READ_SECTORS
+    // секторов, с поиском кластеров по участкам цепочки.
+    if (!(entry->attr & FS_ATTR_DIRECTORY)) {
+        e->runs = mem_alloc_dirty(fat->pool,
+            (FAT_NB_RUNS + 1) * sizeof(fat_run_t));
+        if (!e->runs) {
+            entry->fs->last_error = FS_ERR_NO_MEM;
+            return;
+        }
+        e->nb_runs = 0;
+        e->runs[FAT_NB_RUNS].count = 0;
+        size *= FAT_READ_SECTORS;
+    }
+    entry->cache_data = mem_alloc_dirty(fat->pool, size);
     if (!entry->cache_data) {
+        if (e->runs) {
+            mem_free(e->runs);
+            e->runs = 0;
+        }
         entry->fs->last_error = FS_ERR_NO_MEM;
         return;
     }
-    entry->cache_size = fat->bytes_per_sec;
+    entry->cache_size = size;
     do_fat_seek_start(entry);
     entry->fs->last_error = FS_ERR_OK;
 }
 
+//
+// Чтение элемента FAT для кластера clus через кэш сектора FAT.
+//
+static int read_fat_entry(fat_fs_t *fat, uint32_t clus, uint32_t *next)
+{
+    unsigned width = (fat->fsif.fs_type == FS_TYPE_FAT16) ? 2 : 4;
+    unsigned req_sec = fat->first_fat_sec + clus * width / fat->bytes_per_sec;
+
+    if (req_sec != fat->cached_sector) {
+        if (flash_read(fat->flashif, req_sec,
+            &fat->fat_cache, fat->bytes_per_sec) != FLASH_ERR_OK)
+                return FS_ERR_IO;
+        fat->cached_sector = req_sec;
+    }
+    *next = 0;
+    memcpy(next, &fat->fat_cache[clus * width % fat->bytes_per_sec], width);
+    *next &= 0x0FFFFFFF;
+    return FS_ERR_OK;
+}
+
+static inline int end_of_chain(fat_fs_t *fat, uint32_t clus)
+{
+    if (fat->fsif.fs_type == FS_TYPE_FAT16)
+        return (clus < 2) || (clus >= 0xFFF7);
+    return (clus < 2) || (clus >= 0x0FFFFFF7);
+}
+
 static inline void move_to_next_cluster(fat_fs_t *fat, fat_fs_entry_t *f)
 {
-    unsigned req_sec;
-    if (fat->fsif.fs_type == FS_TYPE_FAT16) {
-        req_sec = fat->first_fat_sec + f->cur_clus * 2 / fat->bytes_per_sec;
-        if (req_sec != fat->cached_sector) {
-            if (flash_read(fat->flashif, req_sec,
-                &fat->fat_cache, fat->bytes_per_sec) != FLASH_ERR_OK) {
-                    fat->fsif.last_error = FS_ERR_IO;
-                    return;
-            }
-            fat->cached_sector = req_sec;
+    int err = read_fat_entry(fat, f->cur_clus, &f->cur_clus);
+    if (err != FS_ERR_OK) {
+        fat->fsif.last_error = err;
+        return;
+    }
+    f->cur_sec = 0;
+}
+
+//
+// Заполнение участка цепочки, начинающегося с кластера clus,
+// который имеет номер idx в файле. Участок продолжается, пока
+// следующий кластер по FAT лежит подряд, но не более limit кластеров.
+//
+static int load_run(fat_fs_t *fat, fat_run_t *r, uint32_t idx,
+    uint32_t clus, uint32_t limit)
+{
+    uint32_t next;
+    int err;
+
+    r->idx = idx;
+    r->clus = clus;
+    r->count = 1;
+    while (r->count < limit) {
+        err = read_fat_entry(fat, clus, &next);
+        if (err != FS_ERR_OK)
+            return err;
+        if (next != clus + 1)
+            break;
+        clus = next;
+        r->count++;
+    }
+    return FS_ERR_OK;
+}
+
+//
+// Поиск кластера с номером idx в открытом файле.
+// Таблица runs содержит известные участки цепочки по возрастанию idx.
+// Пока таблица не заполнена, участки идут подряд и покрывают начало
+// цепочки; при заполнении остаётся каждый второй участок (и последний),
+// а между ними цепочка проходится заново по FAT, от ближайшего
+// предыдущего участка. Пройденный так участок хранится в дополнительном
+// элементе runs[FAT_NB_RUNS]. Время поиска - O(числа участков) плюс
+// проход по пропущенным участкам.
+// Результат - в cur_clus и cur_run.
+//
+static int find_cluster(fat_fs_t *fat, fat_fs_entry_t *e, uint32_t idx)
+{
+    uint32_t clus_bytes = fat->bytes_per_sec * fat->sec_per_clus;
+    uint32_t nb_clus = (e->fs_entry.size + clus_bytes - 1) / clus_bytes;
+    fat_run_t *r, *walk = &e->runs[FAT_NB_RUNS];
+    uint32_t next, start, limit;
+    int i, n, err;
+
+    // Обычно кластер в том же участке, что и предыдущий
+    r = &e->runs[e->cur_run];
+    if ((e->cur_run < e->nb_runs || e->cur_run == FAT_NB_RUNS) &&
+        idx - r->idx < r->count)
+            goto found;
+
+    for (i = e->nb_runs - 1; i > 0; --i)
+        if (e->runs[i].idx <= idx)
+            break;
+    if (i >= 0 && idx - e->runs[i].idx < e->runs[i].count) {
+        e->cur_run = i;
+        r = &e->runs[i];
+        goto found;
+    }
+
+    if (i >= 0 && i < e->nb_runs - 1) {
+        // Кластер в пропуске между участками i и i+1: идём по цепочке
+        // от участка i или от пройденного ранее участка в этом пропуске
+        r = &e->runs[i];
+        e->cur_run = FAT_NB_RUNS;
+        if (walk->count && walk->idx > r->idx && walk->idx <= idx) {
+            r = walk;
+            if (idx - r->idx < r->count)
+                goto found;
         }
-        memcpy(&f->cur_clus, &fat->fat_cache[f->cur_clus * 2 % fat->bytes_per_sec], 2);
-    } else {
-        req_sec = fat->first_fat_sec + f->cur_clus * 4 / fat->bytes_per_sec;
-        if (req_sec != fat->cached_sector) {
-            if (flash_read(fat->flashif, req_sec,
-                &fat->fat_cache, fat->bytes_per_sec) != FLASH_ERR_OK) {
-                    fat->fsif.last_error = FS_ERR_IO;
-                    return;
-            }
-            fat->cached_sector = req_sec;
+        limit = e->runs[i + 1].idx;
+        for (;;) {
+            err = read_fat_entry(fat, r->clus + r->count - 1, &next);
+            if (err != FS_ERR_OK)
+                return err;
+            start = r->idx + r->count;
+            if (end_of_chain(fat, next))
+                return FS_ERR_BAD_FORMAT;
+            err = load_run(fat, walk, start, next, limit - start);
+            if (err != FS_ERR_OK)
+                return err;
+            r = walk;
+            if (idx - r->idx < r->count)
+                goto found;
         }
-        memcpy(&f->cur_clus, &fat->fat_cache[f->cur_clus * 4 % fat->bytes_per_sec], 4);
     }
-    f->cur_sec = 0;
+
+    // Кластер дальше известной части цепочки: продолжаем её
+    for (;;) {
+        if (e->nb_runs == 0) {
+            start = 0;
+            next = e->first_clus;
+        } else {
+            r = &e->runs[e->nb_runs - 1];
+            err = read_fat_entry(fat, r->clus + r->count - 1, &next);
+            if (err != FS_ERR_OK)
+                return err;
+            start = r->idx + r->count;
+        }
+        if (end_of_chain(fat, next))
+            return FS_ERR_BAD_FORMAT;
+        if (e->nb_runs == FAT_NB_RUNS) {
+            // Оставляем чётные участки и последний
+            for (n = 1, i = 2; i < FAT_NB_RUNS - 1; i += 2)
+                e->runs[n++] = e->runs[i];
+            e->runs[n++] = e->runs[FAT_NB_RUNS - 1];
+            e->nb_runs = n;
+        }
+        r = &e->runs[e->nb_runs];
+        err = load_run(fat, r, start, next, nb_clus - start);
+        if (err != FS_ERR_OK)
+            return err;
+        e->cur_run = e->nb_runs++;
+        if (idx - r->idx < r->count)
+            goto found;
+    }
+found:
+    e->cur_clus = r->clus + (idx - r->idx);
+    return FS_ERR_OK;
+}
+
+//
+// Чтение в кэш файла секторов, начиная с сектора текущей позиции,
+// одним запросом к флеш-памяти. Первый запрос после перехода читает
+// один сектор; при последовательном чтении размер запроса удваивается
+// до FAT_READ_SECTORS в пределах участка цепочки и файла.
+//
+static int read_file_cache(fat_fs_t *fat, fat_fs_entry_t *e)
+{
+    fs_entry_t *entry = &e->fs_entry;
+    uint32_t clus_bytes = fat->bytes_per_sec * fat->sec_per_clus;
+    uint32_t idx, nb_sec, rest;
+    filsiz_t pos;
+    fat_run_t *r;
+    int err;
+
+    if (fs_at_end(entry))
+        return FS_ERR_EOF;
+    idx = entry->cur_pos / clus_bytes;
+    err = find_cluster(fat, e, idx);
+    if (err != FS_ERR_OK)
+        return err;
+    r = &e->runs[e->cur_run];
+    e->cur_sec = entry->cur_pos % clus_bytes / fat->bytes_per_sec;
+    pos = entry->cur_pos - entry->cur_pos % fat->bytes_per_sec;
+
+    nb_sec = 1;
+    if (pos == e->cache_pos + entry->cache_size && entry->cache_size) {
+        nb_sec = 2 * entry->cache_size / fat->bytes_per_sec;
+        if (nb_sec > FAT_READ_SECTORS)
+            nb_sec = FAT_READ_SECTORS;
+        rest = (r->idx + r->count - idx) * fat->sec_per_clus - e->cur_sec;
+        if (nb_sec > rest)
+            nb_sec = rest;
+        rest = (entry->size - pos + fat->bytes_per_sec - 1) /
+            fat->bytes_per_sec;
+        if (nb_sec > rest)
+            nb_sec = rest;
+    }
+    e->cache_pos = pos;
+
+    if (flash_read(fat->flashif,
+            fat->first_data_sec + (e->cur_clus - 2) * fat->sec_per_clus + e->cur_sec,
+            entry->cache_data, nb_sec * fat->bytes_per_sec) != FLASH_ERR_OK)
+        return FS_ERR_IO;
+    entry->cache_size = nb_sec * fat->bytes_per_sec;
+    entry->cache_p = entry->cache_data + (entry->cur_pos - e->cache_pos);
+    entry->cache_valid = 1;
+    return FS_ERR_OK;
 }
 
 static inline void move_to_next_sector(fat_fs_t *fat, fat_fs_entry_t *e)
@@ -120,6 +331,10 @@ void do_fat_update_cache(fs_entry_t *entry)
     fat_fs_t *fat = (fat_fs_t *)e->fs_entry.fs;
     
     if (!entry->cache_valid) {
+        if (!(entry->attr & FS_ATTR_DIRECTORY)) {
+            entry->fs->last_error = read_file_cache(fat, e);
+            return;
+        }
         if (flash_read(fat->flashif, 
                 fat->first_data_sec + ((e->cur_clus & 0x0FFFFFFF) - 2) * fat->sec_per_clus + e->cur_sec,
                 entry->cache_data, entry->cache_size) != FLASH_ERR_OK)
@@ -171,37 +386,22 @@ unsigned do_fat_advance(fs_entry_t *entry, unsigned offset)
         } while (offset);
     } else {
         if (entry->cur_pos >= entry->size) return 0;
-        
-        unsigned bytes_to_end_of_sec = fat->bytes_per_sec - entry->cur_pos % fat->bytes_per_sec;
-        unsigned bytes_to_end_of_file = entry->size - entry->cur_pos;
-        do {
-            if (bytes_to_end_of_file < bytes_to_end_of_sec) {
-                if (offset <= bytes_to_end_of_file) {
-                    entry->cur_pos += offset;
-                    entry->cache_p += offset;
-                    return init_offset;
-                } else {
-                    entry->cur_pos = entry->size;
-                    entry->cache_p += bytes_to_end_of_file;
-                    offset -= bytes_to_end_of_file;
-                    return init_offset - offset;
-                }
-            } else {
-                if (offset < bytes_to_end_of_sec) {
-                    entry->cur_pos += offset;
-                    entry->cache_p += offset;
-                    return init_offset;
-                } else {
-                    move_to_next_sector(fat, e);
-                    if (entry->fs->last_error != FS_ERR_OK)
-                        return init_offset - offset;
-                    entry->cur_pos += bytes_to_end_of_sec;
-                    offset -= bytes_to_end_of_sec;
-                    bytes_to_end_of_file -= bytes_to_end_of_sec;
-                    bytes_to_end_of_sec = fat->bytes_per_sec;
-                }
-            }
-        } while (offset);
+        if (offset > entry->size - entry->cur_pos)
+            offset = entry->size - entry->cur_pos;
+        entry->cur_pos += offset;
+
+        // Кэш остаётся действительным, пока позиция в его пределах.
+        // Иначе кластер новой позиции найдётся по участкам цепочки
+        // при следующем обновлении кэша.
+        if (entry->cache_valid &&
+            entry->cur_pos < e->cache_pos + entry->cache_size) {
+                entry->cache_p = entry->cache_data +
+                    (entry->cur_pos - e->cache_pos);
+        } else {
+            entry->cache_valid = 0;
+            entry->cache_p = entry->cache_data;
+        }
+        return offset;
     }
     return init_offset - offset;
 }
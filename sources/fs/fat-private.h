@@ -115,6 +115,17 @@ typedef struct __attribute__((packed)) _fat_long_ent_t
     uint16_t    name2[2];
 } fat_long_ent_t;
 
+//
+// Непрерывный участок цепочки кластеров файла: кластеры файла
+// с номерами idx ... idx+count-1 лежат на диске подряд, начиная с clus.
+//
+typedef struct _fat_run_t
+{
+    uint32_t    idx;
+    uint32_t    clus;
+    uint32_t    count;
+} fat_run_t;
+
 typedef struct _fat_fs_entry_t
 {
     fs_entry_t  fs_entry;
@@ -123,6 +134,11 @@ typedef struct _fat_fs_entry_t
     uint32_t    parent_pos;
     uint32_t    cur_clus;
     uint8_t     cur_sec;
+    uint16_t    nb_runs;        // Количество известных участков
+    uint16_t    cur_run;        // Участок, содержащий cur_clus
+    fat_run_t * runs;           // Участки цепочки, по порядку (только
+                                // для открытого файла)
+    filsiz_t    cache_pos;      // Позиция в файле начала cache_data
 } fat_fs_entry_t;
 
 
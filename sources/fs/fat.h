@@ -7,6 +7,19 @@
 
 #define FAT_MAX_BYTES_PER_SECTOR    512
 
+// Количество секторов, читаемых из файла одним запросом к флеш-памяти.
+// Каждый открытый файл получает кэш такого размера, поэтому по умолчанию
+// он мал; платы с большим объёмом ОЗУ могут его увеличить.
+#ifndef FAT_READ_SECTORS
+#define FAT_READ_SECTORS            2
+#endif
+
+// Количество запоминаемых непрерывных участков цепочки кластеров
+// открытого файла (не меньше 4)
+#ifndef FAT_NB_RUNS
+#define FAT_NB_RUNS                 16
+#endif
+
 //
 // Структура драйвера файловой системы FAT
 //
@@ -1,5 +1,6 @@
 #include <runtime/lib.h>
 #include <kernel/uos.h>
+#include <timer/timer.h>
 #include <fs/fat-private.h>
 #include <fs/fat32-fast-write.h>
 
@@ -322,6 +323,250 @@ void fat32_fw_create(fat32_fw_t *fat, fs_entry_t *entry)
     fat->last_error = FS_ERR_OK;
 }
 
+//
+// Номер сектора, в котором находится позиция pos текущего файла.
+//
+static inline unsigned file_sector(fat32_fw_t *fat, filsiz_t pos)
+{
+    return fat->rsvd_sec_cnt + 2 * fat->fat_sz32 +
+        ((fat->cur_dir_entry.first_clus - 2) << FAT_SEC_PER_CLUSTER_POW) +
+        (pos >> FAT_SECTOR_SIZE_POW);
+}
+
+//
+// Сколько байт можно записать в буфер, начинающийся с сектора sector:
+// последний буфер может упираться в конец раздела.
+//
+static unsigned writer_limit(fat32_fw_t *fat, unsigned sector)
+{
+    unsigned nb_sec = fat->writer->buf_size >> FAT_SECTOR_SIZE_POW;
+
+    if (fat->tot_sec32 - sector < nb_sec)
+        nb_sec = fat->tot_sec32 - sector;
+    return nb_sec << FAT_SECTOR_SIZE_POW;
+}
+
+//
+// Вывод буфера с номером i на флеш одним вызовом flash_write.
+//
+static int writer_output(fat32_fw_t *fat, unsigned i, unsigned size)
+{
+    fat32_fw_writer_t *w = fat->writer;
+    unsigned long t0 = 0, t;
+    int res;
+
+    if (w->timer)
+        t0 = timer_milliseconds(w->timer);
+
+    res = flash_write(fat->flashif, w->sector[i], w->bufs + i * w->buf_size, size);
+
+    if (w->timer) {
+        t = timer_milliseconds(w->timer) - t0;
+        if (t > w->max_flash_msec)
+            w->max_flash_msec = t;
+    }
+    return (res == FLASH_ERR_OK) ? FS_ERR_OK : FS_ERR_IO;
+}
+
+static void writer_task(void *arg)
+{
+    fat32_fw_t *fat = arg;
+    fat32_fw_writer_t *w = fat->writer;
+    unsigned i;
+    int res;
+
+    mutex_lock(&w->lock);
+    for (;;) {
+        if (w->tail == w->head) {
+            mutex_wait(&w->lock);
+            continue;
+        }
+        // Пока буфер пишется, fat32_fw_write() заполняет следующие
+        i = w->tail % w->nb_bufs;
+        mutex_unlock(&w->lock);
+        res = writer_output(fat, i, writer_limit(fat, w->sector[i]));
+        mutex_lock(&w->lock);
+
+        if (res != FS_ERR_OK)
+            w->error = res;
+        w->tail++;
+        w->buffers++;
+        mutex_signal(&w->lock, 0);
+    }
+}
+
+//
+// Ожидание, пока в кольце останется не больше busy заполненных буферов.
+// Если задача записи не запущена, буферы записываются здесь же.
+//
+static void writer_wait(fat32_fw_t *fat, unsigned busy)
+{
+    fat32_fw_writer_t *w = fat->writer;
+    unsigned i;
+    int res;
+
+    if (! w->running) {
+        while (w->head - w->tail > busy) {
+            i = w->tail % w->nb_bufs;
+            res = writer_output(fat, i, writer_limit(fat, w->sector[i]));
+            if (res != FS_ERR_OK)
+                w->error = res;
+            w->tail++;
+            w->buffers++;
+        }
+        return;
+    }
+
+    mutex_lock(&w->lock);
+    while (w->head - w->tail > busy)
+        mutex_wait(&w->lock);
+    mutex_unlock(&w->lock);
+}
+
+//
+// Ошибка записи, случившаяся с прошлой проверки.
+//
+static int writer_error(fat32_fw_writer_t *w)
+{
+    int res;
+
+    mutex_lock(&w->lock);
+    res = w->error;
+    w->error = FS_ERR_OK;
+    mutex_unlock(&w->lock);
+    return res;
+}
+
+//
+// Запись на флеш всех буферов, включая частично заполненный.
+// С keep != 0 частичный буфер остаётся текущим: при дозаписи
+// он будет записан ещё раз уже целиком.
+//
+static int writer_flush(fat32_fw_t *fat, int keep)
+{
+    fat32_fw_writer_t *w = fat->writer;
+    int res;
+
+    writer_wait(fat, 0);
+    if (w->fill) {
+        res = writer_output(fat, w->head % w->nb_bufs,
+            (w->fill + FAT_SECTOR_SIZE - 1) & ~(FAT_SECTOR_SIZE - 1));
+        if (res != FS_ERR_OK)
+            w->error = res;
+        if (! keep)
+            w->fill = 0;
+    }
+    return writer_error(w);
+}
+
+//
+// Асинхронная запись: данные копируются в кольцо буферов,
+// заполненный буфер передаётся задаче записи.
+//
+static void writer_put(fat32_fw_t *fat, uint8_t *p, filsiz_t size)
+{
+    fat32_fw_writer_t *w = fat->writer;
+    fat32_fw_entry_t *f = &fat->cur_dir_entry;
+    unsigned long t0 = 0, t;
+    unsigned i, n, limit;
+    uint8_t *buf;
+
+    if (w->timer)
+        t0 = timer_milliseconds(w->timer);
+
+    fat->last_error = FS_ERR_OK;
+    while (size > 0) {
+        i = w->head % w->nb_bufs;
+        buf = w->bufs + i * w->buf_size;
+        if (w->fill == 0) {
+            // Начинаем новый буфер: ждём, пока задача записи его освободит
+            if (f->cur_sector >= fat->tot_sec32) {
+                fat->last_error = FS_ERR_EOF;
+                break;
+            }
+            if (w->head - w->tail >= w->nb_bufs) {
+                w->stalls++;
+                writer_wait(fat, w->nb_bufs - 1);
+            }
+            w->sector[i] = f->cur_sector;
+
+            // Начало сектора уже записано раньше - читаем его
+            w->fill = f->base.cur_pos & (FAT_SECTOR_SIZE - 1);
+            if (w->fill && flash_read(fat->flashif, f->cur_sector, buf,
+                    FAT_SECTOR_SIZE) != FLASH_ERR_OK) {
+                w->fill = 0;
+                fat->last_error = FS_ERR_IO;
+                break;
+            }
+        }
+
+        limit = writer_limit(fat, w->sector[i]);
+        n = limit - w->fill;
+        if (n > size)
+            n = size;
+        memcpy(buf + w->fill, p, n);
+        w->fill += n;
+        p += n;
+        size -= n;
+
+        f->base.cur_pos += n;
+        if (f->base.size < f->base.cur_pos)
+            f->base.size = f->base.cur_pos;
+        f->cur_sector = file_sector(fat, f->base.cur_pos);
+
+        if (w->fill == limit) {
+            // Буфер заполнен - отдаём его задаче записи
+            mutex_lock(&w->lock);
+            w->head++;
+            if (w->head - w->tail > w->max_queued)
+                w->max_queued = w->head - w->tail;
+            mutex_signal(&w->lock, 0);
+            mutex_unlock(&w->lock);
+            w->fill = 0;
+        }
+    }
+
+    if (fat->last_error == FS_ERR_OK)
+        fat->last_error = writer_error(w);
+
+    if (w->timer) {
+        t = timer_milliseconds(w->timer) - t0;
+        if (t > w->max_write_msec)
+            w->max_write_msec = t;
+    }
+}
+
+void fat32_fw_writer_init(fat32_fw_t *fat, fat32_fw_writer_t *w, void *bufs,
+    unsigned nb_bufs, unsigned buf_size, struct _timer_t *timer)
+{
+    assert(nb_bufs > 0 && nb_bufs <= FAT32_FW_MAX_BUFS);
+    assert(buf_size >= FAT_SECTOR_SIZE && (buf_size & (FAT_SECTOR_SIZE - 1)) == 0);
+
+    // Задача записи работает со структурой и её блокировкой.
+    if (fat->cur_dir_entry.mode || (fat->writer && fat->writer->running)) {
+        fat->last_error = FS_ERR_PROHIBITED;
+        return;
+    }
+
+    memset(w, 0, sizeof(fat32_fw_writer_t));
+    w->bufs = bufs;
+    w->nb_bufs = nb_bufs;
+    w->buf_size = buf_size;
+    w->timer = timer;
+    fat->writer = w;
+
+    fat->last_error = FS_ERR_OK;
+}
+
+void fat32_fw_writer_start(fat32_fw_t *fat, int prio, array_t *stack, unsigned stacksz)
+{
+    assert(fat->writer);
+    assert(! fat->writer->running);
+
+    fat->writer->running = 1;
+    task_create(writer_task, fat, "fatw", prio, stack, stacksz);
+}
+
 void fat32_fw_open(fat32_fw_t *fat, int file_mode)
 {
     if (fat->cur_dir_entry.mode) {
@@ -333,6 +578,7 @@ void fat32_fw_open(fat32_fw_t *fat, int file_mode)
         fat->cur_dir_entry.cur_sector = fat->rsvd_sec_cnt + 2 * fat->fat_sz32 +
         ((fat->cur_dir_entry.first_clus - 2) << FAT_SEC_PER_CLUSTER_POW);
         fat->cur_dir_entry.base.cur_pos = 0;
+        fat->cur_dir_entry.end_clus = 0;
     } else {
         fat->last_error = FS_ERR_BAD_ARG;
         return;
@@ -348,6 +594,12 @@ void fat32_fw_seek_start(fat32_fw_t *fat)
         return;
     }
 
+    // Буферы асинхронной записи относятся к прежней позиции
+    if (fat->cur_dir_entry.mode == O_WRITE && fat->writer) {
+        fat->last_error = writer_flush(fat, 0);
+        if (fat->last_error != FS_ERR_OK) return;
+    }
+
 	fat->cur_dir_entry.base.cur_pos = 0;
 	fat->cur_dir_entry.cur_sector = fat->rsvd_sec_cnt + 2 * fat->fat_sz32 +
 		((fat->cur_dir_entry.first_clus - 2) << FAT_SEC_PER_CLUSTER_POW);
@@ -362,6 +614,11 @@ void fat32_fw_advance(fat32_fw_t *fat, filsiz_t size)
         return;
     }
 
+    if (fat->cur_dir_entry.mode == O_WRITE && fat->writer) {
+        fat->last_error = writer_flush(fat, 0);
+        if (fat->last_error != FS_ERR_OK) return;
+    }
+
 	if (fat->cur_dir_entry.mode == O_READ && 
 		fat->cur_dir_entry.base.size <= fat->cur_dir_entry.base.cur_pos + size) {
 			fat->last_error = FS_ERR_EOF;
@@ -439,6 +696,10 @@ void fat32_fw_write(fat32_fw_t *fat, void *data, filsiz_t size)
         fat->last_error = FS_ERR_BAD_STATE;
         return;
     }
+    if (fat->writer) {
+        writer_put(fat, data, size);
+        return;
+    }
     //fat->last_error = fat_read_sector(fat, fat->cur_dir_entry.cur_sector);
     //if (fat->last_error != FS_ERR_OK) return;
 
@@ -493,61 +754,135 @@ void fat32_fw_write(fat32_fw_t *fat, void *data, filsiz_t size)
     fat->last_error = FS_ERR_OK;
 }
 
-void fat32_fw_close(fat32_fw_t *fat)
+//
+// Запись информации о текущем файле: признак конца файла в FAT,
+// размер в корневой директории и номер свободного кластера в FSInfo.
+//
+static int write_file_info(fat32_fw_t *fat)
 {
-    if (fat->cur_dir_entry.mode == O_WRITE) {
-        // При закрытии записи нужно выполнить несколько шагов:
-        // 1. Записать кэшируемый сектор на флеш
-        if (fat->cached_sector_size) {
-            fat->last_error = fat_write_sector(fat, fat->cur_dir_entry.cur_sector, 
-                fat->cached_sector_size);
-            if (fat->last_error != FS_ERR_OK) return;
-        }
-        
-        // 2. Записать в FAT признак конца файла.
-        unsigned last_cluster = fat->cur_dir_entry.first_clus + 
-			((fat->cur_dir_entry.base.size + FAT_SECTOR_SIZE * FAT_SEC_PER_CLUSTER - 1) >> 
-			(FAT_SECTOR_SIZE_POW + FAT_SEC_PER_CLUSTER_POW)) - 1;
+    fat32_fw_entry_t *f = &fat->cur_dir_entry;
+    unsigned fat_sec;
+    int res;
 
-        unsigned last_cluster_fat_sec = fat->rsvd_sec_cnt + (last_cluster >> (FAT_SECTOR_SIZE_POW - 2));
+    unsigned last_cluster = f->first_clus +
+        ((f->base.size + FAT_SECTOR_SIZE * FAT_SEC_PER_CLUSTER - 1) >>
+        (FAT_SECTOR_SIZE_POW + FAT_SEC_PER_CLUSTER_POW)) - 1;
 
-        fat->last_error = fat_read_sector(fat, last_cluster_fat_sec);
-        if (fat->last_error != FS_ERR_OK) return;
+    // 1. Если после fat32_fw_sync() файл вырос, восстановить цепочку
+    //    на месте прежнего признака конца файла.
+    if (f->end_clus && f->end_clus != last_cluster) {
+        fat_sec = fat->rsvd_sec_cnt + (f->end_clus >> (FAT_SECTOR_SIZE_POW - 2));
+        res = fat_read_sector(fat, fat_sec);
+        if (res != FS_ERR_OK) return res;
 
-        fat->sector[last_cluster & ((FAT_SECTOR_SIZE >> 2) - 1)] = FAT32_FILE_END;
+        fat->sector[f->end_clus & ((FAT_SECTOR_SIZE >> 2) - 1)] = f->end_clus + 1;
 
-        fat->last_error = fat_write_sector(fat, last_cluster_fat_sec, FAT_SECTOR_SIZE);
-        if (fat->last_error != FS_ERR_OK) return;
+        res = fat_write_sector(fat, fat_sec, FAT_SECTOR_SIZE);
+        if (res != FS_ERR_OK) return res;
+    }
+
+    // 2. Записать в FAT признак конца файла.
+    fat_sec = fat->rsvd_sec_cnt + (last_cluster >> (FAT_SECTOR_SIZE_POW - 2));
+
+    res = fat_read_sector(fat, fat_sec);
+    if (res != FS_ERR_OK) return res;
+
+    fat->sector[last_cluster & ((FAT_SECTOR_SIZE >> 2) - 1)] = FAT32_FILE_END;
+
+    res = fat_write_sector(fat, fat_sec, FAT_SECTOR_SIZE);
+    if (res != FS_ERR_OK) return res;
+    f->end_clus = f->base.size ? last_cluster : 0;
+
+    // 3. Обновить запись о файле в корневой директории.
+    // Здесь считаем, что всегда sizeof(fat_dir_ent_t) == 32
+    unsigned nb_sec = fat->rsvd_sec_cnt + 2 * fat->fat_sz32 +
+        ((fat->nb_entries - 1) >> (FAT_SECTOR_SIZE_POW - 5));
+    res = fat_read_sector(fat, nb_sec);
+    if (res != FS_ERR_OK) return res;
+
+    fat_dir_ent_t *e = (fat_dir_ent_t *) fat->sector +
+        ((fat->nb_entries - 1) & ((FAT_SECTOR_SIZE >> 5) - 1));
+    e->file_size = f->base.size;
+
+    res = fat_write_sector(fat, nb_sec, FAT_SECTOR_SIZE);
+    if (res != FS_ERR_OK) return res;
+
+    // 4. Посчитать новое значение номера свободного кластера
+    //    и записать его в FSInfo.
+    fat->nxt_free = last_cluster + 1;
+    fat32_fsinfo_t *fs_info = (fat32_fsinfo_t *)fat->sector;
+    res = fat_read_sector(fat, 1);
+    if (res != FS_ERR_OK) return res;
+    fs_info->nxt_free = fat->nxt_free;
+    res = fat_write_sector(fat, 1, FAT_SECTOR_SIZE);
+    if (res != FS_ERR_OK) return res;
+    return fat_write_sector(fat, 7, FAT_SECTOR_SIZE);
+}
+
+void fat32_fw_flush(fat32_fw_t *fat)
+{
+    if (fat->cur_dir_entry.mode != O_WRITE) {
+        fat->last_error = FS_ERR_BAD_STATE;
+        return;
+    }
 
-        // 3. Обновить запись о файле в корневой директории.
-        // Здесь считаем, что всегда sizeof(fat_dir_ent_t) == 32
-        unsigned nb_sec = fat->rsvd_sec_cnt + 2 * fat->fat_sz32 +
-            ((fat->nb_entries - 1) >> (FAT_SECTOR_SIZE_POW - 5));
-        fat->last_error = fat_read_sector(fat, nb_sec);
+    if (fat->writer) {
+        fat->last_error = writer_flush(fat, 1);
+        return;
+    }
+
+    // Кэшируемый сектор остаётся в буфере для дозаписи
+    unsigned size = fat->cached_sector_size;
+    if (size) {
+        fat->last_error = fat_write_sector(fat, fat->cur_dir_entry.cur_sector, size);
         if (fat->last_error != FS_ERR_OK) return;
+        fat->cached_sector_size = size;
+    }
 
-        fat_dir_ent_t *e = (fat_dir_ent_t *) fat->sector +
-            ((fat->nb_entries - 1) & ((FAT_SECTOR_SIZE >> 5) - 1));
-        e->file_size = fat->cur_dir_entry.base.size;
+    fat->last_error = FS_ERR_OK;
+}
+
+void fat32_fw_sync(fat32_fw_t *fat)
+{
+    unsigned part = fat->cur_dir_entry.base.cur_pos & (FAT_SECTOR_SIZE - 1);
+
+    fat32_fw_flush(fat);
+    if (fat->last_error != FS_ERR_OK) return;
 
-        fat->last_error = fat_write_sector(fat, nb_sec, FAT_SECTOR_SIZE);
+    fat->last_error = write_file_info(fat);
+    if (fat->last_error != FS_ERR_OK) return;
+
+    // Буфер сектора занят служебными данными - возвращаем в него
+    // частично записанный сектор файла
+    if (! fat->writer && part) {
+        fat->last_error = fat_read_sector(fat, fat->cur_dir_entry.cur_sector);
         if (fat->last_error != FS_ERR_OK) return;
+        fat->cached_sector_size = part;
+    }
 
-        if (flash_write(fat->flashif, nb_sec, fat->sector, FAT_SECTOR_SIZE) != FLASH_ERR_OK) {
-            fat->last_error = FS_ERR_IO;
-            return;
+    if (flash_flush(fat->flashif) != FLASH_ERR_OK) {
+        fat->last_error = FS_ERR_IO;
+        return;
+    }
+
+    fat->last_error = FS_ERR_OK;
+}
+
+void fat32_fw_close(fat32_fw_t *fat)
+{
+    if (fat->cur_dir_entry.mode == O_WRITE) {
+        // При закрытии записи нужно записать на флеш данные,
+        // а затем информацию о файле.
+        if (fat->writer) {
+            fat->last_error = writer_flush(fat, 0);
+            if (fat->last_error != FS_ERR_OK) return;
+        } else if (fat->cached_sector_size) {
+            fat->last_error = fat_write_sector(fat, fat->cur_dir_entry.cur_sector, 
+                fat->cached_sector_size);
+            if (fat->last_error != FS_ERR_OK) return;
         }
 
-        // 4. Посчитать новое значение номера свободного кластера
-        //    и записать его в FSInfo.
-        fat->nxt_free = last_cluster + 1;
-        fat32_fsinfo_t *fs_info = (fat32_fsinfo_t *)fat->sector;
-        fat->last_error = fat_read_sector(fat, 1);
-        if (fat->last_error != FS_ERR_OK) return;
-        fs_info->nxt_free = fat->nxt_free;
-        fat->last_error = fat_write_sector(fat, 1, FAT_SECTOR_SIZE);
-        if (fat->last_error != FS_ERR_OK) return;
-        fat->last_error = fat_write_sector(fat, 7, FAT_SECTOR_SIZE);
+        fat->last_error = write_file_info(fat);
         if (fat->last_error != FS_ERR_OK) return;
     }
 
@@ -22,15 +22,49 @@
 #define O_READ      0x1
 #define O_WRITE     0x2
 
+// Максимальное количество буферов асинхронной записи
+#ifndef FAT32_FW_MAX_BUFS
+#define FAT32_FW_MAX_BUFS           8
+#endif
+
 
 typedef struct _fat32_fw_entry_t
 {
     fs_entry_t  base;
     uint32_t    first_clus;
     uint32_t    cur_sector;
+    uint32_t    end_clus;       // кластер с признаком конца файла после fat32_fw_sync
     int         mode;
 } fat32_fw_entry_t;
 
+//
+// Асинхронная запись: fat32_fw_write() копирует данные в кольцо буферов
+// и возвращается, а задача записи выводит заполненные буферы на флеш,
+// каждый одним вызовом flash_write (на SD-карте - многоблочной записью).
+// Когда все буферы заняты, fat32_fw_write() ждёт освобождения буфера.
+//
+typedef struct _fat32_fw_writer_t
+{
+    mutex_t             lock;           // сигналы между fat32_fw_write() и задачей
+    struct _timer_t *   timer;          // для измерения задержек, может быть 0
+    uint8_t *           bufs;           // nb_bufs буферов по buf_size байт
+    unsigned            buf_size;       // кратен FAT_SECTOR_SIZE
+    unsigned            nb_bufs;
+    unsigned            head;           // буферов заполнено
+    unsigned            tail;           // буферов записано на флеш
+    unsigned            fill;           // байт в заполняемом буфере
+    uint32_t            sector[FAT32_FW_MAX_BUFS];  // куда записать буфер
+    int                 error;          // ошибка задачи записи
+    bool_t              running;        // задача записи запущена
+
+    // Статистика
+    unsigned long       buffers;        // записано буферов
+    unsigned long       stalls;         // fat32_fw_write() ждала свободный буфер
+    unsigned            max_queued;     // наибольшее число заполненных буферов
+    unsigned long       max_write_msec; // наибольшая задержка fat32_fw_write()
+    unsigned long       max_flash_msec; // наибольшая длительность flash_write
+} fat32_fw_writer_t;
+
 //
 // Структура драйвера файловой системы FAT
 //
@@ -49,6 +83,7 @@ typedef struct _fat32_fw_t
     char                name_buf[16];
     uint32_t            cached_sector;
     uint32_t            cached_sector_size;
+    fat32_fw_writer_t * writer;         // 0 - синхронная запись
     uint32_t            sector[FAT_SECTOR_SIZE / 4] __attribute__((aligned(8)));
 } fat32_fw_t;
 
@@ -115,6 +150,38 @@ void fat32_fw_write(fat32_fw_t *fat, void *data, filsiz_t size);
 //
 void fat32_fw_write(fat32_fw_t *fat, void *data, filsiz_t size);
 
+//
+// Включение асинхронной записи с кольцом из nb_bufs буферов по buf_size байт.
+// Память bufs должна быть выровнена для флеш-драйвера (flash_data_align).
+// Размер буфера кратен FAT_SECTOR_SIZE; удобно брать размер кластера.
+// С таймером измеряются наибольшие задержки записи, в миллисекундах,
+// с точностью до периода таймера (msec_per_tick в timer_init): более
+// короткие задержки видны как 0 или как один период.
+// Вызывается, когда нет открытого файла и задача записи не запущена.
+//
+void fat32_fw_writer_init(fat32_fw_t *fat, fat32_fw_writer_t *w, void *bufs,
+    unsigned nb_bufs, unsigned buf_size, struct _timer_t *timer);
+
+//
+// Запуск задачи записи, после fat32_fw_writer_init().
+// Приоритет задачи должен быть ниже, чем у задач,
+// которые пишут в файл. Без задачи заполненные буферы записываются
+// в fat32_fw_write(), когда кольцо переполнено.
+//
+void fat32_fw_writer_start(fat32_fw_t *fat, int prio, array_t *stack, unsigned stacksz);
+
+//
+// Ожидание записи на флеш всех данных, переданных fat32_fw_write().
+// Размер файла в директории при этом не меняется.
+//
+void fat32_fw_flush(fat32_fw_t *fat);
+
+//
+// Запись данных и информации о файле (размер, конец цепочки в FAT, FSInfo)
+// без закрытия файла: после сбоя питания файл будет прочитан до этой точки.
+//
+void fat32_fw_sync(fat32_fw_t *fat);
+
 //
 // Чтение очередной порции данных из файла.
 //
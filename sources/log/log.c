@@ -0,0 +1,484 @@
+/*
+ * Deferred logging: writers store raw arguments into a ring,
+ * the drain task formats them later.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <kernel/internal.h>
+#include <stream/stream.h>
+#include <timer/timer.h>
+#include <log/log.h>
+
+/*
+ * Record in the ring: header, then packed arguments.
+ * Records are aligned to the size of long. A record never wraps
+ * around the end of the ring: the tail of the ring is skipped instead.
+ * When the tail is shorter than the header, it has no header:
+ * both writers and the drain skip it implicitly.
+ */
+typedef struct {
+	unsigned	size;		/* bytes, with header and arguments */
+	volatile unsigned char state;	/* RECORD_xxx */
+	unsigned long	time;		/* milliseconds */
+	const char	*fmt;
+} record_t;
+
+#define RECORD_BUSY	0		/* being written */
+#define RECORD_READY	1		/* ready for output */
+#define RECORD_SKIP	2		/* unused space at the end of the ring */
+
+#define ALIGN(n)	(((n) + sizeof(long) - 1) & ~(sizeof(long) - 1))
+
+/*
+ * Store the argument of given type, if it fits.
+ */
+#define PUT(type, val) { type v = (val); \
+			if (n + sizeof(type) > LOG_MAXARGS) return n; \
+			memcpy (args + n, &v, sizeof(type)); n += sizeof(type); }
+
+/*
+ * Fetch the argument of given type, stop when nothing is left.
+ */
+#define GET(type, v)	{ if (arg + sizeof(type) > end) goto truncated; \
+			memcpy (&v, arg, sizeof(type)); arg += sizeof(type); }
+
+log_t *
+log_init (array_t *buf, unsigned bytes, stream_t *stream, timer_t *timer)
+{
+	log_t *l = (log_t*) buf;
+	unsigned size;
+
+	memset (l, 0, sizeof(log_t));
+	bytes -= sizeof(log_t) - sizeof(l->ring);
+	for (size = sizeof(long); size * 2 <= bytes; size *= 2)
+		continue;
+
+	/* At least two records of maximal size. */
+	assert (size >= 2 * ALIGN (sizeof(record_t) + LOG_MAXARGS));
+	l->size = size;
+	l->stream = stream;
+	l->timer = timer;
+
+	/* Without the timer nobody but writers can wake the drain. */
+	l->wakeup = timer ? size / 4 : 1;
+	return l;
+}
+
+void
+log_set_stream (log_t *l, stream_t *stream)
+{
+	l->stream = stream;
+}
+
+/*
+ * Reserve space for the record of `n' bytes.
+ * Interrupts are disabled only for a few instructions.
+ */
+static record_t *
+log_reserve (log_t *l, unsigned n)
+{
+	arch_state_t x;
+	record_t *r;
+	unsigned pos, skip, used;
+
+	arch_intr_disable (&x);
+	pos = l->head & (l->size - 1);
+	skip = (pos + n > l->size) ? l->size - pos : 0;
+	used = l->head - l->tail;
+	if (used + skip + n > l->size) {
+		++l->dropped;
+		arch_intr_restore (x);
+		return 0;
+	}
+	if (skip) {
+		if (skip >= sizeof(record_t)) {
+			r = (record_t*) ((unsigned char*) l->ring + pos);
+			r->size = skip;
+			r->state = RECORD_SKIP;
+		}
+		pos = 0;
+	}
+	r = (record_t*) ((unsigned char*) l->ring + pos);
+	r->size = n;
+	r->state = RECORD_BUSY;
+	r->time = l->timer ? l->timer->milliseconds : 0;
+	l->head += skip + n;
+	used += skip + n;
+	if (used > l->max_used)
+		l->max_used = used;
+	++l->records;
+	arch_intr_restore (x);
+	return r;
+}
+
+/*
+ * Walk the format like stream_vprintf() does, and store the arguments.
+ * Strings and hex dumps are copied. Return the number of bytes;
+ * when the space is exhausted, the rest of arguments is omitted.
+ */
+static unsigned
+log_pack (unsigned char *args, const char *fmt, va_list ap)
+{
+	const unsigned char *s;
+	unsigned char c, dot;
+	int width, dwidth, len;
+	unsigned n = 0;
+	bool_t lflag;
+
+	for (;;) {
+		while ((c = FETCH_BYTE (fmt++)) != '%')
+			if (! c)
+				return n;
+		lflag = 0; dot = 0; width = 0; dwidth = -1;
+reswitch:	switch (c = FETCH_BYTE (fmt++)) {
+		case '.':
+			dot = 1;
+			dwidth = 0;
+			goto reswitch;
+
+		case '#': case '+': case '-':
+			goto reswitch;
+
+		case '*':
+			len = va_arg (ap, int);
+			PUT (int, len);
+			if (dot)
+				dwidth = len;
+			else
+				width = (len < 0) ? -len : len;
+			goto reswitch;
+
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			for (len=0; ; ++fmt) {
+				len = len * 10 + c - '0';
+				c = FETCH_BYTE (fmt);
+				if (c < '0' || c > '9')
+					break;
+			}
+			if (dot)
+				dwidth = len;
+			else
+				width = len;
+			goto reswitch;
+
+		case 'l':
+			lflag = 1;
+			goto reswitch;
+
+		case 'c':
+			PUT (int, va_arg (ap, int));
+			break;
+
+		case 'd': case 'n': case 'o': case 'r':
+		case 'u': case 'x': case 'X': case 'z': case 'Z':
+			if (lflag)
+				PUT (long, va_arg (ap, long))
+			else
+				PUT (int, va_arg (ap, int))
+			break;
+
+		case 'b':
+			PUT (int, va_arg (ap, int));
+			/* Bit names are constant. */
+		case 'p':
+		case 'S':
+			PUT (const void*, va_arg (ap, const void*));
+			break;
+
+		case 's':
+			s = va_arg (ap, const unsigned char*);
+			if (! s)
+				s = (const unsigned char*) "(null)";
+			if (n + 1 > LOG_MAXARGS)
+				return n;
+			for (len=0; s[len] && (dwidth < 0 || len < dwidth) &&
+			    n + len + 1 < LOG_MAXARGS; ++len)
+				continue;
+			memcpy (args + n, s, len);
+			args [n + len] = 0;
+			n += len + 1;
+			break;
+
+		case 'D':
+			s = va_arg (ap, const unsigned char*);
+			if (! width)
+				width = 16;
+			if (n + sizeof(int) > LOG_MAXARGS)
+				return n;
+			len = LOG_MAXARGS - n - sizeof(int);
+			if (len > width)
+				len = width;
+			memcpy (args + n, &len, sizeof(int));
+			memcpy (args + n + sizeof(int), s, len);
+			n += sizeof(int) + len;
+			break;
+#if ARCH_HAVE_FPU
+		case 'e': case 'E':
+		case 'f': case 'F':
+		case 'g': case 'G':
+			PUT (double, va_arg (ap, double));
+			break;
+#endif
+		case 0:
+			return n;
+		}
+	}
+}
+
+void
+log_vprintf (log_t *l, const char *fmt, va_list ap)
+{
+	unsigned char args [LOG_MAXARGS];
+	arch_state_t x;
+	record_t *r;
+	unsigned n;
+	bool_t wake;
+
+	n = log_pack (args, fmt, ap);
+	r = log_reserve (l, ALIGN (sizeof(record_t) + n));
+	if (! r)
+		return;
+	r->fmt = fmt;
+	memcpy (r + 1, args, n);
+	r->state = RECORD_READY;
+
+	arch_intr_disable (&x);
+	wake = l->waiting && l->head - l->tail >= l->wakeup;
+	if (wake)
+		l->waiting = 0;
+	arch_intr_restore (x);
+	if (wake)
+		mutex_signal (&l->lock, 0);
+}
+
+void
+log_printf (log_t *l, const char *fmt, ...)
+{
+	va_list	args;
+
+	va_start (args, fmt);
+	log_vprintf (l, fmt, args);
+	va_end (args);
+}
+
+/*
+ * Print the record into the line buffer: every conversion
+ * of the format is passed to stream_printf() with its own argument.
+ */
+static void
+log_format (stream_t *line, const char *fmt, const unsigned char *arg,
+	const unsigned char *end)
+{
+	unsigned char spec [24], c, sharp;
+	const void *p;
+	int ns, v;
+	long lv;
+#if ARCH_HAVE_FPU
+	double d;
+#endif
+	for (;;) {
+		while ((c = FETCH_BYTE (fmt++)) != '%') {
+			if (! c)
+				return;
+			putchar (line, c);
+		}
+		spec[0] = '%';
+		ns = 1;
+		sharp = 0;
+reswitch:	c = FETCH_BYTE (fmt++);
+		if (ns < (int) sizeof(spec) - 12 && c != '*')
+			spec [ns++] = c;
+		spec [ns] = 0;
+		switch (c) {
+		case '#':
+			sharp = 1;
+		case '.': case '+': case '-': case 'l':
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			goto reswitch;
+
+		case '*':
+			GET (int, v);
+			ns += snprintf (spec + ns, sizeof(spec) - ns, "%d", v);
+			goto reswitch;
+
+		case 'c':
+			GET (int, v);
+			printf (line, (char*) spec, v);
+			break;
+
+		case 'd': case 'n': case 'o': case 'r':
+		case 'u': case 'x': case 'X': case 'z': case 'Z':
+			if (spec [ns-2] == 'l') {
+				GET (long, lv);
+				printf (line, (char*) spec, lv);
+			} else {
+				GET (int, v);
+				printf (line, (char*) spec, v);
+			}
+			break;
+
+		case 'b':
+			GET (int, v);
+			GET (const void*, p);
+			printf (line, (char*) spec, v, p);
+			break;
+
+		case 'p':
+		case 'S':
+			GET (const void*, p);
+			printf (line, (char*) spec, p);
+			break;
+
+		case 's':
+			if (arg >= end)
+				goto truncated;
+			printf (line, (char*) spec, arg);
+			arg += strlen (arg) + 1;
+			break;
+
+		case 'D':
+			GET (int, v);
+			if (v > 0)
+				printf (line, sharp ? "%#*D" : "%*D", v, arg);
+			arg += v;
+			break;
+#if ARCH_HAVE_FPU
+		case 'e': case 'E':
+		case 'f': case 'F':
+		case 'g': case 'G':
+			GET (double, d);
+			printf (line, (char*) spec, d);
+			break;
+#endif
+		case 0:
+			return;
+
+		default:
+			printf (line, (char*) spec);
+			break;
+		}
+	}
+truncated:
+	puts (line, "...\n");
+}
+
+/*
+ * Format the record and write it to the output stream at once.
+ */
+static void
+log_output (log_t *l, record_t *r)
+{
+	stream_buf_t line;
+	const unsigned char *args = (const unsigned char*) (r + 1);
+
+	stropen (&line, l->line, sizeof(l->line));
+	if (l->timer)
+		printf (&line, "%lu.%03u ", r->time / 1000,
+			(unsigned) (r->time % 1000));
+	log_format ((stream_t*) &line, r->fmt, args,
+		(const unsigned char*) r + r->size);
+	if (l->stream)
+		fwrite (l->stream, l->line, line.buf - l->line);
+}
+
+/*
+ * Output pending records. The caller holds l->lock.
+ */
+static int
+log_output_pending (log_t *l)
+{
+	record_t *r;
+	unsigned long lost;
+	unsigned pos;
+	int count = 0;
+
+	while (l->tail != l->head) {
+		pos = l->tail & (l->size - 1);
+		if (l->size - pos < sizeof(record_t)) {
+			/* Tail of the ring without a header. */
+			l->tail += l->size - pos;
+			continue;
+		}
+		r = (record_t*) ((unsigned char*) l->ring + pos);
+		if (r->state == RECORD_BUSY)
+			break;
+		if (r->state == RECORD_READY) {
+			log_output (l, r);
+			++count;
+		}
+		l->tail += r->size;
+	}
+	lost = l->dropped - l->reported;
+	if (lost) {
+		l->reported += lost;
+		if (l->stream)
+			printf (l->stream, "log: %lu records lost\n", lost);
+	}
+	return count;
+}
+
+int
+log_drain (log_t *l)
+{
+	int count;
+
+	mutex_lock (&l->lock);
+	count = log_output_pending (l);
+	mutex_unlock (&l->lock);
+	return count;
+}
+
+static void
+log_task (void *arg)
+{
+	log_t *l = arg;
+	mutex_group_t *g;
+	int n;
+
+	g = mutex_group_init (l->group, sizeof(l->group));
+	mutex_group_add (g, &l->lock);
+	if (l->timer)
+		mutex_group_add (g, &l->timer->decisec);
+	mutex_group_listen (g);
+	for (;;) {
+		/* Writers signal when they see the flag, and the group slot
+		 * remembers the signal, so nothing is missed. */
+		l->waiting = 1;
+		n = log_drain (l);
+
+		if (l->flushing) {
+			mutex_lock (&l->done);
+			mutex_signal (&l->done, 0);
+			mutex_unlock (&l->done);
+		}
+		if (n == 0)
+			mutex_group_wait (g, 0, 0);
+	}
+}
+
+void
+log_start (log_t *l, int prio, array_t *stack, unsigned stacksz)
+{
+	l->started = 1;
+	task_create (log_task, l, "log", prio, stack, stacksz);
+}
+
+void
+log_flush (log_t *l)
+{
+	if (! l->started) {
+		/* Nobody to wait for. */
+		log_drain (l);
+		return;
+	}
+	mutex_lock (&l->done);
+	l->flush = l->head;
+	l->flushing = 1;
+	mutex_signal (&l->lock, 0);
+	while ((int) (l->flush - l->tail) > 0)
+		mutex_wait (&l->done);
+	l->flushing = 0;
+	mutex_unlock (&l->done);
+}
@@ -0,0 +1,90 @@
+#ifndef __LOG_H_
+#define	__LOG_H_ 1
+
+/*
+ * Deferred logging.
+ *
+ * Log_printf() does not format anything: it stores a timestamp,
+ * the format pointer and the raw arguments into a ring buffer
+ * and returns. A low-priority drain task formats the records
+ * and writes them to the output stream (UART, telnet session etc).
+ * The format string must be constant: only its pointer is saved.
+ * Strings (%s) and hex dumps (%D) are copied into the record.
+ */
+#ifndef LOG_MAXARGS
+#   if __AVR__ || MSP430
+#      define LOG_MAXARGS	32	/* bytes of arguments per record */
+#   else
+#      define LOG_MAXARGS	128
+#   endif
+#endif
+
+#ifndef LOG_LINESZ
+#   define LOG_LINESZ		160	/* max length of formatted record */
+#endif
+
+typedef struct _log_t {
+	mutex_t		lock;		/* drain task waits for a signal here */
+	mutex_t		done;		/* log_flush() waits here */
+	struct _stream_t *stream;	/* output */
+	struct _timer_t	*timer;		/* for timestamps, may be 0 */
+	unsigned	size;		/* ring size in bytes, power of 2 */
+	unsigned	head;		/* bytes ever reserved by writers */
+	unsigned	tail;		/* bytes ever released by drain */
+	unsigned	wakeup;		/* wake the drain at this amount of data */
+	unsigned	flush;		/* log_flush() waits for this tail */
+	bool_t		waiting;	/* drain task is idle */
+	bool_t		flushing;	/* log_flush() is waiting */
+	bool_t		started;	/* drain task is created */
+
+	unsigned long	records;	/* records written */
+	unsigned long	dropped;	/* records lost: ring full */
+	unsigned long	reported;	/* lost records already reported */
+	unsigned	max_used;	/* ring high watermark, bytes */
+
+	ARRAY (group, sizeof(mutex_group_t) + sizeof(mutex_slot_t));
+	unsigned char	line [LOG_LINESZ];
+	unsigned long	ring [1];	/* ring data is placed here */
+} log_t;
+
+/*
+ * Create the log in the given buffer, the ring takes the rest
+ * of it (rounded down to power of 2). With the timer, records get
+ * a timestamp, and pending records are output at least every 0.1 sec.
+ */
+log_t *log_init (array_t *buf, unsigned bytes, struct _stream_t *stream,
+	struct _timer_t *timer);
+
+/*
+ * Start the drain task. The priority should be lower, than any task
+ * which writes the log.
+ */
+void log_start (log_t *l, int prio, array_t *stack, unsigned stacksz);
+
+/*
+ * Store the record. Never blocks: when the ring is full,
+ * the record is dropped and counted. Can be called from any task,
+ * with any locks held.
+ */
+void log_printf (log_t *l, const char *fmt, ...);
+void log_vprintf (log_t *l, const char *fmt, va_list args);
+
+/*
+ * Format and output all pending records in the context of the caller.
+ * Serialized with the drain task.
+ * Return the number of records.
+ */
+int log_drain (log_t *l);
+
+/*
+ * Wait until all records written so far are output by the drain task.
+ * Before log_start() the records are output by the caller.
+ */
+void log_flush (log_t *l);
+
+/*
+ * Change the output stream.
+ */
+void log_set_stream (log_t *l, struct _stream_t *stream);
+
+#endif /* !__LOG_H_ */
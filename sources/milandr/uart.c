@@ -56,7 +56,7 @@ uart_putchar (uart_t *u, short c)
 	/* Check that transmitter is enabled. */
 	if (reg->CTL & ARM_UART_CTL_TXE) {
 again:		newlast = u->out_last + 1;
-		if (newlast >= u->out_buf + UART_OUTBUFSZ)
+		if (newlast >= u->out_limit)
 			newlast = u->out_buf;
 		while (u->out_first == newlast)
 			mutex_wait (&u->receiver);
@@ -66,7 +66,7 @@ again:		newlast = u->out_last + 1;
 		if (! (reg->FR & ARM_UART_FR_TXFF)) {
 			/* В буфере FIFO передатчика есть место. */
 			reg->DR = *u->out_first++;
-			if (u->out_first >= u->out_buf + UART_OUTBUFSZ)
+			if (u->out_first >= u->out_limit)
 				u->out_first = u->out_buf;
 		}
 
@@ -93,7 +93,7 @@ uart_getchar (uart_t *u)
 		mutex_wait (&u->receiver);
 
 	c = *u->in_first++;
-	if (u->in_first >= u->in_buf + UART_INBUFSZ)
+	if (u->in_first >= u->in_limit)
 		u->in_first = u->in_buf;
 
 	mutex_unlock (&u->receiver);
@@ -135,7 +135,7 @@ uart_interrupt (void *arg)
 		unsigned c = reg->DR;
 
 		unsigned char *newlast = u->in_last + 1;
-		if (newlast >= u->in_buf + UART_INBUFSZ)
+		if (newlast >= u->in_limit)
 			newlast = u->in_buf;
 
 		/* Если нет места в буфере - теряем данные. */
@@ -151,7 +151,7 @@ uart_interrupt (void *arg)
 		if (u->out_first != u->out_last) {
 			/* Шлём очередной байт. */
 			reg->DR = *u->out_first;
-			if (++u->out_first >= u->out_buf + UART_OUTBUFSZ)
+			if (++u->out_first >= u->out_limit)
 				u->out_first = u->out_buf;
 		} else {
 			/* Нет данных для передачи - сброс прерывания. */
@@ -195,8 +195,13 @@ uart_init (uart_t *u, small_uint_t port, int prio, unsigned int khz,
 	unsigned long baud)
 {
 	u->interface = &uart_interface;
-	u->in_first = u->in_last = u->in_buf;
-	u->out_first = u->out_last = u->out_buf;
+	u->in_buf = u->in_first = u->in_last = u->in_data;
+	u->in_limit = u->in_data + UART_INBUFSZ;
+	u->out_buf = u->out_first = u->out_last = u->out_data;
+	u->out_limit = u->out_data + UART_OUTBUFSZ;
+#if UART_BUFFERED
+	u->in_watermark = 1;
+#endif
 	u->khz = khz;
 	u->onlcr = 1;
 	u->port = (port == 0) ? ARM_UART1_BASE : ARM_UART2_BASE;
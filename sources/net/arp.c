@@ -4,7 +4,9 @@
 #include <buf/buf.h>
 #include <net/netif.h>
 #include <net/route.h>
+#include <net/ip.h>
 #include <net/arp.h>
+#include <net/capture.h>
 
 #undef ARP_TRACE
 
@@ -93,6 +95,8 @@ arp_add_entry (netif_t *netif, unsigned char *ipaddr, unsigned char *ethaddr)
 					ethaddr[0], ethaddr[1], ethaddr[2],
 					ethaddr[3], ethaddr[4], ethaddr[5],
 					netif->name); */
+				if (arp->ip)
+					ip_flow_forget (arp->ip, e->netif, e->ethaddr);
 				memcpy (e->ethaddr, ethaddr, 6);
 				e->netif = netif;
 			}
@@ -122,6 +126,10 @@ arp_add_entry (netif_t *netif, unsigned char *ipaddr, unsigned char *ethaddr)
 			e->ethaddr[0], e->ethaddr[1], e->ethaddr[2],
 			e->ethaddr[3], e->ethaddr[4], e->ethaddr[5],
 			e->netif->name, e->age); */
+
+		/* Forwarding must not use the evicted address. */
+		if (arp->ip)
+			ip_flow_forget (arp->ip, e->netif, e->ethaddr);
 	}
 
 	/* Now, fill this table entry with the new information. */
@@ -231,6 +239,8 @@ arp_input (netif_t *netif, buf_t *p)
 				ah->dst_hwaddr[0], ah->dst_hwaddr[1], ah->dst_hwaddr[2],
 				ah->dst_hwaddr[3], ah->dst_hwaddr[4], ah->dst_hwaddr[5]);
 #endif
+			if (netif->capture)
+				capture_frame (netif->capture, p, CAPTURE_OUT);
 			netif->interface->output (netif, p, 0);
 			return 0;
 
@@ -295,6 +305,8 @@ arp_request (netif_t *netif, buf_t *p, unsigned char *ipdest,
 		ipsrc[0], ipsrc[1], ipsrc[2], ipsrc[3],
 		netif->ethaddr[0], netif->ethaddr[1], netif->ethaddr[2],
 		netif->ethaddr[3], netif->ethaddr[4], netif->ethaddr[5]);*/
+	if (netif->capture)
+		capture_frame (netif->capture, p, CAPTURE_OUT);
 	return netif->interface->output (netif, p, 0);
 }
 
@@ -373,6 +385,8 @@ arp_timer (arp_t *arp)
 				e->ethaddr[0], e->ethaddr[1], e->ethaddr[2],
 				e->ethaddr[3], e->ethaddr[4], e->ethaddr[5],
 				e->netif->name, e->age); */
+			if (arp->ip)
+				ip_flow_forget (arp->ip, e->netif, e->ethaddr);
 			e->netif = 0;
 		}
 	}
@@ -11,9 +11,9 @@
 #define MAXAGE_SEC	300
 
 /*
- * Время полного сканирования таблицы, в секундах.
+ * Количество записей, проверяемых за один вызов bridge_timer().
  */
-#define FULLSCAN_SEC	10
+#define SWEEP_STEP	4
 
 /* MUST be compiled with "pack structs" or equivalent! */
 struct eth_hdr {
@@ -22,6 +22,24 @@ struct eth_hdr {
 	unsigned short	proto;		/* protocol type */
 } __attribute__ ((packed));
 
+/*
+ * Max load of the table, to keep probe sequences short.
+ */
+#define MAXLOAD(size)	((size) - (size) / 8)
+
+/*
+ * Max probe distance (stored as dist + 1 in unsigned char).
+ */
+#define MAXDIST		255
+
+/*
+ * Max entry lifetime in generations. The rest of 16-bit range
+ * leaves time for the sweep to remove outdated entries
+ * before the generation counter wraps around.
+ */
+#define MAXGEN		30000
+#define WRAPGEN		(65536UL - MAXGEN)
+
 /*
  * Initialize bridge data structure.
  */
@@ -29,9 +47,11 @@ bridge_t *
 bridge_init (mem_pool_t *pool, int size, int msec)
 {
 	bridge_t *b;
+	unsigned n;
 
 	/* Size must be a power of 2! */
 	assert ((size & (size-1)) == 0);
+	assert (size >= 2);
 
 	b = (bridge_t*) mem_alloc (pool, sizeof (bridge_t) +
 		(size - 1) * sizeof (bridge_entry_t));
@@ -40,80 +60,190 @@ bridge_init (mem_pool_t *pool, int size, int msec)
 		uos_halt (1);
 	}
 	b->size = size;
-	b->robin = b->table;
-	b->step += b->size * msec / FULLSCAN_SEC / 1000;
+	b->shift = 32;
+	for (n=size; n>1; n>>=1)
+		--b->shift;
+
+	/* Generation and entry age are 16-bit: when the timer
+	 * is too fast, advance the generation every few ticks,
+	 * so that maxage fits in MAXGEN generations. */
+	b->ticks_per_gen = (MAXAGE_SEC * 1000UL / msec + MAXGEN - 1) / MAXGEN;
+	if (b->ticks_per_gen < 1)
+		b->ticks_per_gen = 1;
+	b->maxage = MAXAGE_SEC * 1000UL / msec / b->ticks_per_gen;
+	if (b->maxage < 1)
+		b->maxage = 1;
+
+	/* The sweep must pass the whole table before
+	 * an outdated entry could look alive again. */
+	assert (size / SWEEP_STEP <= WRAPGEN * b->ticks_per_gen);
 	return b;
 }
 
+static inline unsigned
+bridge_hash (bridge_t *b, const unsigned short *addr)
+{
+	uint32_t h;
+
+	h = ((uint32_t) addr[2] << 16 | addr[1]) ^ addr[0];
+	h *= 2654435761u;
+	return h >> b->shift;
+}
+
+static inline bool_t
+bridge_alive (bridge_t *b, bridge_entry_t *e)
+{
+	return (unsigned short) (b->generation - e->seen) < b->maxage;
+}
+
+static inline bool_t
+bridge_match (bridge_entry_t *e, const unsigned short *addr)
+{
+	return e->addr[0] == addr[0] && e->addr[1] == addr[1] &&
+		e->addr[2] == addr[2];
+}
+
+/*
+ * Delete the entry, shifting back the rest of probe sequence.
+ */
+static void
+bridge_delete (bridge_t *b, unsigned i)
+{
+	unsigned mask = b->size - 1;
+	unsigned next;
+
+	for (;;) {
+		next = (i + 1) & mask;
+		if (b->table[next].dist <= 1)
+			break;
+		b->table[i] = b->table[next];
+		b->table[i].dist--;
+		i = next;
+	}
+	b->table[i].dist = 0;
+	b->count--;
+}
+
+/*
+ * Find alive entry by MAC address.
+ * Probing stops at the first entry, which is closer
+ * to its home position than the searched one would be.
+ */
 static bridge_entry_t *
-find_entry (bridge_t *b, unsigned short* mac, int allocate_flag)
+bridge_find (bridge_t *b, const unsigned short *addr)
 {
-	bridge_entry_t *e, *prev, *limit;
-	unsigned short tmp [3], *addr;
-
-	if ((int)mac & 1) {
-		memcpy (tmp, mac, 6);
-		addr = tmp;
-	} else
-		addr = mac;
-
-	/* addr halfword aligned */
-	e = b->table +
-		((addr[0] + addr[1] + addr[2] * 067433) & (b->size - 1));
-
-	for (prev=0; e; prev=e, e=e->next) {
-		if (! e->time_to_live) {
-			/* Found an outdated entry. */
-			if (allocate_flag)
-				goto allocate;
-			if (prev)
-				prev->next = 0;
+	unsigned mask = b->size - 1;
+	unsigned i, dist;
+	bridge_entry_t *e;
+
+	i = bridge_hash (b, addr);
+	for (dist=1; dist<=MAXDIST; ++dist) {
+		e = &b->table[i];
+		if (e->dist < dist)
+			return 0;
+		if (bridge_match (e, addr))
+			return bridge_alive (b, e) ? e : 0;
+		i = (i + 1) & mask;
+	}
+	return 0;
+}
+
+/*
+ * Add or update the entry for the source address.
+ */
+static void
+bridge_learn (bridge_t *b, const unsigned short *addr, small_uint_t port,
+	bridge_stat_t *st)
+{
+	unsigned mask = b->size - 1;
+	unsigned i, dist;
+	bridge_entry_t *e, cur, tmp;
+	bool_t moved = 0;
+
+	i = bridge_hash (b, addr);
+	dist = 1;
+	for (;;) {
+		e = &b->table[i];
+		if (e->dist == 0)
 			break;
+		if (! moved && bridge_match (e, addr)) {
+			/* Existing entry. */
+			if (! bridge_alive (b, e))
+				++st->learned;
+			e->seen = b->generation;
+			e->port = port;
+			return;
+		}
+		if (! bridge_alive (b, e)) {
+			/* Remove outdated entry and look at this place again. */
+			bridge_delete (b, i);
+			continue;
 		}
-		if (((unsigned short*) e->addr) [0] == addr[0] &&
-		    ((unsigned short*) e->addr) [1] == addr[1] &&
-		    ((unsigned short*) e->addr) [2] == addr[2])
-			return e;
+		if (e->dist < dist)
+			break;
+		i = (i + 1) & mask;
+		++dist;
 	}
-	/* Address not found. */
-	if (! allocate_flag)
-		return 0;
 
-	/* Prev cannot be NULL here. */
-	assert (prev != 0);
+	/* Address not found. */
+	if (b->count >= MAXLOAD (b->size)) {
+		++st->no_space;
+		return;
+	}
+	++st->learned;
+	memcpy (cur.addr, addr, 6);
+	cur.seen = b->generation;
+	cur.port = port;
 
-	/* Find an empty slot. */
-	limit = b->table + b->size;
-	for (e=prev+1; e->time_to_live; ++e) {
-		if (e == limit)
-			e = b->table;
-		if (e == prev) {
-			/* No empty space. */
-			return 0;
+	/* Robin Hood insertion: take the place of richer entries. */
+	for (;;) {
+		e = &b->table[i];
+		if (e->dist == 0) {
+			cur.dist = dist;
+			*e = cur;
+			b->count++;
+			return;
+		}
+		if (e->dist < dist) {
+			tmp = *e;
+			cur.dist = dist;
+			*e = cur;
+			cur = tmp;
+			dist = cur.dist;
+			moved = 1;
+		}
+		i = (i + 1) & mask;
+		if (++dist > MAXDIST) {
+			/* Too long probe sequence: forget the entry. */
+			if (! moved)
+				--st->learned;
+			++st->no_space;
+			return;
 		}
 	}
-allocate:
-	((unsigned short*) e->addr) [0] = addr[0];
-	((unsigned short*) e->addr) [1] = addr[1];
-	((unsigned short*) e->addr) [2] = addr[2];
-	if (prev)
-		prev->next = e;
-	/* debug_printf ("bridge: add entry %02x-%02x-%02x-%02x-%02x-%02x\n",
-		e->addr[0], e->addr[1], e->addr[2],
-		e->addr[3], e->addr[4], e->addr[5]); */
-	return e;
 }
 
 /*
- * Process outgoing packet:
- * 1) If the target address is present in table, then ignore the packet.
- * 2) Add the source address to the table.
+ * Process incoming packet on the given port:
+ * 1) Add the source address to the table.
+ * 2) If the target address was seen on the same port, ignore the packet.
  */
 struct _buf_t *
-bridge_filter (bridge_t *b, struct _buf_t *p)
+bridge_filter_port (bridge_t *b, struct _buf_t *p, small_uint_t port)
 {
 	struct eth_hdr *h;
-	bridge_entry_t *s, *d;
+	bridge_entry_t *d;
+	bridge_stat_t *st;
+	unsigned short addr [3];
+
+	if (port >= BRIDGE_MAXPORTS) {
+		/* Invalid port number. */
+		/*debug_printf ("bridge: bad port %d\n", port);*/
+		buf_free (p);
+		return 0;
+	}
+	st = &b->stat [port];
+	++st->in_frames;
 
 	h = (struct eth_hdr*) p->payload;
 	/* debug_printf ("bridge: %d bytes from %02x-%02x-%02x-%02x-%02x-%02x"
@@ -125,74 +255,90 @@ bridge_filter (bridge_t *b, struct _buf_t *p)
 		h->dest[3], h->dest[4], h->dest[5]); */
 
 	/* Update source entry. */
-	s = find_entry (b, (unsigned short*) h->src, 1);
-	if (s)
-		s->time_to_live = MAXAGE_SEC / FULLSCAN_SEC;
+	memcpy (addr, h->src, 6);
+	bridge_learn (b, addr, port, st);
 
 	/* Broadcast or multicast - pass through. */
-	if (h->dest[0] & 0x80)
+	if (h->dest[0] & 1) {
+		++st->flooded;
 		return p;
+	}
 
 	/* Check destination. */
-	d = find_entry (b, (unsigned short*) h->dest, 0);
-	if (d) {
-		/* Destination found in the table of local MAC addresses.
-		 * Ignore the packet. */
+	memcpy (addr, h->dest, 6);
+	d = bridge_find (b, addr);
+	if (! d) {
+		++st->flooded;
+		return p;
+	}
+	if (d->port == port) {
+		/* Destination is on the same port. Ignore the packet. */
+		++st->filtered;
 		buf_free (p);
 		/*debug_printf ("-- ignore\n");*/
 		return 0;
 	}
+	++st->forwarded;
 	return p;
 }
 
 /*
- * Remove outdated entries from MAC address table.
- * Called every second. According to 802.3 specification,
- * MAC addresses must be deleted after MAXAGE_SEC seconds,
+ * Process outgoing packet of a two-port bridge:
+ * 1) If the target address is present in table, then ignore the packet.
+ * 2) Add the source address to the table.
  */
-void
-bridge_timer (bridge_t *b)
+struct _buf_t *
+bridge_filter (bridge_t *b, struct _buf_t *p)
 {
-	bridge_entry_t *next, *limit, *e;
-	int ttl;
+	return bridge_filter_port (b, p, 0);
+}
 
-	/* Указатель на конец таблицы. */
-	limit = b->table + b->size;
+/*
+ * Find the port by MAC address. Return -1 when unknown.
+ */
+int
+bridge_lookup (bridge_t *b, const unsigned char *mac)
+{
+	bridge_entry_t *e;
+	unsigned short addr [3];
 
-	/* Применяем инкрементное сканирование таблицы.
-	 * Robin указывает на место, где мы в прошлый раз закончили.
-	 * Начинаем с этого места. */
-	if (b->robin >= limit)
-		b->robin = b->table;
-	e = b->robin;
-
-	/* Продвигаем robin пропорционально периоду сканирования.
-	 * Участок сканирования должен быть непрерывным. */
-	b->robin += b->step;
-	if (b->robin > limit)
-		b->robin = limit;
-
-	assert (e >= b->table);
-	assert (e < b->robin);
-	assert (b->robin <= limit);
-
-	for (; e != b->robin; ++e) {
-		ttl = e->time_to_live;
-		if (ttl == 0)
-			continue;
+	memcpy (addr, mac, 6);
+	e = bridge_find (b, addr);
+	return e ? e->port : -1;
+}
+
+/*
+ * Age the MAC address table. Must be called every `msec' milliseconds,
+ * as given to bridge_init(). According to 802.3 specification,
+ * MAC addresses must be deleted after MAXAGE_SEC seconds.
+ * Entries expire by advancing the generation: lookups ignore
+ * outdated entries at once, and learning frees them on its probe
+ * path. The sweep checks SWEEP_STEP entries per call, so the work
+ * per call does not depend on the table size; it only makes sure
+ * that old entries are gone before the generation wraps around.
+ */
+void
+bridge_timer (bridge_t *b)
+{
+	unsigned n;
+	bridge_entry_t *e;
 
-		e->time_to_live = --ttl;
-		if (ttl == 0) {
-			/* Clean this entry. */
+	if (++b->ticks >= b->ticks_per_gen) {
+		b->ticks = 0;
+		++b->generation;
+	}
+	for (n=0; n<SWEEP_STEP; ++n) {
+		if (b->sweep >= b->size)
+			b->sweep = 0;
+		e = &b->table [b->sweep];
+		if (e->dist && ! bridge_alive (b, e)) {
 			/* debug_printf ("bridge: remove entry %02x-%02x-%02x-%02x-%02x-%02x\n",
 				e->addr[0], e->addr[1], e->addr[2],
 				e->addr[3], e->addr[4], e->addr[5]); */
-			next = e->next;
-			if (next != 0) {
-				*e = *next;
-				next->time_to_live = 0;
-			}
+			bridge_delete (b, b->sweep);
+			continue;
 		}
+		++b->sweep;
 	}
 }
 
@@ -206,5 +352,6 @@ bridge_clear (bridge_t *b)
 
 	limit = b->table + b->size;
 	for (e=b->table; e<limit; ++e)
-		e->time_to_live = 0;
+		e->dist = 0;
+	b->count = 0;
 }
@@ -1,21 +1,73 @@
 #ifndef __BRIDGE_H_
 #define	__BRIDGE_H_ 1
 
+#ifndef BRIDGE_MAXPORTS
+#   define BRIDGE_MAXPORTS	4
+#endif
+
+/*
+ * Entry of MAC address table. The table uses open addressing
+ * with Robin Hood hashing: lookups and insertions touch only
+ * a short run of neighbouring entries.
+ * Entry is alive while (b->generation - seen) < b->maxage.
+ */
 typedef struct _bridge_entry_t {
-	unsigned short	time_to_live;
-	unsigned short	addr [3];
-	struct _bridge_entry_t	*next;
+	unsigned short	addr [3];	/* MAC address */
+	unsigned short	seen;		/* generation of last update */
+	unsigned char	port;		/* port, where the address was seen */
+	unsigned char	dist;		/* probe distance + 1, 0 when empty */
 } bridge_entry_t;
 
+/*
+ * Per-port forwarding statistics.
+ */
+typedef struct _bridge_stat_t {
+	unsigned long	in_frames;	/* frames, received on the port */
+	unsigned long	forwarded;	/* passed to other ports */
+	unsigned long	flooded;	/* broadcast, multicast or unknown */
+	unsigned long	filtered;	/* dropped, destination is local */
+	unsigned long	learned;	/* new addresses */
+	unsigned long	no_space;	/* addresses not learned, table full */
+} bridge_stat_t;
+
 typedef struct _bridge_t {
-	unsigned long	size;
-	unsigned long	step;
-	bridge_entry_t	*robin;
+	unsigned	size;		/* number of entries, power of 2 */
+	unsigned	shift;		/* hash shift: 32 - log2(size) */
+	unsigned short	generation;	/* advanced by bridge_timer() */
+	unsigned short	maxage;		/* entry lifetime in generations */
+	unsigned short	ticks;		/* timer calls in this generation */
+	unsigned short	ticks_per_gen;	/* timer calls per generation */
+	unsigned	count;		/* number of used entries */
+	unsigned	sweep;		/* next entry to check for aging */
+	bridge_stat_t	stat [BRIDGE_MAXPORTS];
 	bridge_entry_t	table [1];
 } bridge_t;
 
+/*
+ * Allocate the bridge with the table of `size' entries (power of 2).
+ * Bridge_timer() must be called every `msec' milliseconds.
+ */
 bridge_t *bridge_init (struct _mem_pool_t *pool, int size, int msec);
+
+/*
+ * Process the frame, received on the given port: learn the source
+ * address and decide whether the frame must be forwarded.
+ * Return 0 (and free the frame) when the destination is
+ * on the same port, or when port >= BRIDGE_MAXPORTS.
+ */
+struct _buf_t *bridge_filter_port (bridge_t *b, struct _buf_t *p,
+	small_uint_t port);
+
+/*
+ * Same for a simple two-port bridge, when the frame comes from port 0.
+ */
 struct _buf_t *bridge_filter (bridge_t *b, struct _buf_t *p);
+
+/*
+ * Find the port by MAC address. Return -1 when unknown.
+ */
+int bridge_lookup (bridge_t *b, const unsigned char *mac);
+
 void bridge_timer (bridge_t *b);
 void bridge_clear (bridge_t *b);
 
@@ -0,0 +1,270 @@
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <buf/buf.h>
+#include <stream/stream.h>
+#include <timer/timer.h>
+#include <net/netif.h>
+#include <net/capture.h>
+
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_LINKTYPE_ETHERNET	1
+#define PCAP_LINKTYPE_RAW	101
+
+/*
+ * Size of record header, rounded to keep data aligned.
+ */
+#define HDRSZ	((sizeof (capture_record_t) + 3) & ~3)
+
+static inline capture_record_t *
+capture_record (capture_t *c, unsigned n)
+{
+	return (capture_record_t*) (c->ring + n * c->recsize);
+}
+
+/*
+ * Initialize the capture with a ring, placed in the given memory area.
+ */
+void
+capture_init (capture_t *c, netif_t *netif, timer_t *timer,
+	array_t *buf, unsigned bytes, unsigned snaplen)
+{
+	c->netif = netif;
+	c->timer = timer;
+	c->snaplen = snaplen;
+	c->recsize = HDRSZ + ((snaplen + 3) & ~3);
+	c->ring = (unsigned char*) buf;
+	c->nrecords = bytes / c->recsize;
+	c->head = 0;
+	c->count = 0;
+	c->flags = 0;
+	c->nrules = 0;
+	c->captured = 0;
+	c->filtered = 0;
+	c->overwritten = 0;
+	c->dropped = 0;
+	assert (c->nrecords > 0);
+}
+
+void
+capture_start (capture_t *c, small_uint_t flags)
+{
+	mutex_lock (&c->lock);
+	c->flags = flags;
+	mutex_unlock (&c->lock);
+	c->netif->capture = c;
+}
+
+void
+capture_stop (capture_t *c)
+{
+	c->netif->capture = 0;
+}
+
+/*
+ * Add a filter rule.
+ */
+bool_t
+capture_rule (capture_t *c, unsigned offset, small_uint_t len,
+	unsigned long mask, unsigned long value)
+{
+	capture_rule_t *r;
+
+	if (len != 1 && len != 2 && len != 4)
+		return 0;
+	mutex_lock (&c->lock);
+	if (c->nrules >= CAPTURE_MAX_RULES) {
+		mutex_unlock (&c->lock);
+		return 0;
+	}
+	r = &c->rule [c->nrules++];
+	r->offset = offset;
+	r->len = len;
+	r->mask = mask;
+	r->value = value & mask;
+	mutex_unlock (&c->lock);
+	return 1;
+}
+
+void
+capture_clear (capture_t *c)
+{
+	mutex_lock (&c->lock);
+	c->nrules = 0;
+	mutex_unlock (&c->lock);
+}
+
+/*
+ * Fetch a big-endian field from the buffer chain.
+ * Return 0 when the frame is too short.
+ */
+static bool_t
+capture_field (buf_t *p, unsigned offset, small_uint_t len,
+	unsigned long *val)
+{
+	if (offset + len > p->tot_len)
+		return 0;
+	while (offset >= p->len) {
+		offset -= p->len;
+		p = p->next;
+	}
+	*val = 0;
+	while (len-- > 0) {
+		*val = *val << 8 | p->payload [offset];
+		if (++offset >= p->len && len > 0) {
+			p = p->next;
+			offset = 0;
+		}
+	}
+	return 1;
+}
+
+static bool_t
+capture_match (capture_t *c, buf_t *p)
+{
+	capture_rule_t *r;
+	unsigned long val;
+
+	for (r = c->rule; r < c->rule + c->nrules; ++r) {
+		if (! capture_field (p, r->offset, r->len, &val))
+			return 0;
+		if ((val & r->mask) != r->value)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Store the frame into the ring.
+ */
+void
+capture_frame (capture_t *c, buf_t *p, small_uint_t dir)
+{
+	capture_record_t *rec;
+	unsigned char *data;
+	unsigned len;
+	buf_t *q;
+
+	if (! (c->flags & dir))
+		return;
+	mutex_lock (&c->lock);
+	if (! capture_match (c, p)) {
+		++c->filtered;
+		mutex_unlock (&c->lock);
+		return;
+	}
+	if (c->count >= c->nrecords) {
+		if (c->flags & CAPTURE_ONESHOT) {
+			++c->dropped;
+			mutex_unlock (&c->lock);
+			return;
+		}
+		++c->overwritten;
+		--c->count;
+	}
+	rec = capture_record (c, c->head);
+	if (++c->head >= c->nrecords)
+		c->head = 0;
+	++c->count;
+	++c->captured;
+
+	if (c->timer) {
+		rec->msec = c->timer->milliseconds;
+		rec->days = c->timer->days;
+	} else {
+		rec->msec = 0;
+		rec->days = 0;
+	}
+	rec->len = p->tot_len;
+	rec->caplen = (p->tot_len < c->snaplen) ? p->tot_len : c->snaplen;
+	rec->dir = dir;
+
+	/* Copy the data. */
+	data = (unsigned char*) rec + HDRSZ;
+	for (q = p, len = rec->caplen; q && len > 0; q = q->next) {
+		unsigned n = (q->len < len) ? q->len : len;
+
+		memcpy (data, q->payload, n);
+		data += n;
+		len -= n;
+	}
+	mutex_unlock (&c->lock);
+}
+
+static void
+put_long (unsigned char *p, unsigned long val)
+{
+	/* Native byte order: readers detect it by magic number. */
+	memcpy (p, &val, 4);
+}
+
+static void
+put_short (unsigned char *p, unsigned short val)
+{
+	memcpy (p, &val, 2);
+}
+
+/*
+ * Write the captured records in pcap format and empty the ring.
+ * The capture is suspended while exporting.
+ */
+unsigned
+capture_export (capture_t *c, capture_write_t func, void *arg)
+{
+	capture_t *attached = c->netif->capture;
+	capture_record_t *rec;
+	unsigned char hdr [24];
+	unsigned long sec;
+	unsigned n, nexported;
+
+	c->netif->capture = 0;
+
+	/* Global header. */
+	put_long (hdr, PCAP_MAGIC);
+	put_short (hdr + 4, 2);			/* version 2.4 */
+	put_short (hdr + 6, 4);
+	put_long (hdr + 8, 0);			/* GMT */
+	put_long (hdr + 12, 0);			/* accuracy */
+	put_long (hdr + 16, c->snaplen);
+	put_long (hdr + 20, c->netif->arp ? PCAP_LINKTYPE_ETHERNET :
+		PCAP_LINKTYPE_RAW);
+	func (arg, hdr, 24);
+
+	mutex_lock (&c->lock);
+	nexported = c->count;
+	n = (c->head + c->nrecords - c->count) % c->nrecords;
+	while (c->count > 0) {
+		rec = capture_record (c, n);
+		if (++n >= c->nrecords)
+			n = 0;
+		--c->count;
+
+		sec = rec->days * 86400UL + rec->msec / 1000;
+		put_long (hdr, sec);
+		put_long (hdr + 4, rec->msec % 1000 * 1000);
+		put_long (hdr + 8, rec->caplen);
+		put_long (hdr + 12, rec->len);
+		func (arg, hdr, 16);
+		func (arg, (unsigned char*) rec + HDRSZ, rec->caplen);
+	}
+	c->head = 0;
+	mutex_unlock (&c->lock);
+
+	c->netif->capture = attached;
+	return nexported;
+}
+
+static void
+capture_write_stream (void *arg, void *data, unsigned len)
+{
+	stream_write ((stream_t*) arg, data, len);
+}
+
+unsigned
+capture_export_stream (capture_t *c, stream_t *stream)
+{
+	unsigned n;
+
+	n = capture_export (c, capture_write_stream, stream);
+	fflush (stream);
+	return n;
+}
@@ -0,0 +1,143 @@
+#ifndef __CAPTURE_H_
+#define	__CAPTURE_H_ 1
+
+/*
+ * Packet capture on a network interface.
+ * Frames, passed through netif_input() and netif_output(), are copied
+ * (up to snaplen bytes) into a preallocated ring of records.
+ * No memory is allocated on the capture path. When no capture
+ * is attached, the cost is one pointer test per packet.
+ * The ring can be exported in pcap format, readable by tcpdump
+ * and wireshark.
+ */
+#ifndef CAPTURE_MAX_RULES
+#   define CAPTURE_MAX_RULES	4
+#endif
+
+struct _buf_t;
+struct _netif_t;
+struct _timer_t;
+struct _stream_t;
+
+/*
+ * Filter rule: compare masked field of the frame with the value.
+ * Frame is captured only when all rules match.
+ */
+typedef struct _capture_rule_t {
+	unsigned short	offset;		/* offset of the field in frame */
+	unsigned char	len;		/* field size: 1, 2 or 4 bytes */
+	unsigned long	mask;		/* bits to compare */
+	unsigned long	value;		/* expected value, host byte order */
+} capture_rule_t;
+
+typedef struct _capture_record_t {
+	unsigned long	msec;		/* timestamp, milliseconds of day */
+	unsigned short	days;		/* timestamp, days */
+	unsigned short	len;		/* original length of frame */
+	unsigned short	caplen;		/* captured bytes */
+	unsigned char	dir;		/* CAPTURE_IN or CAPTURE_OUT */
+	/* unsigned char data [snaplen]; */
+} capture_record_t;
+
+typedef struct _capture_t {
+	mutex_t		lock;
+	struct _netif_t	*netif;		/* interface we are attached to */
+	struct _timer_t	*timer;		/* for timestamps, may be 0 */
+
+	unsigned char	*ring;		/* ring of records */
+	unsigned	nrecords;	/* ring size in records */
+	unsigned	recsize;	/* size of record in bytes */
+	unsigned short	snaplen;	/* max bytes to capture per frame */
+	unsigned	head;		/* next record to fill */
+	unsigned	count;		/* number of valid records */
+	small_uint_t	flags;		/* capture mode */
+#define CAPTURE_IN	1		/* capture received frames */
+#define CAPTURE_OUT	2		/* capture transmitted frames */
+#define CAPTURE_ONESHOT	4		/* stop when the ring is full,
+					   instead of overwriting */
+
+	small_uint_t	nrules;
+	capture_rule_t	rule [CAPTURE_MAX_RULES];
+
+	/* Statistics. */
+	unsigned long	captured;	/* frames stored */
+	unsigned long	filtered;	/* frames rejected by rules */
+	unsigned long	overwritten;	/* old records lost */
+	unsigned long	dropped;	/* frames lost, ring full */
+} capture_t;
+
+/*
+ * Callback for export, for example fat32_fw_write().
+ */
+typedef void (*capture_write_t) (void *arg, void *data, unsigned len);
+
+/*
+ * Initialize the capture with a ring, placed in the given memory area.
+ */
+void capture_init (capture_t *c, struct _netif_t *netif,
+	struct _timer_t *timer, array_t *buf, unsigned bytes,
+	unsigned snaplen);
+
+/*
+ * Start and stop capturing. Flags select the direction of traffic.
+ */
+void capture_start (capture_t *c, small_uint_t flags);
+void capture_stop (capture_t *c);
+
+/*
+ * Add a filter rule. Return 0 when there is no room for a new rule.
+ */
+bool_t capture_rule (capture_t *c, unsigned offset, small_uint_t len,
+	unsigned long mask, unsigned long value);
+void capture_clear (capture_t *c);
+
+/*
+ * Write the captured records in pcap format, oldest first,
+ * and empty the ring. Return the number of exported frames.
+ */
+unsigned capture_export (capture_t *c, capture_write_t func, void *arg);
+unsigned capture_export_stream (capture_t *c, struct _stream_t *stream);
+
+/*
+ * Store the frame. Called from netif_input() and netif_output().
+ */
+void capture_frame (capture_t *c, struct _buf_t *p, small_uint_t dir);
+
+/*
+ * Frequently used rules. Offsets assume Ethernet framing when
+ * the interface has ARP, raw IP otherwise, and no IP options.
+ */
+static inline unsigned
+capture_ip_offset (capture_t *c)
+{
+	return c->netif->arp ? 14 : 0;
+}
+
+static inline bool_t
+capture_rule_ethertype (capture_t *c, unsigned short type)
+{
+	return capture_rule (c, 12, 2, 0xffff, type);
+}
+
+static inline bool_t
+capture_rule_ip_proto (capture_t *c, small_uint_t proto)
+{
+	return capture_rule (c, capture_ip_offset (c) + 9, 1, 0xff, proto);
+}
+
+static inline bool_t
+capture_rule_ip_host (capture_t *c, bool_t dest, unsigned char *ipaddr)
+{
+	return capture_rule (c, capture_ip_offset (c) + (dest ? 16 : 12), 4,
+		0xffffffff, (unsigned long) ipaddr[0] << 24 |
+		(unsigned long) ipaddr[1] << 16 | ipaddr[2] << 8 | ipaddr[3]);
+}
+
+static inline bool_t
+capture_rule_port (capture_t *c, bool_t dest, unsigned short port)
+{
+	return capture_rule (c, capture_ip_offset (c) + (dest ? 22 : 20), 2,
+		0xffff, port);
+}
+
+#endif /* !__CAPTURE_H_ */
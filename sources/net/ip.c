@@ -10,6 +10,120 @@
 #include <net/udp.h>
 #include <net/tcp.h>
 #include <net/arp.h>
+#include <net/capture.h>
+
+/*
+ * Decrement TTL and incrementally update the IP checksum.
+ */
+static inline void
+ip_decrement_ttl (ip_hdr_t *iphdr)
+{
+	iphdr->ttl--;
+
+	/* Incremental update of the IP checksum. */
+	if (iphdr->chksum_h != 0xff)
+		iphdr->chksum_h += 1;
+	else if (iphdr->chksum_l != 0xff) {
+		iphdr->chksum_h = 0;
+		iphdr->chksum_l += 1;
+	} else {
+		iphdr->chksum_h = 1;
+		iphdr->chksum_l = 0;
+	}
+}
+
+#if IP_FLOW_CACHE_SIZE > 0
+static inline ip_flow_t *
+ip_flow_entry (ip_t *ip, unsigned char *dest, netif_t *inp)
+{
+	unsigned hash = dest[3] ^ dest[2] ^ ((size_t) inp >> 4);
+
+	return &ip->flow [hash & (IP_FLOW_CACHE_SIZE - 1)];
+}
+
+/*
+ * Forward the packet using the flow cache.
+ * Return 0 when no valid entry was found: the packet
+ * must be processed by the slow path.
+ */
+static bool_t
+ip_flow_forward (ip_t *ip, buf_t *p, netif_t *inp)
+{
+	ip_hdr_t *iphdr = (ip_hdr_t*) p->payload;
+	ip_flow_t *f;
+
+	f = ip_flow_entry (ip, iphdr->dest, inp);
+	if (f->generation != ip->flow_generation || f->inp != inp ||
+	    memcmp (f->dest, iphdr->dest, 4) != 0)
+		return 0;
+
+	/* Expired packets and packets with options go to the slow path. */
+	if (iphdr->ttl <= 1 || iphdr->version != 0x40 + IP_HLEN / 4)
+		return 0;
+
+	if (f->netif->arp) {
+		if (! buf_add_header (p, 14))
+			return 0;
+		memcpy (p->payload, f->ethhdr, 14);
+	}
+	ip_decrement_ttl (iphdr);
+
+	if (f->netif->capture)
+		capture_frame (f->netif->capture, p, CAPTURE_OUT);
+	f->netif->interface->output (f->netif, p, 0);
+	++ip->forw_datagrams;
+	++ip->forw_cached;
+	return 1;
+}
+
+/*
+ * Remember the resolved route for the destination.
+ */
+static void
+ip_flow_add (ip_t *ip, unsigned char *dest, netif_t *inp,
+	netif_t *netif, unsigned char *gateway)
+{
+	ip_flow_t *f;
+	unsigned char *ethdest = 0;
+
+	if (IS_MULTICAST (dest))
+		return;
+	if (netif->arp) {
+		ethdest = arp_lookup (netif, gateway);
+		if (! ethdest)
+			return;
+	}
+	f = ip_flow_entry (ip, dest, inp);
+	memcpy (f->dest, dest, 4);
+	f->inp = inp;
+	f->netif = netif;
+	if (ethdest) {
+		struct eth_hdr *h = (struct eth_hdr*) f->ethhdr;
+
+		memcpy (h->dest, ethdest, 6);
+		memcpy (h->src, netif->ethaddr, 6);
+		h->proto = PROTO_IP;
+	}
+	f->generation = ip->flow_generation;
+}
+#endif /* IP_FLOW_CACHE_SIZE */
+
+/*
+ * Invalidate the flow cache entries with the given next hop.
+ */
+void
+ip_flow_forget (ip_t *ip, netif_t *netif, unsigned char *ethaddr)
+{
+#if IP_FLOW_CACHE_SIZE > 0
+	ip_flow_t *f;
+
+	for (f = ip->flow; f < ip->flow + IP_FLOW_CACHE_SIZE; ++f) {
+		if (f->generation == ip->flow_generation && f->netif == netif &&
+		    memcmp (((struct eth_hdr*) f->ethhdr)->dest, ethaddr, 6) == 0)
+			f->generation = ip->flow_generation - 1;
+	}
+#endif
+}
 
 /*
  * Forward an IP packet. It finds an appropriate route for the packet,
@@ -18,7 +132,7 @@
  */
 static void
 ip_forward (ip_t *ip, buf_t *p, unsigned char *gateway, netif_t *netif,
-	unsigned char *netif_ipaddr)
+	unsigned char *netif_ipaddr, netif_t *inp)
 {
 	ip_hdr_t *iphdr = (ip_hdr_t*) p->payload;
 
@@ -30,22 +144,14 @@ ip_forward (ip_t *ip, buf_t *p, unsigned char *gateway, netif_t *netif,
 		}
 		return;
 	}
-	iphdr->ttl--;
-
-	/* Incremental update of the IP checksum. */
-	if (iphdr->chksum_h != 0xff)
-		iphdr->chksum_h += 1;
-	else if (iphdr->chksum_l != 0xff) {
-		iphdr->chksum_h = 0;
-		iphdr->chksum_l += 1;
-	} else {
-		iphdr->chksum_h = 1;
-		iphdr->chksum_l = 0;
-	}
+	ip_decrement_ttl (iphdr);
 
 	/* Forwarding packet to netif. */
 	if (! gateway)
 		gateway = iphdr->dest;
+#if IP_FLOW_CACHE_SIZE > 0
+	ip_flow_add (ip, iphdr->dest, inp, netif, gateway);
+#endif
 	netif_output (netif, p, gateway, netif_ipaddr);
 	++ip->forw_datagrams;
 }
@@ -99,6 +205,11 @@ ip_input (ip_t *ip, buf_t *p, netif_t *inp)
 	 * but we'll do it anyway just to be sure that its done. */
 	buf_truncate (p, iphdr->len_h << 8 | iphdr->len_l);
 
+#if IP_FLOW_CACHE_SIZE > 0
+	/* Fast path for forwarded packets. */
+	if (ip->forwarding && ip_flow_forward (ip, p, inp))
+		return;
+#endif
 	/* Is this packet for us? */
 	broadcast = IS_BROADCAST (iphdr->dest);
 	if (! broadcast) {
@@ -119,7 +230,7 @@ ip_input (ip_t *ip, buf_t *p, netif_t *inp)
 				 * network interface on which they arrived. */
 				if (netif && netif != inp)
 					ip_forward (ip, p, gateway, netif,
-						netif_ipaddr);
+						netif_ipaddr, inp);
 				else
 					buf_free (p);
 			} else {
@@ -360,6 +471,51 @@ ip_main (void *arg)
 	}
 }
 
+/*
+ * Receive task of a network interface.
+ * The lock is taken per packet, so that a receiver of higher
+ * priority waits for at most one packet of another interface.
+ */
+static void
+ip_receiver_main (void *arg)
+{
+	ip_receiver_t *r = (ip_receiver_t*) arg;
+	ip_t *ip = r->ip;
+	mutex_group_t *g;
+	buf_t *p;
+
+	g = mutex_group_init (r->group, sizeof (r->group));
+	mutex_group_add (g, &r->netif->lock);
+	mutex_group_listen (g);
+	for (;;) {
+		mutex_group_wait (g, 0, 0);
+		for (;;) {
+			mutex_lock (&ip->lock);
+			p = netif_input (r->netif);
+			if (! p) {
+				mutex_unlock (&ip->lock);
+				break;
+			}
+			ip_input (ip, p, r->netif);
+			mutex_unlock (&ip->lock);
+		}
+	}
+}
+
+/*
+ * Create a dedicated receive task for the network interface.
+ * The interface must not be included in the netif_group,
+ * passed to ip_init().
+ */
+void
+ip_add_receiver (ip_t *ip, ip_receiver_t *r, netif_t *netif, int prio)
+{
+	r->ip = ip;
+	r->netif = netif;
+	r->task = task_create (ip_receiver_main, r, netif->name, prio,
+		r->stack, sizeof (r->stack));
+}
+
 /*
  * Initialize the IP layer.
  */
@@ -372,6 +528,9 @@ ip_init (ip_t *ip, mem_pool_t *pool, int prio,
 	ip->arp = arp;
 	ip->netif_group = g;
 	ip->default_ttl = 64;
+#if IP_FLOW_CACHE_SIZE > 0
+	ip->flow_generation = 1;
+#endif
 
 	/* Initialize the TCP layer. */
 	ip->tcp_seqno = 6510;
@@ -22,6 +22,26 @@
 #   endif
 #endif
 
+/*
+ * Size of forwarding flow cache, must be a power of 2.
+ * Set to 0 to disable the cache.
+ */
+#ifndef IP_FLOW_CACHE_SIZE
+#   define IP_FLOW_CACHE_SIZE	8
+#endif
+
+/*
+ * Entry of forwarding flow cache: resolved output interface
+ * and link header for the destination address.
+ */
+typedef struct _ip_flow_t {
+	unsigned	generation;	/* valid when equal to ip->flow_generation */
+	struct _netif_t	*inp;		/* input interface */
+	struct _netif_t	*netif;		/* output interface */
+	unsigned char	dest [4];	/* destination IP address */
+	unsigned char	ethhdr [14];	/* prebuilt Ethernet header */
+} ip_flow_t;
+
 typedef struct _ip_t {
 	mutex_t		lock;
 	mutex_group_t	*netif_group;	/* list of network drivers */
@@ -34,6 +54,17 @@ typedef struct _ip_t {
 	small_uint_t	tos;		/* type of service value */
 	unsigned	id;		/* output packet number */
 
+#if IP_FLOW_CACHE_SIZE > 0
+	/*
+	 * Forwarding flow cache. Incrementing the generation
+	 * invalidates all entries: done on route changes.
+	 * ARP changes invalidate only the entries of the changed
+	 * address (ip_flow_forget).
+	 */
+	unsigned	flow_generation;
+	ip_flow_t	flow [IP_FLOW_CACHE_SIZE];
+#endif
+
 	/*
 	 * UDP
 	 */
@@ -81,6 +112,7 @@ typedef struct _ip_t {
 	unsigned long	out_no_routes;	/* lost output packets due to
 					   no route to host */
 	unsigned long	forw_datagrams;	/* forwarded packets */
+	unsigned long	forw_cached;	/* forwarded by flow cache */
 
 	/*
 	 * ICMP statistics.
@@ -136,6 +168,20 @@ typedef struct _ip_t {
 	ARRAY (stack, IP_STACKSZ);	/* task stack */
 } ip_t;
 
+/*
+ * Dedicated receive task for a network interface.
+ * Packets from the interface are processed by this task with
+ * its own priority, instead of the common IP task. The shared
+ * IP state is protected by ip->lock, taken for every packet.
+ */
+typedef struct _ip_receiver_t {
+	struct _ip_t	*ip;
+	struct _netif_t	*netif;
+	task_t		*task;
+	ARRAY (group, sizeof(mutex_group_t) + sizeof(mutex_slot_t));
+	ARRAY (stack, IP_STACKSZ);	/* task stack */
+} ip_receiver_t;
+
 typedef struct _ip_hdr_t {
 	unsigned char	version;	/* version / header length */
 	unsigned char	tos;		/* type of service */
@@ -206,12 +252,33 @@ struct _netif_t;
 void ip_init (ip_t *ip, struct _mem_pool_t *pool, int prio,
 	struct _timer_t *timer, struct _arp_t *arp, mutex_group_t *g);
 void ip_input (ip_t *ip, struct _buf_t *p, struct _netif_t *inp);
+void ip_add_receiver (ip_t *ip, ip_receiver_t *r, struct _netif_t *netif,
+	int prio);
 bool_t ip_output (ip_t *ip, struct _buf_t *p, unsigned char *dest,
 	unsigned char *src, small_uint_t proto);
 bool_t ip_output_netif (ip_t *ip, struct _buf_t *p, unsigned char *dest,
 	unsigned char *src, small_uint_t proto, unsigned char *gateway,
 	struct _netif_t *netif, unsigned char *netif_ipaddr);
 
+/*
+ * Invalidate the forwarding flow cache.
+ * Must be called on every change of routing table.
+ */
+static inline void
+ip_flow_flush (ip_t *ip)
+{
+#if IP_FLOW_CACHE_SIZE > 0
+	++ip->flow_generation;
+#endif
+}
+
+/*
+ * Invalidate the flow cache entries, which send packets
+ * to the given Ethernet address: called when ARP entry
+ * is changed or deleted.
+ */
+void ip_flow_forget (ip_t *ip, struct _netif_t *netif, unsigned char *ethaddr);
+
 void icmp_echo_request (ip_t *ip, struct _buf_t *p, struct _netif_t *inp);
 void icmp_dest_unreach (ip_t *ip, struct _buf_t *p, small_uint_t op);
 void icmp_time_exceeded (ip_t *ip, struct _buf_t *p);
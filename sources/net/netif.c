@@ -4,6 +4,7 @@
 #include <buf/buf.h>
 #include <net/netif.h>
 #include <net/arp.h>
+#include <net/capture.h>
 
 bool_t
 netif_output_prio (netif_t *netif, buf_t *p, unsigned char *ipdest,
@@ -28,6 +29,8 @@ discard:		/* Count this packet as discarded. */
 			return 0;
 		}
 	}
+	if (netif->capture)
+		capture_frame (netif->capture, p, CAPTURE_OUT);
 	return netif->interface->output (netif, p, prio);
 }
 
@@ -44,6 +47,8 @@ netif_input (netif_t *netif)
 	struct _buf_t *p;
 
 	p = netif->interface->input (netif);
+	if (p && netif->capture)
+		capture_frame (netif->capture, p, CAPTURE_IN);
 	if (p && netif->arp)
 		p = arp_input (netif, p);
 	return p;
@@ -2,6 +2,7 @@
 #define	__NETIF_H_ 1
 
 struct _buf_t;
+struct _capture_t;
 
 /*
  * Интерфейс к драйверу сетевого адаптера (Etnernet, SLIP и прочее).
@@ -20,6 +21,7 @@ typedef struct _netif_t {
 	unsigned char type;		/* SNMP-compatible */
 	unsigned long bps;		/* speed in bits per second */
 	unsigned short out_qlen;	/* number of packets in output queue */
+	struct _capture_t *capture;	/* packet capture, when enabled */
 
 	/* Statistics. */
 	unsigned long in_bytes;
@@ -116,6 +116,7 @@ void route_setup (ip_t *ip, route_t *r, unsigned char *ipaddr,
 	memcpy (r->broadcast, &bcast, 4);
 	net = HTONL (net);
 	memcpy (r->netaddr, &net, 4);
+	ip_flow_flush (ip);
 	/* debug_printf ("route: setup net %d.%d.%d.%d bcast %d.%d.%d.%d\n",
 		r->netaddr[0], r->netaddr[1], r->netaddr[2], r->netaddr[3],
 		r->broadcast[0], r->broadcast[1], r->broadcast[2], r->broadcast[3]); */
@@ -131,6 +132,7 @@ void route_add_netif (ip_t *ip, route_t *r, unsigned char *ipaddr,
 	r->netif = netif;
 	r->next = ip->route;
 	ip->route = r;
+	ip_flow_flush (ip);
 }
 
 /*
@@ -150,6 +152,7 @@ bool_t route_add_gateway (ip_t *ip, route_t *r,
 
 	r->next = ip->route;
 	ip->route = r;
+	ip_flow_flush (ip);
 	return 1;
 }
 
@@ -54,13 +54,54 @@ tcp_stream_putchar (tcp_stream_t *u, short c)
 	socket_flush (u->socket);
 }
 
-static unsigned short
-tcp_stream_getchar (tcp_stream_t *u)
+/*
+ * Write a block of bytes: copy into output buffer by chunks,
+ * taking the socket lock once per chunk instead of once per byte.
+ */
+static int
+tcp_stream_write (tcp_stream_t *u, const void *buf, int len)
 {
-	unsigned short c;
+	const unsigned char *p = buf;
+	int n = 0, chunk;
 
 	if (! u->socket)
-		return -1;
+		return 0;
+	mutex_lock (&u->socket->lock);
+	while (n < len) {
+		if (u->socket->state != SYN_SENT && u->socket->state != SYN_RCVD &&
+		    u->socket->state != ESTABLISHED && u->socket->state != CLOSE_WAIT) {
+			/* Connection was closed. */
+			break;
+		}
+		chunk = u->outdata + sizeof(u->outdata) - u->outptr;
+		if (chunk > len - n)
+			chunk = len - n;
+		memcpy (u->outptr, p + n, chunk);
+		u->outptr += chunk;
+		n += chunk;
+		if (u->outptr < u->outdata + sizeof(u->outdata))
+			break;
+
+		stream_flush (u);
+		mutex_unlock (&u->socket->lock);
+
+		/* Force IP level to send a packet. */
+		socket_flush (u->socket);
+		mutex_lock (&u->socket->lock);
+	}
+	mutex_unlock (&u->socket->lock);
+	return n;
+}
+
+/*
+ * Make sure the input buffer has data.
+ * Flush pending output first: the peer may wait for it.
+ * Return 0 when no data is available without waiting,
+ * or the connection is closed.
+ */
+static bool_t
+stream_receive (tcp_stream_t *u, bool_t wait)
+{
 	mutex_lock (&u->socket->lock);
 
 	/* Flush output buffer. */
@@ -72,33 +113,42 @@ tcp_stream_getchar (tcp_stream_t *u)
 	}
 
 	/* Wait for data. */
-	if (u->inbuf)
+	if (u->inbuf) {
 		mutex_unlock (&u->socket->lock);
-	else {
-		while (tcp_queue_is_empty (u->socket)) {
-			if (u->socket->state != SYN_SENT &&
-			    u->socket->state != SYN_RCVD &&
-			    u->socket->state != ESTABLISHED) {
-				mutex_unlock (&u->socket->lock);
-				return -1;
-			}
-			mutex_wait (&u->socket->lock);
+		return 1;
+	}
+	while (tcp_queue_is_empty (u->socket)) {
+		if (! wait ||
+		    (u->socket->state != SYN_SENT &&
+		    u->socket->state != SYN_RCVD &&
+		    u->socket->state != ESTABLISHED)) {
+			mutex_unlock (&u->socket->lock);
+			return 0;
 		}
-		u->inbuf = tcp_queue_get (u->socket);
-		u->inptr = u->inbuf->payload;
-		mutex_unlock (&u->socket->lock);
+		mutex_wait (&u->socket->lock);
+	}
+	u->inbuf = tcp_queue_get (u->socket);
+	u->inptr = u->inbuf->payload;
+	mutex_unlock (&u->socket->lock);
 /*debug_printf ("tstream input"); buf_print (u->inbuf);*/
 
-		mutex_lock (&u->socket->ip->lock);
-		if (! (u->socket->flags & TF_ACK_DELAY) &&
-		    ! (u->socket->flags & TF_ACK_NOW)) {
-			tcp_ack (u->socket);
-		}
-		mutex_unlock (&u->socket->ip->lock);
+	mutex_lock (&u->socket->ip->lock);
+	if (! (u->socket->flags & TF_ACK_DELAY) &&
+	    ! (u->socket->flags & TF_ACK_NOW)) {
+		tcp_ack (u->socket);
 	}
+	mutex_unlock (&u->socket->ip->lock);
+	return 1;
+}
 
-	/* Get byte from buffer. */
-	c = *u->inptr++;
+/*
+ * Advance input pointer by n bytes, within the current buffer.
+ * Free the buffer when it is exhausted.
+ */
+static void
+stream_consume (tcp_stream_t *u, int n)
+{
+	u->inptr += n;
 	if (u->inptr >= u->inbuf->payload + u->inbuf->len) {
 		buf_t *old = u->inbuf;
 
@@ -109,43 +159,50 @@ tcp_stream_getchar (tcp_stream_t *u)
 		}
 		buf_free (old);
 	}
-	return c;
 }
 
-static int
-tcp_stream_peekchar (tcp_stream_t *u)
+static unsigned short
+tcp_stream_getchar (tcp_stream_t *u)
 {
-	if (! u->socket)
+	unsigned short c;
+
+	if (! u->socket || ! stream_receive (u, 1))
 		return -1;
-	mutex_lock (&u->socket->lock);
 
-	/* Flush output buffer. */
-	if (u->outptr > u->outdata) {
-		stream_flush (u);
-		mutex_unlock (&u->socket->lock);
-		socket_flush (u->socket);
-		mutex_lock (&u->socket->lock);
-	}
+	/* Get byte from buffer. */
+	c = *u->inptr;
+	stream_consume (u, 1);
+	return c;
+}
 
-	/* Any data available? */
-	if (u->inbuf)
-		mutex_unlock (&u->socket->lock);
-	else {
-		if (tcp_queue_is_empty (u->socket)) {
-			mutex_unlock (&u->socket->lock);
-			return -1;
-		}
-		u->inbuf = tcp_queue_get (u->socket);
-		u->inptr = u->inbuf->payload;
-		mutex_unlock (&u->socket->lock);
+/*
+ * Wait for data and get all received bytes, up to len.
+ */
+static int
+tcp_stream_read (tcp_stream_t *u, void *buf, int len)
+{
+	unsigned char *p = buf;
+	int n = 0, chunk;
 
-		mutex_lock (&u->socket->ip->lock);
-		if (! (u->socket->flags & TF_ACK_DELAY) &&
-		    ! (u->socket->flags & TF_ACK_NOW)) {
-			tcp_ack (u->socket);
-		}
-		mutex_unlock (&u->socket->ip->lock);
+	if (! u->socket || ! stream_receive (u, 1))
+		return 0;
+
+	while (n < len && u->inbuf) {
+		chunk = u->inbuf->payload + u->inbuf->len - u->inptr;
+		if (chunk > len - n)
+			chunk = len - n;
+		memcpy (p + n, u->inptr, chunk);
+		n += chunk;
+		stream_consume (u, chunk);
 	}
+	return n;
+}
+
+static int
+tcp_stream_peekchar (tcp_stream_t *u)
+{
+	if (! u->socket || ! stream_receive (u, 0))
+		return -1;
 	return *u->inptr;
 }
 
@@ -215,6 +272,8 @@ static stream_interface_t tcp_interface = {
 	.eof = (bool_t (*) (stream_t*))		tcp_stream_eof,
 	.close = (void (*) (stream_t*))		tcp_stream_close,
 	.receiver = (mutex_t *(*) (stream_t*))	tcp_stream_receiver,
+	.write = (int (*) (stream_t*, const void*, int)) tcp_stream_write,
+	.read = (int (*) (stream_t*, void*, int))	tcp_stream_read,
 };
 
 /*
@@ -239,6 +239,65 @@ again:
 	return c;
 }
 
+/*
+ * Write a block: pass runs of plain bytes to tcp-stream at once,
+ * expand newlines and escape IAC in between.
+ */
+static int
+telnet_write (telnet_t *u, const void *buf, int len)
+{
+	const unsigned char *p = buf, *end = p + len, *run;
+
+	while (p < end) {
+		for (run = p; p < end; ++p)
+			if (*p == '\n' || *p == IAC)
+				break;
+		if (p > run)
+			stream_write (&u->ts.stream, run, p - run);
+		if (p < end) {
+			/* '\n' -> "\r\n", IAC -> IAC IAC */
+			unsigned char esc [2];
+
+			esc[0] = (*p == IAC) ? IAC : '\r';
+			esc[1] = *p++;
+			stream_write (&u->ts.stream, esc, 2);
+		}
+	}
+	return len;
+}
+
+/*
+ * Read a block. The first byte goes through telnet_getchar(),
+ * which waits and handles commands. Then take the plain bytes,
+ * already received by tcp-stream, up to the next CR or IAC.
+ */
+static int
+telnet_read (telnet_t *u, void *buf, int len)
+{
+	unsigned char *p = buf, *q, *limit;
+	int c, n;
+
+	if (len <= 0)
+		return 0;
+	c = telnet_getchar (u);
+	if (c == (unsigned short)-1)
+		return 0;
+	p[0] = c;
+	n = 1;
+	while (n < len && u->ts.inbuf) {
+		limit = u->ts.inbuf->payload + u->ts.inbuf->len;
+		if (limit - u->ts.inptr > len - n)
+			limit = u->ts.inptr + len - n;
+		for (q = u->ts.inptr; q < limit; ++q)
+			if (*q == '\r' || *q == IAC)
+				break;
+		if (q == u->ts.inptr)
+			break;
+		n += stream_read (&u->ts.stream, p + n, q - u->ts.inptr);
+	}
+	return n;
+}
+
 static int
 telnet_peekchar (telnet_t *u)
 {
@@ -278,6 +337,8 @@ static stream_interface_t telnet_interface = {
 	.eof = (bool_t (*) (stream_t*))		telnet_eof,
 	.close = (void (*) (stream_t*))		telnet_close,
 	.receiver = (mutex_t *(*) (stream_t*))	telnet_receiver,
+	.write = (int (*) (stream_t*, const void*, int)) telnet_write,
+	.read = (int (*) (stream_t*, void*, int))	telnet_read,
 };
 
 /*
@@ -220,7 +220,7 @@ bool_t
 regexp_compile (regexp_t *r, const unsigned char *exp)
 {
 	unsigned char *scan;
-	unsigned char *longest;
+	unsigned char *longest, *first;
 	compile_t x;
 	unsigned short len;
 	unsigned char flags;
@@ -243,36 +243,44 @@ regexp_compile (regexp_t *r, const unsigned char *exp)
 	r->anchor = 0;
 	r->must = 0;
 	r->mustlen = 0;
+	r->mustprefix = 0;
 	scan = r->program+1;			/* First BRANCH. */
 	if (OP (regnext (scan)) == END) {	/* Only one top-level choice. */
 		scan = OPERAND(scan);
 
 		/* Starting-point info. */
-		if (OP(scan) == EXACTLY)
+		first = 0;
+		if (OP(scan) == EXACTLY) {
 			r->start = *OPERAND(scan);
-		else if (OP(scan) == BOL)
+			first = OPERAND(scan);
+		} else if (OP(scan) == BOL)
 			r->anchor++;
 
 		/*
-		 * If there's something expensive in the r.e., find the
-		 * longest literal string that must appear and make it the
-		 * `must'.  Resolve ties in favor of later strings, since
-		 * the start check works with the beginning of the r.e.
-		 * and avoiding duplication strengthens checking.  Not a
-		 * strong reason, but sufficient in the absence of others.
+		 * Find the longest literal string that must appear and
+		 * make it the `must'.  Resolve ties in favor of later
+		 * strings, since the start check works with the beginning
+		 * of the r.e. and avoiding duplication strengthens
+		 * checking.  But when the leading string is as long, take
+		 * it:  then every match begins with the `must', and
+		 * regexec() looks for the whole string instead of the
+		 * start char.
 		 */
-		if (flags & SPSTART) {
-			longest = 0;
-			len = 0;
-			for (; scan; scan=regnext(scan))
-				if (OP(scan) == EXACTLY &&
-				    strlen (OPERAND (scan)) >= len) {
-					longest = OPERAND (scan);
-					len = strlen(OPERAND (scan));
-				}
-			r->must = longest;
-			r->mustlen = len;
+		longest = 0;
+		len = 0;
+		for (; scan; scan=regnext(scan))
+			if (OP(scan) == EXACTLY &&
+			    strlen (OPERAND (scan)) >= len) {
+				longest = OPERAND (scan);
+				len = strlen(OPERAND (scan));
+			}
+		if (first && strlen (first) >= len) {
+			longest = first;
+			len = strlen (first);
+			r->mustprefix = 1;
 		}
+		r->must = longest;
+		r->mustlen = len;
 	}
 	return 1;
 }
@@ -761,6 +769,24 @@ regoptail (unsigned char *p, unsigned char *val)
  * regexec and friends
  */
 
+/*
+ - regfind - find literal string in the text from s to end
+ */
+static const unsigned char *
+regfind (const unsigned char *s, const unsigned char *end,
+	const unsigned char *str, unsigned short len)
+{
+	while (end - s >= len) {
+		s = memchr (s, str[0], end - s - len + 1);
+		if (! s)
+			return 0;
+		if (memcmp (s + 1, str + 1, len - 1) == 0)
+			return s;
+		s++;
+	}
+	return 0;
+}
+
 /*
  * Match a regular expression against a string.
  * Returns 1 on success, or 0 on failure.
@@ -769,7 +795,7 @@ bool_t
 regexp_execute (regexp_t *prog, const unsigned char *string)
 {
 	execute_t z;
-	const unsigned char *s;
+	const unsigned char *s, *end, *must = 0;
 
 	/* Be paranoid... */
 	if (! prog || ! string) {
@@ -784,14 +810,10 @@ regexp_execute (regexp_t *prog, const unsigned char *string)
 	}
 
 	/* If there is a "must appear" string, look for it. */
+	end = string + strlen (string);
 	if (prog->must) {
-		s = string;
-		while ((s = strchr (s, prog->must[0])) != 0) {
-			if (strncmp (s, prog->must, prog->mustlen) == 0)
-				break;	/* Found it. */
-			s++;
-		}
-		if (! s)	/* Not present. */
+		must = regfind (string, end, prog->must, prog->mustlen);
+		if (! must)	/* Not present. */
 			return 0;
 	}
 
@@ -804,9 +826,15 @@ regexp_execute (regexp_t *prog, const unsigned char *string)
 
 	/* Messy cases:  unanchored match. */
 	s = string;
-	if (prog->start != '\0')
+	if (prog->mustprefix)
+		/* We know what string it must start with. */
+		for (s=must; s; s=regfind (s+1, end, prog->must, prog->mustlen)) {
+			if (regtry (prog, &z, s))
+				return 1;
+		}
+	else if (prog->start != '\0')
 		/* We know what char it must start with. */
-		while ((s = strchr (s, prog->start)) != 0) {
+		while ((s = memchr (s, prog->start, end - s)) != 0) {
 			if (regtry (prog, &z, s))
 				return 1;
 			s++;
@@ -1012,7 +1040,7 @@ regmatch (execute_t *z, unsigned char *prog)
 		case STAR:
 		case PLUS: {
 				unsigned char nextch;
-				unsigned short no, min;
+				int no, min;
 				const unsigned char *save;
 
 				/*
@@ -1160,7 +1188,8 @@ regsub_dump (regexp_t *r)
 	if (r->anchor)
 		printf("anchored ");
 	if (r->must)
-		printf("must have \"%s\"", r->must);
+		printf("must %s \"%s\"", r->mustprefix ? "begin with" : "have",
+			r->must);
 	printf("\n");
 }
 
@@ -12,15 +12,15 @@
  * anchor	is the match anchored (at beginning-of-line only)?
  * must		string (pointer into program) that match must include, or NULL
  * mustlen	length of `must' string
+ * mustprefix	does every match begin with `must'?
  *
  * `Start' and `anchor' permit very fast decisions on suitable starting points
  * for a match, cutting down the work a lot.  `Must' permits fast rejection
- * of lines that cannot possibly match.  The `must' tests are costly enough
- * that regcomp() supplies a `must' only if the r.e. contains something
- * potentially expensive (at present, the only such thing detected is * or +
- * at the start of the r.e., which can involve a lot of backup).  `Mustlen' is
- * supplied because the test in regexec() needs it and regcomp() is computing
- * it anyway.
+ * of lines that cannot possibly match:  regexec() looks for it by memchr,
+ * which compares a word at a time.  When `must' is the prefix, the match
+ * is tried only where the whole string is found.  `Mustlen' is supplied
+ * because the test in regexec() needs it and regcomp() is computing it
+ * anyway.
  */
 struct _regexp_t {
 	const unsigned char	*startp [NSUBEXP];
@@ -29,6 +29,7 @@ struct _regexp_t {
 	unsigned char		anchor;
 	unsigned char		*must;
 	unsigned short		mustlen;
+	unsigned char		mustprefix;
 	unsigned char		program [1];
 };
 
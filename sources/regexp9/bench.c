@@ -0,0 +1,137 @@
+/*
+ * Benchmark of regexp_execute: match the patterns against
+ * generated lines with the lazy DFA and the must string prefilter,
+ * and with the plain NFA, check that the results are the same
+ * and print the speedup.
+ */
+#include <regexp9.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "regpriv.h"
+
+#define NLINES	2000
+#define RUNS	100
+
+char *pattern[] = {
+	"^[^!@]+$",
+	"^local!(.*)$",
+	"^([^!]+)@([^!@]+)$",
+	"^(uk\\.[^!]*)(!.*)$",
+	"^[^!]*\\.[^!]*!.*$",
+	"^(coma|research|pipe|pyxis|inet|hunny|gauss)!(.*)$",
+	"(a|b)*abb",
+	"[0-9]+\\.[0-9]+\\.[0-9]+",
+	"error|warning|fatal",
+	"^ab",
+	"x.*y$",
+	"\xE2\x98\xBA",
+	"ERROR.*timeout",
+	"sshd\\[[0-9]+\\]: Failed",
+	"link (up|down) on eth[0-9]",
+	0,
+};
+
+char *word[] = {
+	"local", "research", "uk", "inet", "pipe", "gauss", "abb", "ab",
+	"error", "warn", "192", "168", "x", "y", "mail", "box", "\xE2\x98\xBA",
+	"!", "@", ".", "\n", " ", "ba", "fatal", "ERROR", "timeout",
+	"sshd[", "]: ", "Failed", "link ", "up", " on ", "eth", "0",
+	"kernel: ", "session opened for user ", "connection closed",
+};
+
+char lines[NLINES][160];
+
+static unsigned long seed = 1;
+
+static int
+rnd(int n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+static double
+seconds(void)
+{
+	return (double) clock() / CLOCKS_PER_SEC;
+}
+
+int main(int ac, char **av)
+{
+	regexp_t *dfa, *nfa;
+	regexp_match_t rs[10], rn[10];
+	double t0, tdfa, tnfa, tdsub, tnsub;
+	int i, k, run, nmatch, ndiff;
+	char **pp;
+
+	for (i = 0; i < NLINES; i++) {
+		k = rnd(24) + 1;
+		while (k-- > 0 && strlen(lines[i]) < 120)
+			strcat(lines[i], word[rnd(nelem(word))]);
+	}
+
+	for (pp = pattern; *pp; pp++) {
+		dfa = regexp_compile(*pp);
+		nfa = regexp_compile(*pp);
+		if (! dfa || ! nfa)
+			return 1;
+		if (! dfa->dfa)
+			printf("%s: no DFA\n", *pp);
+		nfa->dfa = 0;
+		nfa->mustlen = 0;
+		nfa->mustprefix = 0;
+
+		/* check the results */
+		nmatch = ndiff = 0;
+		for (i = 0; i < NLINES; i++) {
+			k = regexp_execute(dfa, lines[i], 0, 0);
+			if (k != regexp_execute(nfa, lines[i], 0, 0))
+				ndiff++;
+			nmatch += k;
+			memset(rs, 0, sizeof rs);
+			memset(rn, 0, sizeof rn);
+			if (regexp_execute(dfa, lines[i], rs, 10) !=
+			    regexp_execute(nfa, lines[i], rn, 10) ||
+			    memcmp(rs, rn, sizeof rs) != 0)
+				ndiff++;
+		}
+
+		t0 = seconds();
+		for (run = 0; run < RUNS; run++)
+			for (i = 0; i < NLINES; i++)
+				regexp_execute(dfa, lines[i], 0, 0);
+		tdfa = seconds() - t0;
+		t0 = seconds();
+		for (run = 0; run < RUNS; run++)
+			for (i = 0; i < NLINES; i++)
+				regexp_execute(nfa, lines[i], 0, 0);
+		tnfa = seconds() - t0;
+		t0 = seconds();
+		for (run = 0; run < RUNS; run++)
+			for (i = 0; i < NLINES; i++) {
+				memset(rs, 0, sizeof rs);
+				regexp_execute(dfa, lines[i], rs, 10);
+			}
+		tdsub = seconds() - t0;
+		t0 = seconds();
+		for (run = 0; run < RUNS; run++)
+			for (i = 0; i < NLINES; i++) {
+				memset(rs, 0, sizeof rs);
+				regexp_execute(nfa, lines[i], rs, 10);
+			}
+		tnsub = seconds() - t0;
+
+		printf("%-52s %4d matches, match %5.1fx, submatch %5.1fx, %lu flushes",
+			*pp, nmatch, tnfa / (tdfa ? tdfa : 1e-6),
+			tnsub / (tdsub ? tdsub : 1e-6),
+			dfa->dfa ? dfa->dfa->nflush : 0);
+		if (ndiff)
+			printf(", %d RESULTS DIFFER", ndiff);
+		printf("\n");
+		free(dfa);
+		free(nfa);
+	}
+	return 0;
+}
@@ -228,14 +228,146 @@ evaluntil(int pri)
 	}
 }
 
+/*
+ *  is END reachable from the start, bypassing the instruction avoid?
+ */
+static	int
+reachend(regexp_t *pp, regexp_instr_t *avoid, char *mark, regexp_instr_t **stack)
+{
+	regexp_instr_t *inst;
+	int sp;
+
+	memset(mark, 0, freep - pp->firstinst);
+	sp = 0;
+	stack[sp++] = pp->startinst;
+	mark[pp->startinst - pp->firstinst] = 1;
+	while(sp > 0){
+		inst = stack[--sp];
+		if(inst == avoid)
+			continue;
+		if(inst->type == END)
+			return 1;
+		if(inst->type == OR && !mark[inst->u1.right - pp->firstinst]){
+			mark[inst->u1.right - pp->firstinst] = 1;
+			stack[sp++] = inst->u1.right;
+		}
+		if(!mark[inst->u2.next - pp->firstinst]){
+			mark[inst->u2.next - pp->firstinst] = 1;
+			stack[sp++] = inst->u2.next;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  copy to buf the utf of the runes, which follow one another
+ *  from inst on, and return the number of bytes
+ */
+static	int
+runestring(regexp_instr_t *inst, char *buf)
+{
+	unsigned short r;
+	int n;
+
+	n = 0;
+	for(;; inst = inst->u2.next){
+		switch(inst->type){
+		case LBRA:
+		case RBRA:
+		case NOP:
+			continue;
+		case RUNE:
+			r = inst->u1.r;
+			if(r == 0 || r == 0x80)	/* 0x80 also stands for bad utf */
+				break;
+			if(r < 0x80){
+				if(n + 1 >= NMUST)
+					break;
+				buf[n++] = r;
+			} else if(r < 0x800){
+				if(n + 2 >= NMUST)
+					break;
+				buf[n++] = 0xc0 | r >> 6;
+				buf[n++] = 0x80 | (r & 0x3f);
+			} else {
+				if(n + 3 >= NMUST)
+					break;
+				buf[n++] = 0xe0 | r >> 12;
+				buf[n++] = 0x80 | ((r >> 6) & 0x3f);
+				buf[n++] = 0x80 | (r & 0x3f);
+			}
+			continue;
+		}
+		break;
+	}
+	buf[n] = 0;
+	return n;
+}
+
+/*
+ *  Find the longest string, which every match contains:
+ *  a chain of runes, which every path from the start to END
+ *  goes through.  When the string, which every match begins
+ *  with, is as long, take it: then regexec looks for it
+ *  to find where to start.
+ */
+static	void
+findmust(regexp_t *pp)
+{
+	regexp_instr_t *inst, **stack;
+	char buf[NMUST], *mark;
+	int n;
+
+	pp->mustlen = 0;
+	pp->mustprefix = 0;
+	mark = malloc(freep - pp->firstinst);
+	stack = malloc((freep - pp->firstinst) * sizeof(*stack));
+	if(mark && stack){
+		for(inst=pp->firstinst; inst<freep; inst++){
+			if(inst->type != RUNE)
+				continue;
+			n = runestring(inst, buf);
+			if(n <= pp->mustlen || reachend(pp, inst, mark, stack))
+				continue;
+			memcpy(pp->must, buf, n+1);
+			pp->mustlen = n;
+		}
+	}
+	free(mark);
+	free(stack);
+
+	/* the prefix: skip the zero-width instructions */
+	for(inst=pp->startinst; ; inst=inst->u2.next)
+		if(inst->type != LBRA && inst->type != RBRA &&
+		   inst->type != NOP && inst->type != BOL)
+			break;
+	if(inst->type == RUNE){
+		n = runestring(inst, buf);
+		if(n > 0 && n >= pp->mustlen){
+			memcpy(pp->must, buf, n+1);
+			pp->mustlen = n;
+			pp->mustprefix = 1;
+		}
+	}
+
+	/*
+	 *  a match anchored at the line start is tried only there,
+	 *  and is rejected right away without the prefix
+	 */
+	if(pp->startinst->type == BOL && pp->mustprefix){
+		pp->mustlen = 0;
+		pp->mustprefix = 0;
+	}
+}
+
 static	regexp_t*
 optimize(regexp_t *pp)
 {
 	regexp_instr_t *inst, *target;
-	int size;
+	int size, dsize, ninst;
 	regexp_t *npp;
 	regexp_class_t *cl;
-	int diff;
+	long diff;
 
 	/*
 	 *  get rid of NOOP chains
@@ -247,15 +379,26 @@ optimize(regexp_t *pp)
 		inst->u2.next = target;
 	}
 
+	findmust(pp);
+
 	/*
 	 *  The original allocation is for an area larger than
-	 *  necessary.  Reallocate to the actual space used
-	 *  and then relocate the code.
+	 *  necessary.  Reallocate to the actual space used,
+	 *  plus the space for the lazy DFA, and then relocate
+	 *  the code.
 	 */
-	size = sizeof(regexp_t) + (freep - pp->firstinst)*sizeof(regexp_instr_t);
-	npp = realloc(pp, size);
-	if(npp==0 || npp==pp)
-		return pp;
+	ninst = freep - pp->firstinst;
+	size = sizeof(regexp_t) + ninst*sizeof(regexp_instr_t);
+	dsize = _regdfasize(pp, ninst);
+	npp = realloc(pp, size + dsize);
+	if(npp==0){
+		npp = pp;
+		dsize = 0;
+	}
+	if(npp==pp){
+		_regdfainit(npp, ninst, (char*)npp + size, dsize);
+		return npp;
+	}
 	diff = (char *)npp - (char *)pp;
 	freep = (regexp_instr_t *)((char *)freep + diff);
 	for(inst=npp->firstinst; inst<freep; inst++){
@@ -276,6 +419,7 @@ optimize(regexp_t *pp)
 		inst->u2.left = (void*)((char*)inst->u2.left + diff);
 	}
 	npp->startinst = (void*)((char*)npp->startinst + diff);
+	_regdfainit(npp, ninst, (char*)npp + size, dsize);
 	return npp;
 }
 
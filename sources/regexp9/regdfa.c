@@ -0,0 +1,428 @@
+#include <string.h>
+#include "regexp9.h"
+#include "regpriv.h"
+
+/*
+ * Lazy DFA for regexp_execute.
+ *
+ * A state of the DFA is the set of instructions, waiting for the next
+ * character, plus the flag of the beginning of a line.  Runes, which
+ * no instruction of the program tells apart, form one class: the
+ * transitions are indexed by class.  States and transitions are built
+ * on demand, in the space after the program.  When the space is full,
+ * all states are dropped and built again.
+ */
+#define WORDBITS	(8 * sizeof(unsigned long))
+#define DFAWORDS	((DFAMAXINST + WORDBITS - 1) / WORDBITS)
+
+#define DBOL		1	/* state at the beginning of a line */
+#define DEMPTY		2	/* no instructions: only the start is tried */
+#define DMATCH		0x8000	/* transition flag: match before the rune */
+
+#define STATE(d, i)	((unsigned long*) ((d)->states + (i) * (d)->statesize))
+#define FLAGS(d, st)	(*(unsigned short*) ((st) + (d)->nwords))
+#define NEXT(d, st)	((unsigned short*) ((st) + (d)->nwords) + 1)
+
+#define ISSET(set, i)	((set)[(i) / WORDBITS] & (1UL << ((i) % WORDBITS)))
+#define SET(set, i)	((set)[(i) / WORDBITS] |= 1UL << ((i) % WORDBITS))
+
+/*
+ * Add the range of runes lo..hi to the sorted list of class bounds.
+ * Return 0 when there are too many classes.
+ */
+static int
+addrange(unsigned short *bound, int *nbound, unsigned lo, unsigned hi)
+{
+	unsigned b[2];
+	int i, k, n;
+
+	b[0] = lo;
+	b[1] = hi + 1;
+	for(k=0; k<2; k++){
+		if(b[k] == 0 || b[k] > 0xffff)
+			continue;
+		n = *nbound;
+		for(i=0; i<n && bound[i] < b[k]; i++)
+			continue;
+		if(i < n && bound[i] == b[k])
+			continue;
+		if(n >= DFAMAXCLASS-1)
+			return 0;
+		memmove(bound+i+1, bound+i, (n-i) * sizeof(bound[0]));
+		bound[i] = b[k];
+		*nbound = n + 1;
+	}
+	return 1;
+}
+
+/*
+ * Split runes into classes by the instructions of the program.
+ * Newline and NUL get classes of their own: they end a line.
+ * Return the number of bounds, or -1 when there are too many.
+ */
+static int
+mkbounds(regexp_t *progp, regexp_instr_t *endp, unsigned short *bound)
+{
+	regexp_instr_t *inst;
+	unsigned short *rp;
+	int n = 0;
+
+	if(!addrange(bound, &n, 0, 0) || !addrange(bound, &n, '\n', '\n'))
+		return -1;
+	for(inst=progp->firstinst; inst<endp; inst++){
+		switch(inst->type){
+		case RUNE:
+			if(!addrange(bound, &n, inst->u1.r, inst->u1.r))
+				return -1;
+			break;
+		case CCLASS:
+		case NCCLASS:
+			for(rp = inst->u1.cp->spans; rp < inst->u1.cp->end; rp += 2)
+				if(!addrange(bound, &n, rp[0], rp[1]))
+					return -1;
+			break;
+		}
+	}
+	return n;
+}
+
+static int
+runeclass(regexp_dfa_t *d, unsigned short r)
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = d->nclass - 1;
+	while(lo < hi){
+		mid = (lo + hi) / 2;
+		if(d->bound[mid] <= r)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int
+statesize(int nwords, int nclass)
+{
+	int size;
+
+	size = nwords * sizeof(unsigned long) + (nclass + 1) * sizeof(short);
+	return (size + sizeof(unsigned long) - 1) & ~(sizeof(unsigned long) - 1);
+}
+
+/*
+ * Return the number of bytes for the DFA of the program,
+ * or 0 when the program is too large for it.
+ */
+extern int
+_regdfasize(regexp_t *progp, int ninst)
+{
+	unsigned short bound[DFAMAXCLASS];
+	int nbound, size;
+
+	if(ninst > DFAMAXINST)
+		return 0;
+	nbound = mkbounds(progp, progp->firstinst + ninst, bound);
+	if(nbound < 0)
+		return 0;
+	size = statesize((ninst + WORDBITS - 1) / WORDBITS, nbound + 1);
+	if(size * DFAMINSTATE > DFASIZE)
+		return 0;
+	return sizeof(regexp_dfa_t) + DFASIZE;
+}
+
+/*
+ * Set up an empty DFA in the given space after the program.
+ */
+extern void
+_regdfainit(regexp_t *progp, int ninst, void *space, int size)
+{
+	regexp_dfa_t *d = space;
+	int nbound, i;
+
+	progp->dfa = 0;
+	if(size == 0)
+		return;
+	nbound = mkbounds(progp, progp->firstinst + ninst, d->bound);
+	d->busy = 0;
+	d->nclass = nbound + 1;
+	d->nwords = (ninst + WORDBITS - 1) / WORDBITS;
+	d->statesize = statesize(d->nwords, d->nclass);
+	d->nstate = (size - sizeof(regexp_dfa_t)) / d->statesize;
+	d->used = 0;
+	d->nflush = 0;
+	d->states = (char*) (d + 1);
+	for(i=0; i<128; i++)
+		d->cmap[i] = runeclass(d, i);
+	progp->dfa = d;
+}
+
+/*
+ * Follow the instructions of the set and the start instruction
+ * until they consume a rune.  Put to the next set the instructions,
+ * which follow the rune r.  Return 1 when the END is reached.
+ */
+static int
+closure(regexp_t *progp, unsigned long *set, int nwords, int bol, int eol,
+	unsigned short r, unsigned long *next)
+{
+	regexp_instr_t *stack[DFAMAXINST], *inst;
+	unsigned long seen[DFAWORDS];
+	unsigned short *rp, *ep;
+	int sp, i, match;
+
+	memset(seen, 0, nwords * sizeof(seen[0]));
+	if(next)
+		memset(next, 0, nwords * sizeof(next[0]));
+	sp = 0;
+	i = progp->startinst - progp->firstinst;
+	SET(seen, i);
+	stack[sp++] = progp->startinst;
+	for(i=0; i<nwords*WORDBITS; i++)
+		if(ISSET(set, i) && !ISSET(seen, i)){
+			SET(seen, i);
+			stack[sp++] = progp->firstinst + i;
+		}
+
+#define PUSH(ip)	do { \
+		i = (ip) - progp->firstinst; \
+		if(!ISSET(seen, i)){ \
+			SET(seen, i); \
+			stack[sp++] = (ip); \
+		} \
+	} while(0)
+#define ADD(ip)		do { \
+		if(next){ \
+			i = (ip) - progp->firstinst; \
+			SET(next, i); \
+		} \
+	} while(0)
+
+	match = 0;
+	while(sp > 0){
+		inst = stack[--sp];
+		switch(inst->type){
+		case RUNE:
+			if(inst->u1.r == r)
+				ADD(inst->u2.next);
+			break;
+		case LBRA:
+		case RBRA:
+		case NOP:
+			PUSH(inst->u2.next);
+			break;
+		case ANY:
+			if(r != '\n')
+				ADD(inst->u2.next);
+			break;
+		case ANYNL:
+			ADD(inst->u2.next);
+			break;
+		case BOL:
+			if(bol)
+				PUSH(inst->u2.next);
+			break;
+		case EOL:
+			if(eol)
+				PUSH(inst->u2.next);
+			break;
+		case CCLASS:
+			ep = inst->u1.cp->end;
+			for(rp = inst->u1.cp->spans; rp < ep; rp += 2)
+				if(r >= rp[0] && r <= rp[1]){
+					ADD(inst->u2.next);
+					break;
+				}
+			break;
+		case NCCLASS:
+			ep = inst->u1.cp->end;
+			for(rp = inst->u1.cp->spans; rp < ep; rp += 2)
+				if(r >= rp[0] && r <= rp[1])
+					break;
+			if(rp == ep)
+				ADD(inst->u2.next);
+			break;
+		case OR:
+			PUSH(inst->u1.right);
+			PUSH(inst->u2.left);
+			break;
+		case END:
+			match = 1;
+			break;
+		}
+	}
+#undef PUSH
+#undef ADD
+	return match;
+}
+
+/*
+ * Find the state with the given set and flags, or add a new one.
+ * Return -1 when there is no space.
+ */
+static int
+findstate(regexp_dfa_t *d, unsigned long *set, int bol)
+{
+	unsigned long *st;
+	int i, flags;
+
+	flags = bol ? DBOL : 0;
+	for(i=0; i<d->nwords && set[i]==0; i++)
+		continue;
+	if(i == d->nwords)
+		flags |= DEMPTY;
+	for(i=0; i<d->used; i++){
+		st = STATE(d, i);
+		if(FLAGS(d, st) == flags &&
+		   memcmp(st, set, d->nwords * sizeof(set[0])) == 0)
+			return i;
+	}
+	if(d->used >= d->nstate)
+		return -1;
+	st = STATE(d, d->used);
+	memcpy(st, set, d->nwords * sizeof(set[0]));
+	FLAGS(d, st) = flags;
+	memset(NEXT(d, st), 0, d->nclass * sizeof(short));
+	return d->used++;
+}
+
+/*
+ * Same as findstate, but drop all the states when there is no space.
+ * Return -1 when the states were dropped too many times in one call:
+ * the DFA does not help on this string.
+ */
+static int
+getstate(regexp_dfa_t *d, unsigned long *set, int bol, int *nflush)
+{
+	int i;
+
+	i = findstate(d, set, bol);
+	if(i < 0){
+		if(++*nflush > DFAMAXFLUSH)
+			return -1;
+		d->used = 0;
+		d->nflush++;
+		i = findstate(d, set, bol);
+	}
+	return i;
+}
+
+/*
+ * Build the transition of state cur by rune r of class c.
+ */
+static int
+transition(regexp_t *progp, regexp_dfa_t *d, int cur, unsigned short r,
+	int c, int *nflush)
+{
+	unsigned long set[DFAWORDS], next[DFAWORDS], *st;
+	int match, i, used;
+
+	st = STATE(d, cur);
+	memcpy(set, st, d->nwords * sizeof(set[0]));
+	match = closure(progp, set, d->nwords, FLAGS(d, st) & DBOL,
+		r == 0 || r == '\n', r, next);
+	used = d->used;
+	i = getstate(d, next, r == '\n', nflush);
+	if(i < 0)
+		return -1;
+	if(d->used >= used)	/* not dropped: remember the transition */
+		NEXT(d, st)[c] = (i + 1) | (match ? DMATCH : 0);
+	return (i + 1) | (match ? DMATCH : 0);
+}
+
+/*
+ *  return	0 if no match
+ *		1 if a match
+ *		<0 if the DFA can't be used: run the NFA
+ */
+extern int
+_regdfaexec(regexp_t *progp,	/* program to run */
+	const char *bol,	/* string to run machine on */
+	regexp_ljunk_t *j)
+{
+	regexp_dfa_t *d = progp->dfa;
+	unsigned long empty[DFAWORDS], *st;
+	const char *s;
+	char *p;
+	unsigned short r;
+	int n, c, t, cur, nflush, rv;
+
+	/* Not atomic: the program must not be shared by tasks. */
+	if(d == 0 || d->busy)
+		return -1;
+	d->busy = 1;
+	nflush = 0;
+	memset(empty, 0, sizeof(empty));
+	s = j->starts;
+	cur = getstate(d, empty, s == bol || *(s-1) == '\n', &nflush);
+	for(;;){
+		if(cur < 0){
+			rv = -1;
+			break;
+		}
+		st = STATE(d, cur);
+
+		/* fast check for first char */
+		if(j->starttype && (FLAGS(d, st) & DEMPTY)){
+			if(j->starttype == RUNE){
+				if(progp->mustprefix)
+					p = _utffind(s, j->send, progp->must, progp->mustlen);
+				else
+					p = _utfrune(s, j->startchar);
+				if(p == 0 || (j->eol && p >= j->eol)){
+					rv = 0;
+					break;
+				}
+				if(p != s){
+					s = p;
+					cur = getstate(d, empty, *(s-1) == '\n', &nflush);
+					continue;
+				}
+			} else if(!(FLAGS(d, st) & DBOL)){
+				p = _utfrune(s, '\n');
+				if(p == 0 || (j->eol && p >= j->eol)){
+					rv = 0;
+					break;
+				}
+				s = p+1;
+				cur = getstate(d, empty, 1, &nflush);
+				continue;
+			}
+		}
+		if(s == j->eol){
+			rv = closure(progp, st, d->nwords, FLAGS(d, st) & DBOL,
+				1, 0, 0);
+			break;
+		}
+		r = *(unsigned char*)s;
+		if(r < 0x80){
+			n = 1;
+			c = d->cmap[r];
+		}else{
+			n = _chartorune(&r, s);
+			c = runeclass(d, r);
+		}
+		t = NEXT(d, st)[c];
+		if(t == 0){
+			t = transition(progp, d, cur, r, c, &nflush);
+			if(t < 0){
+				rv = -1;
+				break;
+			}
+		}
+		if(t & DMATCH){
+			rv = 1;
+			break;
+		}
+		if(r == 0){
+			rv = 0;
+			break;
+		}
+		cur = (t & ~DMATCH) - 1;
+		s += n;
+	}
+	d->busy = 0;
+	return rv;
+}
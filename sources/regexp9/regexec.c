@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "regexp9.h"
 #include "regpriv.h"
 
@@ -46,16 +47,19 @@ regexec1(regexp_t *progp,	/* program to run */
 		if(checkstart) {
 			switch(j->starttype) {
 			case RUNE:
-				p = _utfrune(s, j->startchar);
-				if(p == 0 || s == j->eol)
+				if(progp->mustprefix)
+					p = _utffind(s, j->send, progp->must, progp->mustlen);
+				else
+					p = _utfrune(s, j->startchar);
+				if(p == 0 || (j->eol && p >= j->eol))
 					return match;
 				s = p;
 				break;
 			case BOL:
-				if(s == bol)
+				if(s == bol || *(s-1) == '\n')
 					break;
 				p = _utfrune(s, '\n');
-				if(p == 0 || s == j->eol)
+				if(p == 0 || (j->eol && p >= j->eol))
 					return match;
 				s = p+1;
 				break;
@@ -131,7 +135,7 @@ regexec1(regexp_t *progp,	/* program to run */
 					break;
 				case OR:
 					/* evaluate right choice later */
-					if(_renewthread(tlp, inst->u1.right, ms, &tlp->se) == tle)
+					if(_renewthread(tlp, inst->u1.right, ms, &tlp->se) >= tle)
 						return -1;
 					/* efficiency: advance and re-evaluate */
 					continue;
@@ -192,7 +196,7 @@ regexp_execute(regexp_t *progp,	/* program to run */
 {
 	regexp_ljunk_t j;
 	regexp_list_t relist0[LISTSIZE], relist1[LISTSIZE];
-	int rv;
+	int rv, i;
 
 	/*
  	 *  use user-specified starting/ending location if specified
@@ -220,6 +224,33 @@ regexp_execute(regexp_t *progp,	/* program to run */
 	j.reliste[0] = relist0 + nelem(relist0) - 2;
 	j.reliste[1] = relist1 + nelem(relist1) - 2;
 
+	/*
+	 *  every match contains the must string: reject the text
+	 *  without it, and start only where it is, if it is the prefix
+	 */
+	rv = -1;
+	if(progp->mustlen){
+		j.send = j.eol ? j.eol : j.starts + strlen(j.starts);
+		if(_utffind(j.starts, j.send, progp->must, progp->mustlen) == 0)
+			rv = 0;
+		else if(progp->mustprefix)
+			j.starttype = RUNE;
+	}
+
+	/*
+	 *  the lazy DFA tells whether there is a match;
+	 *  the NFA is run to find the subexpressions
+	 */
+	if(rv < 0)
+		rv = _regdfaexec(progp, bol, &j);
+	if(rv == 0 && mp)
+		for(i=0; i<ms; i++) {
+			mp[i].s.sp = 0;
+			mp[i].e.ep = 0;
+		}
+	if(rv == 0 || (rv > 0 && (mp == 0 || ms <= 0)))
+		return rv;
+
 	rv = regexec1(progp, bol, mp, ms, &j);
 	if(rv >= 0)
 		return rv;
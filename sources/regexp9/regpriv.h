@@ -5,6 +5,7 @@
 
 typedef struct _regexp_class_t	regexp_class_t;
 typedef struct _regexp_instr_t	regexp_instr_t;
+typedef struct _regexp_dfa_t	regexp_dfa_t;
 
 /*
  * Character class, each pair of rune's defines a range
@@ -34,11 +35,18 @@ struct _regexp_instr_t {
 /* max character classes per program */
 #define	NCLASS	16
 
+/* max bytes of the string, every match contains, plus NUL */
+#define	NMUST	32
+
 /*
  * Reprogram definition
  */
 struct _regexp_t {
 	regexp_instr_t	*startinst;	/* start pc */
+	regexp_dfa_t	*dfa;		/* lazy DFA, or 0 */
+	char		must [NMUST];	/* utf string, every match contains */
+	unsigned char	mustlen;
+	unsigned char	mustprefix;	/* every match begins with must */
 	regexp_class_t	class [NCLASS];	/* .data */
 	regexp_instr_t	firstinst [5];	/* .text */
 };
@@ -100,10 +108,42 @@ struct _regexp_ljunk_t
 	unsigned short	startchar;
 	const char*	starts;
 	const char*	eol;
+	const char*	send;	/* end of text for the must search */
 	unsigned short*	rstarts;
 	unsigned short*	reol;
 };
 
+/*
+ *  lazy DFA, placed after the code of the program.
+ *  It is not protected against concurrent use: a program
+ *  must not be shared by tasks. DFASIZE 0 disables the DFA.
+ */
+#ifndef DFASIZE
+#define DFASIZE		2048	/* bytes for the states */
+#endif
+#define DFAMINSTATE	4	/* no DFA, if fewer states fit */
+#define DFAMAXINST	128	/* no DFA for larger programs */
+#define DFAMAXCLASS	32	/* max rune classes */
+#define DFAMAXFLUSH	8	/* run the NFA after so many flushes */
+
+struct _regexp_dfa_t
+{
+	int		busy;		/* in use (reentry): run the NFA */
+	int		nclass;		/* number of rune classes */
+	int		nwords;		/* words of instruction set */
+	int		statesize;	/* bytes per state */
+	int		nstate;		/* max states */
+	int		used;		/* states built */
+	unsigned long	nflush;		/* times all states were dropped */
+	char		*states;
+	unsigned char	cmap[128];	/* class of ASCII rune */
+	unsigned short	bound[DFAMAXCLASS];	/* first rune of next class */
+};
+
+extern int		_regdfasize(regexp_t*, int);
+extern void		_regdfainit(regexp_t*, int, void*, int);
+extern int		_regdfaexec(regexp_t*, const char*, regexp_ljunk_t*);
+
 extern regexp_list_t*	_renewthread(regexp_list_t*, regexp_instr_t*, int, regexp_matchlist_t*);
 extern void		_renewmatch(regexp_match_t*, int, regexp_matchlist_t*);
 extern regexp_list_t*	_renewemptythread(regexp_list_t*, regexp_instr_t*, int, const char*);
@@ -111,4 +151,5 @@ extern regexp_list_t*	_rrenewemptythread(regexp_list_t*, regexp_instr_t*, int, u
 
 int _chartorune(unsigned short*, const char*);
 char *_utfrune(const char*, unsigned short);
+char *_utffind(const char*, const char*, const char*, int);
 unsigned short *_runestrchr(const unsigned short*, unsigned short);
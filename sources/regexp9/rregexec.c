@@ -50,7 +50,7 @@ rregexec1(regexp_t *progp,	/* program to run */
 				s = p;
 				break;
 			case BOL:
-				if(s == bol)
+				if(s == bol || *(s-1) == '\n')
 					break;
 				p = _runestrchr(s, '\n');
 				if(p == 0 || s == j->reol)
@@ -124,7 +124,7 @@ rregexec1(regexp_t *progp,	/* program to run */
 					break;
 				case OR:
 					/* evaluate right choice later */
-					if(_renewthread(tlp, inst->u1.right, ms, &tlp->se) == tle)
+					if(_renewthread(tlp, inst->u1.right, ms, &tlp->se) >= tle)
 						return -1;
 					/* efficiency: advance and re-evaluate */
 					continue;
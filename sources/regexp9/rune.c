@@ -100,3 +100,21 @@ _utfrune(const char *s, unsigned short c)
 	}
 	return 0;
 }
+
+/*
+ * Find the utf string of n bytes between s and e:
+ * memchr compares a word at a time.
+ */
+char*
+_utffind(const char *s, const char *e, const char *str, int n)
+{
+	while(e - s >= n) {
+		s = memchr(s, (unsigned char) str[0], e - s - n + 1);
+		if(s == 0)
+			return 0;
+		if(memcmp(s + 1, str + 1, n - 1) == 0)
+			return (char*) s;
+		s++;
+	}
+	return 0;
+}
@@ -1,6 +1,7 @@
 #ifndef TEST_ASN
 #	include <runtime/lib.h>
 #	include <kernel/uos.h>
+#	include <kernel/internal.h>
 #	include <mem/mem.h>
 #else
 #	include <stdlib.h>
@@ -15,6 +16,7 @@
 #	define debug_putchar(s,c) putchar(c)
 #	define debug_printf printf
 	static inline unsigned char flash_fetch (const unsigned char *p) {return *p;}
+#	define task_current ((struct _task_t*) 1)
 #endif /* TEST_ASN */
 #include <snmp/asn.h>
 
@@ -22,6 +24,111 @@ asn_t asn_null = {
 	.type = ASN_NULL
 };
 
+static asn_arena_t *asn_arenas;
+
+void
+asn_arena_init (asn_arena_t *a, mem_pool_t *pool, void *buf, unsigned bytes)
+{
+	a->pool = pool;
+	a->owner = 0;
+	a->base = (unsigned char*) buf;
+	a->ptr = a->base;
+	a->limit = a->base + bytes;
+	a->spilled = 0;
+	a->max_used = 0;
+	a->spills = 0;
+	a->next = asn_arenas;
+	asn_arenas = a;
+}
+
+/*
+ * Start a new scope: the data of the current task
+ * are allocated from the arena.
+ */
+void
+asn_arena_begin (asn_arena_t *a)
+{
+	a->ptr = a->base;
+	a->spilled = 0;
+	a->owner = task_current;
+}
+
+/*
+ * Release all the arena data.
+ */
+void
+asn_arena_end (asn_arena_t *a)
+{
+	if (a->max_used < a->ptr - a->base)
+		a->max_used = a->ptr - a->base;
+	a->owner = 0;
+	a->ptr = a->base;
+}
+
+/*
+ * Find the arena, which contains the block.
+ */
+static asn_arena_t *
+asn_arena_find (void *block)
+{
+	asn_arena_t *a;
+
+	for (a=asn_arenas; a; a=a->next)
+		if ((unsigned char*) block >= a->base &&
+		    (unsigned char*) block < a->limit)
+			return a;
+	return 0;
+}
+
+/*
+ * Allocate memory for ASN.1 data: from the active arena
+ * of the current task, or from the pool.
+ */
+static void *
+asn_alloc (mem_pool_t *pool, unsigned bytes)
+{
+	asn_arena_t *a;
+	void *p;
+
+	for (a=asn_arenas; a; a=a->next) {
+		if (a->pool != pool || a->owner != task_current)
+			continue;
+		bytes = (bytes + __alignof__ (asn_t) - 1) &
+			~(__alignof__ (asn_t) - 1);
+		if (bytes <= a->limit - a->ptr) {
+			p = a->ptr;
+			a->ptr += bytes;
+			return p;
+		}
+		++a->spilled;
+		++a->spills;
+		break;
+	}
+	return mem_alloc (pool, bytes);
+}
+
+/*
+ * Free the memory of ASN.1 data. The arena data are released
+ * all at once by asn_arena_end().
+ */
+static void
+asn_dealloc (void *block)
+{
+	if (! asn_arena_find (block))
+		mem_free (block);
+}
+
+/*
+ * Get the memory pool of ASN.1 data.
+ */
+static mem_pool_t *
+asn_pool (void *block)
+{
+	asn_arena_t *a = asn_arena_find (block);
+
+	return a ? a->pool : mem_pool (block);
+}
+
 /*
  * Read length value.
  * Return 1 when ok, or 0 on failure.
@@ -66,7 +173,7 @@ asn_get_int (mem_pool_t *pool, unsigned char *input, unsigned sz)
 	if (sz > 4)
 		return 0;
 
-	b = (asn_t*) mem_alloc (pool, sizeof (asn_t));
+	b = (asn_t*) asn_alloc (pool, sizeof (asn_t));
 	if (! b)
 		return 0;
 	b->type = ASN_INTEGER;
@@ -94,7 +201,7 @@ asn_get_uint (mem_pool_t *pool, unsigned char *input, unsigned sz,
 	if (sz > 4)
 		return 0;
 
-	b = (asn_t*) mem_alloc (pool, sizeof (asn_t));
+	b = (asn_t*) asn_alloc (pool, sizeof (asn_t));
 	if (! b)
 		return 0;
 	b->type = type;
@@ -115,7 +222,7 @@ asn_get_string (mem_pool_t *pool, unsigned char *input, unsigned sz,
 {
 	asn_t *b;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_STRING (sz + 1));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_STRING (sz + 1));
 	if (! b)
 		return 0;
 	b->type = type;
@@ -137,7 +244,7 @@ asn_get_oid (mem_pool_t *pool, unsigned char *input, unsigned sz)
 	asn_t *b;
 	unsigned short *id;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_OID (sz ? (sz+1) : 10));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_OID (sz ? (sz+1) : 10));
 	if (! b)
 		return 0;
 	b->type = ASN_OID;
@@ -156,7 +263,7 @@ asn_get_oid (mem_pool_t *pool, unsigned char *input, unsigned sz)
 		*id = 0;
 		while (*input & 0x80) {
 			if (sz-- <= 0) {
-				mem_free (b);
+				asn_dealloc (b);
 				return 0;
 			}
 			*id = (*id | (*input++ & 0x7f)) << 7;
@@ -170,27 +277,36 @@ static asn_t *
 asn_get_sequence (mem_pool_t *pool, unsigned char *input, unsigned sz, small_uint_t type)
 {
 	asn_t *b;
-	unsigned nelem = 5;
+	unsigned char *p;
+	unsigned nelem, n, len;
+
+	/* Count the elements, to allocate the sequence at once. */
+	p = input;
+	n = sz;
+	for (nelem=0; n>0; ++nelem) {
+		if (n < 2)
+			return 0;
+		++p;
+		--n;
+		if (! asn_get_length (&p, &n, &len) || len > n)
+			return 0;
+		p += len;
+		n -= len;
+	}
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_SEQUENCE (nelem));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_SEQUENCE (nelem ? nelem : 1));
 	if (! b)
 		return 0;
 	b->type = type;
 
 	for (b->seq.count=0; sz>0; ++b->seq.count) {
-		if (b->seq.count >= nelem) {
-			nelem += 10;
-			b = (asn_t*) mem_realloc (b, SIZEOF_SEQUENCE (nelem));
-			if (! b)
-				return 0;
-		}
 		b->seq.arr[b->seq.count] = asn_parse (pool, &input, &sz);
 		if (! b->seq.arr[b->seq.count]) {
 			unsigned i;
 
 			for (i=0; i<b->seq.count; ++i)
 				asn_free (b->seq.arr[i]);
-			mem_free (b);
+			asn_dealloc (b);
 			return 0;
 		}
 	}
@@ -247,7 +363,7 @@ asn_parse (mem_pool_t *pool, unsigned char **input, unsigned *insz)
 	case ASN_NOSUCHOBJECT:
 	case ASN_NOSUCHINSTANCE:
 	case ASN_ENDOFMIBVIEW:
-		b = (asn_t*) mem_alloc (pool, sizeof (asn_t));
+		b = (asn_t*) asn_alloc (pool, sizeof (asn_t));
 		if (b)
 			b->type = type;
 		break;
@@ -289,13 +405,21 @@ asn_free (asn_t *b)
 {
 	unsigned i;
 
+	asn_arena_t *a;
+
 	if (! b || b == &asn_null)
 		return;
+
+	/* When nothing was spilled into the pool, the arena data
+	 * refer only to the arena data: they are released at once. */
+	a = asn_arena_find (b);
+	if (a && ! a->spilled)
+		return;
 	if (b->type & ASN_CONSTRUCTED) {
 		for (i = 0; i < b->seq.count; ++i)
 			asn_free (b->seq.arr[i]);
 	}
-	mem_free (b);
+	asn_dealloc (b);
 }
 
 static unsigned char *
@@ -484,12 +608,33 @@ asn_put_oid (oid_t *v, unsigned char *p, unsigned sz)
 	return p;
 }
 
+/*
+ * Put the type and length of constructed data, which are
+ * already placed after p. Returns 0 on buffer overflow.
+ */
+unsigned char *
+asn_encode_header (small_uint_t type, unsigned len, unsigned char *p,
+	unsigned sz)
+{
+	unsigned char *op;
+
+	p = asn_put_length (len, op = p, sz);
+	if (! p)
+		return 0;
+
+	sz -= (op - p);
+	if (sz < 1)
+		return 0;
+	*--p = type;
+	return p;
+}
+
 static unsigned char *
 asn_put_sequence (sequence_t *seq, unsigned char *p, unsigned sz,
 	small_uint_t type)
 {
 	unsigned char *op, *bp;
-	unsigned i, len;
+	unsigned i;
 
 	bp = p;
 	for (i=seq->count; i-->0; ) {
@@ -498,17 +643,7 @@ asn_put_sequence (sequence_t *seq, unsigned char *p, unsigned sz,
 			return 0;
 		sz -= (op - p);
 	}
-	len = bp - p;
-
-	p = asn_put_length (len, op = p, sz);
-	if (! p)
-		return 0;
-
-	sz -= (op - p);
-	if (sz < 1)
-		return 0;
-	*--p = type;
-	return p;
+	return asn_encode_header (type, bp - p, p, sz);
 }
 
 /*
@@ -560,6 +695,29 @@ asn_encode (asn_t *b, unsigned char *p, unsigned sz)
 	return p;
 }
 
+/*
+ * Make a binary representation of the variable binding,
+ * without building a sequence of name and value.
+ * Like asn_encode(), fills the buffer from end to beginning.
+ */
+unsigned char *
+asn_encode_pair (asn_t *name, asn_t *val, unsigned char *p, unsigned sz)
+{
+	unsigned char *op, *bp;
+
+	bp = p;
+	p = asn_encode (val, op = p, sz);
+	if (! p)
+		return 0;
+	sz -= (op - p);
+
+	p = asn_encode (name, op = p, sz);
+	if (! p)
+		return 0;
+	sz -= (op - p);
+	return asn_encode_header (ASN_SEQUENCE, bp - p, p, sz);
+}
+
 /*
  * Make an object identifier from the string.
  * Return 0 on failure.
@@ -571,7 +729,7 @@ asn_make_oid (mem_pool_t *pool, const char *str)
 	char c;
 	unsigned val;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_OID((strlen_flash (str) + 1) / 2));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_OID((strlen_flash (str) + 1) / 2));
 	if (! b)
 		return 0;
 	b->type = ASN_OID;
@@ -602,7 +760,7 @@ asn_make_stringn (mem_pool_t *pool, const unsigned char *str, unsigned len)
 {
 	asn_t *b;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_STRING (len + 1));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_STRING (len + 1));
 	if (! b)
 		return 0;
 	b->type = ASN_STRING;
@@ -625,7 +783,7 @@ asn_make_string_flash (mem_pool_t *pool, const char *str)
 	unsigned char len = strlen_flash (str);
 	asn_t *b;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_STRING (len + 1));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_STRING (len + 1));
 	if (! b)
 		return 0;
 	b->type = ASN_STRING;
@@ -646,7 +804,7 @@ asn_make_int (mem_pool_t *pool, unsigned long val, small_uint_t type)
 {
 	asn_t *b;
 
-	b = (asn_t*) mem_alloc (pool, sizeof (asn_t));
+	b = (asn_t*) asn_alloc (pool, sizeof (asn_t));
 	if (! b)
 		return 0;
 	b->type = type;
@@ -659,7 +817,7 @@ asn_make_seq (mem_pool_t *pool, unsigned size, small_uint_t type)
 {
 	asn_t *b;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_SEQUENCE (size));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_SEQUENCE (size));
 	if (! b)
 		return 0;
 	b->type = type;
@@ -676,7 +834,7 @@ asn_make_oidn (mem_pool_t *pool, unsigned enterprise,
 	asn_t *b;
 	unsigned char i;
 
-	b = (asn_t*) mem_alloc (pool, SIZEOF_OID (len + cnt + 1));
+	b = (asn_t*) asn_alloc (pool, SIZEOF_OID (len + cnt + 1));
 	if (! b)
 		return 0;
 	b->type = ASN_OID;
@@ -708,7 +866,7 @@ asn_copy (asn_t *s)
 
 	if (! s)
 		return 0;
-	pool = mem_pool (s);
+	pool = asn_pool (s);
 
 	switch (s->type) {
 	case ASN_NULL:
@@ -722,7 +880,7 @@ asn_copy (asn_t *s)
 	case ASN_GAUGE:
 	case ASN_TIME_TICKS:
 	case ASN_IP_ADDRESS:
-		b = (asn_t*) mem_alloc (pool, sizeof (asn_t));
+		b = (asn_t*) asn_alloc (pool, sizeof (asn_t));
 		if (! b)
 			return 0;
 		*b = *s;
@@ -730,7 +888,7 @@ asn_copy (asn_t *s)
 
 	case ASN_STRING:
 	case ASN_OPAQUE:
-		b = (asn_t*) mem_alloc (pool,
+		b = (asn_t*) asn_alloc (pool,
 			SIZEOF_STRING (s->string.len + 1));
 		if (! b)
 			return 0;
@@ -738,7 +896,7 @@ asn_copy (asn_t *s)
 		break;
 
 	case ASN_OID:
-		b = (asn_t*) mem_alloc (pool, SIZEOF_OID (s->oid.len));
+		b = (asn_t*) asn_alloc (pool, SIZEOF_OID (s->oid.len));
 		if (! b)
 			return 0;
 		memcpy (b, s, SIZEOF_OID (s->oid.len));
@@ -747,7 +905,7 @@ asn_copy (asn_t *s)
 	default:
 		if (! (s->type & ASN_CONSTRUCTED))
 			return 0;
-		b = (asn_t*) mem_alloc (pool, SIZEOF_SEQUENCE (s->seq.count));
+		b = (asn_t*) asn_alloc (pool, SIZEOF_SEQUENCE (s->seq.count));
 		if (! b)
 			return 0;
 		*b = *s;
@@ -756,7 +914,7 @@ asn_copy (asn_t *s)
 			if (! e) {
 				for (--i; i>=0; --i)
 					asn_free (b->seq.arr[i]);
-				mem_free (b);
+				asn_dealloc (b);
 				return 0;
 			}
 			b->seq.arr[i] = e;
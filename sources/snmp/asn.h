@@ -79,9 +79,36 @@ union _asn_t {
 #define ASN_ENDOFMIBVIEW	0x82
 
 struct _mem_pool_t;
+struct _task_t;
 
 extern asn_t asn_null;
 
+/*
+ * Bump arena for ASN.1 data of one request.
+ * Between asn_arena_begin() and asn_arena_end(), all ASN.1 allocations
+ * of the owner task from the parent pool are served by the arena.
+ * Other tasks use the pool as usual. When the arena is exhausted,
+ * the data are allocated from the pool. asn_arena_end() releases
+ * all the arena data in one step; asn_free() is needed only
+ * when some data were spilled into the pool.
+ */
+typedef struct _asn_arena_t {
+	struct _asn_arena_t *next;	/* list of all arenas */
+	struct _mem_pool_t *pool;	/* parent memory pool */
+	struct _task_t *owner;		/* task, using the arena */
+	unsigned char *base;		/* arena memory */
+	unsigned char *ptr;		/* first free byte */
+	unsigned char *limit;		/* end of arena */
+	unsigned spilled;		/* allocations from pool in this scope */
+	unsigned max_used;		/* statistics */
+	unsigned long spills;
+} asn_arena_t;
+
+void asn_arena_init (asn_arena_t *a, struct _mem_pool_t *pool,
+	void *buf, unsigned bytes);
+void asn_arena_begin (asn_arena_t *a);
+void asn_arena_end (asn_arena_t *a);
+
 asn_t *asn_parse (struct _mem_pool_t *pool, unsigned char **input,
 	unsigned *sz);
 
@@ -108,6 +135,10 @@ asn_t *asn_make_oidn (struct _mem_pool_t *pool, unsigned enterprise,
 	const char *data, unsigned char len, unsigned char cnt, ...);
 
 unsigned char *asn_encode (asn_t*, unsigned char*, unsigned);
+unsigned char *asn_encode_pair (asn_t *name, asn_t *val,
+	unsigned char *p, unsigned sz);
+unsigned char *asn_encode_header (small_uint_t type, unsigned len,
+	unsigned char *p, unsigned sz);
 void asn_free (asn_t*);
 
 void asn_print (asn_t*, unsigned);
@@ -167,14 +167,33 @@ find_netif_by_addr (ip_t *ip, unsigned long addr)
  * Store the found IP address into `addr'.
  */
 static route_t *
-find_first_netif_by_addr (ip_t *ip, unsigned long *addr)
+find_first_netif_by_addr (snmp_t *snmp, unsigned long *addr)
 {
 	route_t *u, *found;
 	unsigned long found_addr, a;
+	unsigned count;
+	snmp_row_t *row;
+
+	/* Collect the rows for the walk to follow. */
+	count = 0;
+	for (u=snmp->ip->route; u; u=u->next)
+		if (u->netif && ! u->gateway[0])
+			++count;
+	if (snmp_rows_begin (snmp, SNMP_ROWS_IP_ADDR, count)) {
+		for (u=snmp->ip->route; u; u=u->next)
+			if (u->netif && ! u->gateway[0])
+				snmp_rows_add (snmp, u, LONG (u->ipaddr), 0);
+		snmp_rows_sort (snmp);
+	}
+	row = snmp_rows_first (snmp, SNMP_ROWS_IP_ADDR);
+	if (row) {
+		*addr = row->index1;
+		return row->row;
+	}
 
 	found = 0;
 	found_addr = 0;
-	for (u=ip->route; u; u=u->next) {
+	for (u=snmp->ip->route; u; u=u->next) {
 		if (! u->netif || u->gateway[0])
 			continue;
 
@@ -195,14 +214,25 @@ find_first_netif_by_addr (ip_t *ip, unsigned long *addr)
  * Store the found IP address into `addr'.
  */
 static route_t *
-find_next_netif_by_addr (ip_t *ip, unsigned long *addr)
+find_next_netif_by_addr (snmp_t *snmp, unsigned long *addr)
 {
 	route_t *u, *found;
 	unsigned long found_addr, a;
+	snmp_row_t *row;
+
+	row = snmp_rows_next (snmp, SNMP_ROWS_IP_ADDR, *addr, 0);
+	if (row) {
+		u = row->row;
+		if (u->netif && ! u->gateway[0] &&
+		    LONG (u->ipaddr) == row->index1) {
+			*addr = row->index1;
+			return u;
+		}
+	}
 
 	found = 0;
 	found_addr = 0;
-	for (u=ip->route; u; u=u->next) {
+	for (u=snmp->ip->route; u; u=u->next) {
 		if (! u->netif || u->gateway[0])
 			continue;
 
@@ -261,8 +291,8 @@ asn_t *snmp_next_ipAdEntAddr (snmp_t *snmp, bool_t nextflag, unsigned long *addr
 {
 	route_t *u;
 
-	u = nextflag ? find_next_netif_by_addr (snmp->ip, addr) :
-		find_first_netif_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_netif_by_addr (snmp, addr) :
+		find_first_netif_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, *addr, ASN_IP_ADDRESS);
@@ -283,8 +313,8 @@ asn_t *snmp_next_ipAdEntIfIndex (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_netif_by_addr (snmp->ip, addr) :
-		find_first_netif_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_netif_by_addr (snmp, addr) :
+		find_first_netif_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, get_netif_index (snmp->ip, u),
@@ -306,8 +336,8 @@ asn_t *snmp_next_ipAdEntNetMask (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_netif_by_addr (snmp->ip, addr) :
-		find_first_netif_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_netif_by_addr (snmp, addr) :
+		find_first_netif_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, get_route_mask (snmp->ip, u),
@@ -326,8 +356,8 @@ asn_t *snmp_next_ipAdEntBcastAddr (snmp_t *snmp, bool_t nextflag, unsigned long
 {
 	route_t *u;
 
-	u = nextflag ? find_next_netif_by_addr (snmp->ip, addr) :
-		find_first_netif_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_netif_by_addr (snmp, addr) :
+		find_first_netif_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 1, ASN_INTEGER);
@@ -344,8 +374,8 @@ asn_t *snmp_next_ipAdEntReasmMaxSize (snmp_t *snmp, bool_t nextflag, unsigned lo
 {
 	route_t *u;
 
-	u = nextflag ? find_next_netif_by_addr (snmp->ip, addr) :
-		find_first_netif_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_netif_by_addr (snmp, addr) :
+		find_first_netif_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, IP_MAXPACKET, ASN_INTEGER);
@@ -371,14 +401,33 @@ find_route_by_addr (ip_t *ip, unsigned long addr)
  * Store the found IP address into `addr'.
  */
 static route_t *
-find_first_route_by_addr (ip_t *ip, unsigned long *addr)
+find_first_route_by_addr (snmp_t *snmp, unsigned long *addr)
 {
 	route_t *u, *found;
 	unsigned long found_addr, a;
+	unsigned count;
+	snmp_row_t *row;
+
+	/* Collect the rows for the walk to follow. */
+	count = 0;
+	for (u=snmp->ip->route; u; u=u->next)
+		if (u->netif && u->gateway[0])
+			++count;
+	if (snmp_rows_begin (snmp, SNMP_ROWS_IP_ROUTE, count)) {
+		for (u=snmp->ip->route; u; u=u->next)
+			if (u->netif && u->gateway[0])
+				snmp_rows_add (snmp, u, LONG (u->ipaddr), 0);
+		snmp_rows_sort (snmp);
+	}
+	row = snmp_rows_first (snmp, SNMP_ROWS_IP_ROUTE);
+	if (row) {
+		*addr = row->index1;
+		return row->row;
+	}
 
 	found = 0;
 	found_addr = 0;
-	for (u=ip->route; u; u=u->next) {
+	for (u=snmp->ip->route; u; u=u->next) {
 		if (! u->netif || ! u->gateway[0])
 			continue;
 
@@ -399,14 +448,25 @@ find_first_route_by_addr (ip_t *ip, unsigned long *addr)
  * Store the found IP address into `addr'.
  */
 static route_t *
-find_next_route_by_addr (ip_t *ip, unsigned long *addr)
+find_next_route_by_addr (snmp_t *snmp, unsigned long *addr)
 {
 	route_t *u, *found;
 	unsigned long found_addr, a;
+	snmp_row_t *row;
+
+	row = snmp_rows_next (snmp, SNMP_ROWS_IP_ROUTE, *addr, 0);
+	if (row) {
+		u = row->row;
+		if (u->netif && u->gateway[0] &&
+		    LONG (u->ipaddr) == row->index1) {
+			*addr = row->index1;
+			return u;
+		}
+	}
 
 	found = 0;
 	found_addr = 0;
-	for (u=ip->route; u; u=u->next) {
+	for (u=snmp->ip->route; u; u=u->next) {
 		if (! u->netif || ! u->gateway[0])
 			continue;
 
@@ -434,8 +494,8 @@ asn_t *snmp_next_ipRouteDest (snmp_t *snmp, bool_t nextflag, unsigned long *addr
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, *addr, ASN_IP_ADDRESS);
@@ -472,8 +532,8 @@ asn_t *snmp_next_ipRouteMask (snmp_t *snmp, bool_t nextflag, unsigned long *addr
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, get_route_mask (snmp->ip, u),
@@ -516,8 +576,8 @@ asn_t *snmp_next_ipRouteNextHop (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, LONG (u->gateway), ASN_IP_ADDRESS);
@@ -558,8 +618,8 @@ asn_t *snmp_next_ipRouteMetric1 (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -582,8 +642,8 @@ asn_t *snmp_next_ipRouteMetric2 (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -606,8 +666,8 @@ asn_t *snmp_next_ipRouteMetric3 (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -630,8 +690,8 @@ asn_t *snmp_next_ipRouteMetric4 (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -654,8 +714,8 @@ asn_t *snmp_next_ipRouteMetric5 (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -704,8 +764,8 @@ asn_t *snmp_next_ipRouteIfIndex (snmp_t *snmp, bool_t nextflag, unsigned long *a
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, get_netif_index_by_netif (snmp->ip, u->netif),
@@ -729,8 +789,8 @@ asn_t *snmp_next_ipRouteType (snmp_t *snmp, bool_t nextflag, unsigned long *addr
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, SNMP_ROUTE_TYPE_DIRECT, ASN_INTEGER);
@@ -753,8 +813,8 @@ asn_t *snmp_next_ipRouteProto (snmp_t *snmp, bool_t nextflag, unsigned long *add
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, SNMP_ROUTE_PROTO_LOCAL, ASN_INTEGER);
@@ -771,8 +831,8 @@ asn_t *snmp_next_ipRouteAge (snmp_t *snmp, bool_t nextflag, unsigned long *addr,
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_INTEGER);
@@ -795,8 +855,8 @@ asn_t *snmp_next_ipRouteInfo (snmp_t *snmp, bool_t nextflag, unsigned long *addr
 {
 	route_t *u;
 
-	u = nextflag ? find_next_route_by_addr (snmp->ip, addr) :
-		find_first_route_by_addr (snmp->ip, addr);
+	u = nextflag ? find_next_route_by_addr (snmp, addr) :
+		find_first_route_by_addr (snmp, addr);
 	if (! u)
 		return 0;
 	return asn_make_oid (snmp->pool, ".0.0");
@@ -830,15 +890,38 @@ find_arp_by_addr (ip_t *ip, unsigned nif, unsigned long addr)
  * Store the found IP address into `addr'.
  */
 static arp_entry_t *
-find_first_arp_by_addr (ip_t *ip, unsigned *nif, unsigned long *addr)
+find_first_arp_by_addr (snmp_t *snmp, unsigned *nif, unsigned long *addr)
 {
+	ip_t *ip = snmp->ip;
 	arp_entry_t *e, *found;
 	unsigned long found_addr, a;
-	unsigned found_nif, n;
+	unsigned found_nif, n, count;
 	arp_t *arp = ip->arp;
+	snmp_row_t *row;
 
 	if (! arp)
 		return 0;
+
+	/* Collect the rows for the walk to follow. */
+	count = 0;
+	for (e=arp->table; e<arp->table+arp->size; ++e)
+		if (e->netif)
+			++count;
+	if (snmp_rows_begin (snmp, SNMP_ROWS_IP_NET_TO_MEDIA, count)) {
+		for (e=arp->table; e<arp->table+arp->size; ++e)
+			if (e->netif)
+				snmp_rows_add (snmp, e,
+					get_netif_index_by_netif (ip, e->netif),
+					LONG (e->ipaddr));
+		snmp_rows_sort (snmp);
+	}
+	row = snmp_rows_first (snmp, SNMP_ROWS_IP_NET_TO_MEDIA);
+	if (row) {
+		*nif = row->index1;
+		*addr = row->index2;
+		return row->row;
+	}
+
 	found = 0;
 	found_addr = 0;
 	found_nif = 0;
@@ -867,15 +950,29 @@ find_first_arp_by_addr (ip_t *ip, unsigned *nif, unsigned long *addr)
  * Store the found IP address into `addr'.
  */
 static arp_entry_t *
-find_next_arp_by_addr (ip_t *ip, unsigned *nif, unsigned long *addr)
+find_next_arp_by_addr (snmp_t *snmp, unsigned *nif, unsigned long *addr)
 {
+	ip_t *ip = snmp->ip;
 	arp_entry_t *e, *found;
 	unsigned long found_addr, a;
 	unsigned found_nif, n;
 	arp_t *arp = ip->arp;
+	snmp_row_t *row;
 
 	if (! arp)
 		return 0;
+
+	row = snmp_rows_next (snmp, SNMP_ROWS_IP_NET_TO_MEDIA, *nif, *addr);
+	if (row) {
+		e = row->row;
+		if (e->netif && LONG (e->ipaddr) == row->index2 &&
+		    get_netif_index_by_netif (ip, e->netif) == row->index1) {
+			*nif = row->index1;
+			*addr = row->index2;
+			return e;
+		}
+	}
+
 	found = 0;
 	found_addr = 0;
 	found_nif = 0;
@@ -919,8 +1016,8 @@ asn_t *snmp_next_ipNetToMediaIfIndex (snmp_t *snmp, bool_t nextflag, unsigned *n
 {
 	arp_entry_t *e;
 
-	e = nextflag ? find_next_arp_by_addr (snmp->ip, nif, addr) :
-		find_first_arp_by_addr (snmp->ip, nif, addr);
+	e = nextflag ? find_next_arp_by_addr (snmp, nif, addr) :
+		find_first_arp_by_addr (snmp, nif, addr);
 	if (! e)
 		return 0;
 	return asn_make_int (snmp->pool, get_netif_index_by_netif (snmp->ip, e->netif),
@@ -944,8 +1041,8 @@ asn_t *snmp_next_ipNetToMediaNetAddress (snmp_t *snmp, bool_t nextflag, unsigned
 {
 	arp_entry_t *e;
 
-	e = nextflag ? find_next_arp_by_addr (snmp->ip, nif, addr) :
-		find_first_arp_by_addr (snmp->ip, nif, addr);
+	e = nextflag ? find_next_arp_by_addr (snmp, nif, addr) :
+		find_first_arp_by_addr (snmp, nif, addr);
 	if (! e)
 		return 0;
 	return asn_make_int (snmp->pool, *addr, ASN_IP_ADDRESS);
@@ -976,8 +1073,8 @@ asn_t *snmp_next_ipNetToMediaType (snmp_t *snmp, bool_t nextflag, unsigned *nif,
 {
 	arp_entry_t *e;
 
-	e = nextflag ? find_next_arp_by_addr (snmp->ip, nif, addr) :
-		find_first_arp_by_addr (snmp->ip, nif, addr);
+	e = nextflag ? find_next_arp_by_addr (snmp, nif, addr) :
+		find_first_arp_by_addr (snmp, nif, addr);
 	if (! e)
 		return 0;
 	return asn_make_int (snmp->pool, SNMP_NTM_TYPE_DYNAMIC, ASN_INTEGER);
@@ -1003,8 +1100,8 @@ asn_t *snmp_next_ipNetToMediaPhysAddress (snmp_t *snmp, bool_t nextflag, unsigne
 {
 	arp_entry_t *e;
 
-	e = nextflag ? find_next_arp_by_addr (snmp->ip, nif, addr) :
-		find_first_arp_by_addr (snmp->ip, nif, addr);
+	e = nextflag ? find_next_arp_by_addr (snmp, nif, addr) :
+		find_first_arp_by_addr (snmp, nif, addr);
 	if (! e)
 		return 0;
 	return asn_make_stringn (snmp->pool, e->ethaddr, 6);
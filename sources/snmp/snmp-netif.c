@@ -43,6 +43,42 @@ find_netif (route_t *tab, unsigned nif)
 	return 0;
 }
 
+/*
+ * Find the network interface for GETNEXT: the first one,
+ * or the one after `*nif'. Store its number into `nif'.
+ * The walk goes by the rows index, collected at the first one.
+ */
+static netif_t *
+next_netif (snmp_t *snmp, bool_t nextflag, unsigned *nif)
+{
+	route_t *r;
+	snmp_row_t *row;
+	unsigned count;
+
+	if (nextflag) {
+		row = snmp_rows_next (snmp, SNMP_ROWS_IF, *nif, 0);
+		++*nif;
+		if (row && row->index1 == *nif) {
+			r = row->row;
+			if (r->netif && ! r->gateway[0])
+				return r->netif;
+		}
+		return find_netif (snmp->ip->route, *nif);
+	}
+	count = 0;
+	for (r=snmp->ip->route; r; r=r->next)
+		if (r->netif && ! r->gateway[0])
+			++count;
+	if (snmp_rows_begin (snmp, SNMP_ROWS_IF, count)) {
+		count = 0;
+		for (r=snmp->ip->route; r; r=r->next)
+			if (r->netif && ! r->gateway[0])
+				snmp_rows_add (snmp, r, ++count, 0);
+	}
+	*nif = 1;
+	return find_netif (snmp->ip->route, 1);
+}
+
 asn_t *
 snmp_get_ifIndex (snmp_t *snmp, unsigned nif, ...)
 {
@@ -54,11 +90,7 @@ snmp_get_ifIndex (snmp_t *snmp, unsigned nif, ...)
 asn_t *
 snmp_next_ifIndex (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	if (! find_netif (snmp->ip->route, *nif))
+	if (! next_netif (snmp, nextflag, nif))
 		return 0;
 	return asn_make_int (snmp->pool, *nif, ASN_INTEGER);
 }
@@ -77,11 +109,7 @@ snmp_next_ifDescr (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_string_flash (snmp->pool, u->name);
@@ -101,11 +129,7 @@ snmp_next_ifType (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->type, ASN_INTEGER);
@@ -122,11 +146,7 @@ snmp_get_ifSpecific (snmp_t *snmp, unsigned nif, ...)
 asn_t *
 snmp_next_ifSpecific (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	if (! find_netif (snmp->ip->route, *nif))
+	if (! next_netif (snmp, nextflag, nif))
 		return 0;
 	return asn_make_oid (snmp->pool, ".0.0");
 }
@@ -148,11 +168,7 @@ snmp_next_ifPhysAddress (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	if (! u->arp)
@@ -174,11 +190,7 @@ snmp_next_ifSpeed (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->bps, ASN_GAUGE);
@@ -195,11 +207,7 @@ snmp_get_ifLastChange (snmp_t *snmp, unsigned nif, ...)
 asn_t *
 snmp_next_ifLastChange (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	if (! find_netif (snmp->ip->route, *nif))
+	if (! next_netif (snmp, nextflag, nif))
 		return 0;
 	return asn_make_int (snmp->pool, 0, ASN_TIME_TICKS);
 }
@@ -218,11 +226,7 @@ snmp_next_ifMtu (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->mtu, ASN_INTEGER);
@@ -239,11 +243,7 @@ snmp_get_ifAdminStatus (snmp_t *snmp, unsigned nif, ...)
 asn_t *
 snmp_next_ifAdminStatus (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	if (! find_netif (snmp->ip->route, *nif))
+	if (! next_netif (snmp, nextflag, nif))
 		return 0;
 	return asn_make_int (snmp->pool, SNMP_IFS_UP, ASN_INTEGER);
 }
@@ -259,11 +259,7 @@ snmp_get_ifOperStatus (snmp_t *snmp, unsigned nif, ...)
 asn_t *
 snmp_next_ifOperStatus (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	if (! find_netif (snmp->ip->route, *nif))
+	if (! next_netif (snmp, nextflag, nif))
 		return 0;
 	return asn_make_int (snmp->pool, SNMP_IFS_UP, ASN_INTEGER);
 }
@@ -282,11 +278,7 @@ snmp_next_ifInOctets (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_bytes, ASN_COUNTER);
@@ -306,11 +298,7 @@ snmp_next_ifInUcastPkts (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_packets - u->in_mcast_pkts, ASN_COUNTER);
@@ -330,11 +318,7 @@ snmp_next_ifInNUcastPkts (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_mcast_pkts, ASN_COUNTER);
@@ -354,11 +338,7 @@ snmp_next_ifInDiscards (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_discards, ASN_COUNTER);
@@ -378,11 +358,7 @@ snmp_next_ifInErrors (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_errors, ASN_COUNTER);
@@ -402,11 +378,7 @@ snmp_next_ifInUnknownProtos (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->in_unknown_protos, ASN_COUNTER);
@@ -426,11 +398,7 @@ snmp_next_ifOutOctets (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_bytes, ASN_COUNTER);
@@ -450,11 +418,7 @@ snmp_next_ifOutUcastPkts (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_packets - u->out_mcast_pkts, ASN_COUNTER);
@@ -474,11 +438,7 @@ snmp_next_ifOutNUcastPkts (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_mcast_pkts, ASN_COUNTER);
@@ -498,11 +458,7 @@ snmp_next_ifOutDiscards (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_discards, ASN_COUNTER);
@@ -522,11 +478,7 @@ snmp_next_ifOutErrors (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_errors, ASN_COUNTER);
@@ -546,11 +498,7 @@ snmp_next_ifOutQLen (snmp_t *snmp, bool_t nextflag, unsigned *nif, ...)
 {
 	netif_t *u;
 
-	if (nextflag)
-		++*nif;
-	else
-		*nif = 1;
-	u = find_netif (snmp->ip->route, *nif);
+	u = next_netif (snmp, nextflag, nif);
 	if (! u)
 		return 0;
 	return asn_make_int (snmp->pool, u->out_qlen, ASN_GAUGE);
@@ -51,11 +51,78 @@ greater:
 }
 
 /*
- * Find the name in the variables table, which
- * has the same name or immediately preceeding name.
+ * Node of the OID trie, compiled from the variables table.
+ * Node 0 is the root. Children of a node are sorted by id.
+ */
+typedef struct _snmp_node_t {
+	unsigned short id;		/* component of OID */
+	unsigned short child;		/* first child, 0 if none */
+	unsigned short sibling;		/* next sibling, 0 if none */
+	unsigned short var;		/* variable index + 1, or 0 */
+	unsigned short last;		/* largest variable index + 1 in subtree */
+} snmp_node_t;
+
+/*
+ * Build the OID trie from the (sorted) variables table.
+ * On failure, variables are found by binary search.
+ */
+static void
+build_trie (snmp_t *snmp)
+{
+	snmp_node_t *trie, *node;
+	unsigned nnodes, max_nodes, k, n, c;
+	unsigned short *prev;
+	const char *id;
+	small_uint_t idlen;
+
+	snmp->trie = 0;
+	max_nodes = 1;
+	for (n=0; n<snmp->tab_len; ++n)
+		max_nodes += FETCH_BYTE (&snmp->tab[n].idlen);
+	if (max_nodes > 0xffff)
+		return;
+	trie = mem_alloc (snmp->pool, max_nodes * sizeof (snmp_node_t));
+	if (! trie)
+		return;
+
+	memset (trie, 0, sizeof (snmp_node_t));
+	nnodes = 1;
+	for (n=0; n<snmp->tab_len; ++n) {
+		id = (const char*) FETCH_PTR (&snmp->tab[n].id);
+		idlen = FETCH_BYTE (&snmp->tab[n].idlen);
+		node = trie;
+		for (k=0; k<idlen; ++k) {
+			/* Value 255 designates the enterprise ID. */
+			c = FETCH_BYTE (id + k);
+			if (c == 255)
+				c = snmp->enterprise;
+
+			/* Find the child, or insert it in sorted order. */
+			prev = &node->child;
+			while (*prev && trie[*prev].id < c)
+				prev = &trie[*prev].sibling;
+			if (! *prev || trie[*prev].id != c) {
+				trie[nnodes].id = c;
+				trie[nnodes].child = 0;
+				trie[nnodes].sibling = *prev;
+				trie[nnodes].var = 0;
+				*prev = nnodes++;
+			}
+			node->last = n + 1;
+			node = &trie[*prev];
+		}
+		node->var = n + 1;
+		node->last = n + 1;
+	}
+	mem_truncate (trie, nnodes * sizeof (snmp_node_t));
+	snmp->trie = trie;
+}
+
+/*
+ * Find the name in the variables table by binary search.
  */
 const static snmp_var_t *
-find_var (snmp_t *snmp, const asn_t *name, bool_t *exact)
+search_var (snmp_t *snmp, const asn_t *name, bool_t *exact)
 {
 	const snmp_var_t *base, *vp;
 	unsigned lim;
@@ -107,6 +174,71 @@ found:
 	}
 }
 
+/*
+ * Find the name in the OID trie: descend by the components of name,
+ * remembering the last variable which precedes it.
+ * Every component is looked up once, with no OID comparisons.
+ */
+const static snmp_var_t *
+trie_var (snmp_t *snmp, const asn_t *name, bool_t *exact)
+{
+	const snmp_node_t *trie = snmp->trie, *node = trie;
+	unsigned k, i, c, best = 0;
+
+	*exact = 0;
+	for (k=0; k<name->oid.len; ++k) {
+		c = name->oid.id[k];
+
+		/* Subtrees of smaller siblings are entirely less than name. */
+		for (i=node->child; i && trie[i].id < c; i=trie[i].sibling)
+			best = trie[i].last;
+		if (! i || trie[i].id != c)
+			break;
+		node = &trie[i];
+		if (node->var) {
+			/* Variable is a prefix of name, or the name itself. */
+			best = node->var;
+			if (k == name->oid.len - 1)
+				*exact = 1;
+		}
+	}
+	return best ? snmp->tab + best - 1 : 0;
+}
+
+/*
+ * Find the name in the variables table, which
+ * has the same name or immediately preceeding name.
+ * The walk by GETNEXT usually asks for the variable, found last time:
+ * check it first.
+ */
+const static snmp_var_t *
+find_var (snmp_t *snmp, const asn_t *name, bool_t *exact)
+{
+	const snmp_var_t *vp;
+	small_int_t cmp;
+
+	if (! snmp->trie)
+		return search_var (snmp, name, exact);
+
+	if (snmp->cursor < snmp->tab_len) {
+		vp = snmp->tab + snmp->cursor;
+		cmp = compare (snmp, name->oid.id, name->oid.len,
+			(const char*) FETCH_PTR (&vp->id), FETCH_BYTE (&vp->idlen));
+		if (cmp == 0) {
+			*exact = 1;
+			return vp;
+		}
+		if (cmp > 0 && (vp+1 == snmp->tab + snmp->tab_len ||
+		    compare (snmp, name->oid.id, name->oid.len,
+		    (const char*) FETCH_PTR (&vp[1].id),
+		    FETCH_BYTE (&vp[1].idlen)) < 0)) {
+			*exact = 0;
+			return vp;
+		}
+	}
+	return trie_var (snmp, name, exact);
+}
+
 /*
  * Perform a GET or SET request on the single variable.
  * Id contains the variable identifier.
@@ -397,7 +529,12 @@ next (snmp_t *snmp, asn_t **name, asn_t **val)
 		}
 		nextflag = i1 = i2 = a1 = a2 = 0;
 	}
-	return (*val ? SNMP_NO_ERROR : SNMP_NO_SUCH_NAME);
+	if (! *val)
+		return SNMP_NO_SUCH_NAME;
+
+	/* Next request of the walk will resume from here. */
+	snmp->cursor = vp - 1 - snmp->tab;
+	return SNMP_NO_ERROR;
 }
 
 static unsigned long
@@ -439,14 +576,14 @@ snmp_auth (snmp_t *snmp, unsigned char *community, bool_t setflag)
  * Return 1 on success, 0 on failure.
  */
 static bool_t
-add_pair (asn_t *outbind, asn_t *name, asn_t *val)
+add_pair (mem_pool_t *pool, asn_t *outbind, asn_t *name, asn_t *val)
 {
 	asn_t *pair;
 
 	if (! name || ! val)
 		return 0;
 
-	pair = asn_make_seq (mem_pool (outbind), 2, ASN_SEQUENCE);
+	pair = asn_make_seq (pool, 2, ASN_SEQUENCE);
 	if (! pair)
 		return 0;
 	pair->seq.count = 2;
@@ -457,8 +594,176 @@ add_pair (asn_t *outbind, asn_t *name, asn_t *val)
 	return 1;
 }
 
-unsigned char *
-snmp_execute (snmp_t *snmp, unsigned char *input, unsigned insz,
+#ifndef SNMP_TREE_RESPONSE
+/*
+ * Value for variables beyond the end of MIB.
+ */
+static asn_t end_of_mib_view = {
+	.type = ASN_ENDOFMIBVIEW
+};
+
+/*
+ * Append the variable binding to the data at *wp.
+ * Return 0 when it does not fit below the limit.
+ */
+static bool_t
+put_pair (unsigned char **wp, unsigned char *limit, asn_t *name, asn_t *val)
+{
+	unsigned char *p;
+
+	/* Encode at the limit, then move into place. */
+	p = asn_encode_pair (name, val, limit, limit - *wp);
+	if (! p)
+		return 0;
+	memmove (*wp, p, limit - p);
+	*wp += limit - p;
+	return 1;
+}
+
+/*
+ * Free the GETBULK cursor names, which are not from the request.
+ */
+static void
+free_cursors (asn_t **cursor, asn_t *inbind, unsigned first)
+{
+	unsigned i;
+
+	if (! cursor)
+		return;
+	for (i=first; i<inbind->seq.count; ++i)
+		if (cursor[i-first] != inbind->seq.arr[i]->seq.arr[0])
+			asn_free (cursor[i-first]);
+	mem_free (cursor);
+}
+
+/*
+ * Process GET, GETNEXT or GETBULK request, and encode the response
+ * without building the tree of variable bindings: every binding is
+ * encoded right after the previous one, and freed. Then the bindings
+ * are moved to the end of the buffer, and the headers are placed before.
+ * GETBULK response is truncated, when the buffer is full (RFC 3416).
+ * On failure, returns 0 and sets the error code and index.
+ */
+static unsigned char *
+get_stream (snmp_t *snmp, asn_t *b, unsigned nonrepeaters,
+	unsigned repetitions, unsigned char *outbuf, unsigned outsz,
+	small_int_t *error_code, unsigned *index)
+{
+	asn_t *pdu = b->seq.arr[2], *inbind = pdu->seq.arr[3];
+	asn_t *pair, *name, *val, **cursor = 0;
+	unsigned char *wp, *limit, *p;
+	unsigned i, r, reserve, len;
+	bool_t v1 = (b->seq.arr[0]->int32.val == SNMP_V1), fit;
+
+	/* Space for headers: three sequences, four integers
+	 * and the community string. */
+	reserve = 3*6 + 4*6 + 6 + b->seq.arr[1]->string.len;
+	*error_code = SNMP_TOO_BIG;
+	if (outsz <= reserve)
+		return 0;
+	limit = outbuf + outsz - reserve;
+	wp = outbuf;
+
+	for (i=0; i<nonrepeaters; ++i) {
+		pair = inbind->seq.arr[i];
+		name = pair->seq.arr[0];
+		if (pdu->type == ASN_GET_REQUEST) {
+			/* Get the variable value. */
+			*error_code = get_set (snmp, name, &val, 0);
+			++snmp->in_total_req_vars;
+			if (*error_code != SNMP_NO_ERROR)
+				goto failed;
+		} else {
+			/* Get the next variable value. */
+			*error_code = next (snmp, &name, &val);
+			++snmp->in_total_req_vars;
+			if (*error_code == SNMP_NO_SUCH_NAME && ! v1)
+				val = &end_of_mib_view;
+			else if (*error_code != SNMP_NO_ERROR)
+				goto failed;
+		}
+		fit = put_pair (&wp, limit, name, val);
+		if (val != &end_of_mib_view)
+			asn_free (val);
+		if (name != pair->seq.arr[0])
+			asn_free (name);
+		if (! fit) {
+			*error_code = SNMP_TOO_BIG;
+			return 0;
+		}
+	}
+	if (pdu->type == ASN_GET_BULK_REQUEST && ! v1 &&
+	    nonrepeaters < inbind->seq.count && repetitions > 0) {
+		/* Repeat variables. Every repetition continues
+		 * from the names, got by the previous one.
+		 * The request is left intact for error replies. */
+		cursor = mem_alloc (snmp->pool, (inbind->seq.count -
+			nonrepeaters) * sizeof (asn_t*));
+		if (! cursor) {
+			*error_code = SNMP_TOO_BIG;
+			return 0;
+		}
+		for (i=nonrepeaters; i<inbind->seq.count; ++i)
+			cursor[i-nonrepeaters] = inbind->seq.arr[i]->seq.arr[0];
+
+		for (r=0; r<repetitions; ++r) {
+			for (i=nonrepeaters; i<inbind->seq.count; ++i) {
+				name = cursor[i-nonrepeaters];
+				*error_code = next (snmp, &name, &val);
+				++snmp->in_total_req_vars;
+				if (*error_code == SNMP_NO_SUCH_NAME)
+					val = &end_of_mib_view;
+				else if (*error_code != SNMP_NO_ERROR)
+					goto failed;
+
+				fit = put_pair (&wp, limit, name, val);
+				if (val != &end_of_mib_view)
+					asn_free (val);
+				if (name != cursor[i-nonrepeaters]) {
+					if (cursor[i-nonrepeaters] !=
+					    inbind->seq.arr[i]->seq.arr[0])
+						asn_free (cursor[i-nonrepeaters]);
+					cursor[i-nonrepeaters] = name;
+				}
+				if (! fit)
+					goto done;
+			}
+		}
+	}
+done:
+	free_cursors (cursor, inbind, nonrepeaters);
+
+	/* Move the bindings to the end of buffer. */
+	len = wp - outbuf;
+	p = outbuf + outsz - len;
+	memmove (p, outbuf, len);
+
+	/* Put the headers before them. */
+	p = asn_encode_header (ASN_SEQUENCE, len, p, p - outbuf);
+	for (i=3; p && i-->0; )
+		p = asn_encode (pdu->seq.arr[i], p, p - outbuf);
+	if (p)
+		p = asn_encode_header (ASN_GET_RESPONSE,
+			outbuf + outsz - p, p, p - outbuf);
+	if (p)
+		p = asn_encode (b->seq.arr[1], p, p - outbuf);
+	if (p)
+		p = asn_encode (b->seq.arr[0], p, p - outbuf);
+	if (p)
+		p = asn_encode_header (ASN_SEQUENCE,
+			outbuf + outsz - p, p, p - outbuf);
+	*error_code = p ? SNMP_NO_ERROR : SNMP_TOO_BIG;
+	return p;
+
+failed:
+	free_cursors (cursor, inbind, nonrepeaters);
+	*index = i;
+	return 0;
+}
+#endif /* SNMP_TREE_RESPONSE */
+
+static unsigned char *
+snmp_process (snmp_t *snmp, unsigned char *input, unsigned insz,
 	unsigned char *outbuf, unsigned outsz)
 {
 	asn_t *b, *pdu, *inbind, *outbind = 0;
@@ -547,6 +852,8 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 		break;
 	case ASN_SET_REQUEST:
 		++snmp->in_set_requests;
+		/* Row indexes may change. */
+		snmp->rows_table = 0;
 		break;
 	default:
 		/*debug_printf ("snmp_execute: bad request type = 0x%02x\n",
@@ -554,9 +861,41 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 		++snmp->in_asn_parse_errs;
 		goto err;
 	}
+	/* Check the correctness of name/value pairs. */
+	for (i=0; i<inbind->seq.count; ++i) {
+		asn_t *pair = inbind->seq.arr[i];
+
+		if (pair->type != ASN_SEQUENCE || pair->seq.count < 2 ||
+		    pair->seq.arr[0]->type != ASN_OID) {
+			/*debug_printf ("snmp_execute: bad name/value pair\n");*/
+			++snmp->in_asn_parse_errs;
+			goto err;
+		}
+	}
+
 	/* Clear error status and index. */
 	pdu->seq.arr[1]->int32.val = 0;
 	pdu->seq.arr[2]->int32.val = 0;
+#ifndef SNMP_TREE_RESPONSE
+	if (pdu->type != ASN_SET_REQUEST) {
+		/* Encode the response directly into the output buffer. */
+		output = get_stream (snmp, b, nonrepeaters, repetitions,
+			outbuf, outsz, &error_code, &i);
+		if (output) {
+			++snmp->out_get_responses;
+			goto ret;
+		}
+		if (error_code != SNMP_TOO_BIG)
+			goto fatal;
+
+		/* Error - package too big. */
+		++snmp->out_too_bigs;
+		pdu->type = ASN_GET_RESPONSE;
+		pdu->seq.arr[1]->int32.val = SNMP_TOO_BIG;
+		output = asn_encode (b, outbuf + outsz, outsz);
+		goto ret;
+	}
+#endif
 	outbind = asn_make_seq (snmp->pool, nonrepeaters +
 		(inbind->seq.count - nonrepeaters) * repetitions, ASN_SEQUENCE);
 	if (! outbind) {
@@ -575,13 +914,6 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 		/*debug_printf ("snmp_execute: processing ");
 		asn_print (pair, 0); debug_putchar (0, '\n');*/
 
-		/* Check the correctness of name/value pair. */
-		if (pair->type != ASN_SEQUENCE || pair->seq.count < 2 ||
-		    name->type != ASN_OID) {
-			/*debug_printf ("snmp_execute: bad name/value pair\n");*/
-			++snmp->in_asn_parse_errs;
-			goto err;
-		}
 		switch (pdu->type) {
 		default:
 			/*debug_printf ("snmp_execute: bad pdu type\n");*/
@@ -595,7 +927,7 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 			if (error_code != SNMP_NO_ERROR)
 				goto fatal;
 			name = asn_copy (name);
-			if (! add_pair (outbind, name, val)) {
+			if (! add_pair (snmp->pool, outbind, name, val)) {
 				error_code = SNMP_GEN_ERR;
 				goto fatal;
 			}
@@ -609,7 +941,7 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 				goto fatal;
 			name = asn_copy (name);
 			val = asn_copy (pair->seq.arr[1]);
-			if (! add_pair (outbind, name, val)) {
+			if (! add_pair (snmp->pool, outbind, name, val)) {
 				error_code = SNMP_GEN_ERR;
 				goto fatal;
 			}
@@ -627,7 +959,7 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 					ASN_ENDOFMIBVIEW);
 			} else if (error_code != SNMP_NO_ERROR)
 				goto fatal;
-			if (! add_pair (outbind, name, val)) {
+			if (! add_pair (snmp->pool, outbind, name, val)) {
 				error_code = SNMP_GEN_ERR;
 				goto fatal;
 			}
@@ -667,7 +999,7 @@ err:            /*debug_printf ("snmp_execute: bad pdu\n");*/
 				} else if (error_code != SNMP_NO_ERROR)
 					goto fatal;
 
-				if (! add_pair (outbind, name, val)) {
+				if (! add_pair (snmp->pool, outbind, name, val)) {
 					error_code = SNMP_GEN_ERR;
 					goto fatal;
 				}
@@ -736,6 +1068,145 @@ fatal:
 	goto ret;
 }
 
+/*
+ * Execute the request and make a response packet.
+ * With the arena, all the ASN.1 data of the request
+ * are released in one step.
+ */
+unsigned char *
+snmp_execute (snmp_t *snmp, unsigned char *input, unsigned insz,
+	unsigned char *outbuf, unsigned outsz)
+{
+	unsigned char *output;
+
+	if (! snmp->arena)
+		return snmp_process (snmp, input, insz, outbuf, outsz);
+
+	asn_arena_begin (snmp->arena);
+	output = snmp_process (snmp, input, insz, outbuf, outsz);
+	asn_arena_end (snmp->arena);
+	return output;
+}
+
+/*
+ * Compare the row with the given index.
+ */
+static int
+compare_row (const snmp_row_t *row, unsigned long index1, unsigned long index2)
+{
+	if (row->index1 != index1)
+		return row->index1 < index1 ? -1 : 1;
+	if (row->index2 != index2)
+		return row->index2 < index2 ? -1 : 1;
+	return 0;
+}
+
+static int
+compare_rows (const void *a, const void *b)
+{
+	const snmp_row_t *r = b;
+
+	return compare_row (a, r->index1, r->index2);
+}
+
+/*
+ * Start collecting the rows of the table, when a walk enters its column.
+ * Return 0 when out of memory: the getters then scan the table as before.
+ */
+bool_t
+snmp_rows_begin (snmp_t *snmp, small_uint_t table, unsigned count)
+{
+	snmp->rows_table = 0;
+	snmp->rows_count = 0;
+	snmp->rows_pos = 0;
+	if (count > snmp->rows_size) {
+		if (snmp->rows)
+			mem_free (snmp->rows);
+		snmp->rows = mem_alloc (snmp->pool, count * sizeof (snmp_row_t));
+		if (! snmp->rows) {
+			snmp->rows_size = 0;
+			return 0;
+		}
+		snmp->rows_size = count;
+	}
+	snmp->rows_table = table;
+	return 1;
+}
+
+void
+snmp_rows_add (snmp_t *snmp, void *row,
+	unsigned long index1, unsigned long index2)
+{
+	snmp_row_t *r;
+
+	if (! snmp->rows_table || snmp->rows_count >= snmp->rows_size)
+		return;
+	r = snmp->rows + snmp->rows_count++;
+	r->row = row;
+	r->index1 = index1;
+	r->index2 = index2;
+}
+
+/*
+ * Order the collected rows by index.
+ */
+void
+snmp_rows_sort (snmp_t *snmp)
+{
+	if (snmp->rows_table && snmp->rows_count > 1)
+		qsort (snmp->rows, snmp->rows_count, sizeof (snmp_row_t),
+			compare_rows);
+}
+
+snmp_row_t *
+snmp_rows_first (snmp_t *snmp, small_uint_t table)
+{
+	if (snmp->rows_table != table || snmp->rows_count == 0)
+		return 0;
+	snmp->rows_pos = 0;
+	return snmp->rows;
+}
+
+/*
+ * Find the row, following the given index.
+ * Only the continuation of a walk is served: the index must be
+ * the one of the row, returned last, or of its predecessor
+ * (several columns walked by one GETBULK request).
+ * Otherwise, or at the end of the table, return 0:
+ * the getter scans the table itself. The caller must check
+ * that the found entry still has the same index.
+ */
+snmp_row_t *
+snmp_rows_next (snmp_t *snmp, small_uint_t table,
+	unsigned long index1, unsigned long index2)
+{
+	unsigned pos = snmp->rows_pos;
+
+	if (snmp->rows_table != table || pos >= snmp->rows_count)
+		return 0;
+	if (compare_row (snmp->rows + pos, index1, index2) == 0) {
+		/* Skip duplicate indexes. */
+		do {
+			if (++pos >= snmp->rows_count)
+				return 0;
+		} while (compare_row (snmp->rows + pos, index1, index2) == 0);
+		snmp->rows_pos = pos;
+	} else if (pos == 0 ||
+	    compare_row (snmp->rows + pos - 1, index1, index2) != 0)
+		return 0;
+	return snmp->rows + pos;
+}
+
+/*
+ * Use the arena for request processing.
+ * The arena must be initialized with the pool of SNMP agent.
+ */
+void
+snmp_set_arena (snmp_t *snmp, asn_arena_t *arena)
+{
+	snmp->arena = arena;
+}
+
 void
 snmp_init (snmp_t *snmp, mem_pool_t *pool, struct _ip_t *ip,
 	const snmp_var_t *tab, unsigned tab_size,
@@ -753,6 +1224,8 @@ snmp_init (snmp_t *snmp, mem_pool_t *pool, struct _ip_t *ip,
 	snmp->sys_object_id = object_id;
 	snmp->sys_resource_descr = resource_descr;
 	snmp->sys_resource_id = resource_id;
+	snmp->cursor = snmp->tab_len;
+	build_trie (snmp);
 
 	/* By default, "get" access is permitted for everybody,
 	 * with community name "public". */
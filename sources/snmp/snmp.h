@@ -3,9 +3,17 @@
 
 typedef struct _snmp_t {
 	struct _mem_pool_t *pool;
+	struct _asn_arena_t *arena;	/* memory for request processing */
 	struct _ip_t	*ip;
 	const struct _snmp_var_t *tab;
 	unsigned tab_len;
+	struct _snmp_node_t *trie;	/* compiled OID tree of variables */
+	unsigned cursor;		/* variable, found by last GETNEXT */
+	struct _snmp_row_t *rows;	/* rows of the table being walked */
+	unsigned rows_count;		/* number of rows */
+	unsigned rows_size;		/* allocated length of rows[] */
+	unsigned rows_pos;		/* row, found by last GETNEXT */
+	small_uint_t rows_table;	/* which table is in rows[] */
 
 	unsigned enterprise;
 	unsigned char	user_addr [4];
@@ -101,6 +109,22 @@ typedef struct _snmp_var_t {
 	snmp_set_t	*set;
 } snmp_var_t;
 
+/*
+ * Row of a table, ordered by index for GETNEXT.
+ * When a walk enters the column, the table getters collect the rows,
+ * and then find every successor without scanning the table again.
+ */
+typedef struct _snmp_row_t {
+	void		*row;			/* table entry */
+	unsigned long	index1;			/* major index */
+	unsigned long	index2;			/* minor index */
+} snmp_row_t;
+
+#define SNMP_ROWS_IF		1		/* ifTable */
+#define SNMP_ROWS_IP_ADDR	2		/* ipAddrTable */
+#define SNMP_ROWS_IP_ROUTE	3		/* ipRouteTable */
+#define SNMP_ROWS_IP_NET_TO_MEDIA 4		/* ipNetToMediaTable */
+
 /*
  * SNMP error codes
  */
@@ -186,6 +210,14 @@ void snmp_init (snmp_t *snmp, struct _mem_pool_t *pool, struct _ip_t *ip,
 	unsigned enterprise, unsigned char services,
 	const char *descr, const char *object_id,
 	const char *resource_descr, const char *resource_id);
+void snmp_set_arena (snmp_t *snmp, struct _asn_arena_t *arena);
+bool_t snmp_rows_begin (snmp_t *snmp, small_uint_t table, unsigned count);
+void snmp_rows_add (snmp_t *snmp, void *row,
+	unsigned long index1, unsigned long index2);
+void snmp_rows_sort (snmp_t *snmp);
+snmp_row_t *snmp_rows_first (snmp_t *snmp, small_uint_t table);
+snmp_row_t *snmp_rows_next (snmp_t *snmp, small_uint_t table,
+	unsigned long index1, unsigned long index2);
 unsigned char *snmp_execute (snmp_t *snmp, unsigned char *input,
 	unsigned insz, unsigned char *output, unsigned outsz);
 bool_t snmp_trap_v1 (snmp_t *snmp, struct _udp_socket_t *sock,
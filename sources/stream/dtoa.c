@@ -0,0 +1,552 @@
+/*
+ * Conversion of double to decimal digits, for printf.
+ *
+ * Fixed precision (%e, %f, %g): digits are generated exactly.
+ * When the value is between 2^-60 and 2^64 (almost all real data),
+ * it is split into a 64-bit integer part and a 60-bit binary fraction,
+ * and every digit costs one multiply. Other values use a small bignum.
+ * Rounding is to nearest, ties to even, like in glibc.
+ *
+ * Shortest representation: Grisu2 algorithm from F. Loitsch,
+ * "Printing floating-point numbers quickly and accurately with
+ * integers", PLDI 2010. The result always reads back to the same
+ * double, and is the shortest one in all but rare cases.
+ */
+#include <runtime/lib.h>
+#include <stream/dtoa.h>
+
+#if ARCH_HAVE_FPU
+
+#define HIDDEN_BIT	0x0010000000000000ULL
+#define FRAC_MASK	0x000fffffffffffffULL
+
+#define BIG_LIMBS	40	/* enough for 2^1074 * 10^17 */
+
+typedef union {
+	double d;
+	uint64_t u;
+} dbits_t;
+
+/*
+ * Bignum, 32-bit limbs, least significant first.
+ */
+typedef struct {
+	int n;
+	uint32_t w [BIG_LIMBS];
+} big_t;
+
+/*
+ * Source of decimal digits of the value.
+ * Remainder R = value / 10^(exp10+1) is in range [0, 1),
+ * next digit is floor (10 * R).
+ */
+typedef struct {
+	bool_t big;
+
+	/* Fast path: R = 0.idigits + frac / 2^shift. */
+	unsigned char idigits [20];
+	int ilen, ipos;
+	uint64_t frac;
+	int shift;
+
+	/* Slow path: R = num / den. */
+	big_t num, den;
+} source_t;
+
+static const uint32_t pow10_32 [10] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+	100000000, 1000000000,
+};
+
+/*
+ * Split the value: v = m * 2^e.
+ */
+static void
+decompose (double v, uint64_t *m, int *e)
+{
+	dbits_t x;
+	int biased;
+
+	x.d = v;
+	biased = (x.u >> 52) & 0x7ff;
+	*m = x.u & FRAC_MASK;
+	if (biased) {
+		*m |= HIDDEN_BIT;
+		*e = biased - 1075;
+	} else
+		*e = -1074;
+}
+
+static void
+big_set (big_t *b, uint64_t v)
+{
+	b->n = 0;
+	while (v) {
+		b->w [b->n++] = (uint32_t) v;
+		v >>= 32;
+	}
+}
+
+/*
+ * b *= k
+ */
+static void
+big_mul (big_t *b, uint32_t k)
+{
+	uint64_t carry = 0;
+	int i;
+
+	for (i=0; i<b->n; ++i) {
+		carry += (uint64_t) b->w[i] * k;
+		b->w[i] = (uint32_t) carry;
+		carry >>= 32;
+	}
+	if (carry)
+		b->w [b->n++] = (uint32_t) carry;
+}
+
+/*
+ * b <<= shift
+ */
+static void
+big_shl (big_t *b, int shift)
+{
+	int words = shift >> 5, bits = shift & 31, i;
+	uint32_t carry, w;
+
+	if (b->n == 0)
+		return;
+	if (bits) {
+		carry = 0;
+		for (i=0; i<b->n; ++i) {
+			w = b->w[i];
+			b->w[i] = w << bits | carry;
+			carry = w >> (32 - bits);
+		}
+		if (carry)
+			b->w [b->n++] = carry;
+	}
+	if (words) {
+		for (i=b->n-1; i>=0; --i)
+			b->w [i + words] = b->w[i];
+		for (i=0; i<words; ++i)
+			b->w[i] = 0;
+		b->n += words;
+	}
+}
+
+/*
+ * b *= 10^k
+ */
+static void
+big_pow10 (big_t *b, int k)
+{
+	for (; k >= 9; k -= 9)
+		big_mul (b, 1000000000);
+	if (k > 0)
+		big_mul (b, pow10_32 [k]);
+}
+
+static int
+big_cmp (const big_t *a, const big_t *b)
+{
+	int i;
+
+	if (a->n != b->n)
+		return (a->n > b->n) ? 1 : -1;
+	for (i=a->n-1; i>=0; --i)
+		if (a->w[i] != b->w[i])
+			return (a->w[i] > b->w[i]) ? 1 : -1;
+	return 0;
+}
+
+/*
+ * a -= b, assuming a >= b
+ */
+static void
+big_sub (big_t *a, const big_t *b)
+{
+	uint64_t t;
+	uint32_t borrow = 0;
+	int i;
+
+	for (i=0; i<a->n; ++i) {
+		t = (uint64_t) a->w[i] - (i < b->n ? b->w[i] : 0) - borrow;
+		a->w[i] = (uint32_t) t;
+		borrow = (t >> 32) & 1;
+	}
+	while (a->n > 0 && a->w [a->n - 1] == 0)
+		--a->n;
+}
+
+/*
+ * Prepare the source of digits for a positive finite value.
+ * Return the decimal exponent of the first digit.
+ */
+static int
+source_init (source_t *src, double v)
+{
+	uint64_t m, ival;
+	int e, x, bits;
+	double lg;
+	big_t t;
+
+	decompose (v, &m, &e);
+	if (e >= -60 && e <= 11) {
+		/* Fits into 64-bit integer part and 60-bit fraction. */
+		src->big = 0;
+		if (e >= 0) {
+			ival = m << e;
+			src->frac = 0;
+			src->shift = 0;
+		} else {
+			src->shift = -e;
+			ival = m >> src->shift;
+			src->frac = m & ((1ULL << src->shift) - 1);
+		}
+		src->ipos = 0;
+		src->ilen = 0;
+		if (ival) {
+			unsigned char rev [20];
+
+			while (ival) {
+				rev [src->ilen++] = ival % 10;
+				ival /= 10;
+			}
+			for (x=0; x<src->ilen; ++x)
+				src->idigits[x] = rev [src->ilen - 1 - x];
+			return src->ilen - 1;
+		}
+		/* Skip leading zeros of the fraction. */
+		x = -1;
+		while ((src->frac * 10) >> src->shift == 0) {
+			src->frac *= 10;
+			--x;
+		}
+		return x;
+	}
+
+	/* R = m * 2^e / 10^(x+1) */
+	src->big = 1;
+	big_set (&src->num, m);
+	big_set (&src->den, 1);
+	if (e > 0)
+		big_shl (&src->num, e);
+	else
+		big_shl (&src->den, -e);
+
+	/* Estimate the exponent, then correct it. */
+	for (bits=0; m >> bits; ++bits)
+		continue;
+	lg = (e + bits - 1) * 0.30102999566398114;
+	x = (int) lg;
+	if (x > lg)
+		--x;
+	if (x + 1 > 0)
+		big_pow10 (&src->den, x + 1);
+	else
+		big_pow10 (&src->num, -x - 1);
+	while (big_cmp (&src->num, &src->den) >= 0) {
+		big_mul (&src->den, 10);
+		++x;
+	}
+	for (;;) {
+		t = src->num;
+		big_mul (&t, 10);
+		if (big_cmp (&t, &src->den) >= 0)
+			break;
+		src->num = t;
+		--x;
+	}
+	return x;
+}
+
+static int
+source_digit (source_t *src)
+{
+	int d;
+
+	if (src->big) {
+		big_mul (&src->num, 10);
+		for (d=0; big_cmp (&src->num, &src->den) >= 0; ++d)
+			big_sub (&src->num, &src->den);
+		return d;
+	}
+	if (src->ipos < src->ilen)
+		return src->idigits [src->ipos++];
+
+	src->frac *= 10;
+	d = src->frac >> src->shift;
+	src->frac &= (1ULL << src->shift) - 1;
+	return d;
+}
+
+/*
+ * Compare the remainder with 1/2: return -1, 0 or 1.
+ */
+static int
+source_half (source_t *src)
+{
+	big_t t;
+	int i;
+
+	if (src->big) {
+		t = src->num;
+		big_shl (&t, 1);
+		return big_cmp (&t, &src->den);
+	}
+	if (src->ipos < src->ilen) {
+		if (src->idigits [src->ipos] != 5)
+			return (src->idigits [src->ipos] > 5) ? 1 : -1;
+		for (i=src->ipos+1; i<src->ilen; ++i)
+			if (src->idigits[i])
+				return 1;
+		return src->frac ? 1 : 0;
+	}
+	if (src->shift == 0 || src->frac < (1ULL << (src->shift - 1)))
+		return -1;
+	return (src->frac > (1ULL << (src->shift - 1))) ? 1 : 0;
+}
+
+int
+dtoa_fixed (double v, int mode, int ndigits, unsigned char *digits,
+	int *exp10)
+{
+	source_t src;
+	int n, i, x, half;
+
+	*exp10 = 0;
+	if (v == 0)
+		return 0;
+	x = source_init (&src, v);
+	n = (mode == DTOA_FRACTION) ? x + 1 + ndigits : ndigits;
+	if (n < 0) {
+		/* Less than half of the last place. */
+		return 0;
+	}
+	if (n > DTOA_MAXDIGITS)
+		n = DTOA_MAXDIGITS;
+	for (i=0; i<n; ++i)
+		digits[i] = '0' + source_digit (&src);
+
+	half = source_half (&src);
+	if (half > 0 || (half == 0 && n > 0 && (digits [n-1] & 1))) {
+		/* Round up. */
+		for (i=n-1; i>=0; --i) {
+			if (digits[i] != '9') {
+				++digits[i];
+				break;
+			}
+			digits[i] = '0';
+		}
+		if (i < 0) {
+			/* 9.99 -> 10.0 */
+			digits[0] = '1';
+			if (n == 0)
+				n = 1;
+			++x;
+		}
+	}
+	*exp10 = x;
+	return n;
+}
+
+/*
+ * Grisu2.
+ */
+typedef struct {
+	uint64_t f;
+	int e;
+} diyfp_t;
+
+/*
+ * Normalized 10^k for k = -348, -340, ..., 340.
+ */
+static const struct {
+	uint64_t f;
+	short e;
+} cached_powers [87] = {
+	{ 0xfa8fd5a0081c0288ULL, -1220 }, { 0xbaaee17fa23ebf76ULL, -1193 },
+	{ 0x8b16fb203055ac76ULL, -1166 }, { 0xcf42894a5dce35eaULL, -1140 },
+	{ 0x9a6bb0aa55653b2dULL, -1113 }, { 0xe61acf033d1a45dfULL, -1087 },
+	{ 0xab70fe17c79ac6caULL, -1060 }, { 0xff77b1fcbebcdc4fULL, -1034 },
+	{ 0xbe5691ef416bd60cULL, -1007 }, { 0x8dd01fad907ffc3cULL, -980 },
+	{ 0xd3515c2831559a83ULL, -954 }, { 0x9d71ac8fada6c9b5ULL, -927 },
+	{ 0xea9c227723ee8bcbULL, -901 }, { 0xaecc49914078536dULL, -874 },
+	{ 0x823c12795db6ce57ULL, -847 }, { 0xc21094364dfb5637ULL, -821 },
+	{ 0x9096ea6f3848984fULL, -794 }, { 0xd77485cb25823ac7ULL, -768 },
+	{ 0xa086cfcd97bf97f4ULL, -741 }, { 0xef340a98172aace5ULL, -715 },
+	{ 0xb23867fb2a35b28eULL, -688 }, { 0x84c8d4dfd2c63f3bULL, -661 },
+	{ 0xc5dd44271ad3cdbaULL, -635 }, { 0x936b9fcebb25c996ULL, -608 },
+	{ 0xdbac6c247d62a584ULL, -582 }, { 0xa3ab66580d5fdaf6ULL, -555 },
+	{ 0xf3e2f893dec3f126ULL, -529 }, { 0xb5b5ada8aaff80b8ULL, -502 },
+	{ 0x87625f056c7c4a8bULL, -475 }, { 0xc9bcff6034c13053ULL, -449 },
+	{ 0x964e858c91ba2655ULL, -422 }, { 0xdff9772470297ebdULL, -396 },
+	{ 0xa6dfbd9fb8e5b88fULL, -369 }, { 0xf8a95fcf88747d94ULL, -343 },
+	{ 0xb94470938fa89bcfULL, -316 }, { 0x8a08f0f8bf0f156bULL, -289 },
+	{ 0xcdb02555653131b6ULL, -263 }, { 0x993fe2c6d07b7facULL, -236 },
+	{ 0xe45c10c42a2b3b06ULL, -210 }, { 0xaa242499697392d3ULL, -183 },
+	{ 0xfd87b5f28300ca0eULL, -157 }, { 0xbce5086492111aebULL, -130 },
+	{ 0x8cbccc096f5088ccULL, -103 }, { 0xd1b71758e219652cULL, -77 },
+	{ 0x9c40000000000000ULL, -50 }, { 0xe8d4a51000000000ULL, -24 },
+	{ 0xad78ebc5ac620000ULL, 3 }, { 0x813f3978f8940984ULL, 30 },
+	{ 0xc097ce7bc90715b3ULL, 56 }, { 0x8f7e32ce7bea5c70ULL, 83 },
+	{ 0xd5d238a4abe98068ULL, 109 }, { 0x9f4f2726179a2245ULL, 136 },
+	{ 0xed63a231d4c4fb27ULL, 162 }, { 0xb0de65388cc8ada8ULL, 189 },
+	{ 0x83c7088e1aab65dbULL, 216 }, { 0xc45d1df942711d9aULL, 242 },
+	{ 0x924d692ca61be758ULL, 269 }, { 0xda01ee641a708deaULL, 295 },
+	{ 0xa26da3999aef774aULL, 322 }, { 0xf209787bb47d6b85ULL, 348 },
+	{ 0xb454e4a179dd1877ULL, 375 }, { 0x865b86925b9bc5c2ULL, 402 },
+	{ 0xc83553c5c8965d3dULL, 428 }, { 0x952ab45cfa97a0b3ULL, 455 },
+	{ 0xde469fbd99a05fe3ULL, 481 }, { 0xa59bc234db398c25ULL, 508 },
+	{ 0xf6c69a72a3989f5cULL, 534 }, { 0xb7dcbf5354e9beceULL, 561 },
+	{ 0x88fcf317f22241e2ULL, 588 }, { 0xcc20ce9bd35c78a5ULL, 614 },
+	{ 0x98165af37b2153dfULL, 641 }, { 0xe2a0b5dc971f303aULL, 667 },
+	{ 0xa8d9d1535ce3b396ULL, 694 }, { 0xfb9b7cd9a4a7443cULL, 720 },
+	{ 0xbb764c4ca7a44410ULL, 747 }, { 0x8bab8eefb6409c1aULL, 774 },
+	{ 0xd01fef10a657842cULL, 800 }, { 0x9b10a4e5e9913129ULL, 827 },
+	{ 0xe7109bfba19c0c9dULL, 853 }, { 0xac2820d9623bf429ULL, 880 },
+	{ 0x80444b5e7aa7cf85ULL, 907 }, { 0xbf21e44003acdd2dULL, 933 },
+	{ 0x8e679c2f5e44ff8fULL, 960 }, { 0xd433179d9c8cb841ULL, 986 },
+	{ 0x9e19db92b4e31ba9ULL, 1013 }, { 0xeb96bf6ebadf77d9ULL, 1039 },
+	{ 0xaf87023b9bf0ee6bULL, 1066 },
+};
+
+static const uint64_t pow10_64 [20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+static diyfp_t
+diy_mul (diyfp_t x, diyfp_t y)
+{
+	uint64_t a = x.f >> 32, b = x.f & 0xffffffff;
+	uint64_t c = y.f >> 32, d = y.f & 0xffffffff;
+	uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d, tmp;
+	diyfp_t r;
+
+	tmp = (bd >> 32) + (ad & 0xffffffff) + (bc & 0xffffffff);
+	tmp += 1U << 31;			/* round */
+	r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+	r.e = x.e + y.e + 64;
+	return r;
+}
+
+static void
+grisu_round (unsigned char *digits, int len, uint64_t delta, uint64_t rest,
+	uint64_t ten_kappa, uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+	    (rest + ten_kappa < wp_w ||
+	    wp_w - rest > rest + ten_kappa - wp_w)) {
+		--digits [len-1];
+		rest += ten_kappa;
+	}
+}
+
+static int
+digit_gen (diyfp_t w, diyfp_t mp, uint64_t delta, unsigned char *digits,
+	int *k)
+{
+	int shift = -mp.e, kappa, len = 0;
+	uint64_t one = 1ULL << shift, wp_w = mp.f - w.f, p2, tmp;
+	uint32_t p1 = mp.f >> shift, d;
+
+	p2 = mp.f & (one - 1);
+	for (kappa=1; kappa<10 && p1 >= pow10_32 [kappa]; ++kappa)
+		continue;
+
+	while (kappa > 0) {
+		d = p1 / pow10_32 [kappa-1];
+		p1 %= pow10_32 [kappa-1];
+		if (d || len)
+			digits [len++] = '0' + d;
+		--kappa;
+		tmp = ((uint64_t) p1 << shift) + p2;
+		if (tmp <= delta) {
+			*k += kappa;
+			grisu_round (digits, len, delta, tmp,
+				(uint64_t) pow10_32 [kappa] << shift, wp_w);
+			return len;
+		}
+	}
+	for (;;) {
+		p2 *= 10;
+		delta *= 10;
+		d = p2 >> shift;
+		if (d || len)
+			digits [len++] = '0' + d;
+		p2 &= one - 1;
+		--kappa;
+		if (p2 < delta) {
+			*k += kappa;
+			grisu_round (digits, len, delta, p2, one,
+				-kappa < 20 ? wp_w * pow10_64 [-kappa] : 0);
+			return len;
+		}
+	}
+}
+
+int
+dtoa_shortest (double v, unsigned char *digits, int *exp10)
+{
+	diyfp_t w, wp, wm, c;
+	uint64_t m;
+	int e, k, index, len;
+	double dk;
+
+	*exp10 = 0;
+	if (v == 0)
+		return 0;
+	decompose (v, &m, &e);
+
+	/* Boundaries, halfway to the neighbours. */
+	wp.f = (m << 1) + 1;
+	wp.e = e - 1;
+	while (! (wp.f & (HIDDEN_BIT << 1))) {
+		wp.f <<= 1;
+		--wp.e;
+	}
+	wp.f <<= 10;
+	wp.e -= 10;
+	if (m == HIDDEN_BIT) {
+		wm.f = (m << 2) - 1;
+		wm.e = e - 2;
+	} else {
+		wm.f = (m << 1) - 1;
+		wm.e = e - 1;
+	}
+	wm.f <<= wm.e - wp.e;
+	wm.e = wp.e;
+
+	w.f = m;
+	w.e = e;
+	while (! (w.f & (1ULL << 63))) {
+		w.f <<= 1;
+		--w.e;
+	}
+
+	/* Cached power, to bring the exponent into range [-60, -32]. */
+	dk = (-61 - wp.e) * 0.30102999566398114 + 347;
+	k = (int) dk;
+	if (k != dk)
+		++k;
+	index = (k >> 3) + 1;
+	k = -(-348 + (index << 3));
+	c.f = cached_powers [index].f;
+	c.e = cached_powers [index].e;
+
+	w = diy_mul (w, c);
+	wp = diy_mul (wp, c);
+	wm = diy_mul (wm, c);
+	++wm.f;
+	--wp.f;
+	len = digit_gen (w, wp, wp.f - wm.f, digits, &k);
+	*exp10 = len + k - 1;
+	return len;
+}
+#endif /* ARCH_HAVE_FPU */
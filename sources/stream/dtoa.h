@@ -0,0 +1,33 @@
+#ifndef __DTOA_H_
+#define __DTOA_H_ 1
+
+/*
+ * Conversion of double to decimal digits, used by printf.
+ * Value is 0.d1d2d3... * 10^(exp10+1), i.e. exp10 is the decimal
+ * exponent of the first digit, as printed by %e.
+ * Digits are ASCII characters, missing trailing digits are zeros.
+ * Zero value gives no digits.
+ */
+#ifndef DTOA_MAXDIGITS
+#   define DTOA_MAXDIGITS	40	/* max exact significant digits */
+#endif
+
+#define DTOA_SIGNIFICANT	0	/* ndigits significant digits, %e, %g */
+#define DTOA_FRACTION		1	/* digits down to 10^-ndigits, %f */
+
+/*
+ * Correctly rounded digits (to nearest, ties to even) of a finite
+ * non-negative value. At most DTOA_MAXDIGITS digits are produced,
+ * further digits of %f for huge values are zeros.
+ * Return the number of digits.
+ */
+int dtoa_fixed (double v, int mode, int ndigits, unsigned char *digits,
+	int *exp10);
+
+/*
+ * Shortest digits, which read back to the same value.
+ * At most 17 digits. Return the number of digits.
+ */
+int dtoa_shortest (double v, unsigned char *digits, int *exp10);
+
+#endif /* __DTOA_H_ */
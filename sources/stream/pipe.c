@@ -6,162 +6,247 @@
 #define MASTER_TO_PIPE(m)	((pipe_t*) ((m) - 1))
 #define SLAVE_TO_PIPE(s)	((pipe_t*) (s))
 
+/*
+ * Wake up the tasks, waiting on the pipe.
+ */
 static void
-master_putchar (stream_t *master, short c)
+pipe_wakeup (pipe_t *u)
 {
-	pipe_t *u = MASTER_TO_PIPE (master);
-	unsigned short *next;
-
-	mutex_lock (&u->lock);
+	++u->wakeups;
+	mutex_signal (&u->lock, 0);
+}
 
-	/* Wait for free space in FIFO. */
-	for (;;) {
-		if (u->slave_closed) {
-			mutex_unlock (&u->lock);
-			return;
-		}
-		next = u->out_last + 1;
-		if (next >= u->out_fifo + u->fifo_chars)
-			next = u->out_fifo;
+/*
+ * Sleep on the pipe. Before that, deliver the data below
+ * the threshold: nobody else will do it.
+ */
+static void
+pipe_wait (pipe_t *u)
+{
+	if ((u->out.reader_waiting && u->out.count > 0) ||
+	    (u->in.reader_waiting && u->in.count > 0))
+		pipe_wakeup (u);
+	mutex_wait (&u->lock);
+}
 
-		if (next != u->out_first)
-			break;
+/*
+ * Wake up the writer, when enough space is free.
+ */
+static inline void
+fifo_wakeup_writer (pipe_t *u, pipe_fifo_t *f)
+{
+	if (f->writer_waiting && (f->count == 0 ||
+	    f->size - f->count >= u->threshold)) {
+		f->writer_waiting = 0;
+		pipe_wakeup (u);
+	}
+}
 
-		mutex_wait (&u->lock);
+/*
+ * Wake up the reader, when enough data are accumulated.
+ */
+static inline void
+fifo_wakeup_reader (pipe_t *u, pipe_fifo_t *f)
+{
+	if (f->reader_waiting && f->count >= u->threshold) {
+		f->reader_waiting = 0;
+		pipe_wakeup (u);
 	}
+}
 
-	/* Put byte into FIFO. */
-	*u->out_last = c;
-	u->out_last = next;
-	mutex_signal (&u->lock, 0);
+/*
+ * Put a block of bytes into FIFO: lock once, copy all that fits
+ * by contiguous runs, wait only when the FIFO is full.
+ */
+static int
+fifo_write (pipe_t *u, pipe_fifo_t *f, unsigned char *closed,
+	const unsigned char *buf, int len)
+{
+	unsigned last, n;
+	int done = 0;
 
+	mutex_lock (&u->lock);
+	while (done < len) {
+		if (*closed)
+			break;
+		if (f->count == f->size) {
+			/* FIFO is full: let the reader drain it. */
+			f->writer_waiting = 1;
+			pipe_wait (u);
+			continue;
+		}
+		last = f->first + f->count;
+		if (last >= f->size)
+			last -= f->size;
+		n = (last < f->first ? f->first : f->size) - last;
+		if (n > len - done)
+			n = len - done;
+		memcpy (f->data + last, buf + done, n);
+		f->count += n;
+		done += n;
+		fifo_wakeup_reader (u, f);
+	}
 	mutex_unlock (&u->lock);
+	return done;
 }
 
-static void
-slave_putchar (stream_t *slave, short c)
+/*
+ * Get a block of bytes from FIFO: wait for data,
+ * then take all available, up to len.
+ */
+static int
+fifo_read (pipe_t *u, pipe_fifo_t *f, unsigned char *closed,
+	unsigned char *buf, int len)
 {
-	pipe_t *u = SLAVE_TO_PIPE (slave);
-	unsigned short *next;
+	unsigned n;
+	int done = 0;
 
 	mutex_lock (&u->lock);
 
-	/* Wait for free space in FIFO. */
-	for (;;) {
-		if (u->master_closed) {
+	/* Wait for data in FIFO. */
+	while (f->count == 0) {
+		if (*closed) {
 			mutex_unlock (&u->lock);
-			return;
+			return 0;
 		}
-		next = u->in_last + 1;
-		if (next >= u->in_fifo + u->fifo_chars)
-			next = u->in_fifo;
-
-		if (next != u->in_first)
-			break;
-
-		mutex_wait (&u->lock);
+		f->reader_waiting = 1;
+		pipe_wait (u);
 	}
-
-	/* Put byte into FIFO. */
-	*u->in_last = c;
-	u->in_last = next;
-	mutex_signal (&u->lock, 0);
+	f->reader_waiting = 0;
+	while (done < len && f->count > 0) {
+		n = f->size - f->first;
+		if (n > f->count)
+			n = f->count;
+		if (n > len - done)
+			n = len - done;
+		memcpy (buf + done, f->data + f->first, n);
+		f->first += n;
+		if (f->first >= f->size)
+			f->first = 0;
+		f->count -= n;
+		done += n;
+	}
+	fifo_wakeup_writer (u, f);
 
 	mutex_unlock (&u->lock);
+	return done;
 }
 
 static unsigned short
-master_getchar (stream_t *master)
+fifo_getchar (pipe_t *u, pipe_fifo_t *f, unsigned char *closed)
 {
-	pipe_t *u = MASTER_TO_PIPE (master);
-	unsigned short c;
+	unsigned char c;
+
+	if (fifo_read (u, f, closed, &c, 1) != 1)
+		return -1;
+	return c;
+}
+
+static int
+fifo_peekchar (pipe_t *u, pipe_fifo_t *f)
+{
+	int c;
 
 	mutex_lock (&u->lock);
+	c = (f->count == 0) ? -1 : f->data [f->first];
+	mutex_unlock (&u->lock);
+	return c;
+}
 
-	/* Wait for data in FIFO. */
-	while (u->in_first == u->in_last) {
-		if (u->slave_closed) {
-			mutex_unlock (&u->lock);
-			return -1;
-		}
-		mutex_wait (&u->lock);
+/*
+ * Wait until the FIFO becomes empty.
+ */
+static void
+fifo_flush (pipe_t *u, pipe_fifo_t *f, unsigned char *closed)
+{
+	mutex_lock (&u->lock);
+	while (f->count > 0 && ! *closed) {
+		f->writer_waiting = 1;
+		pipe_wait (u);
 	}
+	mutex_unlock (&u->lock);
+}
 
-	/* Get byte from FIFO. */
-	c = *u->in_first++;
-	if (u->in_first >= u->in_fifo + u->fifo_chars)
-		u->in_first = u->in_fifo;
+static void
+master_putchar (stream_t *master, short c)
+{
+	pipe_t *u = MASTER_TO_PIPE (master);
+	unsigned char byte = c;
 
-	mutex_signal (&u->lock, 0);
+	fifo_write (u, &u->out, &u->slave_closed, &byte, 1);
+}
 
-	mutex_unlock (&u->lock);
-	return c;
+static void
+slave_putchar (stream_t *slave, short c)
+{
+	pipe_t *u = SLAVE_TO_PIPE (slave);
+	unsigned char byte = c;
+
+	fifo_write (u, &u->in, &u->master_closed, &byte, 1);
+}
+
+static unsigned short
+master_getchar (stream_t *master)
+{
+	pipe_t *u = MASTER_TO_PIPE (master);
+
+	return fifo_getchar (u, &u->in, &u->slave_closed);
 }
 
 static unsigned short
 slave_getchar (stream_t *slave)
 {
 	pipe_t *u = SLAVE_TO_PIPE (slave);
-	unsigned short c;
 
-	mutex_lock (&u->lock);
+	return fifo_getchar (u, &u->out, &u->master_closed);
+}
 
-	/* Wait for data in FIFO. */
-	while (u->out_first == u->out_last) {
-		if (u->master_closed) {
-			mutex_unlock (&u->lock);
-			return -1;
-		}
-		mutex_wait (&u->lock);
-	}
+static int
+master_peekchar (stream_t *master)
+{
+	pipe_t *u = MASTER_TO_PIPE (master);
 
-	/* Get byte from FIFO. */
-	c = *u->out_first++;
-	if (u->out_first >= u->out_fifo + u->fifo_chars)
-		u->out_first = u->out_fifo;
+	return fifo_peekchar (u, &u->in);
+}
 
-	mutex_signal (&u->lock, 0);
+static int
+slave_peekchar (stream_t *slave)
+{
+	pipe_t *u = SLAVE_TO_PIPE (slave);
 
-	mutex_unlock (&u->lock);
-	return c;
+	return fifo_peekchar (u, &u->out);
 }
 
 static int
-master_peekchar (stream_t *master)
+master_write (stream_t *master, const void *buf, int len)
 {
 	pipe_t *u = MASTER_TO_PIPE (master);
-	unsigned short c;
 
-	mutex_lock (&u->lock);
+	return fifo_write (u, &u->out, &u->slave_closed, buf, len);
+}
 
-	/* Is fifo empty? */
-	if (u->in_first == u->in_last) {
-		mutex_unlock (&u->lock);
-		return -1;
-	}
-	c = *u->in_first;
+static int
+slave_write (stream_t *slave, const void *buf, int len)
+{
+	pipe_t *u = SLAVE_TO_PIPE (slave);
 
-	mutex_unlock (&u->lock);
-	return c;
+	return fifo_write (u, &u->in, &u->master_closed, buf, len);
 }
 
 static int
-slave_peekchar (stream_t *slave)
+master_read (stream_t *master, void *buf, int len)
 {
-	pipe_t *u = SLAVE_TO_PIPE (slave);
-	unsigned short c;
+	pipe_t *u = MASTER_TO_PIPE (master);
 
-	mutex_lock (&u->lock);
+	return fifo_read (u, &u->in, &u->slave_closed, buf, len);
+}
 
-	/* Is fifo empty? */
-	if (u->out_first == u->out_last) {
-		mutex_unlock (&u->lock);
-		return -1;
-	}
-	c = *u->out_first;
+static int
+slave_read (stream_t *slave, void *buf, int len)
+{
+	pipe_t *u = SLAVE_TO_PIPE (slave);
 
-	mutex_unlock (&u->lock);
-	return c;
+	return fifo_read (u, &u->out, &u->master_closed, buf, len);
 }
 
 static void
@@ -169,13 +254,8 @@ master_flush (stream_t *master)
 {
 	pipe_t *u = MASTER_TO_PIPE (master);
 
-	mutex_lock (&u->lock);
-
 	/* Wait until output FIFO becomes empty. */
-	while (u->out_first != u->out_last && ! u->slave_closed)
-		mutex_wait (&u->lock);
-
-	mutex_unlock (&u->lock);
+	fifo_flush (u, &u->out, &u->slave_closed);
 }
 
 static void
@@ -183,13 +263,8 @@ slave_flush (stream_t *slave)
 {
 	pipe_t *u = SLAVE_TO_PIPE (slave);
 
-	mutex_lock (&u->lock);
-
 	/* Wait until input FIFO becomes empty. */
-	while (u->in_first != u->in_last && ! u->master_closed)
-		mutex_wait (&u->lock);
-
-	mutex_unlock (&u->lock);
+	fifo_flush (u, &u->in, &u->master_closed);
 }
 
 static bool_t
@@ -224,8 +299,8 @@ master_close (stream_t *master)
 	mutex_lock (&u->lock);
 
 	u->master_closed = 1;
-	u->in_first = u->in_last;
-	mutex_signal (&u->lock, 0);
+	u->in.count = 0;
+	pipe_wakeup (u);
 
 	mutex_unlock (&u->lock);
 }
@@ -238,8 +313,8 @@ slave_close (stream_t *slave)
 	mutex_lock (&u->lock);
 
 	u->slave_closed = 1;
-	u->out_first = u->out_last;
-	mutex_signal (&u->lock, 0);
+	u->out.count = 0;
+	pipe_wakeup (u);
 
 	mutex_unlock (&u->lock);
 }
@@ -251,6 +326,8 @@ static stream_interface_t master_interface = {
 	.flush = (void (*) (stream_t*))		master_flush,
 	.eof = (bool_t (*) (stream_t*))		master_eof,
 	.close = (void (*) (stream_t*))		master_close,
+	.write = master_write,
+	.read = master_read,
 };
 
 static stream_interface_t slave_interface = {
@@ -260,11 +337,24 @@ static stream_interface_t slave_interface = {
 	.flush = (void (*) (stream_t*))		slave_flush,
 	.eof = (bool_t (*) (stream_t*))		slave_eof,
 	.close = (void (*) (stream_t*))		slave_close,
+	.write = slave_write,
+	.read = slave_read,
 };
 
+void
+pipe_set_threshold (pipe_t *u, unsigned bytes)
+{
+	mutex_lock (&u->lock);
+	if (bytes > u->out.size / 2)
+		bytes = u->out.size / 2;
+	u->threshold = bytes ? bytes : 1;
+	mutex_unlock (&u->lock);
+}
+
 /*
  * Create pipe. Use the buffer of given size.
  * Return pointers to master and slave interfaces.
+ * Characters are stored as bytes, like in other byte streams.
  */
 pipe_t *pipe_init (char *buf, int bytes, stream_t **master, stream_t **slave)
 {
@@ -277,19 +367,13 @@ pipe_t *pipe_init (char *buf, int bytes, stream_t **master, stream_t **slave)
 	*slave = &u->slave;
 	u->slave.interface = &slave_interface;
 	u->master.interface = &master_interface;
+	u->threshold = 1;
 
-	u->fifo_chars = (bytes - sizeof (pipe_t) + sizeof(u->data)) /
-		sizeof (unsigned short) / 2;
-	assert (u->fifo_chars > 1);
-
-	u->out_fifo = u->data;
-	u->in_fifo = u->data + u->fifo_chars;
-
-	u->out_first = u->out_fifo;
-	u->out_last = u->out_fifo;
-
-	u->in_first = u->in_fifo;
-	u->in_last = u->in_fifo;
+	u->out.size = (bytes - sizeof (pipe_t) + sizeof(u->data)) / 2;
+	assert (u->out.size > 1);
+	u->in.size = u->out.size;
 
+	u->out.data = u->data;
+	u->in.data = u->data + u->out.size;
 	return u;
 }
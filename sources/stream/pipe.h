@@ -1,6 +1,19 @@
 /*
  * Pipe - communitation channel with two symmetrical stream interfaces.
  */
+
+/*
+ * Byte ring for one direction.
+ */
+typedef struct _pipe_fifo_t {
+	unsigned char *data;
+	unsigned size;			/* ring size */
+	unsigned first;			/* index of the first byte */
+	unsigned count;			/* number of bytes in the ring */
+	bool_t reader_waiting;		/* reader sleeps until data come */
+	bool_t writer_waiting;		/* writer sleeps until space is free */
+} pipe_fifo_t;
+
 typedef struct _pipe_t {
 	stream_t slave;
 	stream_t master;
@@ -9,20 +22,24 @@ typedef struct _pipe_t {
 
 	unsigned char master_closed;
 	unsigned char slave_closed;
-	unsigned short fifo_chars;
 
-	/* From master to slave. */
-	unsigned short *out_fifo;
-	unsigned short *out_first;
-	unsigned short *out_last;
+	/* The reader is woken, when this amount of data is accumulated,
+	 * or when the writer flushes, closes or waits on the pipe.
+	 * The writer is woken, when this amount of space is free. */
+	unsigned threshold;
+	unsigned long wakeups;		/* number of signals */
 
-	/* From slave to master. */
-	unsigned short *in_fifo;
-	unsigned short *in_first;
-	unsigned short *in_last;
+	pipe_fifo_t out;		/* from master to slave */
+	pipe_fifo_t in;			/* from slave to master */
 
-	unsigned short data [4];
+	unsigned char data [4];
 	/* More data space here. */
 } pipe_t;
 
 pipe_t *pipe_init (char *buf, int bytes, stream_t **master, stream_t **slave);
+
+/*
+ * Set the wakeup threshold in bytes. Default is 1: the reader
+ * is woken on every write.
+ */
+void pipe_set_threshold (pipe_t *u, unsigned bytes);
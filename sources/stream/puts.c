@@ -3,14 +3,22 @@
 
 int stream_puts (stream_t *stream, const char *str)
 {
-	int length;
-	unsigned char c;
+	int length, n;
+	unsigned char c, chunk [32];
 
-	for (length = 0; ; length++) {
-		c = FETCH_BYTE (str);
-		if (! c)
-			return length;
-		putchar (stream, c);
-		++str;
+	/* Strings may live in program memory (FETCH_BYTE),
+	 * so copy them by chunks and write every chunk at once. */
+	for (length = 0; ; length += n) {
+		for (n = 0; n < sizeof (chunk); n++) {
+			c = FETCH_BYTE (str);
+			if (! c)
+				break;
+			chunk [n] = c;
+			++str;
+		}
+		if (n > 0)
+			stream_write (stream, chunk, n);
+		if (n < sizeof (chunk))
+			return length + n;
 	}
 }
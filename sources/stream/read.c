@@ -0,0 +1,34 @@
+#include <runtime/lib.h>
+#include <stream/stream.h>
+
+/*
+ * Read a block of bytes: wait for the first byte, then take
+ * whatever is available without blocking, up to len bytes.
+ * Return the number of bytes, or 0 at end of stream.
+ * When the stream has no read method, fall back to getc/peekc.
+ */
+int
+stream_read (stream_t *u, void *buf, int len)
+{
+	unsigned char *p = buf;
+	unsigned short c;
+	int n;
+
+	if (len <= 0)
+		return 0;
+	if (u->interface->read)
+		return u->interface->read (u, buf, len);
+
+	if (u->interface->eof && u->interface->eof (u))
+		return 0;
+	c = u->interface->getc (u);
+	if (c == (unsigned short) -1)
+		return 0;
+	p[0] = c;
+	for (n=1; n<len; ++n) {
+		if (! u->interface->peekc || u->interface->peekc (u) < 0)
+			break;
+		p[n] = u->interface->getc (u);
+	}
+	return n;
+}
@@ -19,6 +19,11 @@ typedef struct _stream_interface_t {
 	bool_t (*eof) (stream_t *u);
 	void (*close) (stream_t *u);
 	struct _mutex_t *(*receiver) (stream_t *u);
+
+	/* Необязательные методы блочного ввода-вывода.
+	 * Если не заданы, используется побайтный putc/getc. */
+	int (*write) (stream_t *u, const void *buf, int len);
+	int (*read) (stream_t *u, void *buf, int len);
 } stream_interface_t;
 
 #define to_stream(x)   ((stream_t*)&(x)->interface)
@@ -39,6 +44,8 @@ typedef struct _stream_interface_t {
 #define freceiver(x)	((x)->interface->receiver ? \
 			(x)->interface->receiver(to_stream (x)) : 0)
 
+#define fwrite(x,b,n)	stream_write (to_stream (x), b, n)
+#define fread(x,b,n)	stream_read (to_stream (x), b, n)
 #define puts(x,str)	stream_puts (to_stream (x), str)
 #define gets(x,str,n)	stream_gets (to_stream (x), str, n)
 #define vprintf(x,f,a)	stream_vprintf (to_stream (x), f, a)
@@ -48,6 +55,13 @@ typedef struct _stream_interface_t {
 #define printf(x,f,...) stream_printf (to_stream (x), f, ##__VA_ARGS__)
 
 void drain_input (stream_t *u); /* LY: чистит забуферизированный в потоке ввод. */
+/*
+ * Блочный вывод: выдать len байтов, вернуть их количество.
+ * Блочный ввод: ждать хотя бы один байт, затем забрать
+ * без ожидания не более len байтов; 0 - конец потока.
+ */
+int stream_write (stream_t *u, const void *buf, int len);
+int stream_read (stream_t *u, void *buf, int len);
 int stream_puts (stream_t *u, const char *str);
 unsigned char *stream_gets (stream_t *u, unsigned char *str, int len);
 int stream_printf (stream_t *u, const char *fmt, ...);
@@ -40,6 +40,33 @@ buf_feof (stream_buf_t *u)
 	return ! *u->buf;
 }
 
+static int
+buf_write (stream_buf_t *u, const void *data, int len)
+{
+	int n = len;
+
+	/* Keep one byte for the terminating zero, like buf_putchar. */
+	if (n > u->size - 1)
+		n = u->size - 1;
+	if (n > 0) {
+		memcpy (u->buf, data, n);
+		u->buf += n;
+		u->size -= n;
+	}
+	return len;
+}
+
+static int
+buf_read (stream_buf_t *u, void *data, int len)
+{
+	unsigned char *p = data;
+	int n;
+
+	for (n=0; n<len && *u->buf; ++n)
+		*p++ = *u->buf++;
+	return n;
+}
+
 static stream_interface_t buf_interface = {
 	.putc =
 #if __STDC__
@@ -61,6 +88,16 @@ static stream_interface_t buf_interface = {
 	(bool_t (*) (stream_t*))
 #endif
 		buf_feof,
+	.write =
+#if __STDC__
+	(int (*) (stream_t*, const void*, int))
+#endif
+		buf_write,
+	.read =
+#if __STDC__
+	(int (*) (stream_t*, void*, int))
+#endif
+		buf_read,
 };
 
 stream_t *
@@ -5,8 +5,14 @@ static void null_putchar (stream_t *t, short c)
 {
 }
 
+static int null_write (stream_t *t, const void *buf, int len)
+{
+	return len;
+}
+
 stream_interface_t null_stream_interface = {
-	.putc = (void (*) (stream_t*, short)) null_putchar
+	.putc = (void (*) (stream_t*, short)) null_putchar,
+	.write = null_write,
 };
 
 stream_t null_stream = {&null_stream_interface};
@@ -42,31 +42,50 @@
  *
  *	("%6D", ptr)       -> XX XX XX XX XX XX
  *	("%#*D", len, ptr) -> XX:XX:XX:XX ...
+ *
+ * Float formats %le, %lf and %lg without precision print the shortest
+ * number, which reads back to the same double.
  */
 #include <runtime/lib.h>
 #include <runtime/math.h>
 #include <stream/stream.h>
+#include <stream/dtoa.h>
 
 /* Max number conversion buffer length: a long in base 2, plus NUL byte. */
 #define MAXNBUF	(sizeof(long) * 8 + 1)
 
+/*
+ * Output is collected in a chunk on stack and passed to the stream
+ * by stream_write(), so the driver is locked once per chunk,
+ * not once per character.
+ */
+#ifndef VPRINTF_CHUNKSZ
+#   if __AVR__ || MSP430
+#      define VPRINTF_CHUNKSZ	16
+#   else
+#      define VPRINTF_CHUNKSZ	64
+#   endif
+#endif
+
 static unsigned char *ksprintn (unsigned char *buf, unsigned long v, unsigned char base,
 	int width, unsigned char *lp);
+static unsigned char *ksprintn10 (unsigned char *buf, unsigned long v,
+	int width, unsigned char *lp);
 static unsigned char mkhex (unsigned char ch);
 
-#if ARCH_HAVE_FPU
-static int cvt (double number, int prec, int sharpflag, unsigned char *negp,
-	unsigned char fmtch, unsigned char *startp, unsigned char *endp);
-#endif
 
 int
 stream_vprintf (stream_t *stream, char const *fmt, va_list ap)
 {
-#define PUTC(c) { putchar(stream,(unsigned char)(c)); ++retval; }
+#define FLUSH() if (nchunk > 0) { stream_write (stream, chunk, nchunk); nchunk = 0; }
+#define PUTC(c) { if (nchunk >= VPRINTF_CHUNKSZ) FLUSH (); \
+		  chunk [nchunk++] = (c); ++retval; }
+	unsigned char chunk [VPRINTF_CHUNKSZ];
 	unsigned char nbuf [MAXNBUF], padding, *q;
 	const unsigned char *s;
 	unsigned char c, base, lflag, ladjust, sharpflag, neg, dot, size;
 	small_int_t n, width, dwidth, retval, uppercase, extrazeros, sign;
+	small_int_t nchunk = 0;
 	unsigned long ul;
 
 	if (! stream)
@@ -77,8 +96,10 @@ stream_vprintf (stream_t *stream, char const *fmt, va_list ap)
 	retval = 0;
 	for (;;) {
 		while ((c = FETCH_BYTE (fmt++)) != '%') {
-			if (! c)
+			if (! c) {
+				FLUSH ();
 				return retval;
+			}
 			PUTC (c);
 		}
 		padding = ' ';
@@ -274,8 +295,14 @@ const_string:
 			if (! ladjust && width > 0)
 				while (width--)
 					PUTC (' ');
-			while (n--)
-				PUTC (*s++);
+			if (n >= VPRINTF_CHUNKSZ) {
+				/* Long string: write it directly. */
+				FLUSH ();
+				stream_write (stream, s, n);
+				retval += n;
+			} else
+				while (n--)
+					PUTC (*s++);
 			if (ladjust && width > 0)
 				while (width--)
 					PUTC (' ');
@@ -346,7 +373,10 @@ number:		if (sign && ((long) ul != 0L)) {
 				extrazeros = dwidth - sizeof(nbuf) + 1;
 				dwidth = sizeof(nbuf) - 1;
 			}
-			s = ksprintn (nbuf, ul, base, dwidth, &size);
+			if (base == 10)
+				s = ksprintn10 (nbuf, ul, dwidth, &size);
+			else
+				s = ksprintn (nbuf, ul, base, dwidth, &size);
 			if (sharpflag && ul != 0) {
 				if (base == 8)
 					size++;
@@ -405,51 +435,107 @@ number:		if (sign && ((long) ul != 0L)) {
 		case 'g':
 		case 'G': {
 			double d = va_arg (ap, double);
+			unsigned char digits [DTOA_MAXDIGITS];
+			int ndig, exp10, nfrac, i, len;
+			small_int_t eformat, shortest = 0;
+
 			/*
 			 * don't do unrealistic precision; just pad it with
 			 * zeroes later, so buffer size stays rational.
+			 * Long double without precision (%lf, %le, %lg)
+			 * gives the shortest digits, which read back
+			 * to the same value.
 			 */
 			if (dwidth > DBL_DIG) {
 				if ((c != 'g' && c != 'G') || sharpflag)
 					extrazeros = dwidth - DBL_DIG;
 				dwidth = DBL_DIG;
 			} else if (dwidth == -1) {
-				dwidth = (lflag ? DBL_DIG : FLT_DIG);
+				if (lflag)
+					shortest = 1;
+				else
+					dwidth = FLT_DIG;
 			}
-			/*
-			 * softsign avoids negative 0 if d is < 0 and
-			 * no significant digits will be shown
-			 */
 			if (d < 0) {
 				neg = 1;
 				d = -d;
 			}
-			/*
-			 * cvt may have to round up past the "start" of the
-			 * buffer, i.e. ``intf("%.2f", (double)9.999);'';
-			 * if the first char isn't NULL, it did.
-			 */
 			if (isnan (d) || isinf (d)) {
-				strcpy_flash (nbuf, isnan (d) ? "NaN" : "Inf");
-				size = 3;
+				s = (const unsigned char*) (isnan (d) ? "NaN" : "Inf");
+				n = 3;
 				extrazeros = 0;
-				s = nbuf;
+				eformat = -1;
+				ndig = exp10 = nfrac = 0;
+			} else if (c == 'f' || c == 'F') {
+				eformat = 0;
+				if (shortest) {
+					ndig = dtoa_shortest (d, digits, &exp10);
+					nfrac = ndig - 1 - exp10;
+				} else {
+					ndig = dtoa_fixed (d, DTOA_FRACTION, dwidth,
+						digits, &exp10);
+					nfrac = dwidth;
+				}
+			} else if (c == 'e' || c == 'E') {
+				eformat = 1;
+				if (shortest) {
+					ndig = dtoa_shortest (d, digits, &exp10);
+					nfrac = ndig - 1;
+				} else {
+					ndig = dtoa_fixed (d, DTOA_SIGNIFICANT,
+						dwidth + 1, digits, &exp10);
+					nfrac = dwidth;
+				}
 			} else {
-				*nbuf = 0;
-				size = cvt (d, dwidth, sharpflag, &neg, c,
-					nbuf, nbuf + sizeof(nbuf) - 1);
-				if (*nbuf) {
-					s = nbuf;
-					nbuf [size] = 0;
+				/*
+				 * ``The style used depends on the value converted;
+				 * style e will be used only if the exponent
+				 * resulting from the conversion is less than -4
+				 * or greater than the precision.'' -- ANSI X3J11
+				 */
+				if (shortest) {
+					ndig = dtoa_shortest (d, digits, &exp10);
+					dwidth = DBL_DIG + 1;
 				} else {
-					s = nbuf + 1;
-					nbuf [size + 1] = 0;
+					if (dwidth == 0)
+						dwidth = 1;
+					ndig = dtoa_fixed (d, DTOA_SIGNIFICANT,
+						dwidth, digits, &exp10);
+				}
+				eformat = (exp10 < -4 || exp10 >= dwidth);
+				if (shortest)
+					dwidth = ndig;
+				nfrac = dwidth - 1 - (eformat ? 0 : exp10);
+				if (! sharpflag || shortest) {
+					/* Trim trailing zeros. */
+					while (ndig > 0 && digits [ndig-1] == '0')
+						--ndig;
+					i = ndig - 1 - (eformat ? 0 : exp10);
+					if (nfrac > i)
+						nfrac = i;
 				}
 			}
+			if (nfrac < 0)
+				nfrac = 0;
+
+			/* Compute the length. */
+			if (eformat < 0)
+				len = n;
+			else {
+				len = (nfrac || sharpflag) + nfrac + extrazeros;
+				if (eformat)
+					len += (exp10 <= -100 || exp10 >= 100) ?
+						6 : 5;
+				else if (exp10 > 0)
+					len += exp10 + 1;
+				else
+					len += 1;
+			}
 			if (neg)
-				size++;
+				len++;
+
 			if (! ladjust && width && padding == ' ' &&
-			    (width -= size) > 0)
+			    (width -= len) > 0)
 				do {
 					PUTC (' ');
 				} while (--width > 0);
@@ -457,25 +543,56 @@ number:		if (sign && ((long) ul != 0L)) {
 			if (neg)
 				PUTC ('-');
 
-			if (! ladjust && width && (width -= size) > 0)
+			if (! ladjust && width && (width -= len) > 0)
 				do {
 					PUTC (padding);
 				} while (--width > 0);
 
-			for (; *s; ++s) {
-				if (extrazeros && (*s == 'e' || *s == 'E'))
+#define DIGIT(i) (((i) >= 0 && (i) < ndig) ? digits[i] : '0')
+			if (eformat < 0) {
+				while (n--)
+					PUTC (*s++);
+			} else if (eformat) {
+				/* d.ddde+xx */
+				PUTC (DIGIT (0));
+				if (nfrac || sharpflag)
+					PUTC ('.');
+				for (i=1; i<=nfrac; ++i)
+					PUTC (DIGIT (i));
+				if (extrazeros)
 					do {
 						PUTC ('0');
 					} while (--extrazeros > 0);
-
-				PUTC (*s);
-			}
-			if (extrazeros)
-				do {
+				PUTC ((c == 'E' || c == 'G') ? 'E' : 'e');
+				if (exp10 < 0) {
+					PUTC ('-');
+					exp10 = -exp10;
+				} else
+					PUTC ('+');
+				if (exp10 >= 100) {
+					PUTC (exp10 / 100 + '0');
+					exp10 %= 100;
+				}
+				PUTC (exp10 / 10 + '0');
+				PUTC (exp10 % 10 + '0');
+			} else {
+				/* ddd.ddd */
+				if (exp10 < 0)
 					PUTC ('0');
-				} while (--extrazeros > 0);
+				for (i=0; i<=exp10; ++i)
+					PUTC (DIGIT (i));
+				if (nfrac || sharpflag)
+					PUTC ('.');
+				for (i=1; i<=nfrac; ++i)
+					PUTC (DIGIT (exp10 + i));
+				if (extrazeros)
+					do {
+						PUTC ('0');
+					} while (--extrazeros > 0);
+			}
+#undef DIGIT
 
-			if (ladjust && width && (width -= size) > 0)
+			if (ladjust && width && (width -= len) > 0)
 				do {
 					PUTC (' ');
 				} while (--width > 0);
@@ -519,311 +636,70 @@ ksprintn (unsigned char *nbuf, unsigned long ul, unsigned char base, int width,
 	return (p);
 }
 
-static unsigned char
-mkhex (unsigned char ch)
-{
-	ch &= 15;
-	if (ch > 9)
-		return ch + 'a' - 10;
-	return ch + '0';
-}
+#if ! __AVR__
+/*
+ * Pairs of decimal digits, from "00" to "99".
+ */
+static const unsigned char digits2 [200] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+#define PUT2(p,r) { *++p = digits2 [2*(r) + 1]; *++p = digits2 [2*(r)]; }
+#else
+/* On AVR constant tables are placed in RAM: use byte division instead. */
+#define PUT2(p,r) { *++p = (r) % 10 + '0'; *++p = (r) / 10 + '0'; }
+#endif
 
-#if ARCH_HAVE_FPU
+/*
+ * Same as ksprintn() for base 10. Produces two digits per division,
+ * and switches to native unsigned arithmetic as soon as the value fits,
+ * which matters on targets without hardware divide.
+ */
 static unsigned char *
-cvtround (double fract, int *exp, unsigned char *start, unsigned char *end, unsigned char ch,
-	unsigned char *negp)
+ksprintn10 (unsigned char *nbuf, unsigned long ul, int width,
+	unsigned char *lenp)
 {
-	double tmp;
+	unsigned char *p;
+	unsigned u, r;
 
-	if (fract) {
-		modf (fract * 10, &tmp);
-	} else {
-		tmp = ch - '0';
+	p = nbuf;
+	*p = 0;
+	while (ul > (unsigned) -1) {
+		r = ul % 100;
+		ul /= 100;
+		PUT2 (p, r);
 	}
-	if (tmp > 4) {
-		for (;; --end) {
-			if (*end == '.') {
-				--end;
-			}
-			if (++*end <= '9') {
-				break;
-			}
-			*end = '0';
-			if (end == start) {
-				if (exp) {	/* e/E; increment exponent */
-					*end = '1';
-					++*exp;
-				} else {	/* f; add extra digit */
-					*--end = '1';
-					--start;
-				}
-				break;
-			}
-		}
-	} else if (*negp) {
-		/*
-		 * ``"%.3f", (double)-0.0004'' gives you a negative 0.
-		 */
-		for (;; --end) {
-			if (*end == '.') {
-				--end;
-			}
-			if (*end != '0') {
-				break;
-			}
-			if (end == start) {
-				*negp = 0;
-			}
-		}
+	u = ul;
+	while (u >= 100) {
+		r = u % 100;
+		u /= 100;
+		PUT2 (p, r);
 	}
-	return start;
+	if (u >= 10) {
+		PUT2 (p, u);
+	} else
+		*++p = u + '0';
+
+	/* Leading zeros for precision. */
+	while (p - nbuf < width)
+		*++p = '0';
+	if (lenp)
+		*lenp = p - nbuf;
+	return (p);
 }
 
-static unsigned char *
-exponent (unsigned char *p, int exp, unsigned char fmtch)
+static unsigned char
+mkhex (unsigned char ch)
 {
-	unsigned char expbuf [8], *t;
-
-	*p++ = fmtch;
-	if (exp < 0) {
-		exp = -exp;
-		*p++ = '-';
-	} else {
-		*p++ = '+';
-	}
-	t = expbuf + sizeof(expbuf);
-	if (exp > 9) {
-		do {
-			*--t = exp % 10 + '0';
-		} while ((exp /= 10) > 9);
-		*--t = exp + '0';
-		for (; t < expbuf + sizeof(expbuf); *p++ = *t++)
-			continue;
-	} else {
-		*p++ = '0';
-		*p++ = exp + '0';
-	}
-	return p;
+	ch &= 15;
+	if (ch > 9)
+		return ch + 'a' - 10;
+	return ch + '0';
 }
 
-static int
-cvt (double number, int prec, int sharpflag, unsigned char *negp, unsigned char fmtch,
-	unsigned char *startp, unsigned char *endp)
-{
-	unsigned char *p, *t;
-	double fract;
-	int dotrim, expcnt, gformat;
-	double integer, tmp;
-
-	expcnt = 0;
-	dotrim = expcnt = gformat = 0;
-	fract = modf (number, &integer);
-
-	/*
-	 * get an extra slot for rounding
-	 */
-	t = ++startp;
-
-	/*
-	 * get integer portion of number; put into the end of the buffer; the
-	 * .01 is added for modf (356.0 / 10, &integer) returning .59999999...
-	 */
-	for (p = endp - 1; integer; ++expcnt) {
-		tmp = modf (integer / 10, &integer);
-		*p-- = (int) ((tmp + .01) * 10) + '0';
-	}
-	switch (fmtch) {
-	case 'f':
-		/* reverse integer into beginning of buffer */
-		if (expcnt) {
-			for (; ++p < endp; *t++ = *p);
-		} else {
-			*t++ = '0';
-		}
-
-		/*
-		 * if precision required or alternate flag set, add in a
-		 * decimal point.
-		 */
-		if (prec || sharpflag) {
-			*t++ = '.';
-		}
-
-		/*
-		 * if requires more precision and some fraction left
-		 */
-		if (fract) {
-			if (prec) {
-				do {
-					fract = modf (fract * 10, &tmp);
-					*t++ = (int)tmp + '0';
-				} while (--prec && fract);
-			}
-			if (fract) {
-				startp = cvtround (fract, 0, startp,
-					t - 1, '0', negp);
-			}
-		}
-		for (; prec--; *t++ = '0');
-		break;
-	case 'e':
-	case 'E':
-eformat:	if (expcnt) {
-			*t++ = *++p;
-			if (prec || sharpflag) {
-				*t++ = '.';
-			}
-
-			/*
-			 * if requires more precision and some integer left
-			 */
-			for (; prec && ++p < endp; --prec) {
-				*t++ = *p;
-			}
-
-			/*
-			 * if done precision and more of the integer component,
-			 * round using it; adjust fract so we don't re-round
-			 * later.
-			 */
-			if (! prec && ++p < endp) {
-				fract = 0;
-				startp = cvtround (0, &expcnt, startp,
-					t - 1, *p, negp);
-			}
-			/*
-			 * adjust expcnt for digit in front of decimal
-			 */
-			--expcnt;
-		}
-		/*
-		 * until first fractional digit, decrement exponent
-		 */
-		else if (fract) {
-			/*
-			 * adjust expcnt for digit in front of decimal
-			 */
-			for (expcnt = -1;; --expcnt) {
-				fract = modf (fract * 10, &tmp);
-				if (tmp) {
-					break;
-				}
-			}
-			*t++ = (int)tmp + '0';
-			if (prec || sharpflag) {
-				*t++ = '.';
-			}
-		} else {
-			*t++ = '0';
-			if (prec || sharpflag) {
-				*t++ = '.';
-			}
-		}
-		/*
-		 * if requires more precision and some fraction left
-		 */
-		if (fract) {
-			if (prec) {
-				do {
-					fract = modf (fract * 10, &tmp);
-					*t++ = (int)tmp + '0';
-				} while (--prec && fract);
-			}
-			if (fract) {
-				startp = cvtround (fract, &expcnt, startp,
-					t - 1, '0', negp);
-			}
-		}
-		/*
-		 * if requires more precision
-		 */
-		for (; prec--; *t++ = '0');
-
-		/*
-		 * unless alternate flag, trim any g/G format trailing 0's
-		 */
-		if (gformat && ! sharpflag) {
-			while (t > startp && *--t == '0');
-			if (*t == '.') {
-				--t;
-			}
-			++t;
-		}
-		t = exponent (t, expcnt, fmtch);
-		break;
-	case 'g':
-	case 'G':
-		/*
-		 * a precision of 0 is treated as a precision of 1
-		 */
-		if (!prec) {
-			++prec;
-		}
-
-		/*
-		 * ``The style used depends on the value converted; style e
-		 * will be used only if the exponent resulting from the
-		 * conversion is less than -4 or greater than the precision.''
-		 *	-- ANSI X3J11
-		 */
-		if (expcnt > prec || (! expcnt && fract && fract < .0001)) {
-			/*
-			 * g/G format counts "significant digits, not digits of
-			 * precision; for the e/E format, this just causes an
-			 * off-by-one problem, i.e. g/G considers the digit
-			 * before the decimal point significant and e/E doesn't
-			 * count it as precision.
-			 */
-			--prec;
-			fmtch -= 2;		/* G->E, g->e */
-			gformat = 1;
-			goto eformat;
-		}
-		/*
-		 * reverse integer into beginning of buffer,
-		 * note, decrement precision
-		 */
-		if (expcnt) {
-			for (; ++p < endp; *t++ = *p, --prec);
-		} else {
-			*t++ = '0';
-		}
-		/*
-		 * if precision required or alternate flag set, add in a
-		 * decimal point.  If no digits yet, add in leading 0.
-		 */
-		if (prec || sharpflag) {
-			dotrim = 1;
-			*t++ = '.';
-		} else {
-			dotrim = 0;
-		}
-		/*
-		 * if requires more precision and some fraction left
-		 */
-		while (prec && fract) {
-			fract = modf (fract * 10, &tmp);
-			*t++ = (int)tmp + '0';
-			prec--;
-		}
-		if (fract) {
-			startp = cvtround (fract, 0, startp, t - 1, '0', negp);
-		}
-		/*
-		 * alternate format, adds 0's for precision, else trim 0's
-		 */
-		if (sharpflag) {
-			for (; prec--; *t++ = '0');
-		} else if (dotrim) {
-			while (t > startp && *--t == '0');
-			if (*t != '.') {
-				++t;
-			}
-		}
-	}
-	return(t - startp);
-}
-#endif /* ARCH_HAVE_FPU */
 
 #ifdef TEST
 /*
@@ -0,0 +1,22 @@
+#include <runtime/lib.h>
+#include <stream/stream.h>
+
+/*
+ * Write a block of bytes. When the stream has no write method,
+ * fall back to putc for every byte.
+ */
+int
+stream_write (stream_t *u, const void *buf, int len)
+{
+	const unsigned char *p = buf;
+	int n;
+
+	if (len <= 0)
+		return 0;
+	if (u->interface->write)
+		return u->interface->write (u, buf, len);
+
+	for (n=0; n<len; ++n)
+		u->interface->putc (u, *p++);
+	return len;
+}
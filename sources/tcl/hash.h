@@ -14,6 +14,27 @@
  * express or implied warranty.
  */
 
+/*
+ * Lists of free blocks of small sizes, kept for reuse instead of
+ * returning them to the memory pool.  Procedure calls create and
+ * delete many variables and hash entries of the same few sizes:
+ * with the cache they do not go through the pool and do not
+ * fragment it.  See Tcl_CacheAlloc in tclAlloc.c for details.
+ */
+#define TCL_CACHE_GRAIN		8	/* Sizes of classes:  8, 16, ... */
+#define TCL_CACHE_CLASSES	8	/* ... up to 64 bytes. */
+#define TCL_CACHE_DEPTH		16	/* Max free blocks of one class. */
+
+typedef struct Tcl_BlockCache {
+    mem_pool_t *pool;			/* Pool for allocating memory. */
+    void *freeList [TCL_CACHE_CLASSES];	/* Free blocks of every class,
+					 * linked through the first word. */
+    unsigned char numFree [TCL_CACHE_CLASSES];
+					/* Number of blocks in freeList. */
+    unsigned long numAllocs;		/* Blocks requested. */
+    unsigned long numHits;		/* Requests served from freeList. */
+} Tcl_BlockCache;
+
 /*
  * Structure definition for an entry in a hash table.  No-one outside
  * Tcl should access any of these fields directly;  use the macros
@@ -50,6 +71,8 @@ typedef struct Tcl_HashEntry {
 
 typedef struct Tcl_HashTable {
     mem_pool_t *pool;			/* Pool for allocating memory. */
+    Tcl_BlockCache *cachePtr;		/* Cache for entries, or NULL to
+					 * allocate them from the pool. */
     Tcl_HashEntry **buckets;		/* Pointer to bucket array.  Each
 					 * element points to first entry in
 					 * bucket's hash chain, or NULL. */
@@ -113,9 +136,18 @@ typedef struct Tcl_HashSearch {
 #define Tcl_CreateHashEntry(tablePtr, key, newPtr) \
 	(*((tablePtr)->createProc))(tablePtr, key, newPtr)
 
+/*
+ * Macro to allocate the entries of a table from the cache.
+ */
+#define Tcl_SetHashCache(tablePtr, cache) ((tablePtr)->cachePtr = (cache))
+
 /*
  * Exported procedures:
  */
+extern void *		Tcl_CacheAlloc (Tcl_BlockCache *cachePtr,
+				unsigned size);
+extern void		Tcl_CacheFlush (Tcl_BlockCache *cachePtr);
+extern void		Tcl_CacheFree (Tcl_BlockCache *cachePtr, void *block);
 extern void		Tcl_DeleteHashEntry (Tcl_HashEntry *entryPtr);
 extern void		Tcl_DeleteHashTable (Tcl_HashTable *tablePtr);
 extern Tcl_HashEntry *	Tcl_FirstHashEntry (Tcl_HashTable *tablePtr,
@@ -205,8 +205,115 @@ typedef struct Proc {
 				 * the procedure (dynamically allocated). */
     Arg *argPtr;		/* Pointer to first of procedure's formal
 				 * arguments, or NULL if none. */
+    struct CompiledScript *compiled;
+				/* Compiled form of the body, made on the
+				 * first call, or NULL. */
+    unsigned char noCompile;	/* Non-zero means the body could not be
+				 * compiled:  interpret it from text. */
+    unsigned short refCount;	/* Number of active calls, plus one for
+				 * the command.  Freed when it drops to 0. */
+    unsigned long id;		/* Unique number of the procedure:  compiled
+				 * scripts and expressions, which refer to
+				 * its local variables by slots, keep it. */
+    unsigned char **locals;	/* Names of local variables, indexed by
+				 * slot:  the arguments, then variables
+				 * referenced in the body as $name. */
+    unsigned short numLocals;	/* Number of entries in locals. */
 } Proc;
 
+/*
+ * Max. number of local variables with slots.  Other names are
+ * found in the hash table of the call frame.  NO_SLOT marks
+ * a name, which has no slot.
+ */
+#define MAX_LOCALS 64
+#define NO_SLOT 0xff
+
+/*
+ *----------------------------------------------------------------
+ * Data structures related to compiled scripts.   These are used
+ * primarily in tclComp.c
+ *----------------------------------------------------------------
+ */
+
+/*
+ * The structure below defines one word of a compiled command.
+ * Literal words get their final value at compile time;  a word,
+ * which is a single command in brackets, is compiled too;  other
+ * words keep their source text and are substituted on each
+ * execution.
+ */
+typedef struct CompiledWord {
+    unsigned char *text;	/* Value of a literal word, or source text
+				 * of a word to substitute, or the start of
+				 * a bracketed command in the source. */
+    struct CompiledScript *script; /* Compiled bracketed command, or
+				 * NULL. */
+    unsigned char flags;	/* See below. */
+    unsigned char slot;		/* For WORD_LOCAL, index of the variable
+				 * in the locals of the procedure, which
+				 * owns the script, or NO_SLOT. */
+} CompiledWord;
+
+/*
+ * Flag bits for compiled words:
+ *
+ * WORD_LITERAL -		1 means the word has no substitutions.
+ * WORD_COPY -			1 means the literal looks like an array
+ *				element name, which is modified in place
+ *				by the variable procedures:  pass them
+ *				a copy.
+ * WORD_SCRIPT -		1 means the word is a command substitution,
+ *				compiled into the separate script.
+ * WORD_LOCAL -			1 means the word is a simple variable
+ *				name, which may get a slot:  either
+ *				$name, or a literal name in the second
+ *				word (used by "set" and "incr").
+ */
+#define WORD_LITERAL		1
+#define WORD_COPY		2
+#define WORD_SCRIPT		4
+#define WORD_LOCAL		8
+
+/*
+ * The structure below defines one command of a compiled script:
+ * the words, already split, and the command procedure found
+ * when the command was executed last time.
+ */
+typedef struct CompiledCmd {
+    unsigned char *start;	/* First character of the command in
+				 * the source text (for error messages). */
+    unsigned char *end;		/* Character just after the command. */
+    CompiledWord *words;	/* Array of words. */
+    unsigned short numWords;	/* Number of words. */
+    struct Command *cmdPtr;	/* Command procedure, or NULL if not
+				 * found yet or the name is substituted. */
+    unsigned long cmdEpoch;	/* Value of interp->cmdEpoch when cmdPtr
+				 * was found. */
+} CompiledCmd;
+
+/*
+ * The structure below defines a compiled script.  The commands,
+ * the words, the literal values and a copy of the source text
+ * are allocated in one block together with this structure.
+ */
+typedef struct CompiledScript {
+    unsigned short refCount;	/* Number of references:  the owner
+				 * (procedure or script cache) plus active
+				 * executions.  Freed when it drops to 0. */
+    unsigned short numCmds;	/* Number of commands. */
+    CompiledCmd *cmds;		/* Array of commands. */
+    unsigned char *source;	/* Copy of the source text. */
+    Tcl_HashEntry *hPtr;	/* Entry in interp->scriptTable, or NULL
+				 * if not in the script cache. */
+    unsigned long lastUse;	/* Value of interp->scriptClock on the
+				 * last lookup, for cache replacement. */
+    unsigned long procId;	/* Procedure, to which the slots of
+				 * WORD_LOCAL words refer, or 0.  They
+				 * are resolved again, when the script
+				 * runs in another procedure. */
+} CompiledScript;
+
 /*
  * The structure below defines a command trace.  This is used to allow Tcl
  * clients to find out whenever a command is about to be executed.
@@ -245,6 +352,12 @@ typedef struct CallFrame {
 				 * as callerPtr unless an "uplevel" command
 				 * or something equivalent was active in
 				 * the caller). */
+    Proc *procPtr;		/* Procedure of this invocation. */
+    Tcl_HashEntry **slots;	/* Hash entries of local variables, indexed
+				 * by slot as procPtr->locals;  NULL means
+				 * not looked up yet. */
+    unsigned long varEpoch;	/* Value of interp->varEpoch, when the
+				 * slots were filled. */
 } CallFrame;
 
 /*
@@ -359,6 +472,10 @@ typedef struct Interp {
     Tcl_HashTable commandTable;	/* Contains all of the commands currently
 				 * registered in this interpreter.  Indexed
 				 * by strings; values have type (Command *). */
+    unsigned long cmdEpoch;	/* Incremented when commands are created,
+				 * deleted or renamed:  invalidates the
+				 * command procedures, remembered in
+				 * compiled scripts. */
 
     /*
      * Information related to procedures and variables.  See tclProc.c
@@ -383,6 +500,10 @@ typedef struct Interp {
     ActiveVarTrace *activeTracePtr;
 				/* First in list of active traces for interp,
 				 * or NULL if no active traces. */
+    unsigned long varEpoch;	/* Incremented when variables of call frames
+				 * are deleted:  invalidates the slots. */
+    unsigned long procEpoch;	/* Incremented when procedures are created,
+				 * to give them unique numbers. */
 
     /*
      * Information related to history:
@@ -440,20 +561,58 @@ typedef struct Interp {
      * A cache of compiled regular expressions.  See TclCompileRegexp
      * in tclUtil.c for details.
      */
-#define NUM_REGEXPS 5
-    unsigned char *patterns [NUM_REGEXPS];
-				/* Strings corresponding to compiled
-				 * regular expression patterns.  NULL
-				 * means that this slot isn't used.
-				 * Malloc-ed. */
-    unsigned short patLengths [NUM_REGEXPS];
-				/* Number of non-null characters in
-				 * corresponding entry in patterns.
-				 * -1 means entry isn't used. */
-    struct _regexp_t *regexps [NUM_REGEXPS];
-				/* Compiled forms of above strings.  Also
-				 * malloc-ed, or NULL if not in use yet. */
+#ifndef NUM_REGEXPS
+#define NUM_REGEXPS 16
+#endif
+    Tcl_HashTable regexpTable;	/* Compiled regular expressions, indexed
+				 * by pattern;  values have type
+				 * (CachedRegexp *). */
+    unsigned short numRegexps;	/* Number of entries in regexpTable. */
+    unsigned short maxRegexps;	/* Size of the cache:  NUM_REGEXPS, or
+				 * set by "info regexps size". */
+    unsigned long regexpClock;	/* Incremented on every lookup. */
+    unsigned long regexpHits;	/* Lookups found in the cache. */
+    unsigned long regexpMisses;	/* Patterns compiled. */
 
+    /*
+     * A cache of compiled loop and branch bodies.  See
+     * TclGetCompiledScript in tclComp.c for details.
+     */
+#define NUM_SCRIPTS 16
+    Tcl_HashTable scriptTable;	/* Compiled scripts, indexed by source
+				 * text;  values have type
+				 * (CompiledScript *). */
+    unsigned short numScripts;	/* Number of entries in scriptTable. */
+    unsigned long scriptClock;	/* Incremented on every lookup. */
+
+    /*
+     * A cache of compiled expressions.  See get_program in
+     * tclExpr.c for details.
+     */
+#define NUM_EXPRS 16
+    Tcl_HashTable exprTable;	/* Compiled expressions, indexed by
+				 * source text. */
+    unsigned short numExprs;	/* Number of entries in exprTable. */
+    unsigned long exprClock;	/* Incremented on every lookup. */
+
+    /*
+     * Memory for transient parse buffers and results, and the cache
+     * of free variables and hash entries.  See tclAlloc.c for details.
+     */
+#ifndef TCL_ARENA_SIZE
+#define TCL_ARENA_SIZE 1024
+#endif
+    mem_pool_t arena;		/* Pool over arenaSpace, released after
+				 * every top-level Tcl_Eval. */
+    unsigned char *arenaSpace;	/* Memory of the arena, taken from the
+				 * pool of the interpreter.  NULL means
+				 * there is no arena. */
+    unsigned short arenaPeak;	/* Max number of bytes used in the arena. */
+    unsigned long arenaResets;	/* Number of times the arena was released. */
+    unsigned long arenaSpills;	/* Allocations, which did not fit into
+				 * the arena and went to the pool. */
+    Tcl_BlockCache blockCache;	/* Free Vars and hash entries of variable
+				 * tables. */
 
     /*
      * Miscellaneous information:
@@ -493,11 +652,19 @@ typedef struct Interp {
  *			called to record information for the current
  *			error.  Zero means Tcl_Eval must clear the
  *			errorCode variable if an error is returned.
+ * COMPILING:		Non-zero means a script is being parsed by the
+ *			compiler:  Tcl_Eval must not log parse errors
+ *			of nested commands in $errorInfo.
+ * NO_COMPILE:		Non-zero means procedure and loop bodies are
+ *			interpreted from text, as by Tcl_Eval (used for
+ *			debugging and benchmarks).
  */
 #define DELETED			1
 #define ERR_IN_PROGRESS		2
 #define ERR_ALREADY_LOGGED	4
 #define ERROR_CODE_SET		8
+#define COMPILING		0x10
+#define NO_COMPILE		0x20
 
 /*
  *----------------------------------------------------------------
@@ -522,7 +689,7 @@ typedef struct ParseValue {
     unsigned char *end;		/* Address of the last usable character
 				 * in the buffer. */
     void (*expandProc) (struct ParseValue *pvPtr, unsigned short needed,
-	struct _mem_pool_t *pool);
+	Tcl_Interp *interp);
 				/* Procedure to call when space runs out;
 				 * it will make more space. */
     void *clientData;		/* Arbitrary information for use of
@@ -576,28 +743,54 @@ typedef struct ParseValue {
  * world:
  *----------------------------------------------------------------
  */
+extern void *		TclArenaAlloc (Interp *iPtr, unsigned size);
+extern void		TclArenaReset (Interp *iPtr);
 extern struct _regexp_t *TclCompileRegexp (Tcl_Interp *interp,
 			    unsigned char *string);
 extern void		TclCopyAndCollapse (int count, unsigned char *src,
 			    unsigned char *dst);
+extern CompiledScript *	TclCompileScript (Interp *iPtr,
+			    unsigned char *script);
+extern void		TclDeleteExprs (Interp *iPtr);
+extern void		TclDeleteRegexps (Interp *iPtr);
+extern void		TclDeleteScripts (Interp *iPtr);
+extern void		TclSetRegexpCacheSize (Interp *iPtr, int size);
 extern void		TclDeleteVars (Interp *iPtr,
 			    Tcl_HashTable *tablePtr);
+extern int		TclEvalBody (Tcl_Interp *interp,
+			    unsigned char *body);
+extern int		TclEvalCompiled (Tcl_Interp *interp,
+			    CompiledScript *csPtr, unsigned char *body);
+extern int		TclEvalFinish (Interp *iPtr, int result);
+extern int		TclExecScript (Interp *iPtr,
+			    CompiledScript *csPtr, unsigned *offsetPtr);
 extern void		TclExpandParseValue (ParseValue *pvPtr,
-			    unsigned short needed, struct _mem_pool_t *pool);
+			    unsigned short needed, Tcl_Interp *interp);
 extern int		TclFindElement (Tcl_Interp *interp,
 			    unsigned char *list, unsigned char **elementPtr,
 			    unsigned char **nextPtr, int *sizePtr, int *bracePtr);
+extern int		TclFindLocal (Interp *iPtr,
+			    unsigned char *name, int length);
 extern Proc *		TclFindProc (Interp *iPtr,
 			    unsigned char *procName);
+extern CompiledScript *	TclGetCompiledScript (Interp *iPtr,
+			    unsigned char *script);
 extern int		TclGetFrame (Tcl_Interp *interp,
 			    unsigned char *string, CallFrame **framePtrPtr);
+extern unsigned char *	TclGetLocal (Interp *iPtr,
+			    unsigned long procId, int slot);
 extern int		TclGetListIndex (Tcl_Interp *interp,
 			    unsigned char *string, int *indexPtr);
 extern int		TclGetOpenFile (Tcl_Interp *interp,
 			    unsigned char *string, OpenFile **filePtrPtr);
 extern Proc *		TclIsProc (Command *cmdPtr);
+extern void		TclLogEvalError (Interp *iPtr, unsigned char *script,
+			    unsigned char *cmdStart, unsigned char *cmdEnd,
+			    unsigned char *ellipsis);
 extern void		TclMakeFileTable (Interp *iPtr,
 			    int index);
+extern void		TclMergeResult (Tcl_Interp *interp,
+			    int argc, unsigned char **argv);
 extern int		TclParseBraces (Tcl_Interp *interp,
 			    unsigned char *string, unsigned char **termPtr,
 			    ParseValue *pvPtr);
@@ -611,7 +804,14 @@ extern int		TclParseWords (Tcl_Interp *interp,
 			    unsigned char *string, int flags, int maxWords,
 			    unsigned char **termPtr, int *argcPtr, unsigned char **argv,
 			    ParseValue *pvPtr);
+extern void		TclReleaseScript (CompiledScript *csPtr);
+extern unsigned char *	TclSetLocal (Interp *iPtr,
+			    unsigned long procId, int slot,
+			    unsigned char *newValue);
 extern void		TclSetupEnv (Tcl_Interp *interp);
+extern int		TclSplitList (Tcl_Interp *interp,
+			    unsigned char *list, int *argcPtr,
+			    unsigned char ***argvPtr);
 extern unsigned char *	TclWordEnd (unsigned char *start, int nested);
 
 /*
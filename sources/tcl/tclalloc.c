@@ -0,0 +1,226 @@
+/*
+ * tclAlloc.c --
+ *
+ *	This file contains the memory management of the interpreter,
+ *	which keeps the shared memory pool from fragmenting:  the arena
+ *	for transient parse buffers and results, released after every
+ *	top-level Tcl_Eval, and the cache of free blocks for variables
+ *	and hash entries.
+ */
+#include <tcl/internal.h>
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_CacheAlloc --
+ *
+ *	Allocate a block of memory:  blocks of small sizes are taken
+ *	from the free list of their size class, when possible.
+ *
+ * Results:
+ *	The return value is a pointer to zeroed memory of at least
+ *	"size" bytes, or NULL if there is no memory.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void *
+Tcl_CacheAlloc(cachePtr, size)
+    Tcl_BlockCache *cachePtr;	/* Cache to allocate from. */
+    unsigned size;		/* Number of bytes needed. */
+{
+    void *block;
+    unsigned class;
+
+    class = (size - 1) / TCL_CACHE_GRAIN;
+    if ((size == 0) || (class >= TCL_CACHE_CLASSES)) {
+	return mem_alloc(cachePtr->pool, size);
+    }
+    cachePtr->numAllocs++;
+    size = (class + 1) * TCL_CACHE_GRAIN;
+    block = cachePtr->freeList[class];
+    if (block == 0) {
+	return mem_alloc(cachePtr->pool, size);
+    }
+    cachePtr->freeList[class] = *(void **) block;
+    cachePtr->numFree[class]--;
+    cachePtr->numHits++;
+    memset(block, 0, size);
+    return block;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_CacheFree --
+ *
+ *	Free a block of memory, allocated by Tcl_CacheAlloc or
+ *	mem_alloc:  put it to the free list of its size class, or
+ *	return it to the pool, when it is large or the list is full.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tcl_CacheFree(cachePtr, block)
+    Tcl_BlockCache *cachePtr;	/* Cache to free to. */
+    void *block;		/* Block to free. */
+{
+    unsigned class;
+
+    /*
+     * The pool may give a bit more memory than requested:  then the
+     * block goes to the class of the largest size it can serve.
+     */
+
+    class = mem_size(block) / TCL_CACHE_GRAIN - 1;
+    if ((class >= TCL_CACHE_CLASSES)
+	    || (cachePtr->numFree[class] >= TCL_CACHE_DEPTH)) {
+	mem_free(block);
+	return;
+    }
+    *(void **) block = cachePtr->freeList[class];
+    cachePtr->freeList[class] = block;
+    cachePtr->numFree[class]++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_CacheFlush --
+ *
+ *	Return all the free blocks of the cache to the pool.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+Tcl_CacheFlush(cachePtr)
+    Tcl_BlockCache *cachePtr;	/* Cache to empty. */
+{
+    void *block;
+    int class;
+
+    for (class = 0; class < TCL_CACHE_CLASSES; class++) {
+	while (cachePtr->freeList[class] != 0) {
+	    block = cachePtr->freeList[class];
+	    cachePtr->freeList[class] = *(void **) block;
+	    mem_free(block);
+	}
+	cachePtr->numFree[class] = 0;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclArenaAlloc --
+ *
+ *	Allocate memory for a transient parse buffer or a result.
+ *	The arena is a small pool of the interpreter, so the block is
+ *	freed by mem_free as usual.  When the arena is full, the memory
+ *	is allocated from the pool of the interpreter.
+ *
+ * Results:
+ *	The return value is a pointer to zeroed memory.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void *
+TclArenaAlloc(iPtr, size)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned size;		/* Number of bytes needed. */
+{
+    void *block = 0;
+    unsigned used;
+
+    if (iPtr->arenaSpace != 0) {
+	block = mem_alloc(&iPtr->arena, size);
+    }
+    if (block == 0) {
+	iPtr->arenaSpills++;
+	return mem_alloc(iPtr->pool, size);
+    }
+    used = TCL_ARENA_SIZE - mem_available(&iPtr->arena);
+    if (used > iPtr->arenaPeak) {
+	iPtr->arenaPeak = used;
+    }
+    return block;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclArenaReset --
+ *
+ *	Release the arena, when the top-level Tcl_Eval is finished.
+ *	The result, if it is in the arena, is moved out:  to the
+ *	static space, or to the pool.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	All the blocks, still allocated in the arena, are freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclArenaReset(iPtr)
+    Interp *iPtr;		/* Interpreter. */
+{
+    unsigned char *result = iPtr->result;
+    Tcl_FreeProc *freeProc = iPtr->freeProc;
+    int length;
+
+    if (iPtr->arenaSpace == 0) {
+	return;
+    }
+    iPtr->arenaResets++;
+    if ((result >= iPtr->arenaSpace)
+	    && (result < iPtr->arenaSpace + TCL_ARENA_SIZE)) {
+	length = strlen(result);
+	if (length <= TCL_RESULT_SIZE) {
+	    iPtr->result = iPtr->resultSpace;
+	    iPtr->freeProc = 0;
+	} else {
+	    iPtr->result = mem_alloc(iPtr->pool, length + 1);
+	    iPtr->freeProc = (Tcl_FreeProc *) mem_free;
+	}
+	memcpy(iPtr->result, result, length + 1);
+	if (freeProc != 0) {
+	    mem_free(result);
+	}
+    }
+
+    /*
+     * Normally every block is freed by its owner, and the arena is
+     * a single hole again.  Otherwise, start it anew.
+     */
+
+    if (mem_available(&iPtr->arena) != TCL_ARENA_SIZE) {
+	memset(&iPtr->arena, 0, sizeof(iPtr->arena));
+	mem_init(&iPtr->arena, (size_t) iPtr->arenaSpace,
+		(size_t) iPtr->arenaSpace + TCL_ARENA_SIZE);
+    }
+}
@@ -124,7 +124,6 @@ Tcl_CreateInterp (mem_pool_t *pool)
     Interp *iPtr;
     Command *c;
     CmdInfo *ci;
-    int i;
 
     iPtr = (Interp*) mem_alloc (pool, sizeof(Interp));
     iPtr->pool = pool;
@@ -132,6 +131,7 @@ Tcl_CreateInterp (mem_pool_t *pool)
     iPtr->freeProc = 0;
     iPtr->errorLine = 0;
     Tcl_InitHashTable (&iPtr->commandTable, pool, TCL_STRING_KEYS);
+    iPtr->cmdEpoch = 0;
     Tcl_InitHashTable (&iPtr->globalTable, pool, TCL_STRING_KEYS);
     iPtr->numLevels = 0;
     iPtr->framePtr = 0;
@@ -150,11 +150,28 @@ Tcl_CreateInterp (mem_pool_t *pool)
     iPtr->appendUsed = 0;
     iPtr->numFiles = 0;
     iPtr->filePtrArray = 0;
-    for (i = 0; i < NUM_REGEXPS; i++) {
-	iPtr->patterns[i] = 0;
-	iPtr->patLengths[i] = -1;
-	iPtr->regexps[i] = 0;
+    Tcl_InitHashTable (&iPtr->regexpTable, pool, TCL_STRING_KEYS);
+    iPtr->numRegexps = 0;
+    iPtr->maxRegexps = NUM_REGEXPS;
+    iPtr->regexpClock = 0;
+    iPtr->regexpHits = 0;
+    iPtr->regexpMisses = 0;
+    Tcl_InitHashTable (&iPtr->scriptTable, pool, TCL_STRING_KEYS);
+    iPtr->numScripts = 0;
+    iPtr->scriptClock = 0;
+    Tcl_InitHashTable (&iPtr->exprTable, pool, TCL_STRING_KEYS);
+    iPtr->numExprs = 0;
+    iPtr->exprClock = 0;
+    iPtr->arenaSpace = mem_alloc (pool, TCL_ARENA_SIZE);
+    if (iPtr->arenaSpace != 0) {
+	mem_init (&iPtr->arena, (size_t) iPtr->arenaSpace,
+	    (size_t) iPtr->arenaSpace + TCL_ARENA_SIZE);
     }
+    iPtr->arenaPeak = 0;
+    iPtr->arenaResets = 0;
+    iPtr->arenaSpills = 0;
+    iPtr->blockCache.pool = pool;
+    Tcl_SetHashCache (&iPtr->globalTable, &iPtr->blockCache);
     iPtr->cmdCount = 0;
     iPtr->noEval = 0;
     iPtr->scriptFile = 0;
@@ -213,7 +230,6 @@ Tcl_DeleteInterp(interp)
     Tcl_HashEntry *he;
     Tcl_HashSearch search;
     register Command *c;
-    int i;
 
     /*
      * If the interpreter is in use, delay the deletion until later.
@@ -280,19 +296,20 @@ Tcl_DeleteInterp(interp)
 	mem_free (iPtr->filePtrArray);
     }
 #endif
-    for (i = 0; i < NUM_REGEXPS; i++) {
-	if (iPtr->patterns[i] == 0) {
-	    break;
-	}
-	mem_free (iPtr->patterns[i]);
-	mem_free (iPtr->regexps[i]);
-    }
+    TclDeleteRegexps(iPtr);
+    TclDeleteExprs(iPtr);
+    TclDeleteScripts(iPtr);
     while (iPtr->tracePtr != 0) {
 	Trace *nextPtr = iPtr->tracePtr->nextPtr;
 
 	mem_free (iPtr->tracePtr);
 	iPtr->tracePtr = nextPtr;
     }
+    Tcl_FreeResult (interp);
+    Tcl_CacheFlush (&iPtr->blockCache);
+    if (iPtr->arenaSpace != 0) {
+	mem_free (iPtr->arenaSpace);
+    }
     mem_free (iPtr);
 }
 
@@ -333,6 +350,7 @@ Tcl_CreateCommand(interp, cmdName, proc, clientData, deleteProc)
     Tcl_HashEntry *he;
     int new;
 
+    iPtr->cmdEpoch++;
     he = Tcl_CreateHashEntry(&iPtr->commandTable, cmdName, &new);
     if (!new) {
 	/*
@@ -385,6 +403,7 @@ Tcl_DeleteCommand(interp, cmdName)
     if (he == 0) {
 	return -1;
     }
+    iPtr->cmdEpoch++;
     c = (Command *) Tcl_GetHashValue(he);
     if (c->deleteProc != 0) {
 	(*c->deleteProc)(c->clientData);
@@ -538,7 +557,7 @@ Tcl_Eval(interp, cmd, flags, termPtr)
 	    case '\r':
 	    case '\n':
 	    case ' ':
-	    case ':':
+	    case ';':
 		++src;
 		continue;
 	    }
@@ -611,7 +630,7 @@ Tcl_Eval(interp, cmd, flags, termPtr)
 	     */
 
 	    argSize *= 2;
-	    newArgv = (unsigned char**) mem_alloc (iPtr->pool,
+	    newArgv = (unsigned char**) TclArenaAlloc (iPtr,
 		(unsigned) argSize * sizeof(char *));
 	    for (i = 0; i < argc; i++) {
 		newArgv[i] = argv[i];
@@ -715,6 +734,46 @@ Tcl_Eval(interp, cmd, flags, termPtr)
     if (argv != argStorage) {
 	mem_free (argv);
     }
+    result = TclEvalFinish(iPtr, result);
+
+    /*
+     * If an error occurred, record information about what was being
+     * executed when the error occurred.
+     */
+
+    if ((result == TCL_ERROR) &&
+	    !(iPtr->flags & (ERR_ALREADY_LOGGED | COMPILING))) {
+	TclLogEvalError(iPtr, cmd, cmdStart, src, ellipsis);
+    }
+    iPtr->flags &= ~ERR_ALREADY_LOGGED;
+    return result;
+}
+
+/*
+ *-----------------------------------------------------------------
+ *
+ * TclEvalFinish --
+ *
+ *	Leave one level of Tcl_Eval.  When returning to the top level,
+ *	convert "return", "break" and "continue" to normal results
+ *	or errors, and release the arena.
+ *
+ * Results:
+ *	The return value is the final result code.
+ *
+ * Side effects:
+ *	The interpreter may be deleted, if it was marked for deletion.
+ *
+ *-----------------------------------------------------------------
+ */
+
+int
+TclEvalFinish(iPtr, result)
+    Interp *iPtr;		/* Interpreter. */
+    int result;			/* Result code of the last command. */
+{
+    Tcl_Interp *interp = (Tcl_Interp *) iPtr;
+
     iPtr->numLevels--;
     if (iPtr->numLevels == 0) {
 	if (result == TCL_RETURN) {
@@ -733,65 +792,85 @@ Tcl_Eval(interp, cmd, flags, termPtr)
 	    }
 	    result = TCL_ERROR;
 	}
+	TclArenaReset(iPtr);
 	if (iPtr->flags & DELETED) {
 	    Tcl_DeleteInterp(interp);
 	}
     }
+    return result;
+}
 
-    /*
-     * If an error occurred, record information about what was being
-     * executed when the error occurred.
-     */
+/*
+ *-----------------------------------------------------------------
+ *
+ * TclLogEvalError --
+ *
+ *	Record information about the command, which failed:  the line
+ *	number in interp->errorLine and the text of the command in
+ *	the errorInfo variable.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The errorInfo variable is modified.
+ *
+ *-----------------------------------------------------------------
+ */
 
-    if ((result == TCL_ERROR) && !(iPtr->flags & ERR_ALREADY_LOGGED)) {
-	int numChars;
-	register unsigned char *p;
+void
+TclLogEvalError(iPtr, script, cmdStart, cmdEnd, ellipsis)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *script;	/* Script, which contains the command. */
+    unsigned char *cmdStart;	/* First character of the command. */
+    unsigned char *cmdEnd;	/* Character just after the command. */
+    unsigned char *ellipsis;	/* "..." if not all of the command was
+				 * parsed, "" otherwise. */
+{
+    unsigned char msg[NUM_CHARS];
+    int numChars;
+    register unsigned char *p;
 
-	/*
-	 * Compute the line number where the error occurred.
-	 */
+    /*
+     * Compute the line number where the error occurred.
+     */
 
-	iPtr->errorLine = 1;
-	for (p = cmd; p != cmdStart; p++) {
-	    if (*p == '\n') {
-		iPtr->errorLine++;
-	    }
+    iPtr->errorLine = 1;
+    for (p = script; p != cmdStart; p++) {
+	if (*p == '\n') {
+	    iPtr->errorLine++;
 	}
-	for ( ; isspace(*p) || (*p == ';'); p++) {
-	    if (*p == '\n') {
-		iPtr->errorLine++;
-	    }
+    }
+    for ( ; isspace(*p) || (*p == ';'); p++) {
+	if (*p == '\n') {
+	    iPtr->errorLine++;
 	}
+    }
 
-	/*
-	 * Figure out how much of the command to print in the error
-	 * message (up to a certain number of characters, or up to
-	 * the first new-line).
-	 */
+    /*
+     * Figure out how much of the command to print in the error
+     * message (up to a certain number of characters, or up to
+     * the first new-line).
+     */
 
-	numChars = src - cmdStart;
-	if (numChars > (NUM_CHARS-50)) {
-	    numChars = NUM_CHARS-50;
-	    ellipsis = (unsigned char*) " ...";
-	}
+    numChars = cmdEnd - cmdStart;
+    if (numChars > (NUM_CHARS-50)) {
+	numChars = NUM_CHARS-50;
+	ellipsis = (unsigned char*) " ...";
+    }
 
-	if (!(iPtr->flags & ERR_IN_PROGRESS)) {
-	    snprintf(copyStorage, sizeof (copyStorage),
-		"\n    while executing\n\"%.*s%s\"",
-		    numChars, cmdStart, ellipsis);
-	} else {
-	    snprintf(copyStorage, sizeof (copyStorage),
-		"\n    invoked from within\n\"%.*s%s\"",
-		    numChars, cmdStart, ellipsis);
-	}
-	Tcl_AddErrorInfo(interp, copyStorage);
-	iPtr->flags &= ~ERR_ALREADY_LOGGED;
+    if (!(iPtr->flags & ERR_IN_PROGRESS)) {
+	snprintf(msg, sizeof (msg),
+	    "\n    while executing\n\"%.*s%s\"",
+		numChars, cmdStart, ellipsis);
     } else {
-	iPtr->flags &= ~ERR_ALREADY_LOGGED;
+	snprintf(msg, sizeof (msg),
+	    "\n    invoked from within\n\"%.*s%s\"",
+		numChars, cmdStart, ellipsis);
     }
-    return result;
+    Tcl_AddErrorInfo((Tcl_Interp *) iPtr, msg);
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
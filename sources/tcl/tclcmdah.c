@@ -103,7 +103,7 @@ Tcl_CaseCmd(dummy, interp, argc, argv)
 
     splitArgs = 0;
     if (caseArgc == 1) {
-	result = Tcl_SplitList(interp, caseArgv[0], &caseArgc, &caseArgv);
+	result = TclSplitList(interp, caseArgv[0], &caseArgc, &caseArgv);
 	if (result != TCL_OK) {
 	    return result;
 	}
@@ -148,7 +148,7 @@ Tcl_CaseCmd(dummy, interp, argc, argv)
 	 * in the list.
 	 */
 
-	result = Tcl_SplitList(interp, caseArgv[i], &patArgc, &patArgv);
+	result = TclSplitList(interp, caseArgv[i], &patArgc, &patArgv);
 	if (result != TCL_OK) {
 	    goto cleanup;
 	}
@@ -462,6 +462,7 @@ Tcl_ForCmd(dummy, interp, argc, argv)
     unsigned char **argv;		/* Argument strings. */
 {
     int result, value;
+    CompiledScript *body, *next;
 
     if (argc != 5) {
 	Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
@@ -469,22 +470,24 @@ Tcl_ForCmd(dummy, interp, argc, argv)
 	return TCL_ERROR;
     }
 
-    result = Tcl_Eval(interp, argv[1], 0, 0);
+    result = TclEvalBody(interp, argv[1]);
     if (result != TCL_OK) {
 	if (result == TCL_ERROR) {
 	    Tcl_AddErrorInfo(interp, (unsigned char*) "\n    (\"for\" initial command)");
 	}
 	return result;
     }
+    body = TclGetCompiledScript((Interp *) interp, argv[4]);
+    next = TclGetCompiledScript((Interp *) interp, argv[3]);
     while (1) {
 	result = Tcl_ExprBoolean(interp, argv[2], &value);
 	if (result != TCL_OK) {
-	    return result;
+	    break;
 	}
 	if (!value) {
 	    break;
 	}
-	result = Tcl_Eval(interp, argv[4], 0, 0);
+	result = TclEvalCompiled(interp, body, argv[4]);
 	if (result == TCL_CONTINUE) {
 	    result = TCL_OK;
 	} else if (result != TCL_OK) {
@@ -495,16 +498,22 @@ Tcl_ForCmd(dummy, interp, argc, argv)
 	    }
 	    break;
 	}
-	result = Tcl_Eval(interp, argv[3], 0, 0);
+	result = TclEvalCompiled(interp, next, argv[3]);
 	if (result == TCL_BREAK) {
 	    break;
 	} else if (result != TCL_OK) {
 	    if (result == TCL_ERROR) {
 		Tcl_AddErrorInfo(interp, (unsigned char*) "\n    (\"for\" loop-end command)");
 	    }
-	    return result;
+	    break;
 	}
     }
+    if (body != 0) {
+	TclReleaseScript(body);
+    }
+    if (next != 0) {
+	TclReleaseScript(next);
+    }
     if (result == TCL_BREAK) {
 	result = TCL_OK;
     }
@@ -541,6 +550,7 @@ Tcl_ForeachCmd(dummy, interp, argc, argv)
 {
     int listArgc, i, result;
     unsigned char **listArgv;
+    CompiledScript *body;
 
     if (argc != 4) {
 	Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
@@ -553,10 +563,11 @@ Tcl_ForeachCmd(dummy, interp, argc, argv)
      * for each value of the element.
      */
 
-    result = Tcl_SplitList(interp, argv[2], &listArgc, &listArgv);
+    result = TclSplitList(interp, argv[2], &listArgc, &listArgv);
     if (result != TCL_OK) {
 	return result;
     }
+    body = TclGetCompiledScript((Interp *) interp, argv[3]);
     for (i = 0; i < listArgc; i++) {
 	if (Tcl_SetVar(interp, argv[1], listArgv[i], 0) == 0) {
 	    Tcl_SetResult(interp, (unsigned char*) "couldn't set loop variable", TCL_STATIC);
@@ -564,7 +575,7 @@ Tcl_ForeachCmd(dummy, interp, argc, argv)
 	    break;
 	}
 
-	result = Tcl_Eval(interp, argv[3], 0, 0);
+	result = TclEvalCompiled(interp, body, argv[3]);
 	if (result != TCL_OK) {
 	    if (result == TCL_CONTINUE) {
 		result = TCL_OK;
@@ -582,6 +593,9 @@ Tcl_ForeachCmd(dummy, interp, argc, argv)
 	    }
 	}
     }
+    if (body != 0) {
+	TclReleaseScript(body);
+    }
     mem_free (listArgv);
     if (result == TCL_OK) {
 	Tcl_ResetResult(interp);
@@ -718,7 +732,7 @@ Tcl_FormatCmd(dummy, interp, argc, argv)
 	    format++;
 	}
 	if (isdigit(*format)) {
-	    width = atoi(format);
+	    width = atoi((void*) format);
 	    do {
 		format++;
 	    } while (isdigit(*format));
@@ -745,7 +759,7 @@ Tcl_FormatCmd(dummy, interp, argc, argv)
 	    format++;
 	}
 	if (isdigit(*format)) {
-	    precision = atoi(format);
+	    precision = atoi((void*) format);
 	    do {
 		format++;
 	    } while (isdigit(*format));
@@ -79,7 +79,7 @@ Tcl_IfCmd(dummy, interp, argc, argv)
 	    return TCL_ERROR;
 	}
 	if (value) {
-	    return Tcl_Eval(interp, argv[i], 0, 0);
+	    return TclEvalBody(interp, argv[i]);
 	}
 
 	/*
@@ -112,7 +112,7 @@ Tcl_IfCmd(dummy, interp, argc, argv)
 	    return TCL_ERROR;
 	}
     }
-    return Tcl_Eval(interp, argv[i], 0, 0);
+    return TclEvalBody(interp, argv[i]);
 }
 
 /*
@@ -425,9 +425,7 @@ Tcl_InfoCmd(dummy, interp, argc, argv)
 	    if (framePtr == 0) {
 		goto levelError;
 	    }
-	    iPtr->result = Tcl_Merge (interp->pool, framePtr->argc,
-		framePtr->argv);
-	    iPtr->freeProc = (Tcl_FreeProc *) mem_free;
+	    TclMergeResult(interp, framePtr->argc, framePtr->argv);
 	    return TCL_OK;
 	}
 	Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
@@ -477,6 +475,23 @@ Tcl_InfoCmd(dummy, interp, argc, argv)
 	    Tcl_AppendElement(interp, name, 0);
 	}
 	return TCL_OK;
+    } else if ((c == 'm') && (strncmp(argv[1], (unsigned char*) "memory", length) == 0)) {
+	int i, cached = 0;
+
+	if (argc != 2) {
+	    Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
+		    " memory\"", 0);
+	    return TCL_ERROR;
+	}
+	for (i = 0; i < TCL_CACHE_CLASSES; i++) {
+	    cached += iPtr->blockCache.numFree[i];
+	}
+	snprintf(iPtr->result, TCL_RESULT_SIZE,
+		"arena %d peak %u resets %lu spills %lu allocs %lu hits %lu cached %d",
+		iPtr->arenaSpace ? TCL_ARENA_SIZE : 0, iPtr->arenaPeak,
+		iPtr->arenaResets, iPtr->arenaSpills,
+		iPtr->blockCache.numAllocs, iPtr->blockCache.numHits, cached);
+	return TCL_OK;
     } else if ((c == 'p') && (strncmp(argv[1], (unsigned char*) "procs", length)) == 0) {
 	if (argc > 3) {
 	    Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
@@ -497,6 +512,30 @@ Tcl_InfoCmd(dummy, interp, argc, argv)
 	    Tcl_AppendElement(interp, name, 0);
 	}
 	return TCL_OK;
+    } else if ((c == 'r') && (strncmp(argv[1], (unsigned char*) "regexps", length) == 0)) {
+	int size;
+
+	if (argc > 3) {
+	    Tcl_AppendResult(interp, "wrong # args: should be \"", argv[0],
+		    " regexps [size]\"", 0);
+	    return TCL_ERROR;
+	}
+	if (argc == 3) {
+	    if (Tcl_GetInt(interp, argv[2], &size) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if ((size < 0) || (size > 0xffff)) {
+		Tcl_AppendResult(interp, "bad regexp cache size \"",
+			argv[2], "\"", 0);
+		return TCL_ERROR;
+	    }
+	    TclSetRegexpCacheSize(iPtr, size);
+	}
+	snprintf(iPtr->result, TCL_RESULT_SIZE,
+		"size %u cached %u hits %lu misses %lu",
+		iPtr->maxRegexps, iPtr->numRegexps,
+		iPtr->regexpHits, iPtr->regexpMisses);
+	return TCL_OK;
     } else if ((c == 's') && (strncmp(argv[1], (unsigned char*) "script", length) == 0)) {
 	if (argc != 2) {
 	    Tcl_AppendResult(interp, "wrong # args: should be \"",
@@ -552,8 +591,8 @@ Tcl_InfoCmd(dummy, interp, argc, argv)
 	Tcl_AppendResult(interp, "bad option \"", argv[1],
 		"\": should be args, body, cmdcount, commands, ",
 		"complete, default, ",
-		"exists, globals, level, library, locals, procs, ",
-		"script, tclversion, or vars", 0);
+		"exists, globals, level, library, locals, memory, procs, ",
+		"regexps, script, tclversion, or vars", 0);
 	return TCL_ERROR;
     }
 }
@@ -597,7 +636,7 @@ Tcl_JoinCmd(dummy, interp, argc, argv)
 	return TCL_ERROR;
     }
 
-    if (Tcl_SplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
+    if (TclSplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
 	return TCL_ERROR;
     }
     for (i = 0; i < listArgc; i++) {
@@ -661,7 +700,7 @@ Tcl_LindexCmd(dummy, interp, argc, argv)
 	return TCL_OK;
     }
     if (size >= TCL_RESULT_SIZE) {
-	interp->result = mem_alloc (interp->pool, (unsigned) size+1);
+	interp->result = TclArenaAlloc ((Interp *) interp, (unsigned) size+1);
 	interp->freeProc = (Tcl_FreeProc *) mem_free;
     }
     if (parenthesized) {
@@ -788,8 +827,7 @@ Tcl_ListCmd(dummy, interp, argc, argv)
 		" arg ?arg ...?\"", 0);
 	return TCL_ERROR;
     }
-    interp->result = Tcl_Merge (interp->pool, argc-1, argv+1);
-    interp->freeProc = (Tcl_FreeProc *) mem_free;
+    TclMergeResult(interp, argc-1, argv+1);
     return TCL_OK;
 }
 
@@ -1086,7 +1124,7 @@ Tcl_LsearchCmd(notUsed, interp, argc, argv)
 		" list pattern\"", 0);
 	return TCL_ERROR;
     }
-    if (Tcl_SplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
+    if (TclSplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
 	return TCL_ERROR;
     }
     match = -1;
@@ -1134,12 +1172,11 @@ Tcl_LsortCmd(notUsed, interp, argc, argv)
 		" list\"", 0);
 	return TCL_ERROR;
     }
-    if (Tcl_SplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
+    if (TclSplitList(interp, argv[1], &listArgc, &listArgv) != TCL_OK) {
 	return TCL_ERROR;
     }
     qsort((void *) listArgv, listArgc, sizeof (char*), SortCompareProc);
-    interp->result = Tcl_Merge (interp->pool, listArgc, listArgv);
-    interp->freeProc = (Tcl_FreeProc *) mem_free;
+    TclMergeResult(interp, listArgc, listArgv);
     mem_free (listArgv);
     return TCL_OK;
 }
@@ -126,7 +126,7 @@ Tcl_RegexpCmd(dummy, interp, argc, argv)
     if (string != argPtr[1]) {
 	mem_free(string);
     }
-    if (match) {
+    if (! match) {
 	interp->result = (unsigned char*) "0";
 	return TCL_OK;
     }
@@ -266,7 +266,7 @@ Tcl_RegsubCmd(dummy, interp, argc, argv)
     flags = 0;
     for (p = string; *p != 0; ) {
 	match = regexp_execute (regexpPtr, p);
-	if (match) {
+	if (! match) {
 	    break;
 	}
 
@@ -451,6 +451,7 @@ Tcl_RenameCmd(dummy, interp, argc, argv)
 		"\":  command doesn't exist", 0);
 	return TCL_ERROR;
     }
+    iPtr->cmdEpoch++;
     cmdPtr = (Command *) Tcl_GetHashValue(hPtr);
     Tcl_DeleteHashEntry(hPtr);
     hPtr = Tcl_CreateHashEntry(&iPtr->commandTable, argv[2], &new);
@@ -1334,6 +1335,7 @@ Tcl_WhileCmd(dummy, interp, argc, argv)
     unsigned char **argv;		/* Argument strings. */
 {
     int result, value;
+    CompiledScript *body;
 
     if (argc != 3) {
 	Tcl_AppendResult(interp, "wrong # args: should be \"",
@@ -1341,15 +1343,16 @@ Tcl_WhileCmd(dummy, interp, argc, argv)
 	return TCL_ERROR;
     }
 
+    body = TclGetCompiledScript((Interp *) interp, argv[2]);
     while (1) {
 	result = Tcl_ExprBoolean(interp, argv[1], &value);
 	if (result != TCL_OK) {
-	    return result;
+	    break;
 	}
 	if (!value) {
 	    break;
 	}
-	result = Tcl_Eval(interp, argv[2], 0, 0);
+	result = TclEvalCompiled(interp, body, argv[2]);
 	if (result == TCL_CONTINUE) {
 	    result = TCL_OK;
 	} else if (result != TCL_OK) {
@@ -1362,6 +1365,9 @@ Tcl_WhileCmd(dummy, interp, argc, argv)
 	    break;
 	}
     }
+    if (body != 0) {
+	TclReleaseScript(body);
+    }
     if (result == TCL_BREAK) {
 	result = TCL_OK;
     }
@@ -0,0 +1,962 @@
+/*
+ * tclComp.c --
+ *
+ *	This file contains the compiler of Tcl scripts.  Procedure
+ *	bodies and bodies of loops are split into commands and words
+ *	once:  words without substitutions get their final values,
+ *	command substitutions like [expr ...] are compiled too,
+ *	and command procedures are remembered between executions.
+ *	Compiled bodies of loops and branches are kept in a small
+ *	cache of the interpreter, indexed by the source text.
+ */
+#include <tcl/internal.h>
+
+/*
+ * Initial space for the words and for the argv array of a command,
+ * same as in Tcl_Eval.
+ */
+#define NUM_CHARS 200
+#define NUM_ARGS 10
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompileNested --
+ *
+ *	Compile a word, which starts with an open bracket, if it
+ *	consists of the only command substitution, like [expr ...].
+ *
+ * Results:
+ *	The compiled command, or NULL if the word has other text
+ *	or can't be compiled.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static CompiledScript *
+CompileNested(iPtr, string, term)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *string;	/* Character just after open bracket. */
+    unsigned char *term;	/* Character just after the word. */
+{
+    CompiledScript *csPtr;
+    unsigned char *end;
+
+    if (Tcl_Eval((Tcl_Interp *) iPtr, string, TCL_BRACKET_TERM, &end)
+	    != TCL_OK || (*end != ']') || (end + 1 != term)) {
+	return 0;
+    }
+
+    /*
+     * Temporarily terminate the command at the close bracket,
+     * like Tcl_ParseVar does with variable names.
+     */
+
+    *end = 0;
+    csPtr = TclCompileScript(iPtr, string);
+    *end = ']';
+    return csPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IsName --
+ *
+ *	Check whether the text up to the end (or up to the null
+ *	character, when end is NULL) is a simple variable name.
+ *
+ * Results:
+ *	Non-zero if the text is a non-empty sequence of letters,
+ *	digits and underscores.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+IsName(p, end)
+    register unsigned char *p;	/* Start of the text. */
+    unsigned char *end;		/* End of the text, or NULL. */
+{
+    unsigned char *start = p;
+
+    while (isalnum(*p) || (*p == '_')) {
+	p++;
+    }
+    return (p != start) && ((end != 0) ? (p == end) : (*p == 0));
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResolveLocals --
+ *
+ *	Find the slots for variable names of the compiled script
+ *	in the procedure of the current call frame.  This is done
+ *	when the script is compiled, and again when it runs in
+ *	another procedure (the bodies like {incr i} are shared
+ *	through the script cache).
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The slots of WORD_LOCAL words are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResolveLocals(iPtr, csPtr)
+    Interp *iPtr;		/* Interpreter. */
+    CompiledScript *csPtr;	/* Compiled script. */
+{
+    CompiledWord *wordPtr;
+    unsigned char *name, *p;
+    int slot;
+
+    csPtr->procId = iPtr->varFramePtr->procPtr->id;
+    for (wordPtr = (CompiledWord *) (csPtr->cmds + csPtr->numCmds);
+	    wordPtr < (CompiledWord *) csPtr->source; wordPtr++) {
+	if (!(wordPtr->flags & WORD_LOCAL)) {
+	    continue;
+	}
+	name = wordPtr->text;
+	if (!(wordPtr->flags & WORD_LITERAL)) {
+	    name++;
+	}
+	for (p = name; isalnum(*p) || (*p == '_'); p++) {
+	    continue;
+	}
+	slot = TclFindLocal(iPtr, name, p - name);
+	wordPtr->slot = (slot < 0) ? NO_SLOT : slot;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParseScript --
+ *
+ *	Split the script into commands and words, the same way
+ *	Tcl_Eval does.  Nested commands are parsed, but not executed
+ *	(the caller sets interp->noEval).  On the first pass, csPtr
+ *	is NULL and only the sizes are computed.  On the second pass,
+ *	the commands and words are stored in *csPtr, and the values
+ *	of literal words are copied to the space at bytes.
+ *
+ * Results:
+ *	A standard Tcl result.  The number of commands, words and bytes
+ *	of literal values are stored at *numCmdsPtr, *numWordsPtr and
+ *	*numBytesPtr.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ParseScript(iPtr, script, csPtr, bytes, numCmdsPtr, numWordsPtr, numBytesPtr)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *script;	/* Script to parse. */
+    CompiledScript *csPtr;	/* Where to store the commands, or NULL. */
+    unsigned char *bytes;	/* Where to store literal values. */
+    int *numCmdsPtr;		/* Number of commands stored here. */
+    int *numWordsPtr;		/* Number of words stored here. */
+    int *numBytesPtr;		/* Size of literal values stored here. */
+{
+    unsigned char copyStorage[NUM_CHARS];
+    ParseValue pv;
+    register unsigned char *src, *p;
+    unsigned char *cmdStart, *wordStart, *first, *term, *value;
+    CompiledCmd *cmdPtr = 0;
+    CompiledWord *wordPtr = 0;
+    CompiledScript *nested;
+    int numCmds = 0, numWords = 0, numBytes = 0;
+    int count, n, literal, length, result = TCL_OK;
+
+    pv.buffer = copyStorage;
+    pv.end = copyStorage + NUM_CHARS - 1;
+    pv.expandProc = TclExpandParseValue;
+    pv.clientData = (void*) 0;
+    if (csPtr != 0) {
+	cmdPtr = csPtr->cmds;
+	wordPtr = (CompiledWord *) (cmdPtr + csPtr->numCmds);
+    }
+
+    src = script;
+    while (*src != 0) {
+	/*
+	 * Skim off leading white space and semi-colons, and skip
+	 * comments.
+	 */
+
+	while (1) {
+	    switch (*src) {
+	    case '\t':
+	    case '\v':
+	    case '\f':
+	    case '\r':
+	    case '\n':
+	    case ' ':
+	    case ';':
+		++src;
+		continue;
+	    }
+	    break;
+	}
+	if (*src == '#') {
+	    for (src++; *src != 0; src++) {
+		if ((*src == '\n') && (src[-1] != '\\')) {
+		    src++;
+		    break;
+		}
+	    }
+	    continue;
+	}
+	cmdStart = src;
+
+	/*
+	 * Parse the words one by one, remembering where each word
+	 * starts in the source text.
+	 */
+
+	for (count = 0; ; count++) {
+	    pv.next = pv.buffer;
+	    wordStart = src;
+	    result = TclParseWords((Tcl_Interp *) iPtr, src, 0, 1, &term,
+		    &n, &value, &pv);
+	    if (result != TCL_OK) {
+		goto done;
+	    }
+	    src = term;
+	    if (n == 0) {
+		break;
+	    }
+
+	    /*
+	     * A word is literal, when it is enclosed in braces, or
+	     * when it has no variable or command substitutions.
+	     * Backslash sequences are substituted by the parser.
+	     */
+
+	    for (p = wordStart; ((*p == ' ') || (*p == '\t') || (*p == '\v')
+		    || (*p == '\f') || (*p == '\r')
+		    || ((*p == '\\') && (p[1] == '\n'))); p++) {
+		if (*p == '\\') {
+		    p++;
+		}
+	    }
+	    first = p;
+	    nested = 0;
+	    if ((*p == '[') && (wordPtr != 0)) {
+		nested = CompileNested(iPtr, p + 1, term);
+	    }
+	    literal = (*p == '{');
+	    if (!literal) {
+		for ( ; (p != term) && (*p != '$') && (*p != '['); p++) {
+		    continue;
+		}
+		literal = (p == term);
+	    }
+	    if (literal) {
+		length = strlen(value) + 1;
+		numBytes += length;
+	    }
+	    if (wordPtr == 0) {
+		continue;
+	    }
+
+	    if (literal) {
+		memcpy(bytes, value, length);
+		wordPtr->text = bytes;
+		wordPtr->flags = WORD_LITERAL;
+		if (strchr(value, '(') != 0) {
+		    wordPtr->flags |= WORD_COPY;
+		} else if ((count == 1) && IsName(value, (unsigned char *) 0)) {
+		    wordPtr->flags |= WORD_LOCAL;
+		}
+		bytes += length;
+	    } else if (nested != 0) {
+		wordPtr->text = p + 1;
+		wordPtr->flags = WORD_SCRIPT;
+	    } else if ((*first == '$') && IsName(first + 1, term)) {
+		/*
+		 * The parser skips white space before the word.
+		 */
+
+		wordPtr->text = first;
+		wordPtr->flags = WORD_LOCAL;
+	    } else {
+		wordPtr->text = wordStart;
+		wordPtr->flags = 0;
+	    }
+	    wordPtr->slot = NO_SLOT;
+	    wordPtr->script = nested;
+	    wordPtr++;
+	}
+	if (count == 0) {
+	    continue;
+	}
+	numCmds++;
+	numWords += count;
+	if (cmdPtr != 0) {
+	    cmdPtr->start = cmdStart;
+	    cmdPtr->end = src;
+	    cmdPtr->words = wordPtr - count;
+	    cmdPtr->numWords = count;
+	    cmdPtr->cmdPtr = 0;
+	    cmdPtr->cmdEpoch = 0;
+	    cmdPtr++;
+	}
+    }
+
+    done:
+    if (pv.buffer != copyStorage) {
+	mem_free (pv.buffer);
+    }
+    *numCmdsPtr = numCmds;
+    *numWordsPtr = numWords;
+    *numBytesPtr = numBytes;
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCompileScript --
+ *
+ *	Compile the script into a list of commands with pre-split
+ *	words.
+ *
+ * Results:
+ *	The return value is the compiled script with reference count 1,
+ *	or NULL if the script has a syntax error, or compilation is
+ *	disabled, or there is no memory.  In that case the caller
+ *	should interpret the text by Tcl_Eval, to get the usual error.
+ *
+ * Side effects:
+ *	The result of the interpreter is reset.
+ *
+ *----------------------------------------------------------------------
+ */
+
+CompiledScript *
+TclCompileScript(iPtr, script)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *script;	/* Script to compile. */
+{
+    CompiledScript *csPtr = 0;
+    CompiledWord *wordPtr;
+    int numCmds, numWords, numBytes, length, result;
+    unsigned char savedFlags;
+
+    if (iPtr->flags & NO_COMPILE) {
+	return 0;
+    }
+    savedFlags = iPtr->flags & COMPILING;
+    iPtr->flags |= COMPILING;
+    iPtr->noEval++;
+
+    result = ParseScript(iPtr, script, (CompiledScript *) 0,
+	    (unsigned char *) 0, &numCmds, &numWords, &numBytes);
+    if ((result != TCL_OK) || (numWords > 0xffff)) {
+	goto done;
+    }
+    length = strlen(script) + 1;
+    csPtr = (CompiledScript *) mem_alloc (iPtr->pool, sizeof(CompiledScript)
+	    + numCmds * sizeof(CompiledCmd) + numWords * sizeof(CompiledWord)
+	    + length + numBytes);
+    if (csPtr == 0) {
+	goto done;
+    }
+    csPtr->refCount = 1;
+    csPtr->numCmds = numCmds;
+    csPtr->cmds = (CompiledCmd *) (csPtr + 1);
+    csPtr->source = (unsigned char *) ((CompiledWord *)
+	    (csPtr->cmds + numCmds) + numWords);
+    csPtr->hPtr = 0;
+    csPtr->lastUse = 0;
+    csPtr->procId = 0;
+    memcpy(csPtr->source, script, length);
+
+    /*
+     * Parse the copy, so that the words refer to it.
+     */
+
+    result = ParseScript(iPtr, csPtr->source, csPtr,
+	    csPtr->source + length, &numCmds, &numWords, &numBytes);
+    if (result != TCL_OK) {
+	/*
+	 * Can't happen:  the text was parsed successfully once.
+	 * Release the command substitutions, compiled so far.
+	 */
+
+	for (wordPtr = (CompiledWord *) (csPtr->cmds + csPtr->numCmds);
+		wordPtr < (CompiledWord *) csPtr->source; wordPtr++) {
+	    if (wordPtr->script != 0) {
+		TclReleaseScript(wordPtr->script);
+	    }
+	}
+	mem_free (csPtr);
+	csPtr = 0;
+    } else if (iPtr->varFramePtr != 0) {
+	ResolveLocals(iPtr, csPtr);
+    }
+
+    done:
+    iPtr->noEval--;
+    iPtr->flags = (iPtr->flags & ~COMPILING) | savedFlags;
+    Tcl_ResetResult((Tcl_Interp *) iPtr);
+    return csPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclReleaseScript --
+ *
+ *	Drop a reference to the compiled script.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The script and its compiled command substitutions are freed,
+ *	when nobody uses it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclReleaseScript(csPtr)
+    CompiledScript *csPtr;	/* Compiled script. */
+{
+    CompiledCmd *cmdPtr;
+    CompiledWord *wordPtr;
+
+    if (--csPtr->refCount != 0) {
+	return;
+    }
+    for (cmdPtr = csPtr->cmds; cmdPtr < csPtr->cmds + csPtr->numCmds;
+	    cmdPtr++) {
+	for (wordPtr = cmdPtr->words;
+		wordPtr < cmdPtr->words + cmdPtr->numWords; wordPtr++) {
+	    if (wordPtr->script != 0) {
+		TclReleaseScript(wordPtr->script);
+	    }
+	}
+    }
+    mem_free (csPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ExecLocal --
+ *
+ *	Execute the "set" or "incr" command on a local variable of
+ *	the procedure, given by its slot, without looking up the name.
+ *
+ * Results:
+ *	Non-zero if the command is done (it can't fail).  Zero means
+ *	the command procedure must be called as usual:  another command,
+ *	or a variable which is not a plain scalar, or a bad value.
+ *
+ * Side effects:
+ *	The variable is set;  the result is its value.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ExecLocal(iPtr, csPtr, cmdPtr, c, argc, argv)
+    Interp *iPtr;		/* Interpreter. */
+    CompiledScript *csPtr;	/* Compiled script. */
+    CompiledCmd *cmdPtr;	/* Compiled command. */
+    Command *c;			/* Command procedure. */
+    int argc;			/* Number of arguments. */
+    unsigned char **argv;	/* Argument strings. */
+{
+    CompiledWord *wordPtr = &cmdPtr->words[1];
+    unsigned char *value, *end, newString[30];
+    int n, increment;
+
+    if ((argc < 2) || (argc > 3) || (argc != cmdPtr->numWords)
+	    || ((wordPtr->flags & (WORD_LITERAL | WORD_LOCAL))
+	    != (WORD_LITERAL | WORD_LOCAL)) || (wordPtr->slot == NO_SLOT)) {
+	return 0;
+    }
+    if (c->proc == Tcl_SetCmd) {
+	if (argc == 2) {
+	    value = TclGetLocal(iPtr, csPtr->procId, wordPtr->slot);
+	} else {
+	    value = TclSetLocal(iPtr, csPtr->procId, wordPtr->slot, argv[2]);
+	}
+    } else if (c->proc == Tcl_IncrCmd) {
+	/*
+	 * Numbers with trailing spaces or garbage are left
+	 * to Tcl_GetInt.
+	 */
+
+	value = TclGetLocal(iPtr, csPtr->procId, wordPtr->slot);
+	if (value == 0) {
+	    return 0;
+	}
+	n = strtol((void*) value, (void*) &end, 0);
+	if ((end == value) || (*end != 0)) {
+	    return 0;
+	}
+	increment = 1;
+	if (argc == 3) {
+	    increment = strtol((void*) argv[2], (void*) &end, 0);
+	    if ((end == argv[2]) || (*end != 0)) {
+		return 0;
+	    }
+	}
+	snprintf(newString, sizeof (newString), "%d", n + increment);
+	value = TclSetLocal(iPtr, csPtr->procId, wordPtr->slot, newString);
+    } else {
+	return 0;
+    }
+    if (value == 0) {
+	return 0;
+    }
+    iPtr->result = value;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclExecScript --
+ *
+ *	Execute the compiled script.  This is the same as Tcl_Eval
+ *	of the source text, except that words are not split again,
+ *	literal words are not copied, and the command procedures
+ *	are looked up only when the command table changes.
+ *
+ * Results:
+ *	A standard Tcl result, as from Tcl_Eval.  *OffsetPtr is filled
+ *	in with the offset in the source text, where the execution
+ *	stopped.
+ *
+ * Side effects:
+ *	Depends on the commands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclExecScript(iPtr, csPtr, offsetPtr)
+    register Interp *iPtr;	/* Interpreter. */
+    CompiledScript *csPtr;	/* Compiled script. */
+    unsigned *offsetPtr;	/* If non-NULL, store here the offset
+				 * of the character, where the execution
+				 * stopped. */
+{
+    Tcl_Interp *interp = (Tcl_Interp *) iPtr;
+    unsigned char copyStorage[NUM_CHARS];
+    ParseValue pv;
+    unsigned char *(argStorage[NUM_ARGS]);
+    unsigned char **argv = argStorage;
+    int argc, argSize = NUM_ARGS;
+    unsigned char *oldBuffer, *oldEnd, *term;
+    unsigned char *cmdStart, *src, *value;
+    unsigned char *ellipsis = (unsigned char*) "";
+    register CompiledCmd *cmdPtr;
+    register CompiledWord *wordPtr;
+    Tcl_HashEntry *he;
+    Command *c;
+    unsigned offset;
+    int result, n, i, length;
+
+    /*
+     * Traces want the text of every command:  let Tcl_Eval
+     * handle them.  Same when the commands are only parsed.
+     */
+
+    if ((iPtr->tracePtr != 0) || iPtr->noEval) {
+	csPtr->refCount++;
+	result = Tcl_Eval(interp, csPtr->source, 0, &term);
+	if (offsetPtr != 0) {
+	    *offsetPtr = term - csPtr->source;
+	}
+	TclReleaseScript(csPtr);
+	return result;
+    }
+
+    Tcl_FreeResult(interp);
+    iPtr->result = iPtr->resultSpace;
+    iPtr->resultSpace[0] = 0;
+    result = TCL_OK;
+
+    iPtr->numLevels++;
+    if (iPtr->numLevels > MAX_NESTING_DEPTH) {
+	iPtr->numLevels--;
+	iPtr->result = (unsigned char*) "too many nested calls to Tcl_Eval (infinite loop?)";
+	if (offsetPtr != 0) {
+	    *offsetPtr = 0;
+	}
+	return TCL_ERROR;
+    }
+
+    /*
+     * The script may be redefined or evicted from the cache
+     * by the commands it runs.
+     */
+
+    csPtr->refCount++;
+    if ((iPtr->varFramePtr != 0)
+	    && (iPtr->varFramePtr->procPtr->id != csPtr->procId)) {
+	ResolveLocals(iPtr, csPtr);
+    }
+    pv.buffer = copyStorage;
+    pv.end = copyStorage + NUM_CHARS - 1;
+    pv.expandProc = TclExpandParseValue;
+    pv.clientData = (void*) 0;
+    cmdStart = src = csPtr->source;
+
+    for (cmdPtr = csPtr->cmds; cmdPtr < csPtr->cmds + csPtr->numCmds;
+	    cmdPtr++) {
+	iPtr->flags &= ~(ERR_IN_PROGRESS | ERROR_CODE_SET);
+	cmdStart = cmdPtr->start;
+	src = cmdPtr->end;
+
+	/*
+	 * Leave two spare argv slots:  one for a NULL pointer,
+	 * and one for the command name "unknown".
+	 */
+
+	if (argSize < cmdPtr->numWords + 2) {
+	    if (argv != argStorage) {
+		mem_free (argv);
+	    }
+	    argSize = cmdPtr->numWords + 2;
+	    argv = (unsigned char**) TclArenaAlloc (iPtr,
+		(unsigned) argSize * sizeof(char *));
+	}
+
+	/*
+	 * Substitute the words, which need it.  Literal words
+	 * are passed as is.
+	 */
+
+	pv.next = pv.buffer;
+	argc = 0;
+	for (wordPtr = cmdPtr->words;
+		wordPtr < cmdPtr->words + cmdPtr->numWords; wordPtr++) {
+	    if ((wordPtr->flags & (WORD_LITERAL | WORD_COPY)) == WORD_LITERAL) {
+		argv[argc++] = wordPtr->text;
+		continue;
+	    }
+	    oldBuffer = pv.buffer;
+	    oldEnd = pv.end;
+	    if (wordPtr->flags & WORD_SCRIPT) {
+		result = TclExecScript(iPtr, wordPtr->script, &offset);
+		if (result != TCL_OK) {
+		    /*
+		     * Report the error up to the failed command, like
+		     * TclParseNestedCmd does.
+		     */
+
+		    src = wordPtr->text + offset;
+		    if (*src == ']') {
+			src++;
+		    }
+		    ellipsis = (unsigned char*) "...";
+		    goto done;
+		}
+		value = iPtr->result;
+	    } else if (wordPtr->flags & WORD_LITERAL) {
+		value = wordPtr->text;
+	    } else if ((wordPtr->flags & WORD_LOCAL)
+		    && (wordPtr->slot != NO_SLOT)) {
+		value = TclGetLocal(iPtr, csPtr->procId, wordPtr->slot);
+	    } else {
+		value = 0;
+	    }
+
+	    /*
+	     * Copy the value:  the command may change the variable,
+	     * or the result.  Other words, and local variables which
+	     * are not plain scalars, are substituted by the parser.
+	     */
+
+	    if (value != 0) {
+		length = strlen(value) + 1;
+		if (pv.end - pv.next < length) {
+		    (*pv.expandProc) (&pv, length, (Tcl_Interp *) iPtr);
+		}
+		argv[argc] = pv.next;
+		memcpy(pv.next, value, length);
+		pv.next += length;
+		n = 1;
+	    } else {
+		result = TclParseWords(interp, wordPtr->text, 0, 1, &term,
+			&n, &argv[argc], &pv);
+		if (result != TCL_OK) {
+		    src = term;
+		    ellipsis = (unsigned char*) "...";
+		    goto done;
+		}
+	    }
+
+	    /*
+	     * Careful!  Buffer space may have gotten reallocated.
+	     * Update the older argv pointers, which refer to it.
+	     */
+
+	    if (oldBuffer != pv.buffer) {
+		for (i = 0; i < argc; i++) {
+		    if ((argv[i] >= oldBuffer) && (argv[i] <= oldEnd)) {
+			argv[i] = pv.buffer + (argv[i] - oldBuffer);
+		    }
+		}
+	    }
+	    argc += n;
+	}
+	if (argc == 0) {
+	    continue;
+	}
+	argv[argc] = 0;
+
+	/*
+	 * Find the procedure to execute this command.  The one found
+	 * last time is good, unless commands were created or deleted
+	 * since then.  If there isn't one, then see if there is
+	 * a command "unknown".
+	 */
+
+	c = cmdPtr->cmdPtr;
+	if ((c == 0) || (cmdPtr->cmdEpoch != iPtr->cmdEpoch)) {
+	    he = Tcl_FindHashEntry(&iPtr->commandTable, argv[0]);
+	    if (he == 0) {
+		he = Tcl_FindHashEntry(&iPtr->commandTable,
+			(unsigned char*) "unknown");
+		if (he == 0) {
+		    Tcl_ResetResult(interp);
+		    Tcl_AppendResult(interp, "invalid command name: \"",
+			    argv[0], "\"", 0);
+		    result = TCL_ERROR;
+		    goto done;
+		}
+		for (i = argc; i >= 0; i--) {
+		    argv[i+1] = argv[i];
+		}
+		argv[0] = (unsigned char*) "unknown";
+		argc++;
+		c = (Command *) Tcl_GetHashValue(he);
+	    } else {
+		c = (Command *) Tcl_GetHashValue(he);
+		if (cmdPtr->words[0].flags & WORD_LITERAL) {
+		    cmdPtr->cmdPtr = c;
+		    cmdPtr->cmdEpoch = iPtr->cmdEpoch;
+		}
+	    }
+	}
+
+	iPtr->cmdCount++;
+	Tcl_FreeResult(interp);
+	iPtr->result = iPtr->resultSpace;
+	iPtr->resultSpace[0] = 0;
+	if (ExecLocal(iPtr, csPtr, cmdPtr, c, argc, argv)) {
+	    continue;
+	}
+	result = (*c->proc)(c->clientData, interp, argc, argv);
+	if (result != TCL_OK) {
+	    break;
+	}
+    }
+
+    done:
+    if (pv.buffer != copyStorage) {
+	mem_free (pv.buffer);
+    }
+    if (argv != argStorage) {
+	mem_free (argv);
+    }
+    if (offsetPtr != 0) {
+	*offsetPtr = src - csPtr->source;
+    }
+    result = TclEvalFinish(iPtr, result);
+    if ((result == TCL_ERROR) &&
+	    !(iPtr->flags & (ERR_ALREADY_LOGGED | COMPILING))) {
+	TclLogEvalError(iPtr, csPtr->source, cmdStart, src, ellipsis);
+    }
+    iPtr->flags &= ~ERR_ALREADY_LOGGED;
+    TclReleaseScript(csPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetCompiledScript --
+ *
+ *	Find the compiled script in the cache of the interpreter,
+ *	or compile it.  When the cache is full, the script which
+ *	was not used for the longest time is removed.
+ *
+ * Results:
+ *	The return value is the compiled script, or NULL if it can't
+ *	be compiled.  The caller must release it by TclReleaseScript.
+ *
+ * Side effects:
+ *	The cache is updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+CompiledScript *
+TclGetCompiledScript(iPtr, script)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *script;	/* Source text. */
+{
+    CompiledScript *csPtr, *oldPtr;
+    Tcl_HashEntry *he;
+    Tcl_HashSearch search;
+    int new;
+
+    if (iPtr->flags & NO_COMPILE) {
+	return 0;
+    }
+    he = Tcl_FindHashEntry(&iPtr->scriptTable, script);
+    if (he != 0) {
+	csPtr = (CompiledScript *) Tcl_GetHashValue(he);
+	csPtr->lastUse = ++iPtr->scriptClock;
+	csPtr->refCount++;
+	return csPtr;
+    }
+    csPtr = TclCompileScript(iPtr, script);
+    if (csPtr == 0) {
+	return 0;
+    }
+
+    if (iPtr->numScripts >= NUM_SCRIPTS) {
+	oldPtr = 0;
+	for (he = Tcl_FirstHashEntry(&iPtr->scriptTable, &search);
+		he != 0; he = Tcl_NextHashEntry(&search)) {
+	    CompiledScript *p = (CompiledScript *) Tcl_GetHashValue(he);
+
+	    if ((oldPtr == 0) || (p->lastUse < oldPtr->lastUse)) {
+		oldPtr = p;
+	    }
+	}
+	Tcl_DeleteHashEntry(oldPtr->hPtr);
+	oldPtr->hPtr = 0;
+	iPtr->numScripts--;
+	TclReleaseScript(oldPtr);
+    }
+    he = Tcl_CreateHashEntry(&iPtr->scriptTable, script, &new);
+    Tcl_SetHashValue(he, csPtr);
+    csPtr->hPtr = he;
+    csPtr->lastUse = ++iPtr->scriptClock;
+    csPtr->refCount++;
+    iPtr->numScripts++;
+    return csPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclDeleteScripts --
+ *
+ *	Empty the cache of compiled scripts, when the interpreter
+ *	is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclDeleteScripts(iPtr)
+    Interp *iPtr;		/* Interpreter. */
+{
+    Tcl_HashEntry *he;
+    Tcl_HashSearch search;
+    CompiledScript *csPtr;
+
+    for (he = Tcl_FirstHashEntry(&iPtr->scriptTable, &search);
+	    he != 0; he = Tcl_NextHashEntry(&search)) {
+	csPtr = (CompiledScript *) Tcl_GetHashValue(he);
+	csPtr->hPtr = 0;
+	TclReleaseScript(csPtr);
+    }
+    Tcl_DeleteHashTable(&iPtr->scriptTable);
+    iPtr->numScripts = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEvalCompiled --
+ *
+ *	Execute the compiled script, or interpret the text, if there
+ *	is no compiled form.
+ *
+ * Results:
+ *	A standard Tcl result, as from Tcl_Eval.
+ *
+ * Side effects:
+ *	Depends on the commands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclEvalCompiled(interp, csPtr, body)
+    Tcl_Interp *interp;		/* Interpreter. */
+    CompiledScript *csPtr;	/* Compiled script, or NULL. */
+    unsigned char *body;	/* Source text. */
+{
+    if (csPtr == 0) {
+	return Tcl_Eval(interp, body, 0, 0);
+    }
+    return TclExecScript((Interp *) interp, csPtr, (unsigned *) 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclEvalBody --
+ *
+ *	Execute the body of a loop or branch, using the cache
+ *	of compiled scripts.
+ *
+ * Results:
+ *	A standard Tcl result, as from Tcl_Eval.
+ *
+ * Side effects:
+ *	Depends on the commands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclEvalBody(interp, body)
+    Tcl_Interp *interp;		/* Interpreter. */
+    unsigned char *body;	/* Source text. */
+{
+    CompiledScript *csPtr;
+    int result;
+
+    csPtr = TclGetCompiledScript((Interp *) interp, body);
+    result = TclEvalCompiled(interp, csPtr, body);
+    if (csPtr != 0) {
+	TclReleaseScript(csPtr);
+    }
+    return result;
+}
@@ -2,7 +2,8 @@
  * tclExpr.c --
  *
  *	This file contains the code to evaluate expressions for
- *	Tcl.
+ *	Tcl.  Expressions with substitutions are compiled into
+ *	a postfix program and kept in a cache of the interpreter.
  *
  *	This implementation of floating-point support was modelled
  *	after an initial implementation by Bill Carpenter.
@@ -32,6 +33,9 @@ typedef struct {
 	unsigned char	static_space [STATIC_STRING_SPACE];
 					/* Storage for small strings;
 					 * large ones are malloc-ed. */
+	unsigned char	skip;		/* Compiled expressions only: 1 means
+					 * interp->noEval was incremented,
+					 * to skip the next operand. */
 } Value_t;
 
 /*
@@ -127,11 +131,105 @@ static char *operator_strings[] = {
 	"-", "!", "~"
 };
 
+/*
+ * Expressions are compiled into a postfix program:  operands
+ * are pushed on the stack, operators take their operands from the
+ * stack and replace them by the result.  Instructions, in addition
+ * to the operators above:
+ */
+#define PUSH_INT	32		/* Integer constant. */
+#define PUSH_STRING	33		/* String constant. */
+#define PUSH_VAR	34		/* Value of a variable. */
+#define PUSH_CMD	35		/* Result of a nested command. */
+#define PUSH_QUOTE	36		/* String in quotes, with substitutions. */
+#define TEST_AND	37		/* Check the first operand of &&, */
+#define TEST_OR		38		/* of ||, or of ?:, and skip the */
+#define TEST_QUESTY	39		/* second operand, if not needed. */
+#define TEST_COLON	40		/* Skip the third operand of ?:. */
+
+typedef struct {
+	unsigned char	op;		/* Operator or instruction. */
+	unsigned short	offset;		/* Position of the operand in
+					 * the source text. */
+	long		int_value;	/* Integer constant;  for PUSH_CMD,
+					 * position of the close bracket;
+					 * for PUSH_VAR, slot of the local
+					 * variable plus 1, or -1 for a
+					 * simple name without a slot. */
+	void		*ptr;		/* String constant, or compiled
+					 * nested command, or NULL. */
+} Expr_code_t;
+
+#define MAX_CODE	32		/* Max. instructions in a program. */
+#define MAX_STACK	6		/* Max. depth of the operand stack. */
+
+/*
+ * Compiled expression.  The instructions and a copy of the source
+ * text are allocated in one block together with this structure.
+ */
+typedef struct {
+	unsigned short	ref_count;	/* The cache plus active executions. */
+	unsigned char	length;		/* Number of instructions;  0 means
+					 * the expression is interpreted. */
+	unsigned char	depth;		/* Max. depth of the operand stack. */
+	Tcl_HashEntry	*hPtr;		/* Entry in interp->exprTable. */
+	unsigned long	last_use;	/* Value of interp->exprClock on
+					 * the last lookup. */
+	unsigned long	proc_id;	/* Procedure, to which the slots
+					 * of PUSH_VAR instructions refer. */
+	Expr_code_t	*code;		/* Instructions. */
+	unsigned char	*source;	/* Copy of the source text. */
+} Expr_prog_t;
+
+/*
+ * State of the compiler.
+ */
+typedef struct {
+	Expr_info_t	info;		/* State of the parse. */
+	Value_t		value;		/* Value of the last token. */
+	Expr_code_t	code [MAX_CODE];
+	unsigned char	length;		/* Number of instructions. */
+	unsigned char	depth;		/* Current depth of the stack. */
+	unsigned char	max_depth;	/* Max. depth of the stack. */
+} Expr_compile_t;
+
 /*
  * Declarations for local procedures to this file:
  */
-static void make_string (mem_pool_t *pool, Value_t *valuePtr);
+static void make_string (Tcl_Interp *interp, Value_t *valuePtr);
 
+/*
+ * Store a string value (but don't do anything if it's already
+ * the value).
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The storage space of *valuePtr may be expanded.
+ */
+static void
+set_string (Tcl_Interp *interp,	/* Interpreter, for memory pool. */
+	unsigned char *string,		/* String value. */
+	Value_t *valuePtr)		/* Where to store value information.
+					 * Caller must have initialized pv field. */
+{
+    unsigned short length, space;
+
+    valuePtr->type = TYPE_STRING;
+    if (string == valuePtr->pv.buffer) {
+	return;
+    }
+    length = strlen (string);
+    valuePtr->pv.next = valuePtr->pv.buffer;
+    space = valuePtr->pv.end - valuePtr->pv.buffer;
+    if (length > space) {
+	(*valuePtr->pv.expandProc) (&valuePtr->pv, length - space,
+	    interp);
+    }
+    strcpy (valuePtr->pv.buffer, string);
+}
+
 /*
  * Given a string (such as one coming from command or variable
  * substitution), make a Value_t based on the string.  The value
@@ -163,7 +261,7 @@ parse_string (Tcl_Interp *interp,	/* Where to store error message. */
 	unsigned char *term;
 
 	valuePtr->type = TYPE_INT;
-	valuePtr->int_value = strtol (string, &term, 0);
+	valuePtr->int_value = strtol ((void*) string, (void*) &term, 0);
 	c = *term;
 	if (c == '\0') {
 	    return TCL_OK;
@@ -171,22 +269,9 @@ parse_string (Tcl_Interp *interp,	/* Where to store error message. */
     }
 
     /*
-     * Not a valid number.  Save a string value (but don't do anything
-     * if it's already the value).
+     * Not a valid number.  Save a string value.
      */
-    valuePtr->type = TYPE_STRING;
-    if (string != valuePtr->pv.buffer) {
-	unsigned short length, space;
-
-	length = strlen (string);
-	valuePtr->pv.next = valuePtr->pv.buffer;
-	space = valuePtr->pv.end - valuePtr->pv.buffer;
-	if (length > space) {
-	    (*valuePtr->pv.expandProc) (&valuePtr->pv, length - space,
-		interp->pool);
-	}
-	strcpy (valuePtr->pv.buffer, string);
-    }
+    set_string (interp, string, valuePtr);
     return TCL_OK;
 }
 
@@ -245,7 +330,7 @@ get_lex (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
 
 	    infoPtr->token = VALUE;
 	    valuePtr->type = TYPE_INT;
-	    valuePtr->int_value = strtoul (p, &term, 0);
+	    valuePtr->int_value = strtoul ((void*) p, (void*) &term, 0);
 	    c = *term;
 	    infoPtr->expr = term;
 	    return TCL_OK;
@@ -432,6 +517,297 @@ get_lex (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
     }
 }
 
+/*
+ * Report the operand of wrong type.
+ *
+ * Results:
+ *	TCL_ERROR is returned, interp->result contains an error message.
+ *
+ * Side effects:
+ *	None.
+ */
+static unsigned char
+illegal_type (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
+	int operator)			/* Operator, which can't use the operand. */
+{
+    Tcl_AppendResult(interp, "can't use non-numeric string as operand of \"",
+	    operator_strings[operator], "\"", 0);
+    return TCL_ERROR;
+}
+
+/*
+ * Apply the unary operator.
+ *
+ * Results:
+ *	TCL_OK is returned, and the result is stored at *valuePtr.
+ *	If the operand is not a number, then TCL_ERROR is returned,
+ *	and interp->result contains an error message.
+ *
+ * Side effects:
+ *	None.
+ */
+static unsigned char
+apply_unary (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
+	int operator,			/* UNARY_MINUS, NOT or BIT_NOT. */
+	Value_t *valuePtr)		/* The operand, and the result. */
+{
+    if (valuePtr->type != TYPE_INT) {
+	return illegal_type(interp, operator);
+    }
+    switch (operator) {
+	case UNARY_MINUS:
+	    valuePtr->int_value = -valuePtr->int_value;
+	    break;
+	case NOT:
+	    valuePtr->int_value = !valuePtr->int_value;
+	    break;
+	case BIT_NOT:
+	    valuePtr->int_value = ~valuePtr->int_value;
+	    break;
+    }
+    return TCL_OK;
+}
+
+/*
+ * Apply the binary operator.
+ *
+ * Results:
+ *	TCL_OK is returned, and the result is stored at *valuePtr.
+ *	If the operands are incompatible with the operator, or
+ *	an arithmetic error occured, then TCL_ERROR is returned,
+ *	and interp->result contains an error message.
+ *
+ * Side effects:
+ *	The operands may be converted to strings.
+ */
+static unsigned char
+apply_binary (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
+	int operator,			/* Binary operator. */
+	Value_t *valuePtr,		/* The first operand, and the result. */
+	Value_t *value2Ptr)		/* The second operand. */
+{
+    /*
+     * At this point we've got two values and an operator.  Check
+     * to make sure that the particular data types are appropriate
+     * for the particular operator, and perform type conversion
+     * if necessary.
+     */
+
+    switch (operator) {
+
+	/*
+	 * For the operators below, no strings are allowed and
+	 * ints get converted to floats if necessary.
+	 */
+
+	case MULT: case DIVIDE: case PLUS: case MINUS:
+	    if ((valuePtr->type == TYPE_STRING)
+		    || (value2Ptr->type == TYPE_STRING)) {
+		return illegal_type(interp, operator);
+	    }
+	    break;
+
+	/*
+	 * For the operators below, only integers are allowed.
+	 */
+
+	case MOD: case LEFT_SHIFT: case RIGHT_SHIFT:
+	case BIT_AND: case BIT_XOR: case BIT_OR:
+	     if (valuePtr->type != TYPE_INT) {
+		 return illegal_type(interp, operator);
+	     } else if (value2Ptr->type != TYPE_INT) {
+		 return illegal_type(interp, operator);
+	     }
+	     break;
+
+	/*
+	 * For the operators below, any type is allowed but the
+	 * two operands must have the same type.  Convert integers
+	 * to floats and either to strings, if necessary.
+	 */
+
+	case LESS: case GREATER: case LEQ: case GEQ:
+	case EQUAL: case NEQ:
+	    if (valuePtr->type == TYPE_STRING) {
+		if (value2Ptr->type != TYPE_STRING) {
+		    make_string (interp, value2Ptr);
+		}
+	    } else if (value2Ptr->type == TYPE_STRING) {
+		if (valuePtr->type != TYPE_STRING) {
+		    make_string (interp, valuePtr);
+		}
+	    }
+	    break;
+
+	/*
+	 * For the operators below, no strings are allowed.
+	 */
+	case AND: case OR:
+	    if (valuePtr->type == TYPE_STRING) {
+		return illegal_type(interp, operator);
+	    }
+	    if (value2Ptr->type == TYPE_STRING) {
+		return illegal_type(interp, operator);
+	    }
+	    break;
+
+	/*
+	 * For the operators below, type and conversions are
+	 * irrelevant:  they're handled elsewhere.
+	 */
+
+	case QUESTY: case COLON:
+	    break;
+
+	/*
+	 * Any other operator is an error.
+	 */
+
+	default:
+	    interp->result = (unsigned char*) "unknown operator in expression";
+	    return TCL_ERROR;
+    }
+
+    /*
+     * If necessary, convert one of the operands to the type
+     * of the other.  If the operands are incompatible with
+     * the operator (e.g. "+" on strings) then return an
+     * error.
+     */
+
+    switch (operator) {
+	case MULT:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value *= value2Ptr->int_value;
+	    }
+	    break;
+	case DIVIDE:
+	    if (valuePtr->type == TYPE_INT) {
+		if (value2Ptr->int_value == 0) {
+		    divideByZero:
+		    interp->result = (unsigned char*) "divide by zero";
+		    return TCL_ERROR;
+		}
+		valuePtr->int_value /= value2Ptr->int_value;
+	    }
+	    break;
+	case MOD:
+	    if (value2Ptr->int_value == 0) {
+		goto divideByZero;
+	    }
+	    valuePtr->int_value %= value2Ptr->int_value;
+	    break;
+	case PLUS:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value += value2Ptr->int_value;
+	    }
+	    break;
+	case MINUS:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value -= value2Ptr->int_value;
+	    }
+	    break;
+	case LEFT_SHIFT:
+	    valuePtr->int_value <<= value2Ptr->int_value;
+	    break;
+	case RIGHT_SHIFT:
+	    /*
+	     * The following code is a bit tricky:  it ensures that
+	     * right shifts propagate the sign bit even on machines
+	     * where ">>" won't do it by default.
+	     */
+
+	    if (valuePtr->int_value < 0) {
+		valuePtr->int_value =
+			~((~valuePtr->int_value) >> value2Ptr->int_value);
+	    } else {
+		valuePtr->int_value >>= value2Ptr->int_value;
+	    }
+	    break;
+	case LESS:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value < value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) < 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case GREATER:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value > value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) > 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case LEQ:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value <= value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) <= 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case GEQ:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value >= value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) >= 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case EQUAL:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value == value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) == 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case NEQ:
+	    if (valuePtr->type == TYPE_INT) {
+		valuePtr->int_value =
+		    valuePtr->int_value != value2Ptr->int_value;
+	    } else {
+		valuePtr->int_value =
+			strcmp(valuePtr->pv.buffer, value2Ptr->pv.buffer) != 0;
+	    }
+	    valuePtr->type = TYPE_INT;
+	    break;
+	case BIT_AND:
+	    valuePtr->int_value &= value2Ptr->int_value;
+	    break;
+	case BIT_XOR:
+	    valuePtr->int_value ^= value2Ptr->int_value;
+	    break;
+	case BIT_OR:
+	    valuePtr->int_value |= value2Ptr->int_value;
+	    break;
+
+	case AND:
+	    valuePtr->int_value = valuePtr->int_value && value2Ptr->int_value;
+	    break;
+	case OR:
+	    valuePtr->int_value = valuePtr->int_value || value2Ptr->int_value;
+	    break;
+
+	case COLON:
+	    interp->result = (unsigned char*) "can't have : operator without ? first";
+	    return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
 /*
  * Parse a "value" from the remainder of the expression in infoPtr.
  *
@@ -463,8 +839,6 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
 					 * operator.  */
     int operator;			/* Current operator (either unary
 					 * or binary). */
-    int badType;			/* Type of offending argument;  used
-					 * for error messages. */
     int gotOp;				/* Non-zero means already lexed the
 					 * operator (while picking up value
 					 * for unary operator).  Don't lex
@@ -519,31 +893,9 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
 	    if (result != TCL_OK) {
 		goto done;
 	    }
-	    switch (operator) {
-		case UNARY_MINUS:
-		    if (valuePtr->type == TYPE_INT) {
-			valuePtr->int_value = -valuePtr->int_value;
-		    } else {
-			badType = valuePtr->type;
-			goto illegalType;
-		    }
-		    break;
-		case NOT:
-		    if (valuePtr->type == TYPE_INT) {
-			valuePtr->int_value = !valuePtr->int_value;
-		    } else {
-			badType = valuePtr->type;
-			goto illegalType;
-		    }
-		    break;
-		case BIT_NOT:
-		    if (valuePtr->type == TYPE_INT) {
-			valuePtr->int_value = ~valuePtr->int_value;
-		    } else {
-			badType  = valuePtr->type;
-			goto illegalType;
-		    }
-		    break;
+	    result = apply_unary(interp, operator, valuePtr);
+	    if (result != TCL_OK) {
+		goto done;
 	    }
 	    gotOp = 1;
 	} else if (infoPtr->token != VALUE) {
@@ -585,7 +937,6 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
 
 	if ((operator == AND) || (operator == OR) || (operator == QUESTY)) {
 	    if (valuePtr->type == TYPE_STRING) {
-		badType = TYPE_STRING;
 		goto illegalType;
 	    }
 	    if (((operator == AND) && !valuePtr->int_value)
@@ -642,232 +993,9 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
 	    goto syntaxError;
 	}
 
-	/*
-	 * At this point we've got two values and an operator.  Check
-	 * to make sure that the particular data types are appropriate
-	 * for the particular operator, and perform type conversion
-	 * if necessary.
-	 */
-
-	switch (operator) {
-
-	    /*
-	     * For the operators below, no strings are allowed and
-	     * ints get converted to floats if necessary.
-	     */
-
-	    case MULT: case DIVIDE: case PLUS: case MINUS:
-		if ((valuePtr->type == TYPE_STRING)
-			|| (value2.type == TYPE_STRING)) {
-		    badType = TYPE_STRING;
-		    goto illegalType;
-		}
-		break;
-
-	    /*
-	     * For the operators below, only integers are allowed.
-	     */
-
-	    case MOD: case LEFT_SHIFT: case RIGHT_SHIFT:
-	    case BIT_AND: case BIT_XOR: case BIT_OR:
-		 if (valuePtr->type != TYPE_INT) {
-		     badType = valuePtr->type;
-		     goto illegalType;
-		 } else if (value2.type != TYPE_INT) {
-		     badType = value2.type;
-		     goto illegalType;
-		 }
-		 break;
-
-	    /*
-	     * For the operators below, any type is allowed but the
-	     * two operands must have the same type.  Convert integers
-	     * to floats and either to strings, if necessary.
-	     */
-
-	    case LESS: case GREATER: case LEQ: case GEQ:
-	    case EQUAL: case NEQ:
-		if (valuePtr->type == TYPE_STRING) {
-		    if (value2.type != TYPE_STRING) {
-			make_string (interp->pool, &value2);
-		    }
-		} else if (value2.type == TYPE_STRING) {
-		    if (valuePtr->type != TYPE_STRING) {
-			make_string (interp->pool, valuePtr);
-		    }
-		}
-		break;
-
-	    /*
-	     * For the operators below, no strings are allowed.
-	     */
-	    case AND: case OR:
-		if (valuePtr->type == TYPE_STRING) {
-		    badType = valuePtr->type;
-		    goto illegalType;
-		}
-		if (value2.type == TYPE_STRING) {
-		    badType = value2.type;
-		    goto illegalType;
-		}
-		break;
-
-	    /*
-	     * For the operators below, type and conversions are
-	     * irrelevant:  they're handled elsewhere.
-	     */
-
-	    case QUESTY: case COLON:
-		break;
-
-	    /*
-	     * Any other operator is an error.
-	     */
-
-	    default:
-		interp->result = (unsigned char*) "unknown operator in expression";
-		result = TCL_ERROR;
-		goto done;
-	}
-
-	/*
-	 * If necessary, convert one of the operands to the type
-	 * of the other.  If the operands are incompatible with
-	 * the operator (e.g. "+" on strings) then return an
-	 * error.
-	 */
-
-	switch (operator) {
-	    case MULT:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value *= value2.int_value;
-		}
-		break;
-	    case DIVIDE:
-		if (valuePtr->type == TYPE_INT) {
-		    if (value2.int_value == 0) {
-			divideByZero:
-			interp->result = (unsigned char*) "divide by zero";
-			result = TCL_ERROR;
-			goto done;
-		    }
-		    valuePtr->int_value /= value2.int_value;
-		}
-		break;
-	    case MOD:
-		if (value2.int_value == 0) {
-		    goto divideByZero;
-		}
-		valuePtr->int_value %= value2.int_value;
-		break;
-	    case PLUS:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value += value2.int_value;
-		}
-		break;
-	    case MINUS:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value -= value2.int_value;
-		}
-		break;
-	    case LEFT_SHIFT:
-		valuePtr->int_value <<= value2.int_value;
-		break;
-	    case RIGHT_SHIFT:
-		/*
-		 * The following code is a bit tricky:  it ensures that
-		 * right shifts propagate the sign bit even on machines
-		 * where ">>" won't do it by default.
-		 */
-
-		if (valuePtr->int_value < 0) {
-		    valuePtr->int_value =
-			    ~((~valuePtr->int_value) >> value2.int_value);
-		} else {
-		    valuePtr->int_value >>= value2.int_value;
-		}
-		break;
-	    case LESS:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value < value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) < 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case GREATER:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value > value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) > 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case LEQ:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value <= value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) <= 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case GEQ:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value >= value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) >= 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case EQUAL:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value == value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) == 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case NEQ:
-		if (valuePtr->type == TYPE_INT) {
-		    valuePtr->int_value =
-			valuePtr->int_value != value2.int_value;
-		} else {
-		    valuePtr->int_value =
-			    strcmp(valuePtr->pv.buffer, value2.pv.buffer) != 0;
-		}
-		valuePtr->type = TYPE_INT;
-		break;
-	    case BIT_AND:
-		valuePtr->int_value &= value2.int_value;
-		break;
-	    case BIT_XOR:
-		valuePtr->int_value ^= value2.int_value;
-		break;
-	    case BIT_OR:
-		valuePtr->int_value |= value2.int_value;
-		break;
-
-	    case AND:
-		valuePtr->int_value = valuePtr->int_value && value2.int_value;
-		break;
-	    case OR:
-		valuePtr->int_value = valuePtr->int_value || value2.int_value;
-		break;
-
-	    case COLON:
-		interp->result = (unsigned char*) "can't have : operator without ? first";
-		result = TCL_ERROR;
-		goto done;
+	result = apply_binary(interp, operator, valuePtr, &value2);
+	if (result != TCL_OK) {
+	    goto done;
 	}
     }
 
@@ -885,9 +1013,7 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
     goto done;
 
     illegalType:
-    Tcl_AppendResult(interp, "can't use non-numeric string as operand of \"",
-            operator_strings[operator], "\"", 0);
-    result = TCL_ERROR;
+    result = illegal_type(interp, operator);
     goto done;
 }
 
@@ -902,14 +1028,14 @@ get_value (Tcl_Interp *interp,	/* Interpreter to use for error reporting. */
  *	None.
  */
 static void
-make_string (mem_pool_t *pool,
+make_string (Tcl_Interp *interp,
 	Value_t *valuePtr)		/* Value to be converted. */
 {
     unsigned short space;
 
     space = valuePtr->pv.end - valuePtr->pv.buffer;
     if (20 > space) {
-	(*valuePtr->pv.expandProc) (&valuePtr->pv, 20 - space, pool);
+	(*valuePtr->pv.expandProc) (&valuePtr->pv, 20 - space, interp);
     }
     if (valuePtr->type == TYPE_INT) {
 	snprintf (valuePtr->pv.buffer, STATIC_STRING_SPACE, "%ld",
@@ -919,16 +1045,696 @@ make_string (mem_pool_t *pool,
 }
 
 /*
- * This procedure provides top-level functionality shared by
- * procedures like Tcl_ExprInt, etc.
+ * Add an instruction to the program being compiled, and track
+ * the depth of the operand stack.
  *
  * Results:
- *	The result is a standard Tcl return value.  If an error
- *	occurs then an error message is left in interp->result.
- *	The value of the expression is returned in *valuePtr, in
- *	whatever form it ends up in (could be string or integer).
- *	Caller may need to convert result.  Caller
- *	is also responsible for freeing string memory in *valuePtr,
+ *	Pointer to the instruction, or NULL if the program is too long.
+ *
+ * Side effects:
+ *	None.
+ */
+static Expr_code_t *
+emit (Expr_compile_t *c,		/* State of the compiler. */
+	unsigned char op,		/* Operator or instruction. */
+	unsigned char *p)		/* Position of the operand. */
+{
+    Expr_code_t *code;
+
+    if (c->length >= MAX_CODE) {
+	return 0;
+    }
+    code = &c->code [c->length++];
+    code->op = op;
+    code->offset = p - c->info.original_expr;
+    code->int_value = 0;
+    code->ptr = 0;
+    if (op >= PUSH_INT && op <= PUSH_QUOTE) {
+	if (++c->depth > c->max_depth) {
+	    c->max_depth = c->depth;
+	}
+    } else if (op == QUESTY) {
+	c->depth -= 2;
+    } else if (op >= MULT && op < UNARY_MINUS) {
+	c->depth--;
+    }
+    return code;
+}
+
+/*
+ * Lexical analyzer for the compiler:  get the next token by get_lex
+ * (the caller has set interp->noEval, so nothing is executed), and
+ * generate an instruction, if the token is a value.
+ *
+ * Results:
+ *	TCL_OK is returned, unless a syntax error found or the program
+ *	is too long.
+ *
+ * Side effects:
+ *	None.
+ */
+static unsigned char
+compile_lex (Tcl_Interp *interp,	/* Interpreter to use for parsing. */
+	Expr_compile_t *c)		/* State of the compiler. */
+{
+    unsigned char *p, *q, result;
+    Expr_code_t *code;
+
+    p = c->info.expr;
+    while (isspace(*p)) {
+	p++;
+    }
+    c->value.pv.next = c->value.pv.buffer;
+    result = get_lex(interp, &c->info, &c->value);
+    if (result != TCL_OK || c->info.token != VALUE) {
+	return result;
+    }
+    switch (*p) {
+	case '$':
+	    code = emit(c, PUSH_VAR, p);
+	    if (! code) {
+		return TCL_ERROR;
+	    }
+
+	    /*
+	     * Simple names may get slots of local variables.
+	     */
+	    for (q = p+1; isalnum(*q) || *q == '_'; q++) {
+		continue;
+	    }
+	    if (q == c->info.expr && q > p+1) {
+		code->int_value = -1;
+	    }
+	    return TCL_OK;
+
+	case '[':
+	    code = emit(c, PUSH_CMD, p);
+	    if (! code) {
+		return TCL_ERROR;
+	    }
+	    code->int_value = c->info.expr - 1 - c->info.original_expr;
+	    return TCL_OK;
+
+	case '"':
+	    for (q = p+1; q < c->info.expr; q++) {
+		if (*q == '$' || *q == '[') {
+		    return emit(c, PUSH_QUOTE, p) ? TCL_OK : TCL_ERROR;
+		}
+	    }
+	    break;
+    }
+
+    /*
+     * Number, or a string without substitutions.
+     */
+    code = emit(c, (c->value.type == TYPE_INT) ? PUSH_INT : PUSH_STRING, p);
+    if (! code) {
+	return TCL_ERROR;
+    }
+    if (c->value.type == TYPE_INT) {
+	code->int_value = c->value.int_value;
+	return TCL_OK;
+    }
+    code->ptr = mem_alloc(interp->pool, strlen(c->value.pv.buffer) + 1);
+    if (! code->ptr) {
+	c->length--;
+	return TCL_ERROR;
+    }
+    strcpy(code->ptr, c->value.pv.buffer);
+    return TCL_OK;
+}
+
+/*
+ * Compile a "value" from the remainder of the expression.
+ * The syntax is the same as in get_value:  instead of computing
+ * the value, generate the postfix program.  The second operand
+ * of &&, || and ?: is executed with interp->noEval set, when
+ * it is not needed;  that gives the same result as get_value,
+ * including errors.
+ *
+ * Results:
+ *	TCL_OK is returned, unless there is a syntax error, or
+ *	the program is too long.
+ *
+ * Side effects:
+ *	None.
+ */
+static unsigned char
+compile_value (Tcl_Interp *interp,	/* Interpreter to use for parsing. */
+	Expr_compile_t *c,		/* State of the compiler. */
+	int prec)			/* Treat any un-parenthesized operator
+					 * with precedence <= this as the end
+					 * of the expression. */
+{
+    int operator, gotOp = 0;
+    unsigned char result;
+
+    result = compile_lex(interp, c);
+    if (result != TCL_OK) {
+	return result;
+    }
+    if (c->info.token == OPEN_PAREN) {
+	result = compile_value(interp, c, -1);
+	if (result != TCL_OK) {
+	    return result;
+	}
+	if (c->info.token != CLOSE_PAREN) {
+	    return TCL_ERROR;
+	}
+    } else {
+	if (c->info.token == MINUS) {
+	    c->info.token = UNARY_MINUS;
+	}
+	if (c->info.token >= UNARY_MINUS) {
+	    operator = c->info.token;
+	    result = compile_value(interp, c, prec_table[operator]);
+	    if (result != TCL_OK) {
+		return result;
+	    }
+	    if (! emit(c, operator, c->info.expr)) {
+		return TCL_ERROR;
+	    }
+	    gotOp = 1;
+	} else if (c->info.token != VALUE) {
+	    return TCL_ERROR;
+	}
+    }
+    if (!gotOp) {
+	result = compile_lex(interp, c);
+	if (result != TCL_OK) {
+	    return result;
+	}
+    }
+    while (1) {
+	operator = c->info.token;
+	if ((operator < MULT) || (operator >= UNARY_MINUS)) {
+	    if ((operator == END) || (operator == CLOSE_PAREN)) {
+		return TCL_OK;
+	    }
+	    return TCL_ERROR;
+	}
+	if (prec_table[operator] <= prec) {
+	    return TCL_OK;
+	}
+	if (operator == AND || operator == OR) {
+	    if (! emit(c, (operator == AND) ? TEST_AND : TEST_OR,
+		    c->info.expr)) {
+		return TCL_ERROR;
+	    }
+	    result = compile_value(interp, c, prec_table[operator]);
+	} else if (operator == QUESTY) {
+	    if (! emit(c, TEST_QUESTY, c->info.expr)) {
+		return TCL_ERROR;
+	    }
+	    result = compile_value(interp, c, prec_table[operator]);
+	    if (result != TCL_OK) {
+		return result;
+	    }
+	    if (c->info.token != COLON) {
+		return TCL_ERROR;
+	    }
+	    if (! emit(c, TEST_COLON, c->info.expr)) {
+		return TCL_ERROR;
+	    }
+	    result = compile_value(interp, c, prec_table[operator]);
+	} else {
+	    result = compile_value(interp, c, prec_table[operator]);
+	}
+	if (result != TCL_OK) {
+	    return result;
+	}
+	if ((c->info.token < MULT) && (c->info.token != VALUE)
+		&& (c->info.token != END)
+		&& (c->info.token != CLOSE_PAREN)) {
+	    return TCL_ERROR;
+	}
+	if (! emit(c, operator, c->info.expr)) {
+	    return TCL_ERROR;
+	}
+    }
+}
+
+/*
+ * Free the compiled expression, when nobody uses it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ */
+static void
+release_program (Expr_prog_t *prog)
+{
+    Expr_code_t *code;
+
+    if (--prog->ref_count != 0) {
+	return;
+    }
+    for (code = prog->code; code < prog->code + prog->length; code++) {
+	if (code->ptr == 0) {
+	    continue;
+	}
+	if (code->op == PUSH_CMD) {
+	    TclReleaseScript ((CompiledScript*) code->ptr);
+	} else {
+	    mem_free (code->ptr);
+	}
+    }
+    mem_free (prog);
+}
+
+/*
+ * Find the slots for simple variable names in the procedure of the
+ * current call frame.  This is done when the expression is compiled,
+ * and again when it runs in another procedure (like {$i < $n},
+ * shared by loops of different procedures).
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The slots of PUSH_VAR instructions are updated.
+ */
+static void
+resolve_locals (Interp *iPtr,		/* Interpreter. */
+	Expr_prog_t *prog)		/* Compiled expression. */
+{
+    Expr_code_t *code;
+    unsigned char *name, *q;
+    int slot;
+
+    prog->proc_id = iPtr->varFramePtr->procPtr->id;
+    for (code = prog->code; code < prog->code + prog->length; code++) {
+	if (code->op != PUSH_VAR || code->int_value == 0) {
+	    continue;
+	}
+	name = prog->source + code->offset + 1;
+	for (q = name; isalnum(*q) || *q == '_'; q++) {
+	    continue;
+	}
+	slot = TclFindLocal(iPtr, name, q - name);
+	code->int_value = (slot < 0) ? -1 : slot + 1;
+    }
+}
+
+/*
+ * Compile the expression into the postfix program.
+ *
+ * Results:
+ *	The compiled expression with reference count 1.  When the
+ *	expression has a syntax error, or it is too complex, the length
+ *	of the program is 0:  the expression should be interpreted, to get
+ *	the usual result or error message.  NULL is returned, when
+ *	there is no memory.
+ *
+ * Side effects:
+ *	The result of the interpreter is reset.
+ */
+static Expr_prog_t *
+compile (Tcl_Interp *interp,		/* Interpreter to use for parsing. */
+	unsigned char *string)		/* Expression to compile. */
+{
+    Interp *iPtr = (Interp *) interp;
+    Expr_compile_t c;
+    Expr_prog_t *prog;
+    Expr_code_t *code;
+    unsigned char result, saved_flags, *end;
+    unsigned length;
+
+    length = strlen (string) + 1;
+    c.info.original_expr = string;
+    c.info.expr = string;
+    c.value.pv.buffer = c.value.pv.next = c.value.static_space;
+    c.value.pv.end = c.value.pv.buffer + STATIC_STRING_SPACE - 1;
+    c.value.pv.expandProc = TclExpandParseValue;
+    c.value.pv.clientData = (void*) 0;
+    c.length = 0;
+    c.depth = 0;
+    c.max_depth = 0;
+
+    result = TCL_ERROR;
+    if (length <= 0xffff) {
+	/* Offsets fit in 16 bits. */
+	saved_flags = iPtr->flags & COMPILING;
+	iPtr->flags |= COMPILING;
+	iPtr->noEval++;
+	result = compile_value(interp, &c, -1);
+	if (result == TCL_OK && c.info.token != END) {
+	    result = TCL_ERROR;
+	}
+	iPtr->noEval--;
+	iPtr->flags = (iPtr->flags & ~COMPILING) | saved_flags;
+	Tcl_ResetResult(interp);
+    }
+    if (c.value.pv.buffer != c.value.static_space) {
+	mem_free (c.value.pv.buffer);
+    }
+
+    prog = 0;
+    if (result == TCL_OK && c.max_depth <= MAX_STACK) {
+	prog = (Expr_prog_t*) mem_alloc (interp->pool, sizeof (Expr_prog_t) +
+	    c.length * sizeof (Expr_code_t) + length);
+    }
+    if (! prog) {
+	/* Interpret the expression. */
+	for (code = c.code; code < c.code + c.length; code++) {
+	    if (code->ptr) {
+		mem_free (code->ptr);
+	    }
+	}
+	c.length = 0;
+	prog = (Expr_prog_t*) mem_alloc (interp->pool, sizeof (Expr_prog_t) +
+	    length);
+	if (! prog) {
+	    return 0;
+	}
+    }
+    prog->ref_count = 1;
+    prog->proc_id = 0;
+    prog->length = c.length;
+    prog->depth = c.max_depth;
+    prog->code = (Expr_code_t*) (prog + 1);
+    prog->source = (unsigned char*) (prog->code + c.length);
+    memcpy (prog->code, c.code, c.length * sizeof (Expr_code_t));
+    memcpy (prog->source, string, length);
+
+    /*
+     * Compile the nested commands from the copy of the text,
+     * temporarily terminated at the close bracket.
+     */
+    for (code = prog->code; code < prog->code + prog->length; code++) {
+	if (code->op == PUSH_CMD) {
+	    end = prog->source + code->int_value;
+	    *end = 0;
+	    code->ptr = TclCompileScript(iPtr, prog->source + code->offset + 1);
+	    *end = ']';
+	}
+    }
+    if (iPtr->varFramePtr != 0) {
+	resolve_locals (iPtr, prog);
+    }
+    return prog;
+}
+
+/*
+ * Find the compiled expression in the cache of the interpreter,
+ * or compile it.  When the cache is full, the expression which
+ * was not used for the longest time is removed.
+ *
+ * Results:
+ *	The compiled expression, or NULL if there is no memory.
+ *	The caller must release it by release_program.
+ *
+ * Side effects:
+ *	The cache is updated.
+ */
+static Expr_prog_t *
+get_program (Tcl_Interp *interp,	/* Interpreter. */
+	unsigned char *string)		/* Expression. */
+{
+    Interp *iPtr = (Interp *) interp;
+    Expr_prog_t *prog, *old;
+    Tcl_HashEntry *he;
+    Tcl_HashSearch search;
+    int new;
+
+    he = Tcl_FindHashEntry(&iPtr->exprTable, string);
+    if (he != 0) {
+	prog = (Expr_prog_t*) Tcl_GetHashValue(he);
+	prog->last_use = ++iPtr->exprClock;
+	prog->ref_count++;
+	return prog;
+    }
+    prog = compile (interp, string);
+    if (! prog) {
+	return 0;
+    }
+    if (iPtr->numExprs >= NUM_EXPRS) {
+	old = 0;
+	for (he = Tcl_FirstHashEntry(&iPtr->exprTable, &search);
+		he != 0; he = Tcl_NextHashEntry(&search)) {
+	    Expr_prog_t *p = (Expr_prog_t*) Tcl_GetHashValue(he);
+
+	    if (old == 0 || p->last_use < old->last_use) {
+		old = p;
+	    }
+	}
+	Tcl_DeleteHashEntry(old->hPtr);
+	iPtr->numExprs--;
+	release_program (old);
+    }
+    he = Tcl_CreateHashEntry(&iPtr->exprTable, string, &new);
+    Tcl_SetHashValue(he, prog);
+    prog->hPtr = he;
+    prog->last_use = ++iPtr->exprClock;
+    prog->ref_count++;
+    iPtr->numExprs++;
+    return prog;
+}
+
+/*
+ * Empty the cache of compiled expressions, when the interpreter
+ * is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ */
+void
+TclDeleteExprs (Interp *iPtr)
+{
+    Tcl_HashEntry *he;
+    Tcl_HashSearch search;
+
+    for (he = Tcl_FirstHashEntry(&iPtr->exprTable, &search);
+	    he != 0; he = Tcl_NextHashEntry(&search)) {
+	release_program ((Expr_prog_t*) Tcl_GetHashValue(he));
+    }
+    Tcl_DeleteHashTable(&iPtr->exprTable);
+    iPtr->numExprs = 0;
+}
+
+/*
+ * Copy the value.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The storage space of *to may be expanded.
+ */
+static void
+copy_value (Tcl_Interp *interp,	/* Interpreter, for memory pool. */
+	Value_t *to,			/* Where to store the value. */
+	Value_t *from)			/* Value to copy. */
+{
+    if (from->type == TYPE_INT) {
+	to->type = TYPE_INT;
+	to->int_value = from->int_value;
+    } else {
+	set_string (interp, from->pv.buffer, to);
+    }
+}
+
+/*
+ * Execute the compiled expression.  Integer values are kept
+ * in binary form on the operand stack, strings are copied only
+ * when the value of a variable, command or constant is not a number.
+ *
+ * Results:
+ *	The result is a standard Tcl return value, as from get_value.
+ *	The value of the expression is returned in *valuePtr.
+ *
+ * Side effects:
+ *	None.
+ */
+static unsigned char
+execute (Tcl_Interp *interp,		/* Context in which to evaluate the
+					 * expression. */
+	Expr_prog_t *prog,		/* Compiled expression. */
+	Value_t *valuePtr)		/* Where to store result.  Should
+					 * not be initialized by caller. */
+{
+    Interp *iPtr = (Interp *) interp;
+    Value_t stack [MAX_STACK - 1], *slot [MAX_STACK], *v;
+    Expr_code_t *code;
+    unsigned char *var, *term, result = TCL_OK;
+    int sp;
+
+    slot[0] = valuePtr;
+    for (sp=0; sp<prog->depth; sp++) {
+	if (sp > 0) {
+	    slot[sp] = &stack[sp-1];
+	}
+	v = slot[sp];
+	v->pv.buffer = v->pv.next = v->static_space;
+	v->pv.end = v->pv.buffer + STATIC_STRING_SPACE - 1;
+	v->pv.expandProc = TclExpandParseValue;
+	v->pv.clientData = (void*) 0;
+	v->skip = 0;
+    }
+    if (iPtr->varFramePtr != 0 &&
+	iPtr->varFramePtr->procPtr->id != prog->proc_id) {
+	resolve_locals (iPtr, prog);
+    }
+    sp = 0;
+    for (code = prog->code; code < prog->code + prog->length; code++) {
+	switch (code->op) {
+	    case PUSH_INT:
+		v = slot[sp++];
+		v->type = TYPE_INT;
+		v->int_value = code->int_value;
+		break;
+
+	    case PUSH_STRING:
+		set_string (interp, code->ptr, slot[sp++]);
+		break;
+
+	    case PUSH_VAR:
+		v = slot[sp++];
+		if (iPtr->noEval) {
+		    v->type = TYPE_INT;
+		    v->int_value = 0;
+		    break;
+		}
+		var = 0;
+		if (code->int_value > 0) {
+		    var = TclGetLocal(iPtr, prog->proc_id,
+			code->int_value - 1);
+		}
+		if (var == 0) {
+		    var = Tcl_ParseVar(interp, prog->source + code->offset, 0);
+		    if (var == 0) {
+			result = TCL_ERROR;
+			goto done;
+		    }
+		}
+		parse_string(interp, var, v);
+		break;
+
+	    case PUSH_CMD:
+		v = slot[sp++];
+		if (iPtr->noEval) {
+		    v->type = TYPE_INT;
+		    v->int_value = 0;
+		    break;
+		}
+		if (code->ptr) {
+		    result = TclExecScript(iPtr, (CompiledScript*) code->ptr,
+			(unsigned*) 0);
+		} else {
+		    result = Tcl_Eval(interp, prog->source + code->offset + 1,
+			TCL_BRACKET_TERM, &term);
+		}
+		if (result != TCL_OK) {
+		    goto done;
+		}
+		parse_string(interp, interp->result, v);
+		Tcl_ResetResult(interp);
+		break;
+
+	    case PUSH_QUOTE:
+		v = slot[sp++];
+		v->pv.next = v->pv.buffer;
+		result = TclParseQuotes(interp, prog->source + code->offset + 1,
+		    '"', 0, &term, &v->pv);
+		if (result != TCL_OK) {
+		    goto done;
+		}
+		parse_string(interp, v->pv.buffer, v);
+		break;
+
+	    case TEST_AND:
+	    case TEST_OR:
+	    case TEST_QUESTY:
+		v = slot[sp-1];
+		if (v->type == TYPE_STRING) {
+		    result = illegal_type(interp, (code->op == TEST_AND) ? AND :
+			(code->op == TEST_OR) ? OR : QUESTY);
+		    goto done;
+		}
+		if ((code->op == TEST_OR) ? v->int_value : ! v->int_value) {
+		    iPtr->noEval++;
+		    v->skip = 1;
+		}
+		break;
+
+	    case TEST_COLON:
+		/*
+		 * The second operand was skipped:  execute the third one.
+		 * Otherwise skip the third one.
+		 */
+		v = slot[sp-2];
+		if (v->skip) {
+		    iPtr->noEval--;
+		    v->skip = 0;
+		} else {
+		    iPtr->noEval++;
+		    v->skip = 1;
+		}
+		break;
+
+	    case QUESTY:
+		v = slot[sp-3];
+		if (v->skip) {
+		    iPtr->noEval--;
+		    v->skip = 0;
+		}
+		copy_value(interp, v, slot [v->int_value ? sp-2 : sp-1]);
+		sp -= 2;
+		break;
+
+	    case UNARY_MINUS:
+	    case NOT:
+	    case BIT_NOT:
+		result = apply_unary(interp, code->op, slot[sp-1]);
+		if (result != TCL_OK) {
+		    goto done;
+		}
+		break;
+
+	    default:
+		v = slot[sp-2];
+		if (v->skip) {
+		    iPtr->noEval--;
+		    v->skip = 0;
+		}
+		result = apply_binary(interp, code->op, v, slot[sp-1]);
+		if (result != TCL_OK) {
+		    goto done;
+		}
+		sp--;
+		break;
+	}
+    }
+
+    done:
+    for (sp=0; sp<prog->depth; sp++) {
+	v = slot[sp];
+	if (v->skip) {
+	    iPtr->noEval--;
+	}
+	if (sp > 0 && v->pv.buffer != v->static_space) {
+	    mem_free (v->pv.buffer);
+	}
+    }
+    return result;
+}
+
+/*
+ * This procedure provides top-level functionality shared by
+ * procedures like Tcl_ExprInt, etc.
+ *
+ * Results:
+ *	The result is a standard Tcl return value.  If an error
+ *	occurs then an error message is left in interp->result.
+ *	The value of the expression is returned in *valuePtr, in
+ *	whatever form it ends up in (could be string or integer).
+ *	Caller may need to convert result.  Caller
+ *	is also responsible for freeing string memory in *valuePtr,
  *	if any was allocated.
  *
  * Side effects:
@@ -941,9 +1747,30 @@ evaluate (Tcl_Interp *interp,	/* Context in which to evaluate the
 	Value_t *valuePtr)	/* Where to store result.  Should
 				 * not be initialized by caller. */
 {
+    Interp *iPtr = (Interp *) interp;
     Expr_info_t info;
+    Expr_prog_t *prog;
     unsigned char result;
 
+    /*
+     * Expressions with substitutions are usually evaluated many
+     * times, in loops:  compile them.  Constant expressions are
+     * usually produced by substitutions in the expr command,
+     * and are interpreted.
+     */
+    if (! (iPtr->flags & NO_COMPILE) && ! iPtr->noEval &&
+	(strchr (string, '$') || strchr (string, '['))) {
+	prog = get_program (interp, string);
+	if (prog && prog->length) {
+	    result = execute (interp, prog, valuePtr);
+	    release_program (prog);
+	    return result;
+	}
+	if (prog) {
+	    release_program (prog);
+	}
+    }
+
     info.original_expr = string;
     info.expr = string;
     valuePtr->pv.buffer = valuePtr->pv.next = valuePtr->static_space;
@@ -45,7 +45,7 @@ Tcl_GetInt(interp, string, intPtr)
     unsigned char *end;
     int i;
 
-    i = strtol(string, &end, 0);
+    i = strtol((void*) string, (void*) &end, 0);
     while ((*end != '\0') && isspace(*end)) {
 	end++;
     }
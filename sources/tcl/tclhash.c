@@ -34,6 +34,21 @@
 #define RANDOM_INDEX(tablePtr, i) \
     (((((size_t) (i))*1103515245) >> (tablePtr)->downShift) & (tablePtr)->mask)
 
+/*
+ * Entries of tables with a block cache are allocated from the cache.
+ */
+
+#define ALLOC_ENTRY(tablePtr, size) \
+    ((Tcl_HashEntry*) ((tablePtr)->cachePtr ? \
+	Tcl_CacheAlloc((tablePtr)->cachePtr, size) : \
+	mem_alloc((tablePtr)->pool, size)))
+
+#define FREE_ENTRY(tablePtr, hPtr) \
+    if ((tablePtr)->cachePtr) \
+	Tcl_CacheFree((tablePtr)->cachePtr, hPtr); \
+    else \
+	mem_free(hPtr)
+
 /*
  * Procedure prototypes for static procedures in this file:
  */
@@ -80,6 +95,7 @@ Tcl_InitHashTable(Tcl_HashTable *tablePtr, /* Pointer to table record, which
 					 * or an integer >= 2. */
 {
     tablePtr->pool = pool;
+    tablePtr->cachePtr = 0;
     tablePtr->buckets = tablePtr->staticBuckets;
     tablePtr->staticBuckets[0] = tablePtr->staticBuckets[1] = 0;
     tablePtr->staticBuckets[2] = tablePtr->staticBuckets[3] = 0;
@@ -138,7 +154,7 @@ Tcl_DeleteHashEntry(entryPtr)
 	}
     }
     entryPtr->tablePtr->numEntries--;
-    mem_free (entryPtr);
+    FREE_ENTRY(entryPtr->tablePtr, entryPtr);
 }
 
 /*
@@ -172,7 +188,7 @@ Tcl_DeleteHashTable(tablePtr)
 	hPtr = tablePtr->buckets[i];
 	while (hPtr != 0) {
 	    nextPtr = hPtr->nextPtr;
-	    mem_free (hPtr);
+	    FREE_ENTRY(tablePtr, hPtr);
 	    hPtr = nextPtr;
 	}
     }
@@ -494,7 +510,7 @@ StringCreate(tablePtr, key, newPtr)
      */
 
     *newPtr = 1;
-    hPtr = (Tcl_HashEntry*) mem_alloc (tablePtr->pool, (unsigned)
+    hPtr = ALLOC_ENTRY(tablePtr, (unsigned)
 	    (sizeof(Tcl_HashEntry) + strlen(key) - (sizeof(hPtr->key) -1)));
     hPtr->tablePtr = tablePtr;
     hPtr->bucketPtr = &(tablePtr->buckets[index]);
@@ -607,7 +623,7 @@ OneWordCreate(tablePtr, key, newPtr)
      */
 
     *newPtr = 1;
-    hPtr = (Tcl_HashEntry*) mem_alloc (tablePtr->pool, sizeof(Tcl_HashEntry));
+    hPtr = ALLOC_ENTRY(tablePtr, sizeof(Tcl_HashEntry));
     hPtr->tablePtr = tablePtr;
     hPtr->bucketPtr = &(tablePtr->buckets[index]);
     hPtr->nextPtr = *hPtr->bucketPtr;
@@ -743,7 +759,7 @@ ArrayCreate(tablePtr, key, newPtr)
      */
 
     *newPtr = 1;
-    hPtr = (Tcl_HashEntry*) mem_alloc (tablePtr->pool, (unsigned)
+    hPtr = ALLOC_ENTRY(tablePtr, (unsigned)
 	(sizeof(Tcl_HashEntry) + (tablePtr->keyType*sizeof(int)) - 4));
     hPtr->tablePtr = tablePtr;
     hPtr->bucketPtr = &(tablePtr->buckets[index]);
@@ -301,7 +301,7 @@ TclParseQuotes(interp, string, termChar, flags, termPtr, pvPtr)
 	     */
 
 	    pvPtr->next = dst;
-	    (*pvPtr->expandProc) (pvPtr, 1, interp->pool);
+	    (*pvPtr->expandProc) (pvPtr, 1, interp);
 	    dst = pvPtr->next;
 	}
 
@@ -329,7 +329,7 @@ TclParseQuotes(interp, string, termChar, flags, termPtr, pvPtr)
 	    length = strlen(value);
 	    if ((pvPtr->end - dst) <= length) {
 		pvPtr->next = dst;
-		(*pvPtr->expandProc) (pvPtr, length, interp->pool);
+		(*pvPtr->expandProc) (pvPtr, length, interp);
 		dst = pvPtr->next;
 	    }
 	    strcpy(dst, value);
@@ -425,7 +425,7 @@ TclParseNestedCmd(interp, string, flags, termPtr, pvPtr)
     length = strlen(iPtr->result);
     shortfall = length + 1 - (pvPtr->end - pvPtr->next);
     if (shortfall > 0) {
-	(*pvPtr->expandProc) (pvPtr, shortfall, interp->pool);
+	(*pvPtr->expandProc) (pvPtr, shortfall, interp);
     }
     strcpy(pvPtr->next, iPtr->result);
     pvPtr->next += length;
@@ -490,7 +490,7 @@ TclParseBraces(interp, string, termPtr, pvPtr)
 	src++;
 	if (dst == end) {
 	    pvPtr->next = dst;
-	    (*pvPtr->expandProc) (pvPtr, 20, interp->pool);
+	    (*pvPtr->expandProc) (pvPtr, 20, interp);
 	    dst = pvPtr->next;
 	    end = pvPtr->end;
 	}
@@ -523,7 +523,7 @@ TclParseBraces(interp, string, termPtr, pvPtr)
 		while (count > 1) {
                     if (dst == end) {
                         pvPtr->next = dst;
-                        (*pvPtr->expandProc) (pvPtr, 20, interp->pool);
+                        (*pvPtr->expandProc) (pvPtr, 20, interp);
                         dst = pvPtr->next;
                         end = pvPtr->end;
                     }
@@ -643,7 +643,7 @@ TclParseWords(interp, string, flags, maxWords, termPtr, argcPtr, argv, pvPtr)
 		     */
 
 		    pvPtr->next = dst;
-		    (*pvPtr->expandProc) (pvPtr, 1, interp->pool);
+		    (*pvPtr->expandProc) (pvPtr, 1, interp);
 		    dst = pvPtr->next;
 		}
 
@@ -666,7 +666,7 @@ TclParseWords(interp, string, flags, maxWords, termPtr, argcPtr, argv, pvPtr)
 		    length = strlen(value);
 		    if ((pvPtr->end - dst) <= length) {
 			pvPtr->next = dst;
-			(*pvPtr->expandProc) (pvPtr, length, interp->pool);
+			(*pvPtr->expandProc) (pvPtr, length, interp);
 			dst = pvPtr->next;
 		    }
 		    strcpy(dst, value);
@@ -806,8 +806,8 @@ TclParseWords(interp, string, flags, maxWords, termPtr, argcPtr, argv, pvPtr)
  * TclExpandParseValue --
  *
  *	This procedure is commonly used as the value of the
- *	expandProc in a ParseValue.  It uses malloc to allocate
- *	more space for the result of a parse.
+ *	expandProc in a ParseValue.  It allocates more space for
+ *	the result of a parse from the arena of the interpreter.
  *
  * Results:
  *	The buffer space in *pvPtr is reallocated to something
@@ -829,7 +829,8 @@ TclExpandParseValue (ParseValue *pvPtr,	/* Information about buffer that
 					 * dynamically allocated. */
 	unsigned short needed,		/* Minimum amount of additional space
 					 * to allocate. */
-	mem_pool_t *pool)		/* Get memory from here */
+	Tcl_Interp *interp)		/* Get memory from the arena of
+					 * this interpreter. */
 {
     int newSpace;
     unsigned char *new;
@@ -845,7 +846,7 @@ TclExpandParseValue (ParseValue *pvPtr,	/* Information about buffer that
     } else {
 	newSpace += newSpace;
     }
-    new = mem_alloc (pool, newSpace);
+    new = TclArenaAlloc ((Interp *) interp, newSpace);
 
     /*
      * Copy from old buffer to new, free old buffer if needed, and
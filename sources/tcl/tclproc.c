@@ -15,10 +15,17 @@
  */
 #include <tcl/internal.h>
 
+/*
+ * Space for the slots of local variables in the call frame,
+ * allocated on the stack.
+ */
+#define NUM_SLOTS 16
+
 /*
  * Forward references to procedures defined later in this file:
  */
 
+static  void	FindLocals (Tcl_Interp *interp, Proc *procPtr);
 static  int	InterpProc (void *clientData, Tcl_Interp *interp,
 			int argc, unsigned char **argv);
 static  void	ProcDeleteProc (void *clientData);
@@ -67,6 +74,12 @@ Tcl_ProcCmd(dummy, interp, argc, argv)
     procPtr->command = mem_alloc (interp->pool, strlen(argv[3]) + 1);
     strcpy(procPtr->command, argv[3]);
     procPtr->argPtr = 0;
+    procPtr->compiled = 0;
+    procPtr->noCompile = 0;
+    procPtr->refCount = 1;
+    procPtr->id = ++iPtr->procEpoch;
+    procPtr->locals = 0;
+    procPtr->numLocals = 0;
 
     /*
      * Break up the argument list into argument specifiers, then process
@@ -131,6 +144,7 @@ Tcl_ProcCmd(dummy, interp, argc, argv)
 	}
 	mem_free((char *) fieldValues);
     }
+    FindLocals(interp, procPtr);
 
     Tcl_CreateCommand(interp, argv[1], InterpProc, (void*) procPtr,
 	    ProcDeleteProc);
@@ -151,6 +165,132 @@ Tcl_ProcCmd(dummy, interp, argc, argv)
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * FindLocals --
+ *
+ *	Make the table of local variables of a procedure, which get
+ *	slots in the call frame:  the arguments, then the variables,
+ *	referenced in the body as $name.  The compiler resolves these
+ *	names to slot indexes.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets allocated for procPtr->locals.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FindLocals(interp, procPtr)
+    Tcl_Interp *interp;		/* Interpreter. */
+    Proc *procPtr;		/* Procedure. */
+{
+    unsigned char *names[MAX_LOCALS], *p, *q;
+    unsigned char lengths[MAX_LOCALS];
+    Arg *argPtr;
+    int n = 0, size = 0, length, i;
+
+    for (argPtr = procPtr->argPtr; (argPtr != 0) && (n < MAX_LOCALS);
+	    argPtr = argPtr->nextPtr) {
+	length = strlen(argPtr->name);
+	if (length > 255) {
+	    break;
+	}
+	names[n] = argPtr->name;
+	lengths[n++] = length;
+	size += length + 1;
+    }
+    for (p = procPtr->command; (*p != 0) && (n < MAX_LOCALS); p++) {
+	if (*p != '$') {
+	    continue;
+	}
+	for (q = p+1; isalnum(*q) || (*q == '_'); q++) {
+	    continue;
+	}
+	length = q - (p+1);
+	if ((length == 0) || (length > 255) || (*q == '(')) {
+	    /*
+	     * Not a name, or an array element.
+	     */
+
+	    continue;
+	}
+	for (i = 0; i < n; i++) {
+	    if ((lengths[i] == length)
+		    && (strncmp(names[i], p+1, length) == 0)) {
+		break;
+	    }
+	}
+	if (i == n) {
+	    names[n] = p+1;
+	    lengths[n++] = length;
+	    size += length + 1;
+	}
+	p = q - 1;
+    }
+    if (n == 0) {
+	return;
+    }
+
+    procPtr->locals = (unsigned char **) mem_alloc (interp->pool,
+	    n * sizeof(unsigned char *) + size);
+    if (procPtr->locals == 0) {
+	return;
+    }
+    p = (unsigned char *) (procPtr->locals + n);
+    for (i = 0; i < n; i++) {
+	procPtr->locals[i] = p;
+	memcpy(p, names[i], lengths[i]);
+	p += lengths[i];
+	*p++ = 0;
+    }
+    procPtr->numLocals = n;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclFindLocal --
+ *
+ *	Used by the compiler to resolve a variable name to the slot
+ *	in the call frame of the current procedure.
+ *
+ * Results:
+ *	Index of the local variable, or -1 if the name has no slot,
+ *	or no procedure is active.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclFindLocal(iPtr, name, length)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned char *name;	/* Name of variable (not terminated). */
+    int length;			/* Length of the name. */
+{
+    Proc *procPtr;
+    int i;
+
+    if (iPtr->varFramePtr == 0) {
+	return -1;
+    }
+    procPtr = iPtr->varFramePtr->procPtr;
+    for (i = 0; i < procPtr->numLocals; i++) {
+	if ((strncmp(procPtr->locals[i], name, length) == 0)
+		&& (procPtr->locals[i][length] == 0)) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -422,8 +562,9 @@ InterpProc(clientData, interp, argc, argv)
     register Interp *iPtr = (Interp *) interp;
     unsigned char **args;
     CallFrame frame;
-    unsigned char *value, *end;
-    int result;
+    Tcl_HashEntry *(slotStorage[NUM_SLOTS]);
+    unsigned char *value, *merged, *end;
+    int result, slot;
 
     /*
      * Set up a call frame for the new procedure invocation.
@@ -431,6 +572,7 @@ InterpProc(clientData, interp, argc, argv)
 
     iPtr = procPtr->iPtr;
     Tcl_InitHashTable (&frame.varTable, interp->pool, TCL_STRING_KEYS);
+    Tcl_SetHashCache (&frame.varTable, &iPtr->blockCache);
     if (iPtr->varFramePtr != 0) {
 	frame.level = iPtr->varFramePtr->level + 1;
     } else {
@@ -440,17 +582,34 @@ InterpProc(clientData, interp, argc, argv)
     frame.argv = argv;
     frame.callerPtr = iPtr->framePtr;
     frame.callerVarPtr = iPtr->varFramePtr;
+    frame.procPtr = procPtr;
+    frame.varEpoch = iPtr->varEpoch;
+    if (procPtr->numLocals <= NUM_SLOTS) {
+	frame.slots = slotStorage;
+	memset(slotStorage, 0, procPtr->numLocals * sizeof(Tcl_HashEntry *));
+    } else {
+	frame.slots = (Tcl_HashEntry **) mem_alloc (interp->pool,
+		procPtr->numLocals * sizeof(Tcl_HashEntry *));
+    }
     iPtr->framePtr = &frame;
     iPtr->varFramePtr = &frame;
 
+    /*
+     * The procedure may be deleted or redefined by its own body:
+     * keep it until return.
+     */
+
+    procPtr->refCount++;
+
     /*
      * Match the actual arguments against the procedure's formal
-     * parameters to compute local variables.
+     * parameters to compute local variables.  The arguments take
+     * the first slots.
      */
 
-    for (argPtr = procPtr->argPtr, args = argv+1, argc -= 1;
+    for (argPtr = procPtr->argPtr, args = argv+1, argc -= 1, slot = 0;
 	    argPtr != 0;
-	    argPtr = argPtr->nextPtr, args++, argc--) {
+	    argPtr = argPtr->nextPtr, args++, argc--, slot++) {
 
 	/*
 	 * Handle the special case of the last formal being "args".  When
@@ -458,16 +617,14 @@ InterpProc(clientData, interp, argc, argv)
 	 * actual arguments.
 	 */
 
+	merged = 0;
 	if ((argPtr->nextPtr == 0) &&
 	  (strcmp (argPtr->name, (unsigned char*) "args") == 0)) {
 	    if (argc < 0) {
 		argc = 0;
 	    }
-	    value = Tcl_Merge (interp->pool, argc, args);
-	    Tcl_SetVar (interp, argPtr->name, value, 0);
-	    mem_free (value);
+	    value = merged = Tcl_Merge (interp->pool, argc, args);
 	    argc = 0;
-	    break;
 	} else if (argc > 0) {
 	    value = *args;
 	} else if (argPtr->defValue != 0) {
@@ -478,7 +635,14 @@ InterpProc(clientData, interp, argc, argv)
 	    result = TCL_ERROR;
 	    goto procDone;
 	}
-	Tcl_SetVar(interp, argPtr->name, value, 0);
+	if ((slot >= procPtr->numLocals)
+		|| (TclSetLocal(iPtr, procPtr->id, slot, value) == 0)) {
+	    Tcl_SetVar(interp, argPtr->name, value, 0);
+	}
+	if (merged != 0) {
+	    mem_free (merged);
+	    break;
+	}
     }
     if (argc > 0) {
 	Tcl_AppendResult(interp, "called \"", argv[0],
@@ -488,10 +652,24 @@ InterpProc(clientData, interp, argc, argv)
     }
 
     /*
-     * Invoke the commands in the procedure's body.
+     * Invoke the commands in the procedure's body.  Compile it
+     * on the first call.
      */
 
-    result = Tcl_Eval(interp, procPtr->command, 0, &end);
+    if (iPtr->flags & NO_COMPILE) {
+	result = Tcl_Eval(interp, procPtr->command, 0, &end);
+	goto evalDone;
+    }
+    if ((procPtr->compiled == 0) && !procPtr->noCompile) {
+	procPtr->compiled = TclCompileScript(iPtr, procPtr->command);
+	procPtr->noCompile = (procPtr->compiled == 0);
+    }
+    if (procPtr->compiled != 0) {
+	result = TclExecScript(iPtr, procPtr->compiled, (unsigned *) 0);
+    } else {
+	result = Tcl_Eval(interp, procPtr->command, 0, &end);
+    }
+    evalDone:
     if (result == TCL_RETURN) {
 	result = TCL_OK;
     } else if (result == TCL_ERROR) {
@@ -523,6 +701,10 @@ InterpProc(clientData, interp, argc, argv)
     iPtr->framePtr = frame.callerPtr;
     iPtr->varFramePtr = frame.callerVarPtr;
     TclDeleteVars(iPtr, &frame.varTable);
+    if ((frame.slots != slotStorage) && (frame.slots != 0)) {
+	mem_free (frame.slots);
+    }
+    ProcDeleteProc((void *) procPtr);
     return result;
 }
 
@@ -532,8 +714,9 @@ InterpProc(clientData, interp, argc, argv)
  * ProcDeleteProc --
  *
  *	This procedure is invoked just before a command procedure is
- *	removed from an interpreter.  Its job is to release all the
- *	resources allocated to the procedure.
+ *	removed from an interpreter, and on return from every call.
+ *	Its job is to release all the resources allocated to the
+ *	procedure, when it is not used anymore.
  *
  * Results:
  *	None.
@@ -551,7 +734,20 @@ ProcDeleteProc(clientData)
     register Proc *procPtr = (Proc *) clientData;
     register Arg *argPtr;
 
+    if (--procPtr->refCount != 0) {
+	/*
+	 * The procedure is active:  it is freed on return.
+	 */
+
+	return;
+    }
     mem_free (procPtr->command);
+    if (procPtr->locals != 0) {
+	mem_free (procPtr->locals);
+    }
+    if (procPtr->compiled != 0) {
+	TclReleaseScript(procPtr->compiled);
+    }
     for (argPtr = procPtr->argPtr; argPtr != 0; ) {
 	Arg *nextPtr = argPtr->nextPtr;
 
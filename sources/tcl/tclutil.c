@@ -41,7 +41,14 @@
  * Function prototypes for local procedures in this file:
  */
 
+static void		ConvertList (int argc, unsigned char **argv,
+			    int *flagPtr, unsigned char *dst);
+static int		ScanList (int argc, unsigned char **argv,
+			    int *flagPtr);
 static void		SetupAppendBuffer (Interp *iPtr, int newSpace);
+static int		SplitList (Tcl_Interp *interp, unsigned char *list,
+			    int *argcPtr, unsigned char ***argvPtr,
+			    int transient);
 
 /*
  *----------------------------------------------------------------------
@@ -336,10 +343,55 @@ Tcl_SplitList(interp, list, argcPtr, argvPtr)
 				 * the number of elements in the list. */
     unsigned char ***argvPtr;	/* Pointer to place to store pointer to array
 				 * of pointers to list elements. */
+{
+    return SplitList(interp, list, argcPtr, argvPtr, 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclSplitList --
+ *
+ *	Same as Tcl_SplitList, for the commands, which free the array
+ *	before they return:  the memory is allocated from the arena
+ *	of the interpreter.
+ *
+ * Results:
+ *	Same as for Tcl_SplitList.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclSplitList(interp, list, argcPtr, argvPtr)
+    Tcl_Interp *interp;		/* Interpreter to use for error reporting. */
+    unsigned char *list;	/* Pointer to string with list structure. */
+    int *argcPtr;		/* Pointer to location to fill in with
+				 * the number of elements in the list. */
+    unsigned char ***argvPtr;	/* Pointer to place to store pointer to array
+				 * of pointers to list elements. */
+{
+    return SplitList(interp, list, argcPtr, argvPtr, 1);
+}
+
+static int
+SplitList(interp, list, argcPtr, argvPtr, transient)
+    Tcl_Interp *interp;		/* Interpreter to use for error reporting. */
+    unsigned char *list;	/* Pointer to string with list structure. */
+    int *argcPtr;		/* Pointer to location to fill in with
+				 * the number of elements in the list. */
+    unsigned char ***argvPtr;	/* Pointer to place to store pointer to array
+				 * of pointers to list elements. */
+    int transient;		/* Non-zero means allocate the array
+				 * from the arena. */
 {
     unsigned char **argv;
     register unsigned char *p;
     int size, i, result, elSize, brace;
+    unsigned bytes;
     unsigned char *element;
 
     /*
@@ -355,8 +407,12 @@ Tcl_SplitList(interp, list, argcPtr, argvPtr)
 	}
     }
     size++;			/* Leave space for final NULL pointer. */
-    argv = (unsigned char**) mem_alloc (interp->pool, (unsigned)
-	    ((size * sizeof(char *)) + (p - list) + 1));
+    bytes = (size * sizeof(char *)) + (p - list) + 1;
+    if (transient) {
+	argv = (unsigned char**) TclArenaAlloc ((Interp *) interp, bytes);
+    } else {
+	argv = (unsigned char**) mem_alloc (interp->pool, bytes);
+    }
     for (i = 0, p = ((unsigned char *) argv) + size*sizeof(char *);
 	    *list != 0; i++) {
 	result = TclFindElement(interp, list, &element, &list, &elSize, &brace);
@@ -655,34 +711,104 @@ Tcl_Merge (mem_pool_t *pool,
 {
 #   define LOCAL_SIZE 20
     int localFlags[LOCAL_SIZE], *flagPtr;
-    int numChars;
     unsigned char *result;
-    register unsigned char *dst;
-    int i;
-
-    /*
-     * Pass 1: estimate space, gather flags.
-     */
 
     if (argc <= LOCAL_SIZE) {
 	flagPtr = localFlags;
     } else {
 	flagPtr = (int*) mem_alloc (pool, (unsigned) argc*sizeof(int));
     }
+    result = mem_alloc (pool, ScanList(argc, argv, flagPtr));
+    ConvertList(argc, argv, flagPtr, result);
+    if (flagPtr != localFlags) {
+	mem_free (flagPtr);
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclMergeResult --
+ *
+ *	Same as Tcl_Merge, but leave the list in interp->result:  in
+ *	the static space when it fits, or in the arena.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The old result of the interpreter is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclMergeResult(interp, argc, argv)
+    Tcl_Interp *interp;		/* Interpreter to leave the result in. */
+    int argc;			/* How many strings to merge. */
+    unsigned char **argv;	/* Array of string values. */
+{
+    register Interp *iPtr = (Interp *) interp;
+    int localFlags[LOCAL_SIZE], *flagPtr;
+    int numChars;
+    unsigned char *result;
+
+    if (argc <= LOCAL_SIZE) {
+	flagPtr = localFlags;
+    } else {
+	flagPtr = (int*) TclArenaAlloc (iPtr, (unsigned) argc*sizeof(int));
+    }
+    numChars = ScanList(argc, argv, flagPtr);
+    Tcl_FreeResult(interp);
+    if (numChars <= TCL_RESULT_SIZE) {
+	result = iPtr->resultSpace;
+	iPtr->freeProc = 0;
+    } else {
+	result = TclArenaAlloc (iPtr, numChars);
+	iPtr->freeProc = (Tcl_FreeProc *) mem_free;
+    }
+    ConvertList(argc, argv, flagPtr, result);
+    iPtr->result = result;
+    if (flagPtr != localFlags) {
+	mem_free (flagPtr);
+    }
+}
+
+/*
+ * Pass 1 of merging:  estimate space, gather flags.
+ */
+static int
+ScanList(argc, argv, flagPtr)
+    int argc;			/* How many strings to merge. */
+    unsigned char **argv;	/* Array of string values. */
+    int *flagPtr;		/* Flags of the strings, filled here. */
+{
+    int numChars, i;
+
     numChars = 1;
     for (i = 0; i < argc; i++) {
 	numChars += Tcl_ScanElement(argv[i], &flagPtr[i]) + 1;
     }
+    return numChars;
+}
 
-    /*
-     * Pass two: copy into the result area.
-     */
+/*
+ * Pass 2 of merging:  copy into the result area.
+ */
+static void
+ConvertList(argc, argv, flagPtr, result)
+    int argc;			/* How many strings to merge. */
+    unsigned char **argv;	/* Array of string values. */
+    int *flagPtr;		/* Flags of the strings from ScanList. */
+    unsigned char *result;	/* Space for the list. */
+{
+    register unsigned char *dst;
+    int i;
 
-    result = mem_alloc (pool, numChars);
     dst = result;
     for (i = 0; i < argc; i++) {
-	numChars = Tcl_ConvertElement(argv[i], dst, flagPtr[i]);
-	dst += numChars;
+	dst += Tcl_ConvertElement(argv[i], dst, flagPtr[i]);
 	*dst = ' ';
 	dst++;
     }
@@ -691,13 +817,8 @@ Tcl_Merge (mem_pool_t *pool,
     } else {
 	dst[-1] = 0;
     }
-
-    if (flagPtr != localFlags) {
-	mem_free (flagPtr);
-    }
-    return result;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -914,7 +1035,7 @@ Tcl_StringMatch(string, pattern)
  *
  * Side effects:
  *	interp->result is left pointing either to "string" (if "copy" is 0)
- *	or to a copy of string.
+ *	or to a copy of string;  a large copy is made in the arena.
  *
  *----------------------------------------------------------------------
  */
@@ -942,7 +1063,7 @@ Tcl_SetResult(interp, string, freeProc)
     } else if (freeProc == TCL_VOLATILE) {
 	length = strlen(string);
 	if (length > TCL_RESULT_SIZE) {
-	    iPtr->result = mem_alloc (interp->pool, length+1);
+	    iPtr->result = TclArenaAlloc (iPtr, length+1);
 	    iPtr->freeProc = (Tcl_FreeProc *) mem_free;
 	} else {
 	    iPtr->result = iPtr->resultSpace;
@@ -1297,15 +1418,99 @@ TclGetListIndex(interp, string, indexPtr)
     return TCL_OK;
 }
 
+/*
+ * An entry of the cache of compiled regular expressions.
+ */
+
+typedef struct CachedRegexp {
+    Tcl_HashEntry *hPtr;	/* Entry in interp->regexpTable. */
+    unsigned long lastUse;	/* Value of interp->regexpClock on the
+				 * latest lookup. */
+    regexp_t *regexpPtr;	/* Compiled form of the pattern. */
+} CachedRegexp;
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RemoveOldestRegexp --
+ *
+ *	Remove from the cache of compiled regular expressions the
+ *	pattern, which was not used for the longest time.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RemoveOldestRegexp(iPtr)
+    Interp *iPtr;			/* Interpreter. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    CachedRegexp *cachePtr, *oldPtr;
+
+    oldPtr = 0;
+    for (hPtr = Tcl_FirstHashEntry(&iPtr->regexpTable, &search);
+	    hPtr != 0; hPtr = Tcl_NextHashEntry(&search)) {
+	cachePtr = (CachedRegexp *) Tcl_GetHashValue(hPtr);
+	if ((oldPtr == 0) || (cachePtr->lastUse < oldPtr->lastUse)) {
+	    oldPtr = cachePtr;
+	}
+    }
+    if (oldPtr == 0) {
+	return;
+    }
+    mem_free(oldPtr->regexpPtr);
+    Tcl_DeleteHashEntry(oldPtr->hPtr);
+    mem_free(oldPtr);
+    iPtr->numRegexps--;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclSetRegexpCacheSize --
+ *
+ *	Change the number of patterns, kept in the cache of compiled
+ *	regular expressions.  When the cache is larger, the patterns
+ *	which were not used for the longest time are removed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may get freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclSetRegexpCacheSize(iPtr, size)
+    Interp *iPtr;			/* Interpreter. */
+    int size;				/* New number of patterns. */
+{
+    iPtr->maxRegexps = size;
+    while (iPtr->numRegexps > size) {
+	RemoveOldestRegexp(iPtr);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
  * TclCompileRegexp --
  *
  *	Compile a regular expression into a form suitable for fast
- *	matching.  This procedure retains a small cache of pre-compiled
+ *	matching.  This procedure retains a cache of pre-compiled
  *	regular expressions in the interpreter, in order to avoid
- *	compilation costs as much as possible.
+ *	compilation costs as much as possible.  When the cache is
+ *	full, the pattern which was not used for the longest time
+ *	is removed.
  *
  * Results:
  *	The return value is a pointer to the compiled form of string,
@@ -1328,63 +1533,86 @@ TclCompileRegexp(interp, string)
 					 * compiled regular expression. */
 {
     register Interp *iPtr = (Interp *) interp;
-    int i, length, size;
+    Tcl_HashEntry *hPtr;
+    CachedRegexp *cachePtr;
     regexp_t *result;
-
-    length = strlen(string);
-    for (i = 0; i < NUM_REGEXPS; i++) {
-	if ((length == iPtr->patLengths[i])
-		&& (strcmp(string, iPtr->patterns[i]) == 0)) {
-	    /*
-	     * Move the matched pattern to the first slot in the
-	     * cache and shift the other patterns down one position.
-	     */
-
-	    if (i != 0) {
-		int j;
-		unsigned char *cachedString;
-
-		cachedString = iPtr->patterns[i];
-		result = iPtr->regexps[i];
-		for (j = i-1; j >= 0; j--) {
-		    iPtr->patterns[j+1] = iPtr->patterns[j];
-		    iPtr->patLengths[j+1] = iPtr->patLengths[j];
-		    iPtr->regexps[j+1] = iPtr->regexps[j];
-		}
-		iPtr->patterns[0] = cachedString;
-		iPtr->patLengths[0] = length;
-		iPtr->regexps[0] = result;
-	    }
-	    return iPtr->regexps[0];
-	}
+    int size, new;
+
+    hPtr = Tcl_FindHashEntry(&iPtr->regexpTable, string);
+    if (hPtr != 0) {
+	cachePtr = (CachedRegexp *) Tcl_GetHashValue(hPtr);
+	cachePtr->lastUse = ++iPtr->regexpClock;
+	iPtr->regexpHits++;
+	return cachePtr->regexpPtr;
     }
 
     /*
-     * No match in the cache.  Compile the string and add it to the
-     * cache.
+     * No match in the cache.  Compile the string.
      */
+
+    iPtr->regexpMisses++;
     size = regexp_size (string);
     if (size <= 0) {
 	Tcl_AppendResult(interp, "invalid regular expression pattern", 0);
 	return 0;
     }
     result = (regexp_t*) mem_alloc (interp->pool, size);
+    if (result == 0) {
+	Tcl_AppendResult(interp, "not enough memory", 0);
+	return 0;
+    }
     if (! regexp_compile (result, string)) {
 	Tcl_AppendResult(interp, "couldn't compile regular expression pattern", 0);
+	mem_free (result);
 	return 0;
     }
-    if (iPtr->patterns[NUM_REGEXPS-1] != 0) {
-	mem_free (iPtr->patterns[NUM_REGEXPS-1]);
-	mem_free (iPtr->regexps[NUM_REGEXPS-1]);
+
+    /*
+     * Add the compiled form to the cache.  The cache holds at least
+     * one pattern:  the caller does not free the result.
+     */
+
+    while ((iPtr->numRegexps > 0)
+	    && (iPtr->numRegexps >= iPtr->maxRegexps)) {
+	RemoveOldestRegexp(iPtr);
     }
-    for (i = NUM_REGEXPS - 2; i >= 0; i--) {
-	iPtr->patterns[i+1] = iPtr->patterns[i];
-	iPtr->patLengths[i+1] = iPtr->patLengths[i];
-	iPtr->regexps[i+1] = iPtr->regexps[i];
+    cachePtr = (CachedRegexp *) mem_alloc (interp->pool,
+	    sizeof(CachedRegexp));
+    if (cachePtr == 0) {
+	Tcl_AppendResult(interp, "not enough memory", 0);
+	mem_free (result);
+	return 0;
     }
-    iPtr->patterns[0] = mem_alloc (interp->pool, length+1);
-    strcpy(iPtr->patterns[0], string);
-    iPtr->patLengths[0] = length;
-    iPtr->regexps[0] = result;
+    hPtr = Tcl_CreateHashEntry(&iPtr->regexpTable, string, &new);
+    Tcl_SetHashValue(hPtr, cachePtr);
+    cachePtr->hPtr = hPtr;
+    cachePtr->lastUse = ++iPtr->regexpClock;
+    cachePtr->regexpPtr = result;
+    iPtr->numRegexps++;
     return result;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclDeleteRegexps --
+ *
+ *	Empty the cache of compiled regular expressions, when the
+ *	interpreter is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory gets freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclDeleteRegexps(iPtr)
+    Interp *iPtr;			/* Interpreter. */
+{
+    TclSetRegexpCacheSize(iPtr, 0);
+    Tcl_DeleteHashTable(&iPtr->regexpTable);
+}
@@ -35,6 +35,13 @@ static unsigned char *noSuchElement
 static unsigned char *traceActive
 	= (unsigned char*) "trace is active on variable";
 
+/*
+ * Variables are allocated from the block cache of the interpreter
+ * by NewVar, and freed back to it.
+ */
+
+#define FreeVar(iPtr, varPtr) Tcl_CacheFree(&(iPtr)->blockCache, varPtr)
+
 /*
  * Forward references to procedures defined later in this file:
  */
@@ -45,7 +52,9 @@ static unsigned char *	CallTraces (Interp *iPtr, Var *arrayPtr,
 static void		DeleteSearches (Var *arrayVarPtr);
 static void		DeleteArray (Interp *iPtr, unsigned char *arrayName,
 			    Var *varPtr, int flags);
-static Var *		NewVar (mem_pool_t *pool, int space);
+static Tcl_HashEntry *	LocalEntry (Interp *iPtr, unsigned long procId,
+			    int slot, CallFrame **framePtrPtr, int *newPtr);
+static Var *		NewVar (Interp *iPtr, int space);
 static ArraySearch *	ParseSearchId (Tcl_Interp *interp,
 			    Var *varPtr, unsigned char *varName,
 			    unsigned char *string);
@@ -373,13 +382,14 @@ Tcl_SetVar2(interp, part1, part2, newValue, flags)
 
     if (part2 != 0) {
 	if (new) {
-	    varPtr = NewVar (interp->pool, 0);
+	    varPtr = NewVar (iPtr, 0);
 	    Tcl_SetHashValue(hPtr, varPtr);
 	    varPtr->flags = VAR_ARRAY;
 	    varPtr->value.tablePtr = (Tcl_HashTable*)
 		    mem_alloc (interp->pool, sizeof(Tcl_HashTable));
 	    Tcl_InitHashTable (varPtr->value.tablePtr, interp->pool,
 		TCL_STRING_KEYS);
+	    Tcl_SetHashCache (varPtr->value.tablePtr, &iPtr->blockCache);
 	} else {
 	    if (varPtr->flags & VAR_UNDEFINED) {
 		varPtr->flags = VAR_ARRAY;
@@ -387,6 +397,7 @@ Tcl_SetVar2(interp, part1, part2, newValue, flags)
 			mem_alloc (interp->pool, sizeof(Tcl_HashTable));
 		Tcl_InitHashTable (varPtr->value.tablePtr, interp->pool,
 			TCL_STRING_KEYS);
+		Tcl_SetHashCache (varPtr->value.tablePtr, &iPtr->blockCache);
 	    } else if (!(varPtr->flags & VAR_ARRAY)) {
 		if (flags & TCL_LEAVE_ERR_MSG) {
 		    VarErrMsg(interp, part1, part2, (unsigned char*) "set", needArray);
@@ -416,7 +427,7 @@ Tcl_SetVar2(interp, part1, part2, newValue, flags)
      */
 
     if (new) {
-	varPtr = NewVar (interp->pool, length);
+	varPtr = NewVar (iPtr, length);
 	Tcl_SetHashValue(hPtr, varPtr);
 	if ((arrayPtr != 0) && (arrayPtr->searchPtr != 0)) {
 	    DeleteSearches(arrayPtr);
@@ -447,7 +458,7 @@ Tcl_SetVar2(interp, part1, part2, newValue, flags)
 	if (newSize <= (length + varPtr->valueLength)) {
 	    newSize += length;
 	}
-	newVarPtr = NewVar (interp->pool, newSize);
+	newVarPtr = NewVar (iPtr, newSize);
 	newVarPtr->valueLength = varPtr->valueLength;
 	newVarPtr->upvarUses = varPtr->upvarUses;
 	newVarPtr->tracePtr = varPtr->tracePtr;
@@ -455,7 +466,7 @@ Tcl_SetVar2(interp, part1, part2, newValue, flags)
 	newVarPtr->flags = varPtr->flags;
 	strcpy(newVarPtr->value.string, varPtr->value.string);
 	Tcl_SetHashValue(hPtr, newVarPtr);
-	mem_free (varPtr);
+	FreeVar (iPtr, varPtr);
 	varPtr = newVarPtr;
     }
 
@@ -684,7 +695,8 @@ Tcl_UnsetVar2(interp, part1, part2, flags)
     Tcl_SetHashValue(&dummyEntry, &dummyVar);
     if (varPtr->upvarUses == 0) {
 	Tcl_DeleteHashEntry(hPtr);
-	mem_free (varPtr);
+	FreeVar (iPtr, varPtr);
+	iPtr->varEpoch++;
     } else {
 	varPtr->flags = VAR_UNDEFINED;
 	varPtr->tracePtr = 0;
@@ -862,13 +874,14 @@ Tcl_TraceVar2(interp, part1, part2, flags, proc, clientData)
 
     if (part2 != 0) {
 	if (new) {
-	    varPtr = NewVar (interp->pool, 0);
+	    varPtr = NewVar (iPtr, 0);
 	    Tcl_SetHashValue(hPtr, varPtr);
 	    varPtr->flags = VAR_ARRAY;
 	    varPtr->value.tablePtr = (Tcl_HashTable*)
 		mem_alloc (interp->pool, sizeof(Tcl_HashTable));
 	    Tcl_InitHashTable (varPtr->value.tablePtr, interp->pool,
 		TCL_STRING_KEYS);
+	    Tcl_SetHashCache (varPtr->value.tablePtr, &iPtr->blockCache);
 	} else {
 	    if (varPtr->flags & VAR_UNDEFINED) {
 		varPtr->flags = VAR_ARRAY;
@@ -876,6 +889,7 @@ Tcl_TraceVar2(interp, part1, part2, flags, proc, clientData)
 		    mem_alloc (interp->pool, sizeof(Tcl_HashTable));
 		Tcl_InitHashTable (varPtr->value.tablePtr, interp->pool,
 		    TCL_STRING_KEYS);
+		Tcl_SetHashCache (varPtr->value.tablePtr, &iPtr->blockCache);
 	    } else if (!(varPtr->flags & VAR_ARRAY)) {
 		iPtr->result = needArray;
 		return TCL_ERROR;
@@ -888,7 +902,7 @@ Tcl_TraceVar2(interp, part1, part2, flags, proc, clientData)
 	if ((part2 != 0) && (varPtr->searchPtr != 0)) {
 	    DeleteSearches(varPtr);
 	}
-	varPtr = NewVar (interp->pool, 0);
+	varPtr = NewVar (iPtr, 0);
 	varPtr->flags = VAR_UNDEFINED;
 	Tcl_SetHashValue(hPtr, varPtr);
     } else {
@@ -1674,7 +1688,7 @@ Tcl_GlobalCmd(dummy, interp, argc, argv)
     for (argc--, argv++; argc > 0; argc--, argv++) {
 	hPtr = Tcl_CreateHashEntry(&iPtr->globalTable, *argv, &new);
 	if (new) {
-	    gVarPtr = NewVar (interp->pool, 0);
+	    gVarPtr = NewVar (iPtr, 0);
 	    gVarPtr->flags |= VAR_UNDEFINED;
 	    Tcl_SetHashValue(hPtr, gVarPtr);
 	} else {
@@ -1692,7 +1706,7 @@ Tcl_GlobalCmd(dummy, interp, argc, argv)
 		return TCL_ERROR;
 	    }
 	}
-	varPtr = NewVar (interp->pool, 0);
+	varPtr = NewVar (iPtr, 0);
 	varPtr->flags |= VAR_UPVAR;
 	varPtr->value.upvarPtr = hPtr;
 	gVarPtr->upvarUses++;
@@ -1772,7 +1786,7 @@ Tcl_UpvarCmd(dummy, interp, argc, argv)
     while (argc > 0) {
         hPtr = Tcl_CreateHashEntry(upVarTablePtr, argv[0], &new);
         if (new) {
-            upVarPtr = NewVar (interp->pool, 0);
+            upVarPtr = NewVar (iPtr, 0);
             upVarPtr->flags |= VAR_UNDEFINED;
             Tcl_SetHashValue(hPtr, upVarPtr);
         } else {
@@ -1790,7 +1804,7 @@ Tcl_UpvarCmd(dummy, interp, argc, argv)
                 "\" already exists", 0);
             return TCL_ERROR;
         }
-        varPtr = NewVar (interp->pool, 0);
+        varPtr = NewVar (iPtr, 0);
         varPtr->flags |= VAR_UPVAR;
         varPtr->value.upvarPtr = hPtr;
         upVarPtr->upvarUses++;
@@ -1802,6 +1816,182 @@ Tcl_UpvarCmd(dummy, interp, argc, argv)
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * LocalEntry --
+ *
+ *	Find a local variable of the current procedure by its slot.
+ *	The hash entry, found once, is remembered in the call frame,
+ *	until some variable is deleted.
+ *
+ * Results:
+ *	The hash entry of the variable, or NULL if it doesn't exist.
+ *	When newPtr is not NULL, the variable is created if needed
+ *	(like by Tcl_CreateHashEntry), and *newPtr is set.
+ *	*FramePtrPtr is set to the current call frame, or to NULL if
+ *	the slot belongs to another procedure (for example, a loop
+ *	body is compiled in one procedure and executed in another),
+ *	or there was no memory for the slots.
+ *
+ * Side effects:
+ *	The slots of the frame are updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_HashEntry *
+LocalEntry(iPtr, procId, slot, framePtrPtr, newPtr)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned long procId;	/* Procedure, which owns the slot. */
+    int slot;			/* Index of the local variable. */
+    CallFrame **framePtrPtr;	/* Call frame is stored here. */
+    int *newPtr;		/* If not NULL, create the variable. */
+{
+    register CallFrame *framePtr = iPtr->varFramePtr;
+    Tcl_HashEntry *hPtr;
+
+    if ((framePtr == 0) || (framePtr->procPtr->id != procId)
+	    || (framePtr->slots == 0)) {
+	*framePtrPtr = 0;
+	return 0;
+    }
+    *framePtrPtr = framePtr;
+    if (framePtr->varEpoch != iPtr->varEpoch) {
+	memset(framePtr->slots, 0,
+		framePtr->procPtr->numLocals * sizeof(Tcl_HashEntry *));
+	framePtr->varEpoch = iPtr->varEpoch;
+    }
+    hPtr = framePtr->slots[slot];
+    if (hPtr != 0) {
+	return hPtr;
+    }
+    if (newPtr != 0) {
+	hPtr = Tcl_CreateHashEntry(&framePtr->varTable,
+		framePtr->procPtr->locals[slot], newPtr);
+    } else {
+	hPtr = Tcl_FindHashEntry(&framePtr->varTable,
+		framePtr->procPtr->locals[slot]);
+    }
+    framePtr->slots[slot] = hPtr;
+    return hPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetLocal --
+ *
+ *	Return the value of a local variable of the current procedure,
+ *	given its slot.  Only plain scalar variables are handled here;
+ *	arrays, undefined variables and variables with traces are left
+ *	to Tcl_GetVar2.
+ *
+ * Results:
+ *	The value of the variable, or NULL if the caller should
+ *	look it up by name.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+unsigned char *
+TclGetLocal(iPtr, procId, slot)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned long procId;	/* Procedure, which owns the slot. */
+    int slot;			/* Index of the local variable. */
+{
+    CallFrame *framePtr;
+    Tcl_HashEntry *hPtr;
+    register Var *varPtr;
+
+    hPtr = LocalEntry(iPtr, procId, slot, &framePtr, (int *) 0);
+    if (hPtr == 0) {
+	return 0;
+    }
+    varPtr = (Var *) Tcl_GetHashValue(hPtr);
+    if (varPtr->flags & VAR_UPVAR) {
+	varPtr = (Var *) Tcl_GetHashValue(varPtr->value.upvarPtr);
+    }
+    if ((varPtr->flags & (VAR_UNDEFINED|VAR_UPVAR|VAR_ARRAY))
+	    || (varPtr->tracePtr != 0)) {
+	return 0;
+    }
+    return varPtr->value.string;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclSetLocal --
+ *
+ *	Change the value of a local variable of the current procedure,
+ *	given its slot, or create it.  Like TclGetLocal, only plain
+ *	scalar variables are handled.
+ *
+ * Results:
+ *	Returns a pointer to the new value of the variable, or NULL
+ *	if the caller should set it by name.
+ *
+ * Side effects:
+ *	The value of the variable is set.
+ *
+ *----------------------------------------------------------------------
+ */
+
+unsigned char *
+TclSetLocal(iPtr, procId, slot, newValue)
+    Interp *iPtr;		/* Interpreter. */
+    unsigned long procId;	/* Procedure, which owns the slot. */
+    int slot;			/* Index of the local variable. */
+    unsigned char *newValue;	/* New value for variable. */
+{
+    CallFrame *framePtr;
+    Tcl_HashEntry *hPtr;
+    register Var *varPtr;
+    int length, new = 0;
+
+    hPtr = LocalEntry(iPtr, procId, slot, &framePtr, &new);
+    if (framePtr == 0) {
+	return 0;
+    }
+    length = strlen(newValue);
+    if (new) {
+	varPtr = NewVar (iPtr, length + 1);
+	Tcl_SetHashValue(hPtr, varPtr);
+    } else {
+	varPtr = (Var *) Tcl_GetHashValue(hPtr);
+	if (varPtr->flags & VAR_UPVAR) {
+	    hPtr = varPtr->value.upvarPtr;
+	    varPtr = (Var *) Tcl_GetHashValue(hPtr);
+	}
+	if ((varPtr->flags & (VAR_UNDEFINED|VAR_UPVAR|VAR_ARRAY))
+		|| (varPtr->tracePtr != 0)) {
+	    return 0;
+	}
+	if (length >= varPtr->valueSpace) {
+	    Var *newVarPtr;
+	    int newSize;
+
+	    newSize = 2*varPtr->valueSpace;
+	    if (newSize <= length) {
+		newSize += length;
+	    }
+	    newVarPtr = NewVar (iPtr, newSize);
+	    newVarPtr->upvarUses = varPtr->upvarUses;
+	    newVarPtr->flags = varPtr->flags;
+	    Tcl_SetHashValue(hPtr, newVarPtr);
+	    FreeVar (iPtr, varPtr);
+	    varPtr = newVarPtr;
+	}
+    }
+    strcpy(varPtr->value.string, newValue);
+    varPtr->valueLength = length;
+    return varPtr->value.string;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1853,7 +2043,7 @@ TclDeleteVars(iPtr, tablePtr)
 	globalFlag = 0;
 	if (varPtr->flags & VAR_UPVAR) {
 	    hPtr = varPtr->value.upvarPtr;
-	    mem_free (varPtr);
+	    FreeVar (iPtr, varPtr);
 	    varPtr = (Var *) Tcl_GetHashValue(hPtr);
 	    varPtr->upvarUses--;
 	    if ((varPtr->upvarUses != 0) || !(varPtr->flags & VAR_UNDEFINED)
@@ -1887,8 +2077,9 @@ TclDeleteVars(iPtr, tablePtr)
 	}
 	if (globalFlag) {
 	    Tcl_DeleteHashEntry(hPtr);
+	    iPtr->varEpoch++;
 	}
-	mem_free (varPtr);
+	FreeVar (iPtr, varPtr);
     }
     Tcl_DeleteHashTable(tablePtr);
 }
@@ -2043,7 +2234,7 @@ CallTraces (iPtr, arrayPtr, hPtr, part1, part2, flags)
  */
 
 static Var *
-NewVar (mem_pool_t *pool,
+NewVar (Interp *iPtr,		/* Interpreter, whose block cache to use. */
 	int space)		/* Minimum amount of space to allocate
 				 * for variable's value. */
 {
@@ -2055,7 +2246,8 @@ NewVar (mem_pool_t *pool,
 	extra = 0;
 	space = sizeof(varPtr->value);
     }
-    varPtr = (Var*) mem_alloc (pool, (unsigned) (sizeof(Var) + extra));
+    varPtr = (Var*) Tcl_CacheAlloc (&iPtr->blockCache,
+	(unsigned) (sizeof(Var) + extra));
     varPtr->valueLength = 0;
     varPtr->valueSpace = space;
     varPtr->upvarUses = 0;
@@ -2110,7 +2302,7 @@ ParseSearchId(interp, varPtr, varName, string)
 		"\"", 0);
 	return 0;
     }
-    id = strtoul(string+2, &end, 10);
+    id = strtoul((void*) (string+2), (void*) &end, 10);
     if ((end == (string+2)) || (*end != '-')) {
 	goto syntax;
     }
@@ -2216,7 +2408,7 @@ DeleteArray(iPtr, arrayName, varPtr, flags)
 	}
 	assert ((elPtr->flags & VAR_SEARCHES_POSSIBLE) == 0);
 
-	mem_free (elPtr);
+	FreeVar (iPtr, elPtr);
     }
     Tcl_DeleteHashTable(varPtr->value.tablePtr);
     mem_free (varPtr->value.tablePtr);
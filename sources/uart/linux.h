@@ -4,6 +4,7 @@
  */
 #include <unistd.h>
 #include <signal.h>
+#include <sys/ioctl.h>
 
 #define __USE_GNU
 #define _SYS_TYPES_H 1
@@ -30,6 +31,13 @@
 	kill (uart_pid, TRANSMIT_IRQ(p)); }
 #define get_received_byte(p)			0 /* empty */
 
+/* Bulk transfer: get or send all contiguous data by one system call. */
+#define receive_block(p,b,n)			linux_receive_block (b, n)
+#define transmit_block(p,b,n)			({ \
+	int _n = write (1, b, n); \
+	kill (uart_pid, TRANSMIT_IRQ(p)); \
+	_n; })
+
 #define test_transmitter_enabled(p)		1
 #define test_transmitter_empty(p)		1
 #define test_get_receive_data(p,d)		(read (0, d, 1) == 1)
@@ -47,3 +55,18 @@
 #define setup_baud_rate(port, khz, baud)	{ uart_pid = getpid (); }
 
 int uart_pid;
+
+/*
+ * Read the available data, without blocking.
+ */
+static inline int
+linux_receive_block (unsigned char *buf, int n)
+{
+	int avail = 0;
+
+	if (ioctl (0, FIONREAD, &avail) < 0 || avail <= 0)
+		return 0;
+	if (n > avail)
+		n = avail;
+	return read (0, buf, n);
+}
@@ -51,63 +51,136 @@ slip_get_cts (slip_t *u)
 	return u->cts_query == 0 || u->cts_query (u);
 }
 
+/* Word access to the byte data. */
+typedef unsigned __attribute__ ((__may_alias__)) slip_word_t;
+
 /*
- * Start transmitting a byte.
+ * Find the first FLAG or ESC byte in the data.
+ * Check a machine word at a time: a byte of the word is equal
+ * to the given value, when the xor has a zero byte.
+ */
+static const unsigned char *
+slip_scan (const unsigned char *p, const unsigned char *limit)
+{
+	const unsigned ones = (unsigned) -1 / 0xff;
+	const unsigned highs = ones << 7;
+	unsigned x, y;
+
+	while (p < limit && ((size_t) p & (sizeof (unsigned) - 1))) {
+		if (*p == SLIP_FLAG || *p == SLIP_ESC)
+			return p;
+		++p;
+	}
+	while (p + sizeof (unsigned) <= limit) {
+		x = *(const slip_word_t*) p ^ (ones * SLIP_FLAG);
+		y = *(const slip_word_t*) p ^ (ones * SLIP_ESC);
+		if (((x - ones) & ~x & highs) | ((y - ones) & ~y & highs))
+			break;
+		p += sizeof (unsigned);
+	}
+	while (p < limit && *p != SLIP_FLAG && *p != SLIP_ESC)
+		++p;
+	return p;
+}
+
+/*
+ * Fill the transmit block with escaped data of the current packet.
+ * Plain data are copied by whole runs between special bytes.
+ */
+static void
+slip_encode (slip_t *u)
+{
+	unsigned char *dst = u->out_block;
+	unsigned char *end = u->out_block + SLIP_OUTBUFSZ;
+	const unsigned char *q;
+	unsigned n;
+
+	while (dst < end) {
+		if (u->out_flag) {
+			*dst++ = SLIP_FLAG;
+			u->out_flag = 0;
+			continue;
+		}
+		if (! u->out)
+			break;
+		if (u->out_first >= u->out_limit) {
+			if (u->outseg->next) {
+				u->outseg = u->outseg->next;
+				u->out_first = u->outseg->payload;
+				u->out_limit = u->outseg->payload + u->outseg->len;
+				continue;
+			}
+			/* Last segment encoded. The previous packet
+			 * must be deallocated before we finish this one. */
+			if (u->out_free)
+				break;
+			++u->netif.out_packets;
+			u->netif.out_bytes += u->out->tot_len;
+			u->out_free = u->out;
+			u->out = 0;
+			u->out_flag = 1;
+			continue;
+		}
+		if (*u->out_first == SLIP_FLAG || *u->out_first == SLIP_ESC) {
+			if (dst + 2 > end)
+				break;
+			*dst++ = SLIP_ESC;
+			*dst++ = (*u->out_first++ == SLIP_FLAG) ?
+				SLIP_ESC_FLAG : SLIP_ESC_ESC;
+			continue;
+		}
+		q = u->out_first + (end - dst);
+		if (q > u->out_limit)
+			q = u->out_limit;
+		q = slip_scan (u->out_first, q);
+		n = q - u->out_first;
+		memcpy (dst, u->out_first, n);
+		dst += n;
+		u->out_first += n;
+	}
+	u->out_pending = u->out_block;
+	u->out_pending_end = dst;
+}
+
+/*
+ * Start transmitting the escaped data.
  * Assume the transmitter is stopped, and the transmit queue is not empty.
  * Return 1 when we are expecting the hardware interrupt.
  */
 static bool_t
 slip_transmit_start (slip_t *u)
 {
-	unsigned char c;
-
+#ifdef transmit_block
+	int n;
+#endif
 	/* Check that transmitter buffer is busy. */
 	if (! test_transmitter_empty (u->port))
 		return 1;
 
+	if (u->out_pending >= u->out_pending_end)
+		slip_encode (u);
+
 	/* Nothing to transmit or no CTS - stop transmitting. */
-	if ((! u->out_flag && ! u->out) || ! slip_get_cts (u)) {
+	if (u->out_pending >= u->out_pending_end || ! slip_get_cts (u)) {
 		/* Disable `transmitter empty' interrupt. */
 		disable_transmit_interrupt (u->port);
 		return 0;
 	}
 
-	if (u->out_flag) {
-		c = SLIP_FLAG;
-		u->out_flag = 0;
-	} else {
-		c = *u->out_first;
-		switch (c) {
-		case SLIP_FLAG:
-			c = SLIP_ESC;
-			*u->out_first = SLIP_ESC_FLAG;
-			break;
-		case SLIP_ESC:
-			c = SLIP_ESC;
-			*u->out_first = SLIP_ESC_ESC;
-			break;
-		default:
-			++u->out_first;
-			break;
-		}
-		if (u->out_first >= u->out_limit) {
-			u->outseg = u->outseg->next;
-			if (u->outseg) {
-				u->out_first = u->outseg->payload;
-				u->out_limit = u->outseg->payload + u->outseg->len;
-			} else {
-				/* Last segment transmitted. */
-				++u->netif.out_packets;
-				u->netif.out_bytes += u->out->tot_len;
-debug_printf ("slip: transmitted %d bytes\n", u->out->tot_len);
-				u->out_free = u->out;
-				u->out = 0;
-				u->out_flag = 1;
-			}
-		}
-	}
-
-	transmit_byte (u->port, c);
+#ifdef transmit_block
+	/* Send all the block at once. */
+	n = transmit_block (u->port, u->out_pending,
+		u->out_pending_end - u->out_pending);
+	if (n > 0)
+		u->out_pending += n;
+#else
+	/* Fill the hardware FIFO, while it has room:
+	 * one interrupt per FIFO, not per byte. */
+	do {
+		transmit_byte (u->port, *u->out_pending++);
+	} while (u->out_pending < u->out_pending_end &&
+	    test_transmitter_empty (u->port));
+#endif
 
 	/* Enable `transmitter empty' interrupt. */
 	enable_transmit_interrupt (u->port);
@@ -144,7 +217,6 @@ slip_set_cts_poller (slip_t *u, bool_t (*func) (slip_t*))
 bool_t
 slip_output (slip_t *u, buf_t *p, small_uint_t prio)
 {
-debug_printf ("slip_output: transmit %d bytes\n", p->tot_len);
 	mutex_lock (&u->transmitter);
 
 	if (u->out) {
@@ -152,7 +224,6 @@ debug_printf ("slip_output: transmit %d bytes\n", p->tot_len);
 		if (buf_queue_is_full (&u->outq)) {
 			++u->netif.out_discards;
 			mutex_unlock (&u->transmitter);
-debug_printf ("slip_output: overflow\n");
 			buf_free (p);
 			return 0;
 		}
@@ -224,6 +295,115 @@ slip_send (slip_t *u, buf_t *p)
 	return 1;
 }
 
+/*
+ * Store the received data into the current packet.
+ */
+static void
+slip_store (slip_t *u, const unsigned char *p, unsigned n)
+{
+	if (n > u->in_limit - u->in_ptr) {
+		/* Ignore input on buffer overflow. */
+		++u->netif.in_errors;
+		u->in_ptr = u->in->payload;
+		return;
+	}
+	memcpy (u->in_ptr, p, n);
+	u->in_ptr += n;
+	u->netif.in_bytes += n;
+}
+
+/*
+ * Put the received packet into the queue,
+ * and continue with the preallocated buffer.
+ */
+static void
+slip_deliver (slip_t *u)
+{
+	++u->netif.in_packets;
+	if (buf_queue_is_full (&u->inq)) {
+		/* Reuse the packet. */
+		++u->netif.in_discards;
+		u->in_ptr = u->in->payload;
+		return;
+	}
+	buf_truncate (u->in, u->in_ptr - u->in->payload);
+	buf_queue_put (&u->inq, u->in);
+
+	u->in = u->in_spare;
+	u->in_spare = 0;
+	if (u->in) {
+		u->in_ptr = u->in->payload;
+		u->in_limit = u->in_ptr + u->netif.mtu;
+	} else
+		u->in_ptr = 0;
+}
+
+/*
+ * Decode a block of received data. Plain data are copied
+ * into the packet by whole runs between special bytes.
+ * Return 1 when the receive task must be woken up.
+ */
+static bool_t
+slip_decode (slip_t *u, const unsigned char *p, const unsigned char *end)
+{
+	const unsigned char *q;
+	bool_t wakeup = 0;
+	unsigned char c;
+
+	while (p < end) {
+		c = *p++;
+		if (! u->in_ptr || u->in_drop) {
+			/* No buffer - ignore input up to the end of packet. */
+			if (c != SLIP_FLAG) {
+				u->in_drop = 1;
+				continue;
+			}
+			if (u->in_drop) {
+				++u->netif.in_discards;
+				u->in_drop = 0;
+			}
+			u->in_escape = 0;
+			wakeup = 1;
+			continue;
+		}
+		switch (c) {
+		case SLIP_FLAG:
+			u->in_escape = 0;
+			if (u->in_ptr > u->in->payload) {
+				/* Received whole packet. */
+				slip_deliver (u);
+				wakeup = 1;
+			}
+			break;
+
+		case SLIP_ESC:
+			u->in_escape = 1;
+			break;
+
+		default:
+			if (u->in_escape) {
+				u->in_escape = 0;
+				switch (c) {
+				case SLIP_ESC_FLAG:
+					c = SLIP_FLAG;
+					break;
+				case SLIP_ESC_ESC:
+					c = SLIP_ESC;
+					break;
+				}
+				slip_store (u, &c, 1);
+				break;
+			}
+			/* Copy the run of plain data. */
+			q = slip_scan (p, end);
+			slip_store (u, p - 1, q - p + 1);
+			p = q;
+			break;
+		}
+	}
+	return wakeup;
+}
+
 /*
  * Fast receive interrupt handler.
  * Fetch and process all received data from the network controller.
@@ -231,24 +411,25 @@ slip_send (slip_t *u, buf_t *p)
 static int
 slip_receive_data (slip_t *u)
 {
-	unsigned char c = 0;
+	bool_t wakeup = 0;
+	int n;
+#ifndef receive_block
+	unsigned char *q;
+#endif
 
 	for (;;) {
 #ifdef clear_receive_errors
 		clear_receive_errors (u->port);
 #else
 		if (test_frame_error (u->port)) {
-debug_putchar (0, '%');
 			/*debug_printf ("slip: FRAME ERROR\n");*/
 			clear_frame_error (u->port);
 		}
 		if (test_parity_error (u->port)) {
-debug_putchar (0, '@');
 			/*debug_printf ("slip: PARITY ERROR\n");*/
 			clear_parity_error (u->port);
 		}
 		if (test_overrun_error (u->port)) {
-debug_putchar (0, '#');
 			/*debug_printf ("slip: RECEIVE OVERRUN\n");*/
 			clear_overrun_error (u->port);
 		}
@@ -261,55 +442,28 @@ debug_putchar (0, '#');
 		if (test_transmitter_enabled (u->port))
 			slip_transmit_start (u);
 #endif
-		/* Check that receive data is available,
-		 * and get the received byte. */
-		if (! test_get_receive_data (u->port, &c)) {
-			enable_receive_interrupt (u->port);
-			return 1;
-		}
-
-debug_printf ("<%x> ", c);
-		if (! u->in_ptr)
-			continue;
-
-		switch (c) {
-		case SLIP_FLAG:
-			u->in_escape = 0;
-			if (u->in_ptr > u->in->payload) {
-				/* Received whole packet. */
-				return 0;
-			}
-			break;
-
-		case SLIP_ESC:
-			u->in_escape = 1;
-			break;
-
-		default:
-			if (u->in_escape) {
-				u->in_escape = 0;
-				switch (c) {
-				case SLIP_ESC_FLAG:
-					c = SLIP_FLAG;
-					break;
-				case SLIP_ESC_ESC:
-					c = SLIP_ESC;
-					break;
-				}
-			}
-			if (u->in_ptr >= u->in_limit) {
-				/* Ignore input on buffer overflow. */
-debug_putchar (0, '!');
-/*				debug_printf ("slip_receive_data: ignore packet - buffer overflow\n");*/
-				++u->netif.in_errors;
-				u->in_ptr = u->in->payload;
+		/* Get a block of received data. */
+#ifdef receive_block
+		n = receive_block (u->port, u->in_block, SLIP_INBUFSZ);
+#else
+		for (n=0, q=u->in_block; n<SLIP_INBUFSZ; ++n, ++q)
+			if (! test_get_receive_data (u->port, q))
 				break;
-			}
-			*u->in_ptr++ = c;
-			++u->netif.in_bytes;
+#endif
+		if (n <= 0)
 			break;
-		}
+		if (slip_decode (u, u->in_block, u->in_block + n))
+			wakeup = 1;
 	}
+#ifndef TRANSMIT_IRQ
+	/* Let the task deallocate the transmitted packet. */
+	if (u->out_free)
+		wakeup = 1;
+#endif
+	if (wakeup)
+		return 0;
+	enable_receive_interrupt (u->port);
+	return 1;
 }
 
 /*
@@ -329,9 +483,9 @@ slip_out_next (slip_t *u)
 			u->out_first = u->outseg->payload;
 			u->out_limit = u->outseg->payload + u->outseg->len;
 			u->out_flag = 1;
-			slip_transmit_start (u);
 		}
 	}
+	slip_transmit_start (u);
 }
 
 /*
@@ -341,7 +495,6 @@ static void
 slip_receiver (void *arg)
 {
 	slip_t *u = arg;
-	unsigned short len;
 
 	/* Start receiver. */
 	mutex_lock_irq (&u->netif.lock, RECEIVE_IRQ (u->port),
@@ -353,40 +506,25 @@ slip_receiver (void *arg)
 	for (;;) {
 		if (! u->in_ptr) {
 			/* Allocate buffer for receive data. */
-			u->in = buf_alloc (u->pool, u->netif.mtu, 16);
+			u->in = u->in_spare;
+			u->in_spare = 0;
+			if (! u->in)
+				u->in = buf_alloc (u->pool, u->netif.mtu, 16);
 			if (u->in) {
 				u->in_ptr = u->in->payload;
 				u->in_limit = u->in_ptr + u->netif.mtu;
-			} else {
-				/* No buffer - ignore input. */
-debug_printf ("slip_receiver: out of memory\n");
-				++u->netif.in_discards;
 			}
 		}
+		if (u->in_ptr && ! u->in_spare) {
+			/* Preallocate the next packet, so that
+			 * the interrupt handler needs not wait for us. */
+			u->in_spare = buf_alloc (u->pool, u->netif.mtu, 16);
+		}
 
-		/* Wait for the receive interrupt. */
+		/* Wait for the receive interrupt.
+		 * Received packets are enqueued by the handler. */
 		mutex_wait (&u->netif.lock);
 
-		/* Process all available received data. */
-		if (u->in_ptr && u->in_ptr > u->in->payload) {
-			len = u->in_ptr - u->in->payload;
-debug_printf ("slip_receiver(%ld): received %d bytes\n", u->netif.in_packets, len);
-			buf_truncate (u->in, len);
-			++u->netif.in_packets;
-
-			if (buf_queue_is_full (&u->inq)) {
-debug_printf ("slip_receiver: input overflow\n");
-				++u->netif.in_discards;
-
-				/* Reuse the packet. */
-				u->in_ptr = u->in->payload;
-				u->in_limit = u->in_ptr + u->netif.mtu;
-			} else {
-				/* Enqueue the received packet. */
-				buf_queue_put (&u->inq, u->in);
-				u->in_ptr = 0;
-			}
-		}
 #ifndef TRANSMIT_IRQ
 		if (u->out_free)
 			slip_out_next (u);
@@ -436,6 +574,8 @@ slip_init (slip_t *u, small_uint_t port, const char *name, int prio,
 	u->pool = pool;
 	u->port = port;
 	u->khz = khz;
+	u->out_pending = u->out_block;
+	u->out_pending_end = u->out_block;
 	buf_queue_init (&u->inq, u->inqdata, sizeof (u->inqdata));
 	buf_queue_init (&u->outq, u->outqdata, sizeof (u->outqdata));
 
@@ -18,9 +18,24 @@
 #      define SLIP_STACKSZ	4000
 #   endif
 #endif
-#define SLIP_INBUFSZ	8
 
-#define SLIP_OUTBUFSZ	32
+/* Size of receive block, read from UART at once. */
+#ifndef SLIP_INBUFSZ
+#   if __AVR__ || MSP430
+#      define SLIP_INBUFSZ	8
+#   else
+#      define SLIP_INBUFSZ	64
+#   endif
+#endif
+
+/* Size of transmit block with escaped data. */
+#ifndef SLIP_OUTBUFSZ
+#   if __AVR__ || MSP430
+#      define SLIP_OUTBUFSZ	16
+#   else
+#      define SLIP_OUTBUFSZ	64
+#   endif
+#endif
 
 typedef struct _slip_t {
 	netif_t netif;			/* common network interface part */
@@ -36,14 +51,20 @@ typedef struct _slip_t {
         struct _buf_t *outqdata[8];
 
 	struct _buf_t *in;		/* packet currently being received */
+	struct _buf_t *in_spare;	/* preallocated next packet */
 	unsigned char *in_ptr, *in_limit;
 	unsigned char in_escape;
+	unsigned char in_drop;		/* no buffer, packet ignored */
+	unsigned char in_block [SLIP_INBUFSZ]; /* raw data from UART */
 
 	struct _buf_t *out;		/* packet currently in transmit */
 	struct _buf_t *outseg;		/* segment currently in transmit */
 	struct _buf_t *out_free;	/* already transmitted packet */
 	unsigned char *out_first, *out_limit;
 	unsigned char out_flag;		/* need to transmit flag */
+	unsigned char *out_pending;	/* escaped data, ready to transmit */
+	unsigned char *out_pending_end;
+	unsigned char out_block [SLIP_OUTBUFSZ];
 
 	bool_t (*cts_query) (struct _slip_t*);
 
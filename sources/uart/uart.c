@@ -1,6 +1,11 @@
 #include <runtime/lib.h>
 #include <kernel/uos.h>
+#include <kernel/internal.h>
 #include <uart/uart.h>
+#if UART_BUFFERED
+#   include <mem/mem.h>
+#   include <timer/timer.h>
+#endif
 
 #if __AVR__
 #   include "avr.h"
@@ -38,6 +43,9 @@
 static bool_t
 uart_transmit_start (uart_t *u)
 {
+#ifdef transmit_block
+	int n;
+#endif
 	if (u->out_first == u->out_last)
 		mutex_signal (&u->transmitter, 0);
 
@@ -54,11 +62,19 @@ uart_transmit_start (uart_t *u)
 		return 0;
 	}
 
+#ifdef transmit_block
+	/* Send all contiguous data at once. */
+	n = ((u->out_last > u->out_first) ? u->out_last : u->out_limit) -
+		u->out_first;
+	n = transmit_block (u->port, u->out_first, n);
+	if (n > 0)
+		u->out_first += n;
+#else
 	/* Send byte. */
 	transmit_byte (u->port, *u->out_first);
-
 	++u->out_first;
-	if (u->out_first >= u->out_buf + UART_OUTBUFSZ)
+#endif
+	if (u->out_first >= u->out_limit)
 		u->out_first = u->out_buf;
 
 	/* Enable `transmitter empty' interrupt. */
@@ -117,7 +133,7 @@ uart_putchar (uart_t *u, short c)
 	/* Check that transmitter is enabled. */
 	if (test_transmitter_enabled (u->port)) {
 again:		newlast = u->out_last + 1;
-		if (newlast >= u->out_buf + UART_OUTBUFSZ)
+		if (newlast >= u->out_limit)
 			newlast = u->out_buf;
 		while (u->out_first == newlast)
 			mutex_wait (&u->transmitter);
@@ -135,6 +151,194 @@ again:		newlast = u->out_last + 1;
 	mutex_unlock (&u->transmitter);
 }
 
+/*
+ * Send a block of bytes: take the lock once and copy the data
+ * to the buffer by contiguous runs, waiting only when it is full.
+ */
+int
+uart_write (uart_t *u, const void *buf, int len)
+{
+	const unsigned char *p = buf, *end = p + len, *nl;
+	int n;
+	bool_t cr = 0;
+
+	mutex_lock (&u->transmitter);
+
+	/* Check that transmitter is enabled. */
+	if (test_transmitter_enabled (u->port)) {
+		while (p < end || cr) {
+			/* Contiguous free space, one byte is kept unused. */
+			if (u->out_last < u->out_first)
+				n = u->out_first - u->out_last - 1;
+			else
+				n = u->out_limit - u->out_last -
+					(u->out_first == u->out_buf);
+			if (n == 0) {
+				/* Buffer is full. */
+				uart_transmit_start (u);
+				while (u->out_last + 1 == u->out_first ||
+				    (u->out_last + 1 == u->out_limit &&
+				    u->out_first == u->out_buf))
+					mutex_wait (&u->transmitter);
+				continue;
+			}
+			if (cr) {
+				*u->out_last = '\r';
+				cr = 0;
+				n = 1;
+			} else {
+				if (n > end - p)
+					n = end - p;
+				if (u->onlcr) {
+					nl = memchr (p, '\n', n);
+					if (nl) {
+						n = nl - p + 1;
+						cr = 1;
+					}
+				}
+				memcpy (u->out_last, p, n);
+				p += n;
+			}
+			u->out_last += n;
+			if (u->out_last >= u->out_limit)
+				u->out_last = u->out_buf;
+		}
+		uart_transmit_start (u);
+	}
+	mutex_unlock (&u->transmitter);
+	return len;
+}
+
+/*
+ * Amount of data in the receive ring.
+ */
+static inline unsigned
+uart_in_count (uart_t *u)
+{
+	if (u->in_last >= u->in_first)
+		return u->in_last - u->in_first;
+	return (u->in_limit - u->in_first) + (u->in_last - u->in_buf);
+}
+
+/*
+ * Fast receive interrupt handler: move the received data
+ * to the ring. Return 0, when the reading tasks must be woken:
+ * the watermark is reached or the ring is full.
+ * The interrupt is allowed again here, unless the ring is full:
+ * then reception is restarted by uart_receive_resume().
+ */
+static bool_t
+uart_receive_handler (uart_t *u)
+{
+	bool_t wake;
+#ifdef receive_block
+	int n;
+#else
+	unsigned char c = 0, *newlast;
+#endif
+
+#ifdef clear_receive_errors
+	clear_receive_errors (u->port);
+#else
+	if (test_frame_error (u->port)) {
+		/*debug_printf ("FRAME ERROR\n");*/
+		clear_frame_error (u->port);
+	}
+	if (test_parity_error (u->port)) {
+		/*debug_printf ("PARITY ERROR\n");*/
+		clear_parity_error (u->port);
+	}
+	if (test_overrun_error (u->port)) {
+		/*debug_printf ("RECEIVE OVERRUN\n");*/
+		clear_overrun_error (u->port);
+	}
+	if (test_break_error (u->port)) {
+		/*debug_printf ("BREAK DETECTED\n");*/
+		clear_break_error (u->port);
+	}
+#endif
+	u->in_full = 0;
+#ifdef receive_block
+	/* Get all available data by contiguous runs.
+	 * When the ring is full, the data are left in the hardware. */
+	for (;;) {
+		if (u->in_last < u->in_first)
+			n = u->in_first - u->in_last - 1;
+		else
+			n = u->in_limit - u->in_last -
+				(u->in_first == u->in_buf);
+		if (n == 0) {
+			u->in_full = 1;
+			break;
+		}
+		n = receive_block (u->port, u->in_last, n);
+		if (n <= 0)
+			break;
+		u->in_last += n;
+		if (u->in_last >= u->in_limit)
+			u->in_last = u->in_buf;
+	}
+#else
+	/* Check that receive data is available,
+	 * and get the received bytes. */
+	while (test_get_receive_data (u->port, &c)) {
+/*debug_printf ("%02x", c);*/
+		newlast = u->in_last + 1;
+		if (newlast >= u->in_limit)
+			newlast = u->in_buf;
+
+		/* Ignore input on buffer overflow. */
+		if (u->in_first == newlast) {
+			++u->overruns;
+			u->in_full = 1;
+			continue;
+		}
+		*u->in_last = c;
+		u->in_last = newlast;
+	}
+#endif
+#if UART_BUFFERED
+	if (u->timer) {
+		u->in_time = u->timer->milliseconds;
+		u->in_idle = 0;
+	}
+#endif
+#if UART_BUFFERED
+	wake = u->in_full || uart_in_count (u) >= u->in_watermark;
+#else
+	wake = u->in_full || u->in_first != u->in_last;
+#endif
+#ifndef TRANSMIT_IRQ
+	/* The interrupt is shared with the transmitter:
+	 * wake the receive task to restart it. */
+	if (test_transmitter_enabled (u->port))
+		wake = 1;
+#endif
+	if (! u->in_full)
+		arch_intr_allow (RECEIVE_IRQ (u->port));
+	if (! wake)
+		return 1;
+	++u->wakeups;
+	return 0;
+}
+
+/*
+ * Restart the reception, stopped when the receive ring was full.
+ */
+static inline void
+uart_receive_resume (uart_t *u)
+{
+	if (u->in_full) {
+		u->in_full = 0;
+#ifdef receive_block
+		/* Get the data, left in the hardware. */
+		uart_receive_handler (u);
+#else
+		arch_intr_allow (RECEIVE_IRQ (u->port));
+#endif
+	}
+}
+
 /*
  * Wait for the byte to be received and return it.
  */
@@ -150,8 +354,9 @@ uart_getchar (uart_t *u)
 		mutex_wait (&u->receiver);
 	/* TODO: utf8 to unicode conversion. */
 	c = *u->in_first++;
-	if (u->in_first >= u->in_buf + UART_INBUFSZ)
+	if (u->in_first >= u->in_limit)
 		u->in_first = u->in_buf;
+	uart_receive_resume (u);
 
 	mutex_unlock (&u->receiver);
 	return c;
@@ -169,6 +374,37 @@ uart_peekchar (uart_t *u)
 	return c;
 }
 
+/*
+ * Wait for received data and get all available bytes, up to len.
+ */
+int
+uart_read (uart_t *u, void *buf, int len)
+{
+	unsigned char *p = buf;
+	int n, got = 0;
+
+	mutex_lock (&u->receiver);
+
+	/* Wait until receive data available. */
+	while (u->in_first == u->in_last)
+		mutex_wait (&u->receiver);
+	while (got < len && u->in_first != u->in_last) {
+		/* Contiguous run of data. */
+		n = ((u->in_last > u->in_first) ? u->in_last : u->in_limit) -
+			u->in_first;
+		if (n > len - got)
+			n = len - got;
+		memcpy (p + got, u->in_first, n);
+		got += n;
+		u->in_first += n;
+		if (u->in_first >= u->in_limit)
+			u->in_first = u->in_buf;
+		uart_receive_resume (u);
+	}
+	mutex_unlock (&u->receiver);
+	return got;
+}
+
 /*
  * Receive interrupt task.
  */
@@ -176,7 +412,10 @@ static void
 uart_receiver (void *arg)
 {
 	uart_t *u = arg;
-	unsigned char c = 0, *newlast;
+#if UART_BUFFERED
+	mutex_group_t *g;
+	mutex_t *m;
+#endif
 
 	/*
 	 * Enable transmitter.
@@ -190,54 +429,49 @@ uart_receiver (void *arg)
 	/*
 	 * Enable receiver.
 	 */
-	mutex_lock_irq (&u->receiver, RECEIVE_IRQ (u->port), 0, 0);
+	mutex_lock_irq (&u->receiver, RECEIVE_IRQ (u->port),
+		(handler_t) uart_receive_handler, u);
 	enable_receiver (u->port);
 	enable_receive_interrupt (u->port);
 
-	for (;;) {
-		mutex_wait (&u->receiver);
-
-#ifdef clear_receive_errors
-		clear_receive_errors (u->port);
+#if UART_BUFFERED
+	while (! u->timer) {
 #else
-		if (test_frame_error (u->port)) {
-			/*debug_printf ("FRAME ERROR\n");*/
-			clear_frame_error (u->port);
-		}
-		if (test_parity_error (u->port)) {
-			/*debug_printf ("PARITY ERROR\n");*/
-			clear_parity_error (u->port);
-		}
-		if (test_overrun_error (u->port)) {
-			/*debug_printf ("RECEIVE OVERRUN\n");*/
-			clear_overrun_error (u->port);
-		}
-		if (test_break_error (u->port)) {
-			/*debug_printf ("BREAK DETECTED\n");*/
-			clear_break_error (u->port);
-		}
+	for (;;) {
 #endif
+		mutex_wait (&u->receiver);
 #ifndef TRANSMIT_IRQ
 		if (test_transmitter_enabled (u->port))
 			uart_transmit_start (u);
 #endif
-		/* Check that receive data is available,
-		 * and get the received byte. */
-		if (! test_get_receive_data (u->port, &c))
-			continue;
-/*debug_printf ("%02x", c);*/
-
-		newlast = u->in_last + 1;
-		if (newlast >= u->in_buf + UART_INBUFSZ)
-			newlast = u->in_buf;
-
-		/* Ignore input on buffer overflow. */
-		if (u->in_first == newlast)
-			continue;
+	}
+#if UART_BUFFERED
+	mutex_unlock (&u->receiver);
 
-		*u->in_last = c;
-		u->in_last = newlast;
+	/*
+	 * Idle line timeout: look at the receive ring on every timer tick.
+	 */
+	g = mutex_group_init (u->group, sizeof (u->group));
+	mutex_group_add (g, &u->receiver);
+	mutex_group_add (g, &u->timer->lock);
+	mutex_group_listen (g);
+	for (;;) {
+		mutex_group_wait (g, &m, 0);
+		mutex_lock (&u->receiver);
+		if (m == &u->receiver) {
+#ifndef TRANSMIT_IRQ
+			if (test_transmitter_enabled (u->port))
+				uart_transmit_start (u);
+#endif
+		} else if (! u->in_idle && u->in_first != u->in_last &&
+		    u->timer->milliseconds - u->in_time >= u->idle_msec) {
+			u->in_idle = 1;
+			++u->wakeups;
+			mutex_signal (&u->receiver, 0);
+		}
+		mutex_unlock (&u->receiver);
 	}
+#endif
 }
 
 mutex_t *
@@ -252,15 +486,68 @@ static stream_interface_t uart_interface = {
 	.peekc = (int (*) (stream_t*))			uart_peekchar,
 	.flush = (void (*) (stream_t*))			uart_fflush,
 	.receiver = (mutex_t *(*) (stream_t*))		uart_receive_lock,
+	.write = (int (*) (stream_t*, const void*, int))	uart_write,
+	.read = (int (*) (stream_t*, void*, int))		uart_read,
 };
 
+#if UART_BUFFERED
+bool_t
+uart_set_buffers (uart_t *u, mem_pool_t *pool, unsigned insz, unsigned outsz)
+{
+	unsigned char *in, *out;
+
+	in = mem_alloc_dirty (pool, insz);
+	if (! in)
+		return 0;
+	out = mem_alloc_dirty (pool, outsz);
+	if (! out) {
+		mem_free (in);
+		return 0;
+	}
+	uart_fflush (u);
+	mutex_lock (&u->transmitter);
+	mutex_lock (&u->receiver);
+	if (u->in_buf != u->in_data)
+		mem_free (u->in_buf);
+	if (u->out_buf != u->out_data)
+		mem_free (u->out_buf);
+	u->in_buf = u->in_first = u->in_last = in;
+	u->in_limit = in + insz;
+	u->out_buf = u->out_first = u->out_last = out;
+	u->out_limit = out + outsz;
+	uart_receive_resume (u);
+	mutex_unlock (&u->receiver);
+	mutex_unlock (&u->transmitter);
+	return 1;
+}
+
+void
+uart_set_watermark (uart_t *u, unsigned bytes, timer_t *timer, unsigned msec)
+{
+	mutex_lock (&u->receiver);
+	u->in_watermark = bytes ? bytes : 1;
+	u->idle_msec = msec;
+	if (timer && ! u->timer) {
+		/* Switch the receive task to the timer. */
+		u->timer = timer;
+		mutex_signal (&u->receiver, 0);
+	}
+	mutex_unlock (&u->receiver);
+}
+#endif
+
 void
 uart_init (uart_t *u, small_uint_t port, int prio, unsigned int khz,
 	unsigned long baud)
 {
 	u->interface = &uart_interface;
-	u->in_first = u->in_last = u->in_buf;
-	u->out_first = u->out_last = u->out_buf;
+	u->in_buf = u->in_first = u->in_last = u->in_data;
+	u->in_limit = u->in_data + UART_INBUFSZ;
+	u->out_buf = u->out_first = u->out_last = u->out_data;
+	u->out_limit = u->out_data + UART_OUTBUFSZ;
+#if UART_BUFFERED
+	u->in_watermark = 1;
+#endif
 	u->khz = khz;
 	u->onlcr = 1;
 #if (ARM_1986BE9 || ARM_1986BE1)
@@ -28,25 +28,50 @@
 #endif
 
 /**\~english
- * Size of input buffer.
+ * Default size of input buffer.
+ * Larger buffer can be allocated by uart_set_buffers().
  *
  * \~russian
- * Размер буфера ввода.
+ * Размер буфера ввода по умолчанию.
+ * Буфер большего размера можно выделить вызовом uart_set_buffers().
  */
 #ifndef UART_INBUFSZ
 #define UART_INBUFSZ	8
 #endif
 
 /**\~english
- * Size of output buffer.
+ * Default size of output buffer.
  *
  * \~russian
- * Размер буфера вывода.
+ * Размер буфера вывода по умолчанию.
  */
 #ifndef UART_OUTBUFSZ
 #define UART_OUTBUFSZ	32
 #endif
 
+/**\~english
+ * Rings from a memory pool and watermark wakeups: uart_set_buffers()
+ * and uart_set_watermark(). Needs the mem and timer modules and
+ * takes about 60 bytes of RAM per port on AVR and MSP430, so it is
+ * disabled there by default.
+ *
+ * \~russian
+ * Буферы из пула памяти и пробуждение по порогу: uart_set_buffers()
+ * и uart_set_watermark(). Требует модулей mem и timer и занимает
+ * около 60 байт ОЗУ на порт для AVR и MSP430, поэтому там
+ * по умолчанию отключено.
+ */
+#ifndef UART_BUFFERED
+#   if __AVR__ || MSP430
+#      define UART_BUFFERED	0
+#   else
+#      define UART_BUFFERED	1
+#   endif
+#endif
+
+struct _mem_pool_t;
+struct _timer_t;
+
 /**\~english
  * Data structure of UART driver.
  *
@@ -60,12 +85,28 @@ typedef struct _uart_t {
 	small_uint_t port;
 	bool_t onlcr;
 	unsigned int khz;
-	unsigned char out_buf [UART_OUTBUFSZ];
+	unsigned char *out_buf, *out_limit;	/* transmit ring */
 	unsigned char *out_first, *out_last;
-	unsigned char in_buf [UART_INBUFSZ];
+	unsigned char *in_buf, *in_limit;	/* receive ring */
 	unsigned char *in_first, *in_last;
 	bool_t (*cts_query) (struct _uart_t*);
 
+#if UART_BUFFERED
+	unsigned in_watermark;		/* wake readers at this amount of data */
+	struct _timer_t *timer;		/* for idle line timeout */
+	unsigned idle_msec;		/* wake readers after this pause */
+	unsigned long in_time;		/* when last data received */
+	bool_t in_idle;			/* readers woken by timeout */
+#endif
+	bool_t in_full;			/* data left in hardware, ring full */
+	unsigned long overruns;		/* bytes lost: receive ring full */
+	unsigned long wakeups;		/* readers woken */
+
+	unsigned char out_data [UART_OUTBUFSZ];	/* default buffers */
+	unsigned char in_data [UART_INBUFSZ];
+#if UART_BUFFERED
+	ARRAY (group, sizeof(mutex_group_t) + sizeof(mutex_slot_t));
+#endif
 	ARRAY (rstack, UART_STACKSZ);		/* task receive stack */
 } uart_t;
 
@@ -75,6 +116,30 @@ void uart_set_cts_poller (uart_t *u, bool_t (*) (uart_t*));
 void uart_cts_ready (uart_t *u);
 void uart_transmit_wait (uart_t *u);
 
+#if UART_BUFFERED
+/*
+ * Allocate the receive and transmit rings from the pool.
+ * Pending input is discarded. Return 0 when no memory.
+ */
+bool_t uart_set_buffers (uart_t *u, struct _mem_pool_t *pool,
+	unsigned insz, unsigned outsz);
+
+/*
+ * Wake reading tasks only when `bytes' are received, or when
+ * the line is idle for `msec' milliseconds (needs the timer).
+ * By default the readers are woken on every received byte.
+ */
+void uart_set_watermark (uart_t *u, unsigned bytes,
+	struct _timer_t *timer, unsigned msec);
+#endif
+
 unsigned short uart_getchar (uart_t *u);
 int uart_peekchar (uart_t *u);
 void uart_putchar (uart_t *u, short c);
+
+/*
+ * Bulk transfer. Write returns when all data are queued.
+ * Read waits for data and returns all available, up to len.
+ */
+int uart_write (uart_t *u, const void *buf, int len);
+int uart_read (uart_t *u, void *buf, int len);
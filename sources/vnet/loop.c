@@ -0,0 +1,68 @@
+/*
+ * Software loopback network interface.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <buf/buf.h>
+#include <vnet/loop.h>
+
+/*
+ * Put the packet to the input queue and wake up the IP task.
+ */
+static bool_t
+loop_output (loop_t *u, buf_t *p, small_uint_t prio)
+{
+	p = buf_make_continuous (p);
+	if (! p) {
+		++u->netif.out_discards;
+		return 0;
+	}
+	mutex_lock (&u->netif.lock);
+	if (buf_queue_is_full (&u->inq)) {
+		++u->netif.out_discards;
+		mutex_unlock (&u->netif.lock);
+		buf_free (p);
+		return 0;
+	}
+	++u->netif.out_packets;
+	u->netif.out_bytes += p->tot_len;
+	++u->netif.in_packets;
+	u->netif.in_bytes += p->tot_len;
+	buf_queue_put (&u->inq, p);
+	mutex_signal (&u->netif.lock, 0);
+	mutex_unlock (&u->netif.lock);
+	return 1;
+}
+
+static buf_t *
+loop_input (loop_t *u)
+{
+	buf_t *p;
+
+	mutex_lock (&u->netif.lock);
+	p = buf_queue_get (&u->inq);
+	mutex_unlock (&u->netif.lock);
+	return p;
+}
+
+static netif_interface_t loop_interface = {
+	(bool_t (*) (netif_t*, buf_t*, small_uint_t))
+						loop_output,
+	(buf_t *(*) (netif_t*))			loop_input,
+	0,
+};
+
+/*
+ * Set up the network interface.
+ */
+void
+loop_init (loop_t *u, const char *name)
+{
+	u->netif.interface = &loop_interface;
+	u->netif.name = name;
+	u->netif.arp = 0;
+	u->netif.mtu = 1500;
+	u->netif.type = NETIF_SOFTWARELOOPBACK;
+	u->netif.bps = 0;
+	buf_queue_init (&u->inq, u->inqdata, sizeof (u->inqdata));
+}
@@ -0,0 +1,27 @@
+/*
+ * Software loopback network interface.
+ */
+#ifndef __VNET_LOOP_H_
+#define	__VNET_LOOP_H_ 1
+
+#include <net/netif.h>
+#include <buf/buf-queue.h>
+
+#ifndef LOOP_INQ_SIZE
+#   define LOOP_INQ_SIZE	16
+#endif
+
+typedef struct _loop_t {
+	netif_t netif;			/* common network interface part */
+	buf_queue_t inq;		/* queue of looped packets */
+	struct _buf_t *inqdata [LOOP_INQ_SIZE];
+} loop_t;
+
+/*
+ * Set up the loopback interface. Every packet, sent to the interface,
+ * is received back on it. The interface has no ARP, so use it as
+ * a point-to-point link, for example with address 127.0.0.1/8.
+ */
+void loop_init (loop_t *u, const char *name);
+
+#endif /* !__VNET_LOOP_H_ */
@@ -0,0 +1,342 @@
+/*
+ * In-process virtual Ethernet switch.
+ */
+#include <runtime/lib.h>
+#include <kernel/uos.h>
+#include <mem/mem.h>
+#include <buf/buf.h>
+#include <timer/timer.h>
+#include <random/rand15.h>
+#include <vnet/vswitch.h>
+
+/*
+ * Put the frame to the receive queue of the port
+ * and wake up the IP task, listening on it.
+ */
+static void
+vswitch_deliver (vswitch_port_t *u, buf_t *p)
+{
+	mutex_lock (&u->netif.lock);
+	if (buf_queue_is_full (&u->inq)) {
+		++u->netif.in_discards;
+		mutex_unlock (&u->netif.lock);
+		buf_free (p);
+		return;
+	}
+	++u->netif.in_packets;
+	u->netif.in_bytes += p->tot_len;
+	if (p->payload[0] & 1)
+		++u->netif.in_mcast_pkts;
+	buf_queue_put (&u->inq, p);
+	mutex_signal (&u->netif.lock, 0);
+	mutex_unlock (&u->netif.lock);
+}
+
+/*
+ * Time from `a' to `b' in milliseconds. The timer counts
+ * milliseconds of a day, so the difference is taken modulo a day.
+ */
+static long
+vswitch_msec_diff (unsigned long b, unsigned long a)
+{
+	long d = (long) (b - a);
+
+	if (d >= (long) (TIMER_MSEC_PER_DAY / 2))
+		d -= TIMER_MSEC_PER_DAY;
+	else if (d < - (long) (TIMER_MSEC_PER_DAY / 2))
+		d += TIMER_MSEC_PER_DAY;
+	return d;
+}
+
+/*
+ * Pass the frame through the emulated link: drop, delay or deliver it.
+ * Called with switch locked.
+ */
+static void
+vswitch_transmit (vswitch_t *sw, vswitch_port_t *from, vswitch_port_t *to,
+	buf_t *p)
+{
+	vswitch_frame_t *f;
+	unsigned long now, start;
+	unsigned usec, extra = 0;
+
+	if (sw->loss && rand15 () % 1000 < sw->loss) {
+		++sw->lost;
+		buf_free (p);
+		return;
+	}
+	if (sw->reorder && rand15 () % 1000 < sw->reorder) {
+		++sw->reordered;
+		extra = sw->jitter ? sw->jitter : 1;
+	}
+	if (! sw->timer || (! sw->delay && ! sw->bps && ! extra)) {
+		++sw->forwarded;
+		vswitch_deliver (to, p);
+		return;
+	}
+	if (sw->delayed >= VSWITCH_DELAYQ_SIZE) {
+		/* Link is congested: tail drop. */
+		++sw->overflows;
+		++from->netif.out_discards;
+		buf_free (p);
+		return;
+	}
+
+	/* Compute the time when the last bit leaves the transmitter. */
+	now = timer_milliseconds (sw->timer);
+	start = now;
+	if (sw->bps) {
+		/* With the queue empty, all transmitters are idle:
+		 * their busy time is behind the last delivery. */
+		usec = 0;
+		if (sw->delayed > 0 &&
+		    vswitch_msec_diff (from->busy_until, now) >= 0) {
+			start = from->busy_until;
+			usec = from->busy_usec;
+		}
+		usec += (unsigned long) p->tot_len * 8000 /
+			(sw->bps < 1000 ? 1 : sw->bps / 1000);
+		start = (start + usec / 1000) % TIMER_MSEC_PER_DAY;
+		from->busy_until = start;
+		from->busy_usec = usec % 1000;
+	}
+	f = &sw->delayq [sw->delayed++];
+	f->p = p;
+	f->port = to;
+	f->due = (start + sw->delay + extra) % TIMER_MSEC_PER_DAY;
+	++sw->forwarded;
+
+	/* Wake up the delivery task. */
+	if (sw->delayed == 1)
+		mutex_signal (&sw->lock, 0);
+}
+
+/*
+ * Find the port by destination MAC address.
+ * Return 0 for broadcasts, multicasts and unknown addresses.
+ */
+static vswitch_port_t *
+vswitch_lookup (vswitch_t *sw, unsigned char *addr)
+{
+	vswitch_mac_t *m;
+
+	if (addr[0] & 1)
+		return 0;
+	for (m = sw->mac; m < sw->mac + VSWITCH_MACTAB_SIZE; ++m)
+		if (m->port && memcmp (m->addr, addr, 6) == 0)
+			return m->port;
+	return 0;
+}
+
+/*
+ * Remember the port, on which the source MAC address was seen.
+ */
+static void
+vswitch_learn (vswitch_t *sw, vswitch_port_t *u, unsigned char *addr)
+{
+	vswitch_mac_t *m;
+
+	for (m = sw->mac; m < sw->mac + VSWITCH_MACTAB_SIZE; ++m)
+		if (m->port && memcmp (m->addr, addr, 6) == 0) {
+			m->port = u;
+			return;
+		}
+	m = &sw->mac [sw->mac_next];
+	if (++sw->mac_next >= VSWITCH_MACTAB_SIZE)
+		sw->mac_next = 0;
+	memcpy (m->addr, addr, 6);
+	m->port = u;
+}
+
+/*
+ * Send the frame to the switch.
+ */
+static bool_t
+vswitch_output (vswitch_port_t *u, buf_t *p, small_uint_t prio)
+{
+	vswitch_t *sw = u->sw;
+	vswitch_port_t *to, **v;
+	buf_t *q;
+
+	p = buf_make_continuous (p);
+	if (! p) {
+		++u->netif.out_discards;
+		return 0;
+	}
+	if (p->len < 14) {
+		++u->netif.out_errors;
+		buf_free (p);
+		return 0;
+	}
+	mutex_lock (&u->netif.lock);
+	++u->netif.out_packets;
+	u->netif.out_bytes += p->tot_len;
+	if (p->payload[0] & 1)
+		++u->netif.out_mcast_pkts;
+	mutex_unlock (&u->netif.lock);
+
+	mutex_lock (&sw->lock);
+	vswitch_learn (sw, u, p->payload + 6);
+	to = vswitch_lookup (sw, p->payload);
+	if (to) {
+		if (to != u)
+			vswitch_transmit (sw, u, to, p);
+		else
+			buf_free (p);
+		mutex_unlock (&sw->lock);
+		return 1;
+	}
+
+	/* Flood to all other ports. */
+	++sw->flooded;
+	to = 0;
+	for (v = sw->port; v < sw->port + sw->nports; ++v) {
+		if (*v == u)
+			continue;
+		if (to) {
+			q = buf_copy (p);
+			if (q)
+				vswitch_transmit (sw, u, to, q);
+			else
+				++u->netif.out_discards;
+		}
+		to = *v;
+	}
+	if (to)
+		vswitch_transmit (sw, u, to, p);
+	else
+		buf_free (p);
+	mutex_unlock (&sw->lock);
+	return 1;
+}
+
+static buf_t *
+vswitch_input (vswitch_port_t *u)
+{
+	buf_t *p;
+
+	mutex_lock (&u->netif.lock);
+	p = buf_queue_get (&u->inq);
+	mutex_unlock (&u->netif.lock);
+	return p;
+}
+
+static void
+vswitch_set_address (vswitch_port_t *u, unsigned char *addr)
+{
+	mutex_lock (&u->netif.lock);
+	memcpy (&u->netif.ethaddr, addr, 6);
+	mutex_unlock (&u->netif.lock);
+}
+
+/*
+ * Deliver all frames, which time has come. Keep the order
+ * of the remaining frames. Called with switch locked.
+ */
+static void
+vswitch_deliver_due (vswitch_t *sw, unsigned long now)
+{
+	vswitch_frame_t *f, *last;
+
+	last = sw->delayq;
+	for (f = sw->delayq; f < sw->delayq + sw->delayed; ++f) {
+		if (vswitch_msec_diff (now, f->due) >= 0) {
+			vswitch_deliver (f->port, f->p);
+			continue;
+		}
+		if (last != f)
+			*last = *f;
+		++last;
+	}
+	sw->delayed = last - sw->delayq;
+}
+
+/*
+ * Delivery task: on every timer tick pass the delayed frames
+ * to their destination ports.
+ */
+static void
+vswitch_main (void *arg)
+{
+	vswitch_t *sw = arg;
+	unsigned long now;
+
+	for (;;) {
+		mutex_lock (&sw->lock);
+		while (! sw->delayed)
+			mutex_wait (&sw->lock);
+		mutex_unlock (&sw->lock);
+
+		/* Wait for the next timer tick. */
+		mutex_lock (&sw->timer->lock);
+		mutex_wait (&sw->timer->lock);
+		now = sw->timer->milliseconds;
+		mutex_unlock (&sw->timer->lock);
+
+		mutex_lock (&sw->lock);
+		vswitch_deliver_due (sw, now);
+		mutex_unlock (&sw->lock);
+	}
+}
+
+static netif_interface_t vswitch_interface = {
+	(bool_t (*) (netif_t*, buf_t*, small_uint_t))
+						vswitch_output,
+	(buf_t *(*) (netif_t*))			vswitch_input,
+	(void (*) (netif_t*, unsigned char*))	vswitch_set_address,
+};
+
+/*
+ * Initialize the switch.
+ */
+void
+vswitch_init (vswitch_t *sw, timer_t *timer, int prio)
+{
+	sw->timer = timer;
+	if (timer)
+		task_create (vswitch_main, sw, "vswitch", prio,
+			sw->stack, sizeof (sw->stack));
+}
+
+/*
+ * Set parameters of the emulated link.
+ */
+void
+vswitch_set_link (vswitch_t *sw, unsigned delay, unsigned jitter,
+	unsigned loss, unsigned reorder, unsigned long bps)
+{
+	vswitch_port_t **v;
+
+	mutex_lock (&sw->lock);
+	sw->delay = delay;
+	sw->jitter = jitter;
+	sw->loss = loss;
+	sw->reorder = reorder;
+	sw->bps = bps;
+	for (v = sw->port; v < sw->port + sw->nports; ++v)
+		(*v)->netif.bps = bps ? bps : 100000000;
+	mutex_unlock (&sw->lock);
+}
+
+/*
+ * Attach a new port to the switch.
+ */
+void
+vswitch_port_init (vswitch_port_t *u, vswitch_t *sw, const char *name,
+	struct _arp_t *arp, const unsigned char *macaddr)
+{
+	u->netif.interface = &vswitch_interface;
+	u->netif.name = name;
+	u->netif.arp = arp;
+	u->netif.mtu = 1500;
+	u->netif.type = NETIF_ETHERNET_CSMACD;
+	u->netif.bps = sw->bps ? sw->bps : 100000000;
+	memcpy (u->netif.ethaddr, macaddr, 6);
+	u->sw = sw;
+	buf_queue_init (&u->inq, u->inqdata, sizeof (u->inqdata));
+
+	mutex_lock (&sw->lock);
+	assert (sw->nports < VSWITCH_MAXPORTS);
+	sw->port [sw->nports++] = u;
+	mutex_unlock (&sw->lock);
+}
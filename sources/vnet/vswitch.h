@@ -0,0 +1,117 @@
+/*
+ * In-process virtual Ethernet switch.
+ *
+ * Connects several network stacks (ip_t instances) running in one
+ * program, without any hardware or privileges. Every port of the switch
+ * is a regular Ethernet network interface. The link between ports can
+ * emulate delay, loss, reordering and limited bandwidth.
+ */
+#ifndef __VNET_VSWITCH_H_
+#define	__VNET_VSWITCH_H_ 1
+
+#include <net/netif.h>
+#include <buf/buf-queue.h>
+
+#ifndef VSWITCH_STACKSZ
+#   if LINUX386
+#      define VSWITCH_STACKSZ	4000
+#   else
+#      define VSWITCH_STACKSZ	1000
+#   endif
+#endif
+
+#ifndef VSWITCH_MAXPORTS
+#   define VSWITCH_MAXPORTS	8	/* max number of ports */
+#endif
+
+#ifndef VSWITCH_INQ_SIZE
+#   define VSWITCH_INQ_SIZE	32	/* receive queue of a port */
+#endif
+
+#ifndef VSWITCH_DELAYQ_SIZE
+#   define VSWITCH_DELAYQ_SIZE	64	/* frames in flight */
+#endif
+
+#ifndef VSWITCH_MACTAB_SIZE
+#   define VSWITCH_MACTAB_SIZE	32	/* learned MAC addresses */
+#endif
+
+struct _timer_t;
+struct _vswitch_t;
+
+typedef struct _vswitch_port_t {
+	netif_t netif;			/* common network interface part */
+	struct _vswitch_t *sw;		/* switch we are connected to */
+	buf_queue_t inq;		/* queue of received packets */
+	struct _buf_t *inqdata [VSWITCH_INQ_SIZE];
+	unsigned long busy_until;	/* transmitter is busy, milliseconds */
+	unsigned busy_usec;		/* ...and microseconds */
+} vswitch_port_t;
+
+typedef struct _vswitch_frame_t {
+	struct _buf_t *p;		/* the frame */
+	vswitch_port_t *port;		/* destination port */
+	unsigned long due;		/* time of delivery, milliseconds */
+} vswitch_frame_t;
+
+typedef struct _vswitch_mac_t {
+	unsigned char addr [6];		/* learned source address */
+	vswitch_port_t *port;		/* port it was seen on */
+} vswitch_mac_t;
+
+typedef struct _vswitch_t {
+	mutex_t lock;
+	struct _timer_t *timer;		/* time source for link emulation */
+
+	small_uint_t nports;
+	vswitch_port_t *port [VSWITCH_MAXPORTS];
+
+	vswitch_mac_t mac [VSWITCH_MACTAB_SIZE];
+	small_uint_t mac_next;		/* next entry to replace */
+
+	/* Link emulation parameters. */
+	unsigned delay;			/* one-way delay, milliseconds */
+	unsigned jitter;		/* extra delay of reordered frames */
+	unsigned loss;			/* frame loss rate, 1/1000 */
+	unsigned reorder;		/* frame reorder rate, 1/1000 */
+	unsigned long bps;		/* link speed, 0 - unlimited */
+
+	/* Frames in flight, delayed by link emulation. */
+	vswitch_frame_t delayq [VSWITCH_DELAYQ_SIZE];
+	small_uint_t delayed;
+
+	/* Statistics. */
+	unsigned long forwarded;	/* frames passed to ports */
+	unsigned long flooded;		/* frames sent to all ports */
+	unsigned long lost;		/* frames dropped by loss emulation */
+	unsigned long reordered;	/* frames delivered out of order */
+	unsigned long overflows;	/* delay queue overflows */
+
+	ARRAY (stack, VSWITCH_STACKSZ);	/* task delivering delayed frames */
+} vswitch_t;
+
+/*
+ * Initialize the switch. The structure must be zeroed.
+ * Timer is needed only for link emulation (delay, reordering or
+ * bandwidth limit); with timer=0 frames are delivered immediately.
+ */
+void vswitch_init (vswitch_t *sw, struct _timer_t *timer, int prio);
+
+/*
+ * Set parameters of the emulated link:
+ *	delay	- one-way delay in milliseconds
+ *	jitter	- additional delay of reordered frames, milliseconds
+ *	loss	- rate of lost frames, per 1000
+ *	reorder	- rate of reordered frames, per 1000
+ *	bps	- bandwidth of every port in bits per second, 0 - unlimited
+ */
+void vswitch_set_link (vswitch_t *sw, unsigned delay, unsigned jitter,
+	unsigned loss, unsigned reorder, unsigned long bps);
+
+/*
+ * Attach a new port to the switch.
+ */
+void vswitch_port_init (vswitch_port_t *u, vswitch_t *sw, const char *name,
+	struct _arp_t *arp, const unsigned char *macaddr);
+
+#endif /* !__VNET_VSWITCH_H_ */